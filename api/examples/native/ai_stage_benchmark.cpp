@@ -0,0 +1,149 @@
+/**
+ * @file ai_stage_benchmark.cpp
+ * @brief Benchmark of the native API AI stage on the mock inference backend
+ *
+ * Feeds 640x640 NV12 frames through the HailortAsyncStage with the mock inference backend in place of HailoRT, into a
+ * sink stage, on the native pipeline threads. Reports the latency from pushing a frame to the AI stage until its output
+ * reaches the sink, and the frames per second - the queueing, batching and callback overhead of the stage on top of the
+ * mock inference time. The frame pools come from the heap, so it needs no CMA allocator, Hailo device or network.
+ * The source keeps at most two batches in flight, so the leaky stage queues never drop a frame.
+ * Usage: ai_stage_benchmark [frames] [inference time in us] [inferences per second, 0 for unlimited] [batch size]
+ **/
+#include "infra/stages.hpp"
+#include "infra/hailort_stage.hpp"
+#include "infra/pipeline.hpp"
+#include "media_library/mock_inference_backend.hpp"
+#include "benchmark_utils.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+#define BENCHMARK_FRAME_WIDTH (640)
+#define BENCHMARK_FRAME_HEIGHT (640)
+#define BENCHMARK_OUTPUT_FRAME_SIZE (160320)
+
+/**
+ * @brief Collects the AI stage outputs, matching them in order to the submit times of the source
+ */
+class LatencySinkStage : public Stage<BufferPtr>
+{
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::chrono::steady_clock::time_point> m_submit_times;
+    BenchmarkLatency m_latency;
+
+public:
+    LatencySinkStage(std::string name, size_t queue_size) :
+        Stage<BufferPtr>(name, queue_size, drop_buffer), m_latency("ai stage latency") {}
+
+    void submitted(std::chrono::steady_clock::time_point submit_time)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_submit_times.push_back(submit_time);
+    }
+
+    void wait_for_in_flight(size_t max_in_flight)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            return m_submit_times.size() < max_in_flight;
+        });
+    }
+
+    int process(BufferPtr data) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_submit_times.empty())
+        {
+            std::cerr << "Output without a submitted frame" << std::endl;
+            return ERROR;
+        }
+        m_latency.add(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_submit_times.front()).count());
+        m_submit_times.pop_front();
+        lock.unlock();
+        m_cv.notify_all();
+
+        return SUCCESS;
+    }
+
+    void print()
+    {
+        m_latency.print();
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+    int inference_us = argc > 2 ? atoi(argv[2]) : 5000;
+    int fps = argc > 3 ? atoi(argv[3]) : 0;
+    int batch_size = argc > 4 ? atoi(argv[4]) : 4;
+    if (frames <= 0 || inference_us < 0 || fps < 0 || batch_size <= 0 || frames % batch_size != 0)
+    {
+        std::cout << "Usage: " << argv[0] << " [frames, a multiple of the batch size] [inference time in us] "
+                  << "[inferences per second, 0 for unlimited] [batch size]" << std::endl;
+        return 1;
+    }
+    size_t max_in_flight = 2 * batch_size;
+
+    size_t y_size = BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT;
+    mock_inference_config_t mock_config;
+    mock_config.frame_sizes = {y_size, y_size / 2, BENCHMARK_OUTPUT_FRAME_SIZE};
+    mock_config.outputs = {false, false, true};
+    mock_config.latency = std::chrono::microseconds(inference_us);
+    mock_config.fps = fps;
+    mock_config.max_in_flight = batch_size;
+    // The stage writes no data of its own, skip the copy so only the stage overhead is measured
+    mock_config.transform = [](const std::vector<inference_buffer_t> &buffers) {};
+    std::shared_ptr<MockInferenceBackend> backend = std::make_shared<MockInferenceBackend>(mock_config);
+
+    MediaLibraryBufferPoolPtr input_pool = std::make_shared<MediaLibraryBufferPool>(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, DSP_IMAGE_FORMAT_NV12,
+                                                                                    max_in_flight + 1, HEAP, "ai_stage_benchmark");
+    if (input_pool->init() != MEDIA_LIBRARY_SUCCESS)
+    {
+        std::cerr << "Failed to init the input buffer pool" << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<HailortAsyncStage> ai_stage = std::make_shared<HailortAsyncStage>("hrt_detector", max_in_flight, max_in_flight + 1, "", "0",
+                                                                                      batch_size, backend);
+    std::shared_ptr<LatencySinkStage> sink_stage = std::make_shared<LatencySinkStage>("latency_sink", max_in_flight);
+    ai_stage->add_subscriber(sink_stage);
+
+    Pipeline pipeline;
+    pipeline.add_stage(ai_stage);
+    pipeline.add_stage(sink_stage);
+    pipeline.run_pipeline();
+
+    std::cout << frames << " frames of " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT << " through the AI stage, "
+              << inference_us << " us mock inference, batch " << batch_size << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        sink_stage->wait_for_in_flight(max_in_flight);
+
+        hailo_media_library_buffer *input_buffer = new hailo_media_library_buffer;
+        if (input_pool->acquire_buffer(*input_buffer) != MEDIA_LIBRARY_SUCCESS)
+        {
+            std::cerr << "Failed to acquire buffer" << std::endl;
+            delete input_buffer;
+            break;
+        }
+        BufferPtr input = create_buffer_ptr_with_deleter({{MediaLibraryBufferType::Cropped, input_buffer}});
+
+        sink_stage->submitted(std::chrono::steady_clock::now());
+        ai_stage->push(input);
+    }
+    sink_stage->wait_for_in_flight(1);
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    pipeline.stop_pipeline();
+
+    sink_stage->print();
+    printf("  %-32s %.0f frames per second\n", "ai stage", frames / elapsed_s);
+
+    return 0;
+}
@@ -2,37 +2,53 @@
 
 #include "stages.hpp"
 #include "hailo/hailort.hpp"
+#include "media_library/vdevice_registry.hpp"
+#include "media_library/inference_backend.hpp"
 
 class HailortAsyncStage : public ProducableStage<BufferPtr, BufferPtr>
 {
 private:
     MediaLibraryBufferPoolPtr m_output_buffer_pool;
-    std::unique_ptr<hailort::VDevice> m_vdevice;
+    std::shared_ptr<hailort::VDevice> m_vdevice;
+    NetworkUsagePtr m_network_usage;
     std::shared_ptr<hailort::InferModel> m_infer_model;
     hailort::ConfiguredInferModel m_configured_infer_model;
     hailort::ConfiguredInferModel::Bindings m_bindings;
+    std::string m_name;
     int m_output_pool_size;
     std::string m_hef_path;
     std::string m_group_id;
     int m_batch_size;
     std::queue<BufferPtr> m_batch_queue;
+    // Runs the jobs in place of HailoRT when set - its tensors are the Y and UV planes of the input, then the output
+    InferenceBackendPtr m_inference_backend;
+    size_t m_output_frame_size;
     
 public:
-    HailortAsyncStage(std::string name, size_t queue_size, int output_pool_size, std::string hef_path, std::string group_id, int batch_size) :
-        ProducableStage(name, queue_size, drop_buffer), m_output_pool_size(output_pool_size), m_hef_path(hef_path), m_group_id(group_id), m_batch_size(batch_size) { }
+    HailortAsyncStage(std::string name, size_t queue_size, int output_pool_size, std::string hef_path, std::string group_id, int batch_size,
+                      InferenceBackendPtr inference_backend = nullptr) :
+        ProducableStage(name, queue_size, drop_buffer), m_name(name), m_output_pool_size(output_pool_size), m_hef_path(hef_path), m_group_id(group_id), m_batch_size(batch_size),
+        m_inference_backend(inference_backend) { }
 
     int init() override
     {
-        hailo_vdevice_params_t vdevice_params = {0};
-        hailo_init_vdevice_params(&vdevice_params);
-        vdevice_params.group_id = m_group_id.c_str();
+        if (m_inference_backend) {
+            std::vector<size_t> frame_sizes = m_inference_backend->get_frame_sizes();
+            if (frame_sizes.size() != 3) {
+                std::cerr << "Inference backend has " << frame_sizes.size() << " tensors, expected the Y and UV inputs and an output" << std::endl;
+                return ERROR;
+            }
+            m_network_usage = std::make_shared<NetworkUsage>(m_name, m_group_id, network_scheduling_t{});
+            return init_output_buffer_pool(frame_sizes[2]);
+        }
 
-        auto vdevice_exp = hailort::VDevice::create(vdevice_params);
+        // Shared with the denoise and the other networks of the process, so they are scheduled together
+        auto vdevice_exp = VDeviceRegistry::get_instance().acquire_vdevice(m_group_id);
         if (!vdevice_exp) {
-            std::cerr << "Failed create vdevice, status = " << vdevice_exp.status() << std::endl;
-            return vdevice_exp.status();
+            std::cerr << "Failed to acquire vdevice, status = " << vdevice_exp.error() << std::endl;
+            return ERROR;
         }
-        m_vdevice = vdevice_exp.release();
+        m_vdevice = vdevice_exp.value();
 
         auto infer_model_exp = m_vdevice->create_infer_model(m_hef_path.c_str());
         if (!infer_model_exp) {
@@ -48,8 +64,16 @@ public:
             return configured_infer_model_exp.status();
         }
         m_configured_infer_model = configured_infer_model_exp.release();
-        m_configured_infer_model.set_scheduler_threshold(4);
-        m_configured_infer_model.set_scheduler_timeout(std::chrono::milliseconds(100));
+
+        network_scheduling_t scheduling;
+        scheduling.threshold = 4;
+        scheduling.timeout_ms = 100;
+        auto network_usage_exp = VDeviceRegistry::get_instance().register_network(m_name, m_group_id, m_configured_infer_model, scheduling);
+        if (!network_usage_exp) {
+            std::cerr << "Failed to register network, status = " << network_usage_exp.error() << std::endl;
+            return ERROR;
+        }
+        m_network_usage = network_usage_exp.value();
 
         auto bindings = m_configured_infer_model.create_bindings();
         if (!bindings) {
@@ -58,10 +82,15 @@ public:
         }
         m_bindings = bindings.release();
 
-        size_t output_frame_size = m_infer_model->output()->get_frame_size();
+        return init_output_buffer_pool(m_infer_model->output()->get_frame_size());
+    }
 
+    int init_output_buffer_pool(size_t output_frame_size)
+    {
+        m_output_frame_size = output_frame_size;
+        HailoMemoryType memory_type = m_inference_backend == nullptr || m_inference_backend->requires_dma_buffers() ? CMA : HEAP;
         m_output_buffer_pool = std::make_shared<MediaLibraryBufferPool>(output_frame_size, 1, DSP_IMAGE_FORMAT_GRAY8,
-                                                                        m_output_pool_size, CMA, output_frame_size);
+                                                                        m_output_pool_size, memory_type, output_frame_size);
 
         if (m_output_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
         {
@@ -107,8 +136,11 @@ public:
             return -1;
         }
 
-        size_t output_frame_size = m_infer_model->output()->get_frame_size();
-        auto status = m_bindings.output()->set_buffer(hailort::MemoryView(output_buffer->get_plane(0), output_frame_size));
+        if (m_inference_backend) {
+            return SUCCESS;
+        }
+
+        auto status = m_bindings.output()->set_buffer(hailort::MemoryView(output_buffer->get_plane(0), m_output_frame_size));
         if (HAILO_SUCCESS != status) {
             std::cerr << "Failed to set infer output buffer, status = " << status << std::endl;
             return status;
@@ -117,19 +149,57 @@ public:
         return SUCCESS;
     }
 
+    int infer_on_backend(HailoMediaLibraryBufferPtr input_buffer, BufferPtr output_buffer)
+    {
+        if (m_inference_backend->wait_for_ready(std::chrono::milliseconds(1000)) != 0) {
+            std::cerr << "Failed to wait for the inference backend" << std::endl;
+            return ERROR;
+        }
+
+        HailoMediaLibraryBufferPtr output_media_lib_buffer = output_buffer->media_lib_buffers_list[MediaLibraryBufferType::Hailort];
+        std::vector<inference_buffer_t> buffers = {
+            {input_buffer->get_plane(0), input_buffer->get_plane_size(0), -1},
+            {input_buffer->get_plane(1), input_buffer->get_plane_size(1), -1},
+            {output_media_lib_buffer->get_plane(0), m_output_frame_size, -1}};
+
+        auto submit_time = std::chrono::steady_clock::now();
+        // the input is held by the callback until the job is done
+        int status = m_inference_backend->infer_async(buffers, [output_buffer, input_buffer, this, submit_time](int job_status) {
+            if (job_status != 0) {
+                std::cerr << "Failed to run async infer, status = " << job_status << std::endl;
+                return;
+            }
+            m_network_usage->record(submit_time, std::chrono::steady_clock::now());
+
+            send_to_subscribers(output_buffer);
+        });
+        if (status != 0) {
+            std::cerr << "Failed to start async infer job, status = " << status << std::endl;
+            return ERROR;
+        }
+
+        return SUCCESS;
+    }
+
     int infer(HailoMediaLibraryBufferPtr input_buffer, BufferPtr output_buffer)
     {
+        if (m_inference_backend) {
+            return infer_on_backend(input_buffer, output_buffer);
+        }
+
         auto status = m_configured_infer_model.wait_for_async_ready(std::chrono::milliseconds(1000));
         if (HAILO_SUCCESS != status) {
             std::cerr << "Failed to wait for async ready, status = " << status << std::endl;
             return status;
         }
 
-        auto job = m_configured_infer_model.run_async(m_bindings, [output_buffer, input_buffer, this](const hailort::AsyncInferCompletionInfo& completion_info) {
+        auto submit_time = std::chrono::steady_clock::now();
+        auto job = m_configured_infer_model.run_async(m_bindings, [output_buffer, input_buffer, this, submit_time](const hailort::AsyncInferCompletionInfo& completion_info) {
             if (completion_info.status != HAILO_SUCCESS) {
                 std::cerr << "Failed to run async infer, status = " << completion_info.status << std::endl;
                 return ERROR;
             }
+            m_network_usage->record(submit_time, std::chrono::steady_clock::now());
 
             send_to_subscribers(output_buffer);
 
@@ -162,7 +232,7 @@ public:
             auto input_buffer = m_batch_queue.front();
             m_batch_queue.pop();
             
-            if (set_pix_buf(input_buffer->media_lib_buffers_list[MediaLibraryBufferType::Cropped]) != SUCCESS)
+            if (!m_inference_backend && set_pix_buf(input_buffer->media_lib_buffers_list[MediaLibraryBufferType::Cropped]) != SUCCESS)
             {
                 return ERROR;
             }
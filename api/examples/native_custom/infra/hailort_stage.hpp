@@ -2,13 +2,15 @@
 
 #include "stages.hpp"
 #include "hailo/hailort.hpp"
+#include "media_library/vdevice_registry.hpp"
 
 class HailortAsyncStage : public ProducableStage<BufferPtr, BufferPtr>
 {
 private:
     std::unordered_map<std::string, MediaLibraryBufferPoolPtr> m_output_buffer_pool;
 
-    std::unique_ptr<hailort::VDevice> m_vdevice;
+    std::shared_ptr<hailort::VDevice> m_vdevice;
+    NetworkUsagePtr m_network_usage;
     std::shared_ptr<hailort::InferModel> m_infer_model;
     hailort::ConfiguredInferModel m_configured_infer_model;
     hailort::ConfiguredInferModel::Bindings m_bindings;
@@ -25,18 +27,13 @@ public:
 
     int init() override
     {
-        hailo_vdevice_params_t vdevice_params = {0};
-        hailo_init_vdevice_params(&vdevice_params);
-        vdevice_params.group_id = m_group_id.c_str();        
-        //std::cout << "Hailo Device Count = " << vdevice_params.device_count << ", Group Id: " << vdevice_params.group_id << std::endl;
-
-        auto vdevice_exp = hailort::VDevice::create(vdevice_params);
-
+        // Shared with the denoise and the other networks of the process, so they are scheduled together
+        auto vdevice_exp = VDeviceRegistry::get_instance().acquire_vdevice(m_group_id);
         if (!vdevice_exp) {
-            std::cerr << "Failed create vdevice, status = " << vdevice_exp.status() << std::endl;
-            return vdevice_exp.status();
+            std::cerr << "Failed to acquire vdevice, status = " << vdevice_exp.error() << std::endl;
+            return ERROR;
         }
-        m_vdevice = vdevice_exp.release();
+        m_vdevice = vdevice_exp.value();
 
         auto infer_model_exp = m_vdevice->create_infer_model(m_hef_path.c_str());
         if (!infer_model_exp) {
@@ -54,8 +51,16 @@ public:
             return configured_infer_model_exp.status();
         }
         m_configured_infer_model = configured_infer_model_exp.release();
-        m_configured_infer_model.set_scheduler_threshold(4);
-        m_configured_infer_model.set_scheduler_timeout(std::chrono::milliseconds(100));
+
+        network_scheduling_t scheduling;
+        scheduling.threshold = 4;
+        scheduling.timeout_ms = 100;
+        auto network_usage_exp = VDeviceRegistry::get_instance().register_network(m_name, m_group_id, m_configured_infer_model, scheduling);
+        if (!network_usage_exp) {
+            std::cerr << "Failed to register network, status = " << network_usage_exp.error() << std::endl;
+            return ERROR;
+        }
+        m_network_usage = network_usage_exp.value();
 
         auto bindings = m_configured_infer_model.create_bindings();
         if (!bindings) {
@@ -166,11 +171,13 @@ public:
             return status;
         }
 
-        auto job = m_configured_infer_model.run_async(m_bindings, [output_buffers_ptr_list, input_buffer, this](const hailort::AsyncInferCompletionInfo& completion_info) {
+        auto submit_time = std::chrono::steady_clock::now();
+        auto job = m_configured_infer_model.run_async(m_bindings, [output_buffers_ptr_list, input_buffer, this, submit_time](const hailort::AsyncInferCompletionInfo& completion_info) {
             if (completion_info.status != HAILO_SUCCESS) {
                 std::cerr << "Failed to run async infer, status = " << completion_info.status << std::endl;
                 return ERROR;
             }
+            m_network_usage->record(submit_time, std::chrono::steady_clock::now());
 
             for (const auto& output_buffer : output_buffers_ptr_list)
             {
@@ -23,6 +23,7 @@
 #include "gstnativedenoise.hpp"
 #include "common/gstmedialibcommon.hpp"
 #include "buffer_utils/buffer_utils.hpp"
+#include "buffer_utils/gsthailobuffermeta.hpp"
 #include "hailo_v4l2/hailo_v4l2_meta.h"
 #include <gst/video/video.h>
 #include <tl/expected.hpp>
@@ -319,6 +320,14 @@ gst_hailo_denoise_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
         GST_ERROR_OBJECT(self, "Cannot create hailo buffer from GstBuffer");
         return GST_FLOW_ERROR;
     }
+    if (gst_buffer_get_hailo_buffer_meta(buffer) == nullptr)
+    {
+        // The frame wraps the memory of the GstBuffer without owning it. A bypassed frame is pushed downstream and
+        // kept as loopback after the GstBuffer is released here, so the frame holds a reference to it while it lives
+        gst_buffer_ref(buffer);
+        input_frame_ptr = HailoMediaLibraryBufferPtr(input_frame_ptr.get(), [input_frame_ptr, buffer](hailo_media_library_buffer *)
+                                                     { gst_buffer_unref(buffer); });
+    }
     gst_caps_unref(input_caps);
 
     HailoMediaLibraryBufferPtr output_frame_ptr = std::make_shared<hailo_media_library_buffer>();
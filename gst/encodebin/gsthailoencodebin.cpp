@@ -52,6 +52,7 @@ static gboolean gst_hailoencodebin_prepare_encoder_element(GstHailoEncodeBin *ha
 static gboolean gst_hailoencodebin_link_elements(GstElement *element);
 static void gst_hailoencodebin_dispose(GObject *object);
 static void gst_hailoencodebin_reset(GstHailoEncodeBin *self);
+static void gst_hailoencodebin_set_scheduling(GstHailoEncodeBin *hailoencodebin);
 
 #define MIN_QUEUE_SIZE 1
 #define DEFAULT_QUEUE_SIZE 2
@@ -67,6 +68,8 @@ typedef enum
     PROP_QUEUE_SIZE,
     PROP_ENFORCE_CAPS,
     PROP_FORCE_VIDEORATE,
+    PROP_SCHEDULING_PRIORITY,
+    PROP_SCHEDULING_DEADLINE,
 } hailoencodebin_prop_t;
 
 // Pad Templates
@@ -145,6 +148,16 @@ gst_hailoencodebin_class_init(GstHailoEncodeBinClass *klass)
                                                          "Force videorate to not be only drop-only",
                                                          FALSE,
                                                          (GParamFlags)(GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+    g_object_class_install_property(gobject_class, PROP_SCHEDULING_PRIORITY,
+                                    g_param_spec_uint("scheduling-priority", "Scheduling priority",
+                                                      "Priority of the stream on the shared encoder core - late encodes go first by priority, otherwise the earliest deadline, with priority breaking ties",
+                                                      0, G_MAXUINT, 0,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+    g_object_class_install_property(gobject_class, PROP_SCHEDULING_DEADLINE,
+                                    g_param_spec_uint("scheduling-deadline", "Scheduling deadline",
+                                                      "Time in microseconds a frame may take from when its GOP can be encoded until it is encoded, 0 for one frame interval",
+                                                      0, G_MAXUINT, 0,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
 }
 
 static void
@@ -154,6 +167,8 @@ gst_hailoencodebin_init(GstHailoEncodeBin *hailoencodebin)
     hailoencodebin->config_file_path = NULL;
     hailoencodebin->m_elements_linked = FALSE;
     hailoencodebin->queue_size = DEFAULT_QUEUE_SIZE;
+    hailoencodebin->scheduling_priority = 0;
+    hailoencodebin->scheduling_deadline = 0;
     hailoencodebin->encoder_type = EncoderType::None;
 
     // Prepare internal elements
@@ -310,6 +325,18 @@ void gst_hailoencodebin_set_property(GObject *object, guint property_id,
         g_object_set(hailoencodebin->m_videorate, "drop-only", !force, NULL);
         break;
     }
+    case PROP_SCHEDULING_PRIORITY:
+    {
+        hailoencodebin->scheduling_priority = g_value_get_uint(value);
+        gst_hailoencodebin_set_scheduling(hailoencodebin);
+        break;
+    }
+    case PROP_SCHEDULING_DEADLINE:
+    {
+        hailoencodebin->scheduling_deadline = g_value_get_uint(value);
+        gst_hailoencodebin_set_scheduling(hailoencodebin);
+        break;
+    }
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -374,6 +401,16 @@ void gst_hailoencodebin_get_property(GObject *object, guint property_id,
         g_value_set_boolean(value, !force);
         break;
     }
+    case PROP_SCHEDULING_PRIORITY:
+    {
+        g_value_set_uint(value, hailoencodebin->scheduling_priority);
+        break;
+    }
+    case PROP_SCHEDULING_DEADLINE:
+    {
+        g_value_set_uint(value, hailoencodebin->scheduling_deadline);
+        break;
+    }
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -496,6 +533,16 @@ gst_hailoencodebin_set_encoder_properties(GstHailoEncodeBin *hailoencodebin, con
     }
 }
 
+static void
+gst_hailoencodebin_set_scheduling(GstHailoEncodeBin *hailoencodebin)
+{
+    // Only the hailo encoder runs on the shared encoder core, the element may also not be created yet
+    if (hailoencodebin->encoder_type != EncoderType::Hailo)
+        return;
+    g_object_set(hailoencodebin->m_encoder, "scheduling-priority", hailoencodebin->scheduling_priority,
+                 "scheduling-deadline", hailoencodebin->scheduling_deadline, NULL);
+}
+
 static gboolean
 gst_hailoencodebin_prepare_encoder_element(GstHailoEncodeBin *hailoencodebin, const char* config_property,
                                            const gchar *property_value)
@@ -518,6 +565,7 @@ gst_hailoencodebin_prepare_encoder_element(GstHailoEncodeBin *hailoencodebin, co
 
     hailoencodebin->encoder_type = encoder_type;
     gst_hailoencodebin_set_encoder_properties(hailoencodebin, config_property, property_value, config_json);
+    gst_hailoencodebin_set_scheduling(hailoencodebin);
     gst_bin_add(GST_BIN(hailoencodebin), hailoencodebin->m_encoder);
     // Now that we have encoder, initialize the ghost src pad
     gst_hailoencodebin_init_ghost_src(hailoencodebin);
@@ -63,6 +63,8 @@ struct _GstHailoEncodeBin
     GstElement *m_queue_encoder;
     GstElement *m_encoder;
     guint queue_size;
+    guint scheduling_priority;
+    guint scheduling_deadline;
 };
 
 struct _GstHailoEncodeBinClass
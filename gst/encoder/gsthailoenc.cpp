@@ -31,6 +31,7 @@
 #include <gst/allocators/gstfdmemory.h>
 #include "gsthailoenc.hpp"
 #include "buffer_utils/buffer_utils.hpp"
+#include "media_library/ewl_dmabuf_cache.hpp"
 
 /*******************
 Property Definitions
@@ -752,17 +753,17 @@ static GstFlowReturn gst_hailoenc_update_input_buffer(GstHailoEnc *hailoenc,
       return GST_FLOW_ERROR;
     }
     // Get the physical Addresses of input buffer luma and chroma.
-    ewl_ret = EWLShareDmabuf(enc_params->ewl, lumaFd, &(enc_params->encIn.busLuma));
+    ewl_ret = enc_params->dmabuf_cache->share(lumaFd, &(enc_params->encIn.busLuma));
     if (ewl_ret != EWL_OK)
     {
       hailo_buffer->decrease_ref_count();
       GST_ERROR_OBJECT(hailoenc, "Could not get physical address of input picture luma");
       return GST_FLOW_ERROR;
     }
-    ewl_ret = EWLShareDmabuf(enc_params->ewl, chromaFd, &(enc_params->encIn.busChromaU));
+    ewl_ret = enc_params->dmabuf_cache->share(chromaFd, &(enc_params->encIn.busChromaU));
     if (ewl_ret != EWL_OK)
     {
-      EWLUnshareDmabuf(enc_params->ewl, lumaFd);
+      enc_params->dmabuf_cache->release(lumaFd);
       hailo_buffer->decrease_ref_count();
       GST_ERROR_OBJECT(hailoenc, "Could not get physical address of input picture chroma");
       return GST_FLOW_ERROR;
@@ -1022,11 +1023,8 @@ static void gst_hailoenc_slice_ready(VCEncSliceReady *slice)
 
 static GstFlowReturn releaseDmabuf(GstHailoEnc *hailoenc, int fd)
 {
-  if (EWLUnshareDmabuf(hailoenc->enc_params.ewl, fd) != EWL_OK)
-  {
-    GST_ERROR_OBJECT(hailoenc, "Could not unshare dmabuf");
-    return GST_FLOW_ERROR;
-  }
+  // Cached dmabufs stay shared for the next frame of their buffer, the cache logs its own unshare errors
+  hailoenc->enc_params.dmabuf_cache->release(fd);
   return GST_FLOW_OK;
 }
 
@@ -44,6 +44,8 @@ enum
     PROP_CONFIG_PATH,
     PROP_CONFIG,
     PROP_ENFORCE_CAPS,
+    PROP_SCHEDULING_PRIORITY,
+    PROP_SCHEDULING_DEADLINE,
     NUM_OF_PROPS,
 };
 
@@ -145,6 +147,18 @@ gst_hailo_encoder_class_init(GstHailoEncoderClass *klass)
                                     g_param_spec_pointer("config", "Encoder config", "Encoder config as encoder_config_t",
                                                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
 
+    g_object_class_install_property(gobject_class, PROP_SCHEDULING_PRIORITY,
+                                    g_param_spec_uint("scheduling-priority", "Scheduling priority",
+                                                      "Priority of the stream on the shared encoder core - late encodes go first by priority, otherwise the earliest deadline, with priority breaking ties",
+                                                      0, G_MAXUINT, 0,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+
+    g_object_class_install_property(gobject_class, PROP_SCHEDULING_DEADLINE,
+                                    g_param_spec_uint("scheduling-deadline", "Scheduling deadline",
+                                                      "Time in microseconds a frame may take from when its GOP can be encoded until it is encoded, 0 for one frame interval",
+                                                      0, G_MAXUINT, 0,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_PLAYING)));
+
     venc_class->open = gst_hailo_encoder_open;
     venc_class->start = gst_hailo_encoder_start;
     venc_class->stop = gst_hailo_encoder_stop;
@@ -165,6 +179,8 @@ gst_hailo_encoder_init(GstHailoEncoder *hailoencoder)
     hailoencoder->stream_restart = FALSE;
     hailoencoder->encoder = nullptr;
     hailoencoder->enforce_caps = TRUE;
+    hailoencoder->scheduling_priority = 0;
+    hailoencoder->scheduling_deadline = 0;
 }
 
 /************************
@@ -207,6 +223,16 @@ gst_hailo_encoder_get_property(GObject *object,
         g_value_set_boolean(value, hailoencoder->enforce_caps);
         break;
     }
+    case PROP_SCHEDULING_PRIORITY:
+    {
+        g_value_set_uint(value, hailoencoder->scheduling_priority);
+        break;
+    }
+    case PROP_SCHEDULING_DEADLINE:
+    {
+        g_value_set_uint(value, hailoencoder->scheduling_deadline);
+        break;
+    }
     default:
     {
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -262,6 +288,20 @@ gst_hailo_encoder_set_property(GObject *object,
         hailoencoder->enforce_caps = g_value_get_boolean(value);
         break;
     }
+    case PROP_SCHEDULING_PRIORITY:
+    {
+        hailoencoder->scheduling_priority = g_value_get_uint(value);
+        if (hailoencoder->encoder)
+            hailoencoder->encoder->set_scheduling(hailoencoder->scheduling_priority, hailoencoder->scheduling_deadline);
+        break;
+    }
+    case PROP_SCHEDULING_DEADLINE:
+    {
+        hailoencoder->scheduling_deadline = g_value_get_uint(value);
+        if (hailoencoder->encoder)
+            hailoencoder->encoder->set_scheduling(hailoencoder->scheduling_priority, hailoencoder->scheduling_deadline);
+        break;
+    }
     default:
     {
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -484,6 +524,7 @@ gst_hailo_encoder_open(GstVideoEncoder *encoder)
         std::cout << "hailoencoder create new encoder" << std::endl;
         hailoencoder->encoder = std::make_unique<Encoder>(hailoencoder->config);
     }
+    hailoencoder->encoder->set_scheduling(hailoencoder->scheduling_priority, hailoencoder->scheduling_deadline);
     return TRUE;
 }
 
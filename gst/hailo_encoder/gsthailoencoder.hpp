@@ -49,6 +49,8 @@ struct _GstHailoEncoder
     gboolean stream_restart;
     GQueue *dts_queue;
     gboolean enforce_caps;
+    guint scheduling_priority;
+    guint scheduling_deadline;
 };
 
 struct _GstHailoEncoderClass
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file benchmark_utils.hpp
+ * @brief Timing helpers shared by the media library benchmarks
+ **/
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+template <typename func_t>
+static double measure_ns(int iterations, func_t func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+/**
+ * @brief Collects the latency of single operations and reports their distribution
+ */
+class BenchmarkLatency
+{
+public:
+    BenchmarkLatency(const std::string &name) : m_name(name) {}
+
+    template <typename func_t>
+    void measure(func_t func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        add(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void add(double ns)
+    {
+        m_samples.push_back(ns);
+    }
+
+    size_t count() const
+    {
+        return m_samples.size();
+    }
+
+    double mean_ns() const
+    {
+        double sum = 0;
+        for (double sample : m_samples)
+            sum += sample;
+        return m_samples.empty() ? 0 : sum / m_samples.size();
+    }
+
+    double percentile_ns(double percentile) const
+    {
+        if (m_samples.empty())
+            return 0;
+        std::vector<double> sorted = m_samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = std::min(sorted.size() - 1, static_cast<size_t>(percentile / 100 * sorted.size()));
+        return sorted[index];
+    }
+
+    void print() const
+    {
+        printf("  %-32s %6zu samples, mean %10.1f us, p50 %10.1f us, p99 %10.1f us, max %10.1f us\n",
+               m_name.c_str(), count(), mean_ns() / 1000, percentile_ns(50) / 1000, percentile_ns(99) / 1000,
+               percentile_ns(100) / 1000);
+    }
+
+private:
+    std::string m_name;
+    std::vector<double> m_samples;
+};
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file defog_benchmark.cpp
+ * @brief Benchmark of the native defog stage
+ *
+ * Runs on the target - needs a Hailo device and the defog network. Feeds frames from a CMA pool through
+ * MediaLibraryDefog::handle_frame and reports the latency from submitting a frame to its buffer ready callback,
+ * the time handle_frame blocks the caller and the throughput.
+ * For the hailonet path, run the GStreamer element on the same configuration and compare the fps it reports:
+ *   gst-launch-1.0 videotestsrc num-buffers=<frames> ! video/x-raw,format=NV12,width=<w>,height=<h> !
+ *     hailodefog config-file-path=<config> ! fpsdisplaysink video-sink=fakesink text-overlay=false -v
+ * Usage: defog_benchmark <config file> [frames] [width] [height]
+ **/
+#include "benchmark_utils.hpp"
+#include "buffer_pool.hpp"
+#include "defog.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+
+// Frames the benchmark keeps in the stage at once - above the in flight frames of the defog so it never starves
+#define BENCHMARK_INPUT_POOL_SIZE (6)
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static std::string read_string_from_file(const char *file_path)
+{
+    std::ifstream file_to_read(file_path);
+    if (!file_to_read.is_open())
+        return "";
+    return std::string((std::istreambuf_iterator<char>(file_to_read)), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <config file> [frames] [width] [height]\n", argv[0]);
+        return 1;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 1000;
+    uint width = argc > 3 ? atoi(argv[3]) : 3840;
+    uint height = argc > 4 ? atoi(argv[4]) : 2160;
+
+    std::string config_string = read_string_from_file(argv[1]);
+    auto defog_exp = MediaLibraryDefog::create(config_string);
+    if (!defog_exp.has_value())
+    {
+        printf("Failed to create defog from %s\n", argv[1]);
+        return 1;
+    }
+    MediaLibraryDefogPtr defog = defog_exp.value();
+    if (!defog->is_enabled())
+    {
+        printf("Defog is disabled in %s\n", argv[1]);
+        return 1;
+    }
+
+    auto input_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, BENCHMARK_INPUT_POOL_SIZE, CMA, "defog_benchmark_input");
+    if (input_pool->init() != MEDIA_LIBRARY_SUCCESS)
+    {
+        printf("Failed to allocate the input pool\n");
+        return 1;
+    }
+
+    // Outputs are delivered in submission order, so the n-th delivered frame is the n-th submitted
+    std::vector<benchmark_clock::time_point> submit_times(frames);
+    BenchmarkLatency latency("submit to buffer ready");
+    BenchmarkLatency handle_frame_latency("handle_frame");
+    std::atomic<int> delivered = 0;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    MediaLibraryDefog::callbacks_t callbacks;
+    callbacks.on_buffer_ready = [&](HailoMediaLibraryBufferPtr output_buffer)
+    {
+        int frame = delivered;
+        latency.add(std::chrono::duration<double, std::nano>(benchmark_clock::now() - submit_times[frame]).count());
+        output_buffer->decrease_ref_count();
+        std::unique_lock<std::mutex> lock(done_mutex);
+        delivered++;
+        done_cv.notify_all();
+    };
+    defog->observe(callbacks);
+
+    printf("%d %ux%u frames through the native defog\n", frames, width, height);
+    auto start = benchmark_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        HailoMediaLibraryBufferPtr input_buffer = std::make_shared<hailo_media_library_buffer>();
+        if (input_pool->acquire_buffer(*input_buffer) != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to acquire an input buffer\n");
+            return 1;
+        }
+        HailoMediaLibraryBufferPtr output_buffer = std::make_shared<hailo_media_library_buffer>();
+        submit_times[frame] = benchmark_clock::now();
+        media_library_return ret = MEDIA_LIBRARY_SUCCESS;
+        // the first frame opens the network and allocates the output pool
+        if (frame == 0)
+            ret = defog->handle_frame(input_buffer, output_buffer);
+        else
+            handle_frame_latency.measure([&]
+                                         { ret = defog->handle_frame(input_buffer, output_buffer); });
+        input_buffer->decrease_ref_count();
+        if (ret != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to defog frame %d, status %d\n", frame, ret);
+            return 1;
+        }
+        if (frame == 0)
+            start = benchmark_clock::now();
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]
+                 { return delivered == frames; });
+    double elapsed_s = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+    latency.print();
+    handle_frame_latency.print();
+    printf("  %-32s %.1f frames per second\n", "native defog", (frames - 1) / elapsed_s);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file denoise_queue_benchmark.cpp
+ * @brief Benchmark of the denoise loopback, staging and inference callback queues
+ *
+ * Runs MediaLibraryDenoise on the mock inference backend in place of HailoRT, so the frames take the real denoise
+ * path - output pool, loopback and staging rings, ordered delivery and the inference callback thread. Reports the
+ * latency from submitting a frame to its buffer ready callback, minus the mock inference time - the queueing overhead
+ * of a frame - the time handle_frame blocks the caller and the throughput.
+ * The mock takes host memory, so the frame pools come from the heap - no CMA allocator, Hailo device or network needed.
+ * With a loopback count above 1 that many frames are in flight, as with the denoise's infer job slots.
+ * The mock copies the input planes to the output planes, as the network writes its output - the copy is counted in
+ * the overhead.
+ * Usage: denoise_queue_benchmark [frames] [inference time in us] [loopback count]
+ **/
+#include "benchmark_utils.hpp"
+#include "buffer_pool.hpp"
+#include "denoise.hpp"
+#include "mock_inference_backend.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Same maximal loopback count as the denoise
+#define BENCHMARK_MAX_LOOPBACK_COUNT (3)
+// The denoise only supports 4K
+#define BENCHMARK_WIDTH (3840)
+#define BENCHMARK_HEIGHT (2160)
+// Input frames held at once - the frames in flight, the loopback frames and one being filled
+#define BENCHMARK_INPUT_POOL_SIZE (BENCHMARK_MAX_LOOPBACK_COUNT * 2 + 1)
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static std::string create_config_string(int loopback_count)
+{
+    // The network is never opened, the mock stands in for it - only the tensor count has to match
+    return R"({
+        "hailort": {
+            "device-id": "device0"
+        },
+        "denoise": {
+            "enabled": true,
+            "sensor": "imx678",
+            "method": "HIGH_QUALITY",
+            "loopback-count": )" +
+           std::to_string(loopback_count) + R"(,
+            "network": {
+                "network_path": "mock.hef",
+                "y_channel": "model/input_layer1",
+                "uv_channel": "model/input_layer4",
+                "feedback_y_channel": "model/input_layer3",
+                "feedback_uv_channel": "model/input_layer2",
+                "output_y_channel": "model/conv17",
+                "output_uv_channel": "model/conv14"
+            }
+        }
+    })";
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    int inference_us = argc > 2 ? atoi(argv[2]) : 0;
+    int loopback_count = argc > 3 ? atoi(argv[3]) : 1;
+    if (loopback_count < 1 || loopback_count > BENCHMARK_MAX_LOOPBACK_COUNT || frames <= loopback_count || inference_us < 0)
+    {
+        printf("Usage: %s [frames] [inference time in us] [loopback count 1-%d]\n", argv[0], BENCHMARK_MAX_LOOPBACK_COUNT);
+        return 1;
+    }
+    std::chrono::microseconds inference_time(inference_us);
+
+    // Tensors in the order the denoise binds them: input, loopback and output Y and UV planes
+    size_t y_size = BENCHMARK_WIDTH * BENCHMARK_HEIGHT;
+    size_t uv_size = y_size / 2;
+    mock_inference_config_t mock_config;
+    mock_config.frame_sizes = {y_size, uv_size, y_size, uv_size, y_size, uv_size};
+    mock_config.outputs = {false, false, false, false, true, true};
+    mock_config.latency = inference_time;
+    mock_config.max_in_flight = loopback_count;
+    MockInferenceBackendPtr backend = std::make_shared<MockInferenceBackend>(mock_config);
+
+    auto denoise_exp = MediaLibraryDenoise::create(create_config_string(loopback_count), backend);
+    if (!denoise_exp.has_value())
+    {
+        printf("Failed to create the denoise on the mock backend\n");
+        return 1;
+    }
+    MediaLibraryDenoisePtr denoise = denoise_exp.value();
+
+    auto input_pool = std::make_shared<MediaLibraryBufferPool>(BENCHMARK_WIDTH, BENCHMARK_HEIGHT, DSP_IMAGE_FORMAT_NV12, BENCHMARK_INPUT_POOL_SIZE,
+                                                               HEAP, "denoise_benchmark_input");
+    if (input_pool->init() != MEDIA_LIBRARY_SUCCESS)
+    {
+        printf("Failed to allocate the input pool\n");
+        return 1;
+    }
+
+    // Outputs are delivered in submission order, so the n-th delivered frame is the n-th submitted
+    std::vector<benchmark_clock::time_point> submit_times(frames);
+    BenchmarkLatency latency("queueing overhead");
+    BenchmarkLatency handle_frame_latency("handle_frame");
+    std::atomic<int> delivered = 0;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    MediaLibraryDenoise::callbacks_t callbacks;
+    callbacks.on_buffer_ready = [&](HailoMediaLibraryBufferPtr output_buffer)
+    {
+        int frame = delivered;
+        latency.add(std::chrono::duration<double, std::nano>(benchmark_clock::now() - submit_times[frame]).count() -
+                    std::chrono::duration<double, std::nano>(inference_time).count());
+        output_buffer->decrease_ref_count();
+        std::unique_lock<std::mutex> lock(done_mutex);
+        delivered++;
+        done_cv.notify_all();
+    };
+    denoise->observe(callbacks);
+
+    printf("%d %dx%d frames through the denoise, %d us mock inference, %d in flight\n", frames, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+           inference_us, loopback_count);
+    auto start = benchmark_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        HailoMediaLibraryBufferPtr input_buffer = std::make_shared<hailo_media_library_buffer>();
+        if (input_pool->acquire_buffer(*input_buffer) != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to acquire an input buffer\n");
+            return 1;
+        }
+        HailoMediaLibraryBufferPtr output_buffer = std::make_shared<hailo_media_library_buffer>();
+        submit_times[frame] = benchmark_clock::now();
+        media_library_return ret = MEDIA_LIBRARY_SUCCESS;
+        handle_frame_latency.measure([&]
+                                     { ret = denoise->handle_frame(input_buffer, output_buffer); });
+        // decrease ref count regardless of success, as the GStreamer element does
+        input_buffer->decrease_ref_count();
+        if (ret != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to denoise frame %d, status %d\n", frame, ret);
+            return 1;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]
+                 { return delivered == frames; });
+    double elapsed_s = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+    latency.print();
+    handle_frame_latency.print();
+    printf("  %-32s %.0f frames per second, %lu mock jobs\n", "denoise", frames / elapsed_s, backend->get_completed_jobs());
+    return 0;
+}
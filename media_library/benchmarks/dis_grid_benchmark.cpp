@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file dis_grid_benchmark.cpp
+ * @brief Benchmark of the DIS mesh projection - batched rays2mesh() against the scalar ray2point() loop
+ *
+ * Runs on synthetic 4K fisheye calibration, no hardware needed.
+ * Usage: dis_grid_benchmark [iterations] [cell size in pixels]
+ **/
+#include "benchmark_utils.hpp"
+#include "camera.h"
+#include "dewarp.h"
+#include "dis_math.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define BENCHMARK_WIDTH (3840)
+#define BENCHMARK_HEIGHT (2160)
+// Maximum allowed difference between the implementations - 1/64 pixel
+#define BENCHMARK_TOLERANCE ((1 << MESH_FRACT_BITS) / 64)
+
+static FishEye create_input_camera()
+{
+    // equidistant projection with a mild barrel distortion, 180 degrees over the sensor width
+    float theta2r[FishEye::theta2r_size];
+    float flen = BENCHMARK_WIDTH / float(M_PI);
+    for (int i = 0; i < FishEye::theta2r_size; i++)
+    {
+        float theta = i * FishEye::theta_step;
+        theta2r[i] = flen * theta * (1.f - 0.05f * theta * theta / float(M_PI * M_PI));
+    }
+    return FishEye(vec2(BENCHMARK_WIDTH / 2.f, BENCHMARK_HEIGHT / 2.f), ivec2(BENCHMARK_WIDTH, BENCHMARK_HEIGHT), theta2r);
+}
+
+static float rad2theta_reference(const FishEye &cam, float radius)
+{
+    int i = std::lower_bound(std::begin(cam.theta2r), std::end(cam.theta2r) - 2, radius) - std::begin(cam.theta2r);
+    return FishEye::theta_step * (float(i) + (radius - cam.theta2r[i]) / (cam.theta2r[i + 1] - cam.theta2r[i]));
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    int cell = argc > 2 ? atoi(argv[2]) : MESH_CELL_SIZE_PIX;
+    if (iterations <= 0 || cell <= 0)
+    {
+        printf("Usage: %s [iterations] [cell size in pixels]\n", argv[0]);
+        return 1;
+    }
+
+    FishEye in_cam = create_input_camera();
+
+    // rad2theta - inverse LUT against binary search, must match exactly
+    std::vector<float> radii;
+    for (float r = -1.f; r < in_cam.theta2r[FishEye::theta2r_size - 1] + 100.f; r += 0.37f)
+        radii.push_back(r);
+    size_t mismatches = 0;
+    for (float r : radii)
+    {
+        if (in_cam.rad2theta(r) != rad2theta_reference(in_cam, r))
+            mismatches++;
+    }
+    volatile float sink = 0;
+    double lut_ns = measure_ns(10, [&]
+                               { for (float r : radii) sink = sink + in_cam.rad2theta(r); });
+    double bsearch_ns = measure_ns(10, [&]
+                                   { for (float r : radii) sink = sink + rad2theta_reference(in_cam, r); });
+    printf("rad2theta: %zu radii, %zu mismatches, inverse LUT %.2f ns/call, binary search %.2f ns/call\n",
+           radii.size(), mismatches, lut_ns / radii.size(), bsearch_ns / radii.size());
+
+    // output rays through the mesh vertexes, same camera as the input one
+    int grid_w = BENCHMARK_WIDTH / cell + 1;
+    int grid_h = BENCHMARK_HEIGHT / cell + 1;
+    int count = grid_w * grid_h;
+    std::vector<vec3> rays(count);
+    std::vector<float> ray_x(count), ray_y(count), ray_z(count);
+    for (int y = 0; y < grid_h; y++)
+    {
+        for (int x = 0; x < grid_w; x++)
+        {
+            vec3 ray = in_cam.point2ray(vec2(x * cell + 0.5f, y * cell + 0.5f));
+            int ind = y * grid_w + x;
+            rays[ind] = ray;
+            ray_x[ind] = ray.x;
+            ray_y[ind] = ray.y;
+            ray_z[ind] = ray.z;
+        }
+    }
+
+    // a typical stabilizing rotation of a couple of degrees
+    float lo = RADIANS(1.5f), la = RADIANS(-2.f);
+    mat3 rot = {std::cos(lo), 0, std::sin(lo),
+                -std::sin(la) * std::sin(lo), std::cos(la), std::sin(la) * std::cos(lo),
+                -std::cos(la) * std::sin(lo), -std::sin(la), std::cos(la) * std::cos(lo)};
+
+    std::vector<int> mesh_scalar(count * 2), mesh_batched(count * 2);
+    auto scalar = [&]
+    {
+        for (int i = 0; i < count; i++)
+        {
+            vec2 pt = in_cam.ray2point(rot * rays[i]) - vec2(0.5f, 0.5f);
+            mesh_scalar[i * 2] = pt.x * (1 << MESH_FRACT_BITS);
+            mesh_scalar[i * 2 + 1] = pt.y * (1 << MESH_FRACT_BITS);
+        }
+    };
+    auto batched = [&]
+    {
+        in_cam.rays2mesh(rot, ray_x.data(), ray_y.data(), ray_z.data(), count, 0.5f, MESH_FRACT_BITS, mesh_batched.data());
+    };
+
+    double scalar_ns = measure_ns(iterations, scalar);
+    double batched_ns = measure_ns(iterations, batched);
+
+    int max_diff = 0;
+    for (int i = 0; i < count * 2; i++)
+        max_diff = std::max(max_diff, std::abs(mesh_scalar[i] - mesh_batched[i]));
+
+    printf("projection: %dx%d grid (%d vertexes), %d iterations\n", grid_w, grid_h, count, iterations);
+    printf("  scalar  %10.1f us/grid %6.2f ns/vertex\n", scalar_ns / 1000, scalar_ns / count);
+    printf("  batched %10.1f us/grid %6.2f ns/vertex (x%.2f)\n", batched_ns / 1000, batched_ns / count, scalar_ns / batched_ns);
+    printf("  max difference %d (%.6f pixels), tolerance %d\n", max_diff, float(max_diff) / (1 << MESH_FRACT_BITS), BENCHMARK_TOLERANCE);
+
+    return (mismatches == 0 && max_diff <= BENCHMARK_TOLERANCE) ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_async_benchmark.cpp
+ * @brief Benchmark of the native encoder throughput and latency, with handle_frame and with async submission
+ *
+ * Runs on the target - needs the VC8000 encoder. Encodes frames from a CMA pool once with Encoder::handle_frame and
+ * once with Encoder::submit_frame, each unpaced for throughput and paced at the configured frame rate (60 for a 4K60
+ * configuration) for the time from submitting a frame to receiving it encoded.
+ * The pool buffers are filled with noise, so the frames are large and change every frame.
+ * Use an encoder configuration with a GOP size of 1, so every frame is encoded as it is submitted.
+ * Usage: encoder_async_benchmark <encoder config file> [frames] [queue size]
+ **/
+#include "benchmark_utils.hpp"
+#include "buffer_pool.hpp"
+#include "encoder_class.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// Distinct input frames the benchmark cycles through - enough for the queue, the encoded and the submitted frame
+#define BENCHMARK_INPUT_POOL_SIZE (8)
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static std::string read_string_from_file(const char *file_path)
+{
+    std::ifstream file_to_read(file_path);
+    if (!file_to_read.is_open())
+        return "";
+    return std::string((std::istreambuf_iterator<char>(file_to_read)), std::istreambuf_iterator<char>());
+}
+
+static bool fill_with_noise(MediaLibraryBufferPoolPtr pool)
+{
+    std::mt19937 generator(0);
+    std::vector<HailoMediaLibraryBufferPtr> buffers;
+    for (int i = 0; i < BENCHMARK_INPUT_POOL_SIZE; i++)
+    {
+        HailoMediaLibraryBufferPtr buffer = std::make_shared<hailo_media_library_buffer>();
+        if (pool->acquire_buffer(*buffer) != MEDIA_LIBRARY_SUCCESS)
+            return false;
+        if (buffer->is_dmabuf())
+            buffer->sync_start();
+        for (uint32_t plane = 0; plane < buffer->get_num_of_planes(); plane++)
+        {
+            uint32_t *data = static_cast<uint32_t *>(buffer->get_plane(plane));
+            for (uint32_t word = 0; word < buffer->get_plane_size(plane) / sizeof(uint32_t); word++)
+                data[word] = generator();
+        }
+        if (buffer->is_dmabuf())
+            buffer->sync_end();
+        buffers.push_back(buffer);
+    }
+    for (HailoMediaLibraryBufferPtr &buffer : buffers)
+        buffer->decrease_ref_count();
+    return true;
+}
+
+/**
+ * @brief Matches encoded frames to the time their input was submitted
+ */
+class SubmitTimes
+{
+public:
+    void submitted()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_times.push_back(benchmark_clock::now());
+    }
+
+    void encoded(BenchmarkLatency &latency)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_times.empty())
+            return;
+        latency.add(std::chrono::duration<double, std::nano>(benchmark_clock::now() - m_times.front()).count());
+        m_times.pop_front();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<benchmark_clock::time_point> m_times;
+};
+
+static bool benchmark_encode(const std::string &config_string, MediaLibraryBufferPoolPtr input_pool, int frames,
+                             uint32_t fps, bool async, uint32_t queue_size)
+{
+    // A new encoder per run, so every run starts its stream the same way
+    Encoder encoder(config_string);
+    std::string name = std::string(async ? "submit_frame" : "handle_frame") + (fps > 0 ? " paced" : " unpaced");
+    BenchmarkLatency latency(name + " latency");
+    SubmitTimes submit_times;
+    std::mutex outputs_mutex;
+    uint64_t encoded_frames = 0;
+
+    auto on_outputs = [&](std::vector<EncoderOutputBuffer> &outputs)
+    {
+        std::lock_guard<std::mutex> lock(outputs_mutex);
+        for (EncoderOutputBuffer &output : outputs)
+        {
+            submit_times.encoded(latency);
+            output.buffer->decrease_ref_count();
+            encoded_frames++;
+        }
+    };
+
+    // The stream header stays referenced by the encoder, it is prepended to every IDR frame
+    encoder.start();
+    if (async && encoder.start_async(on_outputs, queue_size) != MEDIA_LIBRARY_SUCCESS)
+    {
+        printf("Failed to start async encode\n");
+        return false;
+    }
+
+    benchmark_clock::time_point start = benchmark_clock::now();
+    benchmark_clock::time_point next_submit = start;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        if (fps > 0)
+        {
+            std::this_thread::sleep_until(next_submit);
+            next_submit += std::chrono::nanoseconds(1000000000 / fps);
+        }
+        HailoMediaLibraryBufferPtr input_buffer = std::make_shared<hailo_media_library_buffer>();
+        if (input_pool->acquire_buffer(*input_buffer) != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to acquire an input buffer\n");
+            return false;
+        }
+        submit_times.submitted();
+        if (async)
+        {
+            if (encoder.submit_frame(input_buffer) != MEDIA_LIBRARY_SUCCESS)
+            {
+                printf("Failed to submit frame %d\n", frame);
+                return false;
+            }
+        }
+        else
+        {
+            std::vector<EncoderOutputBuffer> outputs = encoder.handle_frame(input_buffer);
+            on_outputs(outputs);
+        }
+        input_buffer->decrease_ref_count();
+    }
+    // Encodes the queued frames before it returns
+    encoder.stop_async();
+    double elapsed_s = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+    EncoderOutputBuffer end = encoder.stop();
+    if (end.buffer != nullptr)
+        end.buffer->decrease_ref_count();
+    encoder.release();
+    encoder.dispose();
+
+    printf("  %-32s %6llu frames in %.2f s, %.1f fps\n", name.c_str(), (unsigned long long)encoded_frames, elapsed_s, encoded_frames / elapsed_s);
+    latency.print();
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <encoder config file> [frames] [queue size]\n", argv[0]);
+        return 1;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 600;
+    uint32_t queue_size = argc > 3 ? atoi(argv[3]) : ENCODER_ASYNC_QUEUE_SIZE;
+
+    std::string config_string = read_string_from_file(argv[1]);
+    if (config_string.empty())
+    {
+        printf("Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    hailo_encoder_config_t config = std::get<hailo_encoder_config_t>(Encoder(config_string).get_config());
+    uint width = config.input_stream.width;
+    uint height = config.input_stream.height;
+    uint32_t fps = config.input_stream.framerate;
+
+    auto input_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, BENCHMARK_INPUT_POOL_SIZE, CMA, "encoder_async_benchmark_input");
+    if (input_pool->init() != MEDIA_LIBRARY_SUCCESS || !fill_with_noise(input_pool))
+    {
+        printf("Failed to allocate the input pool\n");
+        return 1;
+    }
+
+    printf("%d %ux%u frames through the native encoder at %u fps, %u kbps, async queue of %u frames\n", frames, width,
+           height, fps, config.rate_control.bitrate.target_bitrate / 1000, queue_size);
+    for (uint32_t pace : {0u, fps})
+    {
+        for (bool async : {false, true})
+        {
+            if (!benchmark_encode(config_string, input_pool, frames, pace, async, queue_size))
+                return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_slice_benchmark.cpp
+ * @brief Benchmark of the first byte out latency of the native encoder, with complete frame and slice output
+ *
+ * Runs on the target - needs the VC8000 encoder. Encodes frames from a CMA pool with Encoder::handle_frame, once with
+ * complete frames and once per slice size, and reports the time from handle_frame to the first byte of each frame -
+ * the first slice, or the returned frame - and to its last byte.
+ * A run fails if none of its frames were handed out of the encoder output ring without a copy.
+ * The pool buffers are filled with noise, so the frames are large and change every frame.
+ * Use an encoder configuration with a GOP size of 1, so every handle_frame encodes the frame it is given.
+ * Usage: encoder_slice_benchmark <encoder config file> [frames] [slice sizes in block rows...]
+ **/
+#include "benchmark_utils.hpp"
+#include "buffer_pool.hpp"
+#include "encoder_class.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+// Distinct input frames the benchmark cycles through
+#define BENCHMARK_INPUT_POOL_SIZE (4)
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static std::string read_string_from_file(const char *file_path)
+{
+    std::ifstream file_to_read(file_path);
+    if (!file_to_read.is_open())
+        return "";
+    return std::string((std::istreambuf_iterator<char>(file_to_read)), std::istreambuf_iterator<char>());
+}
+
+static bool fill_with_noise(MediaLibraryBufferPoolPtr pool)
+{
+    std::mt19937 generator(0);
+    std::vector<HailoMediaLibraryBufferPtr> buffers;
+    for (int i = 0; i < BENCHMARK_INPUT_POOL_SIZE; i++)
+    {
+        HailoMediaLibraryBufferPtr buffer = std::make_shared<hailo_media_library_buffer>();
+        if (pool->acquire_buffer(*buffer) != MEDIA_LIBRARY_SUCCESS)
+            return false;
+        if (buffer->is_dmabuf())
+            buffer->sync_start();
+        for (uint32_t plane = 0; plane < buffer->get_num_of_planes(); plane++)
+        {
+            uint32_t *data = static_cast<uint32_t *>(buffer->get_plane(plane));
+            for (uint32_t word = 0; word < buffer->get_plane_size(plane) / sizeof(uint32_t); word++)
+                data[word] = generator();
+        }
+        if (buffer->is_dmabuf())
+            buffer->sync_end();
+        buffers.push_back(buffer);
+    }
+    for (HailoMediaLibraryBufferPtr &buffer : buffers)
+        buffer->decrease_ref_count();
+    return true;
+}
+
+static bool benchmark_slice_size(const std::string &config_string, MediaLibraryBufferPoolPtr input_pool, int frames, uint32_t slice_size)
+{
+    // A new encoder per run, so every run starts its stream the same way
+    Encoder encoder(config_string);
+    std::string name = slice_size == 0 ? "complete frames" : std::to_string(slice_size) + " rows per slice";
+    BenchmarkLatency first_byte_latency(name + " first byte");
+    BenchmarkLatency last_byte_latency(name + " last byte");
+    benchmark_clock::time_point submit_time;
+    bool first_byte_seen = false;
+    uint64_t slices = 0;
+
+    EncoderSliceCallback callback = nullptr;
+    if (slice_size > 0)
+    {
+        callback = [&](EncoderOutputSlice &slice)
+        {
+            double elapsed_ns = std::chrono::duration<double, std::nano>(benchmark_clock::now() - submit_time).count();
+            if (slice.first && !first_byte_seen)
+            {
+                first_byte_latency.add(elapsed_ns);
+                first_byte_seen = true;
+            }
+            if (slice.last)
+                last_byte_latency.add(elapsed_ns);
+            slices++;
+        };
+    }
+    if (encoder.set_slice_output(slice_size, callback) != MEDIA_LIBRARY_SUCCESS)
+    {
+        printf("Failed to set the slice size to %u\n", slice_size);
+        return false;
+    }
+
+    // The stream header stays referenced by the encoder, it is prepended to every IDR frame
+    encoder.start();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        HailoMediaLibraryBufferPtr input_buffer = std::make_shared<hailo_media_library_buffer>();
+        if (input_pool->acquire_buffer(*input_buffer) != MEDIA_LIBRARY_SUCCESS)
+        {
+            printf("Failed to acquire an input buffer\n");
+            return false;
+        }
+        first_byte_seen = false;
+        submit_time = benchmark_clock::now();
+        std::vector<EncoderOutputBuffer> outputs = encoder.handle_frame(input_buffer);
+        double elapsed_ns = std::chrono::duration<double, std::nano>(benchmark_clock::now() - submit_time).count();
+        input_buffer->decrease_ref_count();
+        if (!outputs.empty())
+        {
+            // Complete frames - the first byte is out when the whole frame is
+            first_byte_latency.add(elapsed_ns);
+            last_byte_latency.add(elapsed_ns);
+        }
+        for (EncoderOutputBuffer &output : outputs)
+            output.buffer->decrease_ref_count();
+    }
+    EncoderOutputStats output_stats = encoder.get_output_stats();
+    EncoderOutputBuffer end = encoder.stop();
+    if (end.buffer != nullptr)
+        end.buffer->decrease_ref_count();
+    encoder.release();
+    encoder.dispose();
+
+    first_byte_latency.print();
+    last_byte_latency.print();
+    if (slice_size > 0)
+        printf("  %-32s %.1f slices per frame\n", name.c_str(), (double)slices / std::max<size_t>(1, last_byte_latency.count()));
+    uint64_t zero_copy_frames = slice_size > 0 ? output_stats.sliced_ring_frames : output_stats.ring_frames;
+    uint64_t encoded_frames = slice_size > 0 ? output_stats.sliced_frames : output_stats.ring_frames + output_stats.copied_frames;
+    printf("  %-32s %lu of %lu frames out of the output ring, %lu overflowed their room\n", name.c_str(),
+           zero_copy_frames, encoded_frames, output_stats.ring_overflow_frames);
+    if (encoded_frames > 0 && zero_copy_frames == 0)
+    {
+        printf("No frame was handed out of the encoder output ring\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <encoder config file> [frames] [slice sizes in block rows...]\n", argv[0]);
+        return 1;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 300;
+    std::vector<uint32_t> slice_sizes = {0};
+    for (int i = 3; i < argc; i++)
+        slice_sizes.push_back(atoi(argv[i]));
+    if (argc <= 3)
+        slice_sizes.insert(slice_sizes.end(), {8, 4, 1});
+
+    std::string config_string = read_string_from_file(argv[1]);
+    if (config_string.empty())
+    {
+        printf("Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    hailo_encoder_config_t config = std::get<hailo_encoder_config_t>(Encoder(config_string).get_config());
+    uint width = config.input_stream.width;
+    uint height = config.input_stream.height;
+
+    auto input_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, BENCHMARK_INPUT_POOL_SIZE, CMA, "encoder_slice_benchmark_input");
+    if (input_pool->init() != MEDIA_LIBRARY_SUCCESS || !fill_with_noise(input_pool))
+    {
+        printf("Failed to allocate the input pool\n");
+        return 1;
+    }
+
+    printf("%d %ux%u frames through the native encoder, %u kbps\n", frames, width, height,
+           config.rate_control.bitrate.target_bitrate / 1000);
+    for (uint32_t slice_size : slice_sizes)
+    {
+        if (!benchmark_slice_size(config_string, input_pool, frames, slice_size))
+            return 1;
+    }
+    return 0;
+}
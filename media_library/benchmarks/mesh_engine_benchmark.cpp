@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mesh_engine_benchmark.cpp
+ * @brief Benchmark of the mesh engine threading and caching models used by the front end and vision pre-processing
+ *
+ * Runs on the target - meshes are DMA buffers. Frames are paced at the given frame rate, and every acquired mesh is
+ * held for half a frame as the DSP dewarp would.
+ * Usage: mesh_engine_benchmark <sensor calibration file> [frames] [fps]
+ **/
+#include "benchmark_utils.hpp"
+#include "mesh_engine.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define BENCHMARK_WIDTH (3840)
+#define BENCHMARK_HEIGHT (2160)
+#define BENCHMARK_ZOOM_STEPS (10)
+
+struct benchmark_model_t
+{
+    const char *name;
+    mesh_engine_config_t config;
+};
+
+static mesh_engine_params_t create_params(const char *calib_path)
+{
+    mesh_engine_params_t params = {};
+    params.dewarp_config.enabled = true;
+    params.dewarp_config.sensor_calib_path = calib_path;
+    params.dewarp_config.interpolation_type = INTERPOLATION_TYPE_BILINEAR;
+    params.dewarp_config.camera_type = CAMERA_TYPE_PINHOLE;
+    params.dewarp_config.camera_fov = 100.0f;
+    // same DIS configuration as the frontend configuration example
+    params.dis_config.enabled = true;
+    params.dis_config.minimun_coefficient_filter = 0.1f;
+    params.dis_config.decrement_coefficient_threshold = 0.001f;
+    params.dis_config.increment_coefficient_threshold = 0.01f;
+    params.dis_config.running_average_coefficient = 0.033f;
+    params.dis_config.std_multiplier = 3.0f;
+    params.dis_config.black_corners_correction_enabled = true;
+    params.dis_config.black_corners_threshold = 0.5f;
+    params.dis_config.average_luminance_threshold = 0;
+    params.width = BENCHMARK_WIDTH;
+    params.height = BENCHMARK_HEIGHT;
+    params.flip_mirror_rot = NATURAL;
+    params.optical_zoom_enabled = true;
+    params.magnification = 1.0f;
+    return params;
+}
+
+static bool run_model(const benchmark_model_t &model, const char *calib_path, int frames, int fps)
+{
+    printf("%s: async generation %d, cache capacity %zu, prefetch depth %u\n", model.name,
+           model.config.async_generation, model.config.cache_capacity, model.config.prefetch_depth);
+
+    MeshEngine engine(model.config);
+    mesh_engine_params_t params = create_params(calib_path);
+    BenchmarkLatency configure_latency("configure (cold)");
+    BenchmarkLatency reconfigure_latency("configure (cached)");
+    BenchmarkLatency submit_latency("submit_vsm");
+    BenchmarkLatency get_latency("get");
+    BenchmarkLatency zoom_latency("set_optical_zoom");
+
+    media_library_return ret = MEDIA_LIBRARY_SUCCESS;
+    configure_latency.measure([&]
+                              { ret = engine.configure(params); });
+    if (ret != MEDIA_LIBRARY_SUCCESS)
+    {
+        printf("  configure failed, status %d\n", ret);
+        return false;
+    }
+    reconfigure_latency.measure([&]
+                                { ret = engine.configure(params); });
+
+    auto frame_period = std::chrono::microseconds(1000000 / fps);
+    auto next_frame = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        // a slow zoom sweep in and back out, a step every 30 frames
+        if (i % 30 == 0 && i > 0)
+        {
+            int step = (i / 30) % (2 * BENCHMARK_ZOOM_STEPS);
+            int level = step < BENCHMARK_ZOOM_STEPS ? step : 2 * BENCHMARK_ZOOM_STEPS - step;
+            zoom_latency.measure([&]
+                                 { engine.set_optical_zoom(1.0f + 0.1f * level); });
+        }
+
+        // hand shake of a few pixels
+        float motion_x = 4.0f * std::sin(i * 0.3f);
+        float motion_y = 3.0f * std::cos(i * 0.2f);
+        submit_latency.measure([&]
+                               { engine.submit_vsm(motion_x, motion_y, std::make_shared<angular_dis_params_t>()); });
+
+        std::shared_ptr<dsp_dewarp_mesh_t> mesh;
+        get_latency.measure([&]
+                            { mesh = engine.get(); });
+        if (mesh == nullptr)
+        {
+            printf("  no mesh on frame %d\n", i);
+            return false;
+        }
+        std::this_thread::sleep_for(frame_period / 2);
+        mesh.reset();
+
+        next_frame += frame_period;
+        std::this_thread::sleep_until(next_frame);
+    }
+
+    mesh_engine_stats_t stats = engine.get_stats();
+    configure_latency.print();
+    reconfigure_latency.print();
+    submit_latency.print();
+    get_latency.print();
+    zoom_latency.print();
+    printf("  cache: %lu hits, %lu misses, %lu prefetched\n", stats.cache.hits, stats.cache.misses, stats.cache.prefetched);
+    printf("  generator: %lu of %lu frames used a stale mesh, %lu VSM updates merged\n",
+           stats.generator.stale, stats.generator.acquired, stats.generator.merged);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 2 ? atoi(argv[2]) : 900;
+    int fps = argc > 3 ? atoi(argv[3]) : 30;
+    if (argc < 2 || frames <= 0 || fps <= 0)
+    {
+        printf("Usage: %s <sensor calibration file> [frames] [fps]\n", argv[0]);
+        return 1;
+    }
+
+    // snapshots are not persisted, so every model starts from a cold cache
+    const benchmark_model_t models[] = {
+        {"front end (asynchronous generation, zoom prefetch)", {MESH_CACHE_CAPACITY, MESH_CACHE_PREFETCH_DEPTH, true, false}},
+        {"vision pre-processing (synchronous generation, zoom prefetch)", {MESH_CACHE_CAPACITY, MESH_CACHE_PREFETCH_DEPTH, false, false}},
+        {"synchronous generation, no zoom prefetch", {MESH_CACHE_CAPACITY, 0, false, false}},
+    };
+
+    bool success = true;
+    for (const benchmark_model_t &model : models)
+        success &= run_model(model, argv[1], frames, fps);
+    return success ? 0 : 1;
+}
@@ -0,0 +1,675 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file privacy_mask_benchmark.cpp
+ * @brief Benchmark of the privacy mask rasterization - dirty region updates against a full rebuild,
+ * and the full rebuild cost as the number of polygons grows while the masked area stays the same,
+ * a single polygon moving among static ones,
+ * the cost of rotating the bitmask instead of rasterizing it again,
+ * detection boxes and ellipses replaced on every frame,
+ * and the rasterization, bitmask bytes and pixelation cost of each quantization
+ *
+ * Moves polygons across a 4K frame and rasterizes the bitmask in host memory, no hardware needed.
+ * With dsp, also measures the DSP time of the multi resize with the masks on the target.
+ * Usage: privacy_mask_benchmark [frames] [polygons] [dsp]
+ **/
+#include "benchmark_utils.hpp"
+#include "polygon_math.hpp"
+#include "privacy_mask.hpp"
+#include "buffer_pool.hpp"
+#include "dsp_utils.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define BENCHMARK_WIDTH (3840)
+#define BENCHMARK_HEIGHT (2160)
+// Number of polygons the total masked area is spread over in the scaling benchmark
+#define BENCHMARK_BASE_POLYGONS (8)
+// Number of detections masked on every frame
+#define BENCHMARK_DYNAMIC_MASKS (50)
+
+using namespace privacy_mask_types;
+
+static polygon create_polygon(int index, int frame, int count = BENCHMARK_BASE_POLYGONS)
+{
+    // an octagon of about 300x200 pixels drifting across the frame, shrunk so count polygons cover the area of 8
+    float scale = std::sqrt(float(BENCHMARK_BASE_POLYGONS) / std::max(count, BENCHMARK_BASE_POLYGONS));
+    float center_x = std::fmod(200.0f + index * 450.0f + frame * (3.0f + index), BENCHMARK_WIDTH - 400.0f) + 200.0f;
+    float center_y = std::fmod(150.0f + index * 240.0f + frame * (2.0f + index % 3), BENCHMARK_HEIGHT - 300.0f) + 150.0f;
+    polygon result;
+    result.id = "mask" + std::to_string(index);
+    for (int i = 0; i < 8; i++)
+    {
+        float angle = i * float(M_PI) / 4 + frame * 0.01f;
+        result.vertices.emplace_back(int(center_x + 150.0f * scale * std::cos(angle)), int(center_y + 100.0f * scale * std::sin(angle)));
+    }
+    return result;
+}
+
+/**
+ * Host reference of the DSP blend - every frame pixel of the rois is visited and colored where its bitmask bit is set.
+ * The DSP time follows the same area, so this is used to compare roi sets when no DSP is present.
+ */
+static void blend_rois_reference(const std::vector<uint8_t> &bitmask, uint bytes_per_line, const std::vector<roi_t> &rois,
+                                 std::vector<uint8_t> &y_plane)
+{
+    int scale = 1 / PRIVACY_MASK_QUANTIZATION;
+    for (const roi_t &roi : rois)
+    {
+        uint y_end = std::min<uint>((roi.y + roi.height) * scale, BENCHMARK_HEIGHT);
+        uint x_end = std::min<uint>((roi.x + roi.width) * scale, BENCHMARK_WIDTH);
+        for (uint y = roi.y * scale; y < y_end; y++)
+        {
+            const uint8_t *mask_row = bitmask.data() + (size_t)(y / scale) * bytes_per_line;
+            uint8_t *row = y_plane.data() + (size_t)y * BENCHMARK_WIDTH;
+            for (uint x = roi.x * scale; x < x_end; x++)
+            {
+                if ((mask_row[x / scale / 8] >> (7 - (x / scale) % 8)) & 1)
+                    row[x] = 0x10;
+            }
+        }
+    }
+}
+
+static void benchmark_scaling(int frames, uint bytes_per_line, uint mask_height)
+{
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> bitmask(bytes_per_line * mask_height);
+    std::vector<uint8_t> y_plane(BENCHMARK_WIDTH * BENCHMARK_HEIGHT);
+    printf("full rebuild with the same masked area spread over more polygons\n");
+    for (int count = BENCHMARK_BASE_POLYGONS; count <= MAX_NUM_OF_PRIVACY_MASKS; count *= 2)
+    {
+        std::vector<PolygonPtr> polygons;
+        for (int i = 0; i < count; i++)
+            polygons.emplace_back(std::make_shared<polygon>(create_polygon(i, 0, count)));
+
+        PrivacyMaskEdgeTable edge_table;
+        BenchmarkLatency latency(std::to_string(count) + " polygons");
+        BenchmarkLatency rois_latency(std::to_string(count) + " polygons DSP rois");
+        BenchmarkLatency blend_latency(std::to_string(count) + " polygons blend (ref)");
+        uint64_t masked_pixels = 0;
+        uint64_t roi_pixels = 0;
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            for (int i = 0; i < count; i++)
+                *polygons[i] = create_polygon(i, frame, count);
+            latency.measure([&]
+                            {
+                edge_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+                edge_table.rasterize(full_mask, bitmask.data(), bytes_per_line); });
+            rois_latency.measure([&]
+                                 { edge_table.get_dsp_rois(); });
+            const std::vector<roi_t> &rois = edge_table.get_dsp_rois();
+            blend_latency.measure([&]
+                                  { blend_rois_reference(bitmask, bytes_per_line, rois, y_plane); });
+
+            for (uint8_t byte : bitmask)
+                masked_pixels += __builtin_popcount(byte);
+            for (const roi_t &roi : rois)
+                roi_pixels += (uint64_t)roi.width * roi.height;
+        }
+        latency.print();
+        rois_latency.print();
+        blend_latency.print();
+        printf("  %zu edges, %zu DSP rois covering x%.2f the masked area\n", edge_table.get_num_of_edges(), edge_table.get_dsp_rois().size(),
+               double(roi_pixels) / std::max<uint64_t>(masked_pixels, 1));
+    }
+}
+
+static size_t benchmark_partial_update(int frames, uint bytes_per_line, uint mask_height)
+{
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> full(bytes_per_line * mask_height);
+    std::vector<uint8_t> incremental(bytes_per_line * mask_height);
+    size_t mismatches = 0;
+    printf("one polygon moving among static ones\n");
+    for (int count = BENCHMARK_BASE_POLYGONS; count <= MAX_NUM_OF_PRIVACY_MASKS; count *= 4)
+    {
+        std::vector<PolygonPtr> polygons;
+        for (int i = 0; i < count; i++)
+            polygons.emplace_back(std::make_shared<polygon>(create_polygon(i, 0, count)));
+        PrivacyMaskEdgeTable full_table;
+        PrivacyMaskEdgeTable edge_table;
+        edge_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+        edge_table.rasterize(full_mask, incremental.data(), bytes_per_line);
+
+        BenchmarkLatency full_latency(std::to_string(count) + " polygons full rebuild");
+        BenchmarkLatency incremental_latency(std::to_string(count) + " polygons dirty regions");
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            PolygonPtr &moving = polygons[0];
+            std::vector<roi_t> dirty_regions;
+            dirty_regions.push_back(get_polygon_dirty_region(*moving, BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+            *moving = create_polygon(0, frame, count);
+            dirty_regions.push_back(get_polygon_dirty_region(*moving, BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+
+            full_latency.measure([&]
+                                 {
+                full_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+                full_table.rasterize(full_mask, full.data(), bytes_per_line); });
+            incremental_latency.measure([&]
+                                        {
+                edge_table.set_polygon(*moving);
+                edge_table.rasterize(merge_dirty_regions(dirty_regions), incremental.data(), bytes_per_line); });
+            if (memcmp(full.data(), incremental.data(), full.size()) != 0)
+                mismatches++;
+        }
+        full_latency.print();
+        incremental_latency.print();
+    }
+    printf("  %zu frames where the dirty region bitmask differs from the full rebuild\n", mismatches);
+    return mismatches;
+}
+
+static bool mask_pixel(const std::vector<uint8_t> &bitmask, uint bytes_per_line, uint x, uint y)
+{
+    return (bitmask[y * bytes_per_line + x / 8] >> (7 - x % 8)) & 1;
+}
+
+static size_t benchmark_rotation(int frames, uint bytes_per_line, uint mask_height)
+{
+    uint mask_width = BENCHMARK_WIDTH * PRIVACY_MASK_QUANTIZATION;
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> bitmask(bytes_per_line * mask_height);
+    std::vector<PolygonPtr> polygons;
+    for (int i = 0; i < BENCHMARK_BASE_POLYGONS; i++)
+        polygons.emplace_back(std::make_shared<polygon>(create_polygon(i, 0)));
+    PrivacyMaskEdgeTable edge_table;
+    edge_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+    edge_table.rasterize(full_mask, bitmask.data(), bytes_per_line);
+
+    // Bits are only set inside the DSP rois, only they are rotated after clearing the rotated bitmask
+    std::vector<roi_t> mask_rois;
+    for (const roi_t &roi : edge_table.get_dsp_rois())
+        mask_rois.push_back({roi.x, roi.y, roi.width + 1, roi.height + 1});
+
+    printf("rotating the bitmask of %d polygons instead of rasterizing it again\n", BENCHMARK_BASE_POLYGONS);
+    size_t mismatches = 0;
+    const char *names[] = {"", "rotate 90", "rotate 180", "rotate 270"};
+    for (int angle = ROTATION_ANGLE_90; angle <= ROTATION_ANGLE_270; angle++)
+    {
+        rotation_angle_t rotation = (rotation_angle_t)angle;
+        bool transposed = rotation != ROTATION_ANGLE_180;
+        uint rotated_width = transposed ? mask_height : mask_width;
+        uint rotated_height = transposed ? mask_width : mask_height;
+        uint rotated_bytes_per_line = (rotated_width / 8 + 1 + 7) & ~7;
+        std::vector<uint8_t> rotated(rotated_bytes_per_line * rotated_height);
+
+        BenchmarkLatency latency(names[angle]);
+        for (int frame = 0; frame < frames; frame++)
+            latency.measure([&]
+                            {
+                memset(rotated.data(), 0, rotated.size());
+                rotate_privacy_mask_regions(bitmask.data(), bytes_per_line, mask_width, mask_height, rotation, mask_rois,
+                                            rotated.data(), rotated_bytes_per_line); });
+        latency.print();
+
+        for (uint y = 0; y < mask_height; y++)
+        {
+            for (uint x = 0; x < mask_width; x++)
+            {
+                roi_t pixel = rotate_mask_roi({x, y, 1, 1}, rotation, mask_width, mask_height);
+                if (mask_pixel(bitmask, bytes_per_line, x, y) != mask_pixel(rotated, rotated_bytes_per_line, pixel.x, pixel.y))
+                    mismatches++;
+            }
+        }
+    }
+    printf("  %zu pixels where the rotated bitmask differs from the rotated frame\n", mismatches);
+    return mismatches;
+}
+
+static dynamic_mask_t create_dynamic_mask(dynamic_mask_shape_t shape, int index, int frame)
+{
+    // a face sized detection of about 120x160 pixels walking across the frame, partially leaving it
+    int x = (int)std::fmod(index * 397.0f + frame * (2.0f + index % 5), BENCHMARK_WIDTH + 120.0f) - 120;
+    int y = (int)std::fmod(index * 211.0f + frame * (1.0f + index % 3), BENCHMARK_HEIGHT);
+    return {shape, x, y, 120u + index % 7, 160u + index % 11};
+}
+
+static size_t benchmark_dynamic_masks(int frames, uint bytes_per_line, uint mask_height)
+{
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> full(bytes_per_line * mask_height);
+    std::vector<uint8_t> incremental(bytes_per_line * mask_height);
+    std::vector<PolygonPtr> no_polygons;
+    size_t mismatches = 0;
+
+    printf("%d detections replaced on every frame\n", BENCHMARK_DYNAMIC_MASKS);
+    for (dynamic_mask_shape_t shape : {DYNAMIC_MASK_SHAPE_BOX, DYNAMIC_MASK_SHAPE_ELLIPSE})
+    {
+        const char *name = shape == DYNAMIC_MASK_SHAPE_BOX ? "boxes" : "ellipses";
+        std::vector<dynamic_mask_t> masks;
+        for (int i = 0; i < BENCHMARK_DYNAMIC_MASKS; i++)
+            masks.push_back(create_dynamic_mask(shape, i, 0));
+        PrivacyMaskEdgeTable full_table;
+        PrivacyMaskEdgeTable edge_table;
+        edge_table.build(no_polygons, masks, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+        edge_table.rasterize(full_mask, incremental.data(), bytes_per_line);
+
+        BenchmarkLatency full_latency(std::string(name) + " full rebuild");
+        BenchmarkLatency incremental_latency(std::string(name) + " dirty regions");
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            std::vector<roi_t> dirty_regions;
+            for (int i = 0; i < BENCHMARK_DYNAMIC_MASKS; i++)
+            {
+                dirty_regions.push_back(get_dynamic_mask_dirty_region(masks[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+                masks[i] = create_dynamic_mask(shape, i, frame);
+                dirty_regions.push_back(get_dynamic_mask_dirty_region(masks[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+            }
+
+            full_latency.measure([&]
+                                 {
+                full_table.build(no_polygons, masks, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+                full_table.rasterize(full_mask, full.data(), bytes_per_line); });
+            incremental_latency.measure([&]
+                                        {
+                edge_table.set_dynamic_masks(masks);
+                edge_table.rasterize(merge_dirty_regions(dirty_regions), incremental.data(), bytes_per_line); });
+
+            if (memcmp(full.data(), incremental.data(), full.size()) != 0)
+                mismatches++;
+        }
+        full_latency.print();
+        incremental_latency.print();
+
+        if (shape != DYNAMIC_MASK_SHAPE_BOX)
+            continue;
+        // Boxes cover exactly their dirty regions
+        std::vector<uint8_t> expected(full.size());
+        for (const dynamic_mask_t &mask : masks)
+        {
+            roi_t region = get_dynamic_mask_dirty_region(mask, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+            for (uint y = region.y; y < region.y + region.height; y++)
+                for (uint x = region.x; x < region.x + region.width; x++)
+                    expected[y * bytes_per_line + x / 8] |= 0x80 >> (x % 8);
+        }
+        if (memcmp(full.data(), expected.data(), full.size()) != 0)
+            mismatches++;
+    }
+    printf("  %zu frames where the dirty region bitmask differs from the full rebuild or the boxes\n", mismatches);
+    return mismatches;
+}
+
+/**
+ * Host reference of the DSP area downscale of the pixelation region to 2x2 pixels per cell.
+ */
+static void downscale_cells_reference(const std::vector<uint8_t> &y_plane, const std::vector<uint8_t> &uv_plane, const roi_t &region,
+                                      uint quantization, std::vector<uint8_t> &cells_y, std::vector<uint8_t> &cells_uv, uint cells_stride)
+{
+    uint cells_width = (region.width + quantization - 1) / quantization * 2;
+    uint cells_height = (region.height + quantization - 1) / quantization * 2;
+    uint half = quantization / 2;
+    for (uint cy = 0; cy < cells_height; cy++)
+    {
+        for (uint cx = 0; cx < cells_width; cx++)
+        {
+            uint x0 = region.x + cx * half, y0 = region.y + cy * half;
+            uint x1 = std::min(x0 + half, region.x + region.width), y1 = std::min(y0 + half, region.y + region.height);
+            uint sum = 0, count = 0;
+            for (uint y = y0; y < y1; y++)
+                for (uint x = x0; x < x1; x++, count++)
+                    sum += y_plane[(size_t)y * BENCHMARK_WIDTH + x];
+            cells_y[(size_t)cy * cells_stride + cx] = count ? (sum + count / 2) / count : 0;
+        }
+    }
+    for (uint cy = 0; cy < cells_height / 2; cy++)
+    {
+        for (uint cx = 0; cx < cells_width; cx += 2)
+        {
+            uint x0 = region.x / 2 + cx / 2 * half, y0 = region.y / 2 + cy * half;
+            uint x1 = std::min(x0 + half, (region.x + region.width) / 2), y1 = std::min(y0 + half, (region.y + region.height) / 2);
+            uint u_sum = 0, v_sum = 0, count = 0;
+            for (uint y = y0; y < y1; y++)
+            {
+                for (uint x = x0; x < x1; x++, count++)
+                {
+                    u_sum += uv_plane[(size_t)y * BENCHMARK_WIDTH + 2 * x];
+                    v_sum += uv_plane[(size_t)y * BENCHMARK_WIDTH + 2 * x + 1];
+                }
+            }
+            cells_uv[(size_t)cy * cells_stride + cx] = count ? (u_sum + count / 2) / count : 0;
+            cells_uv[(size_t)cy * cells_stride + cx + 1] = count ? (v_sum + count / 2) / count : 0;
+        }
+    }
+}
+
+static size_t benchmark_quantization(int frames, uint bytes_per_line, uint mask_height)
+{
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> full(bytes_per_line * mask_height);
+    std::vector<uint8_t> incremental(bytes_per_line * mask_height);
+    // NV12 frame with a gradient, so the pixelated cells have something to average
+    std::vector<uint8_t> y_plane(BENCHMARK_WIDTH * BENCHMARK_HEIGHT);
+    std::vector<uint8_t> uv_plane(BENCHMARK_WIDTH * BENCHMARK_HEIGHT / 2);
+    for (size_t i = 0; i < y_plane.size(); i++)
+        y_plane[i] = (i % BENCHMARK_WIDTH + i / BENCHMARK_WIDTH) & 0xff;
+    for (size_t i = 0; i < uv_plane.size(); i++)
+        uv_plane[i] = (i * 7) & 0xff;
+    // The resize outputs the masks are pixelated into
+    std::vector<uint8_t> output_y(y_plane.size());
+    std::vector<uint8_t> output_uv(uv_plane.size());
+    std::vector<uint8_t> small_y(y_plane.size() / 4);
+    std::vector<uint8_t> small_uv(uv_plane.size() / 4);
+    const roi_t full_frame = {0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT};
+    size_t mismatches = 0;
+
+    // The polygons carry their own quantization, the ellipses take the quantization of the table
+    printf("%d polygons and %d ellipses per quantization\n", BENCHMARK_BASE_POLYGONS, BENCHMARK_DYNAMIC_MASKS);
+    for (uint quantization = PRIVACY_MASK_MIN_QUANTIZATION; quantization <= PRIVACY_MASK_MAX_QUANTIZATION; quantization *= 2)
+    {
+        uint cell_size = quantization * PRIVACY_MASK_QUANTIZATION;
+        std::vector<PolygonPtr> polygons;
+        std::vector<dynamic_mask_t> masks;
+        for (int i = 0; i < BENCHMARK_BASE_POLYGONS; i++)
+        {
+            polygons.emplace_back(std::make_shared<polygon>(create_polygon(i, 0)));
+            polygons.back()->quantization = quantization;
+        }
+        for (int i = 0; i < BENCHMARK_DYNAMIC_MASKS; i++)
+            masks.push_back(create_dynamic_mask(DYNAMIC_MASK_SHAPE_ELLIPSE, i, 0));
+        PrivacyMaskEdgeTable full_table;
+        PrivacyMaskEdgeTable edge_table;
+        edge_table.build(polygons, masks, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, cell_size);
+        edge_table.rasterize(full_mask, incremental.data(), bytes_per_line);
+
+        BenchmarkLatency full_latency("q" + std::to_string(quantization) + " full rebuild");
+        BenchmarkLatency incremental_latency("q" + std::to_string(quantization) + " dirty regions");
+        BenchmarkLatency pixelate_latency("q" + std::to_string(quantization) + " pixelate 4K (cpu)");
+        BenchmarkLatency pixelate_small_latency("q" + std::to_string(quantization) + " pixelate 1080p (cpu)");
+        uint64_t dirty_bytes = 0;
+        uint64_t roi_bytes = 0;
+        // The cells image holds 2x2 pixels per cell, as the DSP downscales the pixelation region to
+        uint cells_stride = (BENCHMARK_WIDTH + quantization - 1) / quantization * 2;
+        std::vector<uint8_t> cells_y((size_t)cells_stride * cells_stride);
+        std::vector<uint8_t> cells_uv((size_t)cells_stride * cells_stride / 2);
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            std::vector<roi_t> dirty_regions;
+            for (int i = 0; i < BENCHMARK_BASE_POLYGONS; i++)
+            {
+                dirty_regions.push_back(get_polygon_dirty_region(*polygons[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+                *polygons[i] = create_polygon(i, frame);
+                polygons[i]->quantization = quantization;
+                dirty_regions.push_back(get_polygon_dirty_region(*polygons[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+            }
+            for (int i = 0; i < BENCHMARK_DYNAMIC_MASKS; i++)
+            {
+                dirty_regions.push_back(get_dynamic_mask_dirty_region(masks[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT, cell_size));
+                masks[i] = create_dynamic_mask(DYNAMIC_MASK_SHAPE_ELLIPSE, i, frame);
+                dirty_regions.push_back(get_dynamic_mask_dirty_region(masks[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT, cell_size));
+            }
+
+            full_latency.measure([&]
+                                 {
+                full_table.build(polygons, masks, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, cell_size);
+                full_table.rasterize(full_mask, full.data(), bytes_per_line); });
+            std::vector<roi_t> merged_regions;
+            incremental_latency.measure([&]
+                                        {
+                for (const PolygonPtr &polygon : polygons)
+                    edge_table.set_polygon(*polygon);
+                edge_table.set_dynamic_masks(masks);
+                merged_regions = merge_dirty_regions(dirty_regions);
+                edge_table.rasterize(merged_regions, incremental.data(), bytes_per_line); });
+            if (memcmp(full.data(), incremental.data(), full.size()) != 0)
+                mismatches++;
+
+            // The input frame is only read, the DSP downscale of the region is emulated on the host
+            const std::vector<roi_t> &rois = edge_table.get_dsp_rois();
+            roi_t region = get_pixelation_region(rois.data(), rois.size(), cell_size, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+            downscale_cells_reference(y_plane, uv_plane, region, quantization, cells_y, cells_uv, cells_stride);
+            pixelate_latency.measure([&]
+                                     { fill_pixelated_cells(full.data(), bytes_per_line, rois.data(), rois.size(), cell_size, region,
+                                                            cells_y.data(), cells_stride, cells_uv.data(), cells_stride,
+                                                            BENCHMARK_WIDTH, BENCHMARK_HEIGHT, full_frame,
+                                                            output_y.data(), BENCHMARK_WIDTH, output_uv.data(), BENCHMARK_WIDTH,
+                                                            BENCHMARK_WIDTH, BENCHMARK_HEIGHT); });
+            pixelate_small_latency.measure([&]
+                                           { fill_pixelated_cells(full.data(), bytes_per_line, rois.data(), rois.size(), cell_size, region,
+                                                                  cells_y.data(), cells_stride, cells_uv.data(), cells_stride,
+                                                                  BENCHMARK_WIDTH, BENCHMARK_HEIGHT, full_frame,
+                                                                  small_y.data(), BENCHMARK_WIDTH / 2, small_uv.data(), BENCHMARK_WIDTH / 2,
+                                                                  BENCHMARK_WIDTH / 2, BENCHMARK_HEIGHT / 2); });
+
+            for (const roi_t &region : merged_regions)
+                dirty_bytes += (uint64_t)region.height * ((region.width + 7) / 8 + 1);
+            // The DSP reads the bitmask rows of every roi
+            for (const roi_t &roi : rois)
+                roi_bytes += (uint64_t)(roi.height + 1) * ((roi.width + 8) / 8 + 1);
+        }
+        full_latency.print();
+        incremental_latency.print();
+        pixelate_latency.print();
+        pixelate_small_latency.print();
+        printf("  q%u bytes per update: written %lu, read by the DSP from the rois %lu\n", quantization,
+               dirty_bytes / frames, roi_bytes / frames);
+    }
+    printf("  %zu frames where the dirty region bitmask differs from the full rebuild\n", mismatches);
+    return mismatches;
+}
+
+static bool acquire_benchmark_buffer(MediaLibraryBufferPoolPtr &pool, uint width, uint height, dsp_image_format_t format,
+                                     const std::string &name, hailo_media_library_buffer &buffer)
+{
+    pool = std::make_shared<MediaLibraryBufferPool>(width, height, format, 1, CMA, dsp_utils::get_dsp_desired_stride_from_width(width), name);
+    return pool->init() == MEDIA_LIBRARY_SUCCESS && pool->acquire_buffer(buffer) == MEDIA_LIBRARY_SUCCESS;
+}
+
+/**
+ * DSP time of the multi resize of a 4K frame to a 4K and a 1080p output - without masks, with the masks blended in
+ * their color, and with the pixelation cells resized by the same operation followed by the fill of the outputs.
+ * Needs the DSP, runs on the target only.
+ */
+static int benchmark_dsp(int frames)
+{
+    auto blender_expected = PrivacyMaskBlender::create(BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+    if (!blender_expected.has_value())
+    {
+        printf("Failed to create the privacy mask blender\n");
+        return 1;
+    }
+    PrivacyMaskBlenderPtr blender = blender_expected.value();
+
+    MediaLibraryBufferPoolPtr input_pool, output_pool, small_pool, helper_pool;
+    hailo_media_library_buffer input, helper;
+    std::vector<hailo_media_library_buffer> outputs(2);
+    if (!acquire_benchmark_buffer(input_pool, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, DSP_IMAGE_FORMAT_NV12, "privacy_mask_benchmark_input", input) ||
+        !acquire_benchmark_buffer(output_pool, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, DSP_IMAGE_FORMAT_NV12, "privacy_mask_benchmark_output", outputs[0]) ||
+        !acquire_benchmark_buffer(small_pool, BENCHMARK_WIDTH / 2, BENCHMARK_HEIGHT / 2, DSP_IMAGE_FORMAT_NV12, "privacy_mask_benchmark_small", outputs[1]) ||
+        !acquire_benchmark_buffer(helper_pool, 1280, 720, DSP_IMAGE_FORMAT_GRAY8, "privacy_mask_benchmark_helper", helper))
+    {
+        printf("Failed to allocate the DSP buffers\n");
+        return 1;
+    }
+
+    for (int i = 0; i < BENCHMARK_BASE_POLYGONS; i++)
+        blender->add_privacy_mask(create_polygon(i, 0));
+    dsp_roi_t crop = {0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT};
+    dsp_roi_t cells_crop;
+    dsp_crop_resize_params_t crop_resize_params[2] = {};
+    crop_resize_params[0].crop = &crop;
+    crop_resize_params[0].dst[0] = outputs[0].hailo_pix_buffer.get();
+    crop_resize_params[0].dst[1] = outputs[1].hailo_pix_buffer.get();
+    dsp_multi_crop_resize_params_t multi_crop_resize_params = {
+        .src = input.hailo_pix_buffer.get(),
+        .crop_resize_params = crop_resize_params,
+        .crop_resize_params_count = 1,
+        .interpolation = INTERPOLATION_TYPE_BILINEAR,
+        .helper_plane = helper.hailo_pix_buffer.get(),
+    };
+
+    size_t failures = 0;
+    printf("%d polygons resized from 4K to 4K and 1080p on the DSP\n", BENCHMARK_BASE_POLYGONS);
+    for (uint quantization : {4u, 16u, 64u})
+    {
+        blender->set_quantization(quantization);
+        std::string name = "q" + std::to_string(quantization);
+        BenchmarkLatency resize_latency(name + " resize");
+        BenchmarkLatency color_latency(name + " resize + color (dsp)");
+        BenchmarkLatency cells_latency(name + " resize + cells (dsp)");
+        BenchmarkLatency fill_latency(name + " pixelate outputs (cpu)");
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            for (int i = 0; i < BENCHMARK_BASE_POLYGONS; i++)
+                blender->set_privacy_mask(create_polygon(i, frame));
+            auto data_expected = blender->blend();
+            if (!data_expected.has_value())
+            {
+                failures++;
+                continue;
+            }
+            PrivacyMaskDataPtr privacy_mask_data = data_expected.value();
+
+            multi_crop_resize_params.crop_resize_params_count = 1;
+            resize_latency.measure([&]
+                                   { failures += dsp_utils::perform_dsp_multi_resize(&multi_crop_resize_params) != DSP_SUCCESS; });
+
+            dsp_roi_t dsp_rois[MAX_NUM_OF_PRIVACY_MASK_ROIS];
+            for (uint i = 0; i < privacy_mask_data->rois_count; i++)
+            {
+                const roi_t &roi = privacy_mask_data->rois[i];
+                dsp_rois[i] = {.start_x = roi.x, .start_y = roi.y, .end_x = roi.x + roi.width, .end_y = roi.y + roi.height};
+            }
+            dsp_privacy_mask_t dsp_privacy_mask = {
+                .bitmask = (uint8_t *)privacy_mask_data->bitmask.get_plane(0),
+                .y_color = privacy_mask_data->color.y,
+                .u_color = privacy_mask_data->color.u,
+                .v_color = privacy_mask_data->color.v,
+                .rois = dsp_rois,
+                .rois_count = privacy_mask_data->rois_count,
+            };
+            color_latency.measure([&]
+                                  { failures += dsp_utils::perform_dsp_multi_resize(&multi_crop_resize_params, &dsp_privacy_mask) != DSP_SUCCESS; });
+
+            auto cells_expected = blender->get_pixelation_cells(input, cells_crop);
+            if (!cells_expected.has_value() || cells_expected.value() == nullptr)
+            {
+                failures++;
+                continue;
+            }
+            crop_resize_params[1].crop = &cells_crop;
+            crop_resize_params[1].dst[0] = cells_expected.value();
+            multi_crop_resize_params.crop_resize_params_count = 2;
+            cells_latency.measure([&]
+                                  { failures += dsp_utils::perform_dsp_multi_resize(&multi_crop_resize_params) != DSP_SUCCESS; });
+            fill_latency.measure([&]
+                                 { failures += blender->pixelate({0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT}, outputs) != MEDIA_LIBRARY_SUCCESS; });
+        }
+        resize_latency.print();
+        color_latency.print();
+        cells_latency.print();
+        fill_latency.print();
+    }
+    printf("  %zu failed DSP operations\n", failures);
+
+    input.decrease_ref_count();
+    for (auto &output : outputs)
+        output.decrease_ref_count();
+    helper.decrease_ref_count();
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 300;
+    int count = argc > 2 ? atoi(argv[2]) : 8;
+    bool dsp = argc > 3 && std::string(argv[3]) == "dsp";
+    if (frames <= 0 || count <= 0 || count > MAX_NUM_OF_PRIVACY_MASKS)
+    {
+        printf("Usage: %s [frames] [polygons (up to %d)] [dsp]\n", argv[0], MAX_NUM_OF_PRIVACY_MASKS);
+        return 1;
+    }
+
+    // same layout as the privacy mask buffer pool
+    int line_division = 8 / PRIVACY_MASK_QUANTIZATION;
+    uint bytes_per_line = (BENCHMARK_WIDTH / line_division + 7) & ~7;
+    uint mask_height = BENCHMARK_HEIGHT * PRIVACY_MASK_QUANTIZATION;
+    std::vector<roi_t> full_mask = {{0, 0, bytes_per_line * 8, mask_height}};
+    std::vector<uint8_t> full(bytes_per_line * mask_height);
+    std::vector<uint8_t> incremental(bytes_per_line * mask_height);
+
+    std::vector<PolygonPtr> polygons;
+    for (int i = 0; i < count; i++)
+        polygons.emplace_back(std::make_shared<polygon>(create_polygon(i, 0)));
+    PrivacyMaskEdgeTable full_table;
+    PrivacyMaskEdgeTable edge_table;
+    edge_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+    edge_table.rasterize(full_mask, incremental.data(), bytes_per_line);
+
+    BenchmarkLatency full_latency("full rebuild");
+    BenchmarkLatency incremental_latency("dirty regions");
+    uint64_t full_bytes = 0;
+    uint64_t dirty_bytes = 0;
+    size_t mismatches = 0;
+    for (int frame = 1; frame <= frames; frame++)
+    {
+        std::vector<roi_t> dirty_regions;
+        for (int i = 0; i < count; i++)
+        {
+            dirty_regions.push_back(get_polygon_dirty_region(*polygons[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+            *polygons[i] = create_polygon(i, frame);
+            dirty_regions.push_back(get_polygon_dirty_region(*polygons[i], BENCHMARK_WIDTH, BENCHMARK_HEIGHT));
+        }
+
+        full_latency.measure([&]
+                             {
+            full_table.build(polygons, {}, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+            full_table.rasterize(full_mask, full.data(), bytes_per_line); });
+        std::vector<roi_t> merged_regions;
+        incremental_latency.measure([&]
+                                    {
+            for (const PolygonPtr &polygon : polygons)
+                edge_table.set_polygon(*polygon);
+            merged_regions = merge_dirty_regions(dirty_regions);
+            edge_table.rasterize(merged_regions, incremental.data(), bytes_per_line); });
+
+        full_bytes += full.size();
+        for (const roi_t &region : merged_regions)
+            dirty_bytes += (uint64_t)region.height * ((region.width + 7) / 8 + 1);
+        if (memcmp(full.data(), incremental.data(), full.size()) != 0)
+            mismatches++;
+    }
+
+    printf("%d polygons moving over %dx%d (bitmask %ux%u bytes), %d frames\n", count, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+           bytes_per_line, mask_height, frames);
+    full_latency.print();
+    incremental_latency.print();
+    printf("  bytes written per update: full %lu, dirty regions %lu (x%.1f less)\n", full_bytes / frames, dirty_bytes / frames,
+           double(full_bytes) / std::max<uint64_t>(dirty_bytes, 1));
+    printf("  %zu frames where the dirty region bitmask differs from the full rebuild\n", mismatches);
+
+    benchmark_scaling(frames, bytes_per_line, mask_height);
+    mismatches += benchmark_partial_update(frames, bytes_per_line, mask_height);
+    mismatches += benchmark_rotation(frames, bytes_per_line, mask_height);
+    mismatches += benchmark_dynamic_masks(frames, bytes_per_line, mask_height);
+    mismatches += benchmark_quantization(frames, bytes_per_line, mask_height);
+    if (dsp && benchmark_dsp(frames) != 0)
+        return 1;
+    return mismatches == 0 ? 0 : 1;
+}
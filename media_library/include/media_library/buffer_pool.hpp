@@ -46,7 +46,9 @@
  */
 enum HailoMemoryType
 {
-    CMA
+    CMA,
+    // Host memory, for running without the dma-heap - the planes are passed as user pointers
+    HEAP
 };
 
 class MediaLibraryBufferPool;
@@ -71,6 +73,8 @@ private:
     std::shared_ptr<std::mutex> m_bucket_mutex;
 
     media_library_return allocate();
+    media_library_return allocate_buffer(void **buffer);
+    media_library_return free_buffer(void *buffer);
     media_library_return free(bool fail_on_used_buffers = true);
     media_library_return acquire(intptr_t *buffer_ptr);
     media_library_return release(intptr_t buffer_ptr);
@@ -89,6 +93,7 @@ public:
     HailoBucket &operator=(HailoBucket &&) = delete;
     friend class MediaLibraryBufferPool;
     int available_buffers_count();
+    std::vector<intptr_t> all_buffers();
 };
 using HailoBucketPtr = std::shared_ptr<HailoBucket>;
 
@@ -102,10 +107,13 @@ private:
     uint m_height;
     uint m_bytes_per_line;
     dsp_image_format_t m_format;
+    HailoMemoryType m_memory_type;
     std::shared_ptr<std::mutex> m_buffer_pool_mutex;
     size_t m_max_buffers;
     uint32_t m_buffer_index;
 
+    media_library_return get_plane_fd(intptr_t plane_ptr, int &fd);
+
 public:
     /**
      * @brief Constructor of MediaLibraryBufferPool
@@ -142,6 +150,17 @@ public:
     void log_decrease_ref_count(uint32_t plane_index, uint32_t ref_count, uint32_t buffer_index);
     int get_available_buffers_count();
 
+    /**
+     * @brief Gets every buffer allocated for a plane, used or available.
+     * Lets consumers map or bind the pool memory once instead of per frame.
+     *
+     * @param[in] plane_index - index of the plane
+     * @param[out] buffers - plane buffers of the pool
+     * @param[out] buffer_size - size of each plane buffer
+     * @return media_library_return
+     */
+    media_library_return get_plane_buffers(uint32_t plane_index, std::vector<void *> &buffers, size_t &buffer_size);
+
     /**
      * @brief Initialization of MediaLibraryBufferPool
      * Allocates all the required buffers (according to max_buffers)
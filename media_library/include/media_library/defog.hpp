@@ -33,7 +33,9 @@
 #include <memory>
 #include <tl/expected.hpp>
 
+#include "buffer_pool.hpp"
 #include "media_library_types.hpp"
+#include "inference_backend.hpp"
 
 /** @defgroup defog_type_definitions MediaLibrary Defog CPP API definitions
  *  @{
@@ -48,15 +50,24 @@ protected:
   std::shared_ptr<Impl> m_impl;
 
 public:
+  class callbacks_t
+  {
+  public:
+    std::function<void(bool)> on_enable_changed = nullptr;
+    std::function<void(HailoMediaLibraryBufferPtr)> on_buffer_ready = nullptr;
+  };
+
   /**
    * @brief Create the defog module
    *
    * @param[in] config_string - json configuration string
+   * @param[in] inference_backend - backend to run the network on, or nullptr to open it on the device with HailoRT
    * @return tl::expected<MediaLibraryDefogPtr, media_library_return> -
    * An expected object that holds either a shared pointer
    * to an MediaLibraryDefog object, or a error code.
    */
-  static tl::expected<std::shared_ptr<MediaLibraryDefog>, media_library_return> create(std::string config_string);
+  static tl::expected<std::shared_ptr<MediaLibraryDefog>, media_library_return> create(std::string config_string,
+                                                                                       InferenceBackendPtr inference_backend = nullptr);
 
   /**
    * @brief Constructor for the defog module
@@ -90,6 +101,19 @@ public:
    */
   media_library_return configure(defog_config_t &defog_configs, hailort_t &hailort_configs);
 
+  /**
+   * @brief Perform defog on the input frame, the output frame is passed to the on_buffer_ready callbacks
+   *
+   * The network is opened and the output pool is allocated on the first frame, at its resolution.
+   * While defog is disabled the input frame is passed to the callbacks as is.
+   *
+   * @param[in] input_frame - pointer to the input frame
+   * @param[out] output_frame - output frame after defog
+   *
+   * @return media_library_return - status of the defog operation
+   */
+  media_library_return handle_frame(HailoMediaLibraryBufferPtr input_frame, HailoMediaLibraryBufferPtr output_frame);
+
   /**
    * @brief get the defog configurations object
    *
@@ -110,6 +134,17 @@ public:
    * @return bool - enabled config flag
    */
   bool is_enabled();
+
+  /**
+   * @brief Observes the media library by registering the provided callbacks.
+   *
+   * This function allows the user to observe the media library by registering
+   * callbacks that will be called when certain events occur.
+   *
+   * @param callbacks The callbacks to be registered for observation.
+   * @return media_library_return - status of the observation operation
+   */
+  media_library_return observe(const callbacks_t &callbacks);
 };
 
 /** @} */ // end of defog_type_definitions
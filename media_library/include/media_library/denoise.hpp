@@ -35,6 +35,7 @@
 
 #include "buffer_pool.hpp"
 #include "media_library_types.hpp"
+#include "inference_backend.hpp"
 
 /** @defgroup denoise_type_definitions MediaLibrary Denoise CPP API definitions
  *  @{
@@ -42,6 +43,41 @@
 class MediaLibraryDenoise;
 using MediaLibraryDenoisePtr = std::shared_ptr<MediaLibraryDenoise>;
 
+/**
+ * @brief Frames the adaptive bypass skipped and the network time it saved
+ */
+struct denoise_bypass_stats_t
+{
+  uint64_t inferred_frames;
+  uint64_t bypassed_frames;
+  bool bypassing;
+  // mean time from submitting an inferred frame to its completion
+  double inference_latency_ms;
+  // mean time from passing a bypassed frame through to its delivery, behind the inferred frames in flight
+  double bypass_latency_ms;
+  // latency a bypassed frame saves compared to an inferred one
+  double saved_latency_ms;
+  // time the network would have had the bypassed frames on the device. This is wall time measured on the host,
+  // time waiting for other networks on a shared device included - it is not the device compute time.
+  double saved_active_ms;
+};
+
+/**
+ * @brief CMA taken by the denoise output pool, compared to a loopback that copies the outputs to a pool of its own
+ */
+struct denoise_cma_stats_t
+{
+  // bytes of one full resolution NV12 output buffer
+  size_t buffer_size;
+  // output buffers in the pool - the frames in flight, their loopback references and the buffers held downstream
+  size_t pool_buffers;
+  size_t pool_bytes;
+  // output buffers currently retained as the loopback input of a later frame
+  size_t loopback_buffers;
+  // CMA a separate loopback pool of copied outputs would take - one buffer per loopback frame and one being copied
+  size_t copy_loopback_pool_bytes;
+};
+
 class MediaLibraryDenoise
 {
 protected:
@@ -59,21 +95,24 @@ public:
   /**
    * @brief Create the denoise module
    *
+   * @param[in] inference_backend - backend to run the network on, or nullptr to open it on the device with HailoRT
    * @return tl::expected<MediaLibraryDenoisePtr, media_library_return> -
    * An expected object that holds either a shared pointer
    * to an MediaLibraryDenoise object, or a error code.
    */
-  static tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> create();
+  static tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> create(InferenceBackendPtr inference_backend = nullptr);
 
   /**
    * @brief Create the denoise module
    *
    * @param[in] config_string - json configuration string
+   * @param[in] inference_backend - backend to run the network on, or nullptr to open it on the device with HailoRT
    * @return tl::expected<MediaLibraryDenoisePtr, media_library_return> -
    * An expected object that holds either a shared pointer
    * to an MediaLibraryDenoise object, or a error code.
    */
-  static tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> create(std::string config_string);
+  static tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> create(std::string config_string,
+                                                                                         InferenceBackendPtr inference_backend = nullptr);
 
   /**
    * @brief Constructor for the denoise module
@@ -109,6 +148,8 @@ public:
 
   /**
    * @brief Perform low-light-enhancement on the input frame and return the output frame
+   * A frame the adaptive bypass skips is delivered as its own output and kept as the loopback input of the next
+   * frames, so its memory must stay valid for as long as the input_frame pointer is referenced.
    *
    * @param[in] input_frame - pointer to the input frame to be pre-processed
    * @param[out] output_frames - output frame after denoise
@@ -148,6 +189,20 @@ public:
    * @return media_library_return - status of the observation operation
    */
   media_library_return observe(const callbacks_t &callbacks);
+
+  /**
+   * @brief Get the adaptive bypass statistics since the denoise was created
+   *
+   * @return denoise_bypass_stats_t - inferred and bypassed frames and the saved network time
+   */
+  denoise_bypass_stats_t get_bypass_stats();
+
+  /**
+   * @brief Get the CMA taken by the denoise output pool
+   *
+   * @return denoise_cma_stats_t - pool size and the loopback buffers it holds, compared to a copying loopback
+   */
+  denoise_cma_stats_t get_cma_stats();
 };
 
 /** @} */ // end of denoise_type_definitions
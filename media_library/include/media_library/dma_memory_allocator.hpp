@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <functional>
 #include <mutex>
 #include <memory>
 #include <stdint.h>
@@ -43,6 +44,10 @@ class DmaMemoryAllocator
         bool m_dma_heap_fd_open;
         std::shared_ptr<std::mutex> m_allocator_mutex;
         std::unordered_map<void *, dma_heap_allocation_data> m_allocated_buffers; 
+        // Called with the fd of a freed buffer, before it is closed
+        std::mutex m_free_listeners_mutex;
+        std::unordered_map<uint64_t, std::function<void(int)>> m_free_listeners;
+        uint64_t m_next_free_listener_id;
         DmaMemoryAllocator();
         ~DmaMemoryAllocator();
         
@@ -68,6 +73,17 @@ class DmaMemoryAllocator
         media_library_return dmabuf_sync_end(void *buffer);
         media_library_return get_fd(void *buffer, int& fd);
         media_library_return get_ptr(uint fd, void **buffer);
+        bool owns_fd(int fd);
+
+        /**
+         * @brief Register a function called with the fd of every freed buffer, before the fd is closed.
+         * Lets users that hold a mapping of the buffer by its fd release it while the fd is still valid.
+         * The listener runs on the freeing thread, without the allocator lock held.
+         *
+         * @return uint64_t - id to unregister the listener with
+         */
+        uint64_t register_free_listener(std::function<void(int)> listener);
+        void unregister_free_listener(uint64_t id);
 };
 
 static inline media_library_return destroy_dma_buffer(void *buffer)
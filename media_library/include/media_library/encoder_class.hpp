@@ -21,12 +21,14 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #pragma once
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <vector>
 
 #include "buffer_pool.hpp"
 #include "encoder_config.hpp"
+#include "encoder_scheduler.hpp"
 #include "media_library_types.hpp"
 
 struct EncoderOutputBuffer
@@ -35,6 +37,35 @@ struct EncoderOutputBuffer
     uint32_t size;
 };
 
+struct EncoderOutputSlice
+{
+    // references the slice in the encoder output memory, without a copy
+    HailoMediaLibraryBufferPtr buffer;
+    uint32_t size;
+    // the slice starts a frame, with the stream header on IDR frames
+    bool first;
+    // the slice ends a frame
+    bool last;
+};
+using EncoderSliceCallback = std::function<void(EncoderOutputSlice &slice)>;
+
+struct EncoderOutputStats
+{
+    // frames handed out of the output ring without a copy, complete or slice by slice
+    uint64_t ring_frames;
+    // complete frames copied out of the scratch memory, the ring had no room for them
+    uint64_t copied_frames;
+    // frames larger than their room in the ring
+    uint64_t ring_overflow_frames;
+    // frames delivered slice by slice, and those of them delivered out of the ring without a copy
+    uint64_t sliced_frames;
+    uint64_t sliced_ring_frames;
+};
+using EncoderOutputCallback = std::function<void(std::vector<EncoderOutputBuffer> &outputs)>;
+
+// Frames that may wait for the encode thread before submit_frame blocks
+#define ENCODER_ASYNC_QUEUE_SIZE (2)
+
 class Encoder
 {
 public:
@@ -43,10 +74,70 @@ public:
     int get_gop_size();
     void force_keyframe();
     void update_stride(uint32_t stride);
+    /**
+     * @brief Configure the encoder, applied from the next IDR frame. May be called from any thread - it waits for
+     * the frame or GOP being encoded. Not from the slice callback, which runs while a frame is encoded.
+     */
     media_library_return configure(std::string json_string);
     media_library_return configure(const encoder_config_t &config);
     encoder_config_t get_config();
+    /**
+     * @brief Encode a frame on the calling thread. Fails while async encode runs - frames are then given to submit_frame.
+     */
     std::vector<EncoderOutputBuffer> handle_frame(HailoMediaLibraryBufferPtr buf);
+    /**
+     * @brief Deliver encoded frames slice by slice while they are encoded, instead of as complete frames.
+     * The callback runs on the thread calling handle_frame, each slice as soon as the encoder finished it, and
+     * handle_frame returns no frames while slices are delivered. Set before start() or after stop().
+     * The callback runs while the encoder core is held, so the time it takes delays the frames of the other encoders in
+     * the process - copy or queue the slice and return.
+     *
+     * @param[in] slice_size - CTB rows (HEVC) or macroblock rows (H264) per slice, 0 for complete frames
+     * @param[in] callback - called with each slice
+     * @return media_library_return
+     */
+    media_library_return set_slice_output(uint32_t slice_size, EncoderSliceCallback callback);
+    /**
+     * @brief Encode on a dedicated thread. Frames are queued by submit_frame, and the bus addresses of a frame
+     * are set up on the submitting thread while the previous frame is encoded. The callback runs on the encode
+     * thread with the outputs of each encode, as handle_frame would have returned them. Call after start().
+     *
+     * @param[in] callback - called with the encoded frames
+     * @param[in] queue_size - frames queued before submit_frame blocks
+     * @return media_library_return
+     */
+    media_library_return start_async(EncoderOutputCallback callback, uint32_t queue_size = ENCODER_ASYNC_QUEUE_SIZE);
+    /**
+     * @brief Queue a frame for the encode thread, blocking while the queue is full. The encoder holds its own
+     * reference to the buffer until the frame is encoded. Call from a single thread.
+     *
+     * @param[in] buf - the frame to encode
+     * @return media_library_return
+     */
+    media_library_return submit_frame(HailoMediaLibraryBufferPtr buf);
+    /**
+     * @brief Encode the queued frames and stop the encode thread. Also done by stop().
+     *
+     * @return media_library_return
+     */
+    media_library_return stop_async();
+    /**
+     * @brief Set how the encodes of this stream are scheduled against the other streams sharing the encoder core.
+     * Late encodes of all the streams in the process go first by priority, otherwise the earliest deadline, with
+     * priority breaking ties. By default a stream has priority 0 and a deadline of one frame interval.
+     * The frames of a GOP can only be encoded once its last frame is submitted - the deadline of the n-th frame
+     * encoded in the GOP is n deadlines after that.
+     *
+     * @param[in] priority - orders the late encodes and breaks deadline ties, higher first
+     * @param[in] deadline_us - time a frame may take until it is encoded, 0 for one frame interval
+     * @return media_library_return
+     */
+    media_library_return set_scheduling(uint32_t priority, uint32_t deadline_us);
+    EncoderSchedulingStats get_scheduling_stats();
+    /**
+     * @brief Statistics of the encoder output memory since init(). Not from the slice callback.
+     */
+    EncoderOutputStats get_output_stats();
     EncoderOutputBuffer start();
     EncoderOutputBuffer stop();
     media_library_return init();
@@ -38,6 +38,8 @@ extern "C"
 #include "video_encoder/hevcencapi.h"
 }
 
+class EwlDmabufCache;
+
 /** @defgroup encoder_common_definitions MediaLibrary Encoder Common CPP API
  * definitions
  *  @{
@@ -143,6 +145,10 @@ typedef struct
     /* SW/HW shared memories for output buffers */
     void *ewl;
     EWLLinearMem_t outbufMem;
+    /* Input dmabufs kept shared with the EWL across frames */
+    EwlDmabufCache *dmabuf_cache;
+    /* Stream id in the EncoderScheduler, 0 until the first frame */
+    uint64_t scheduler_stream;
 
     float sumsquareoferror;
     float averagesquareoferror;
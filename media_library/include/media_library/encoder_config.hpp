@@ -121,6 +121,9 @@ struct quantization_config_t
     uint32_t fixed_intra_qp;
 };
 
+// Default headroom of the encoder output buffers over the estimated IDR frame size, in percent
+#define ENCODER_OUTPUT_BUFFER_HEADROOM_DEFAULT (100)
+
 struct  rate_control_config_t
 {
   bool picture_rc;
@@ -133,6 +136,8 @@ struct  rate_control_config_t
   uint32_t gop_length;
   quantization_config_t quantization;
   bitrate_config_t bitrate;
+  // headroom of the output buffers over the estimated IDR frame size, in percent
+  uint32_t output_buffer_headroom;
 };
 
 struct jpeg_encoder_config_t
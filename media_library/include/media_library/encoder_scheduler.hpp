@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_scheduler.hpp
+ * @brief Earliest deadline first scheduling of the encodes of all the streams sharing the encoder core
+ **/
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using encoder_scheduler_clock = std::chrono::steady_clock;
+
+struct EncoderSchedulingStats
+{
+    // encodes of the stream
+    uint64_t jobs;
+    // encodes that ended after the deadline of their frame
+    uint64_t missed_deadlines;
+    // time the encodes waited for the encoder core
+    uint64_t mean_queueing_delay_us;
+    uint64_t max_queueing_delay_us;
+};
+
+/**
+ * @brief Orders the encodes of every Encoder in the process on the one encoder core.
+ *
+ * Each stream registers with a priority and a frame deadline - the time a frame may take from when it can be encoded
+ * until it is encoded. An encode waits in acquire() until the core is free and it is the next waiting encode:
+ * - Encodes already past their deadline go first, the higher priority first - when the core is overloaded the
+ *   main stream keeps its frame rate and the low priority streams fall behind.
+ * - Then the earliest deadline, ties go to the higher priority and then to the earlier request.
+ * Without the scheduler the streams reach the core in whatever order the kernel lets them, and a low priority stream
+ * can delay the frames of the main stream.
+ * The core is held for the whole encode, including the slice callbacks the encoder calls while it encodes a frame -
+ * a slow callback delays the encodes of the other streams.
+ * The scheduler keeps the queueing delay and the missed deadlines of each stream.
+ */
+class EncoderScheduler
+{
+public:
+    static EncoderScheduler &get_instance()
+    {
+        static EncoderScheduler instance;
+        return instance;
+    }
+
+    EncoderScheduler(EncoderScheduler const &) = delete;
+    void operator=(EncoderScheduler const &) = delete;
+
+    /**
+     * @brief Register a stream.
+     *
+     * @param[in] name - name of the stream in the statistics log
+     * @param[in] priority - orders the late encodes and breaks deadline ties, higher first
+     * @param[in] deadline - time a frame may take from when it can be encoded until it is encoded
+     * @return uint64_t - id of the stream
+     */
+    uint64_t register_stream(const std::string &name, uint32_t priority, std::chrono::microseconds deadline);
+    void update_stream(uint64_t id, uint32_t priority, std::chrono::microseconds deadline);
+    /**
+     * @brief Unregister a stream and log its statistics.
+     */
+    void unregister_stream(uint64_t id);
+
+    /**
+     * @brief Wait until the encode of a frame of the stream may use the core.
+     *
+     * @param[in] id - id of the stream
+     * @param[in] submit_time - time the frame could first be encoded, its deadline counts from it
+     */
+    void acquire(uint64_t id, encoder_scheduler_clock::time_point submit_time);
+    /**
+     * @brief Free the core after an encode, and account for its deadline. Does nothing if the stream did not take the
+     * core in acquire() - it was not registered then.
+     */
+    void release(uint64_t id, encoder_scheduler_clock::time_point submit_time);
+
+    EncoderSchedulingStats get_stats(uint64_t id);
+
+private:
+    struct stream_t
+    {
+        std::string name;
+        uint32_t priority;
+        std::chrono::microseconds deadline;
+        EncoderSchedulingStats stats;
+        // sum of the queueing delays, for the mean
+        uint64_t total_queueing_delay_us;
+    };
+
+    struct job_t
+    {
+        uint64_t stream;
+        encoder_scheduler_clock::time_point deadline;
+        uint32_t priority;
+        uint64_t sequence;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_core_free;
+    // stream encoding on the core, 0 while it is free
+    uint64_t m_core_stream = 0;
+    // time the next encode is chosen at - the same for all the waiters, so they agree on which one runs
+    encoder_scheduler_clock::time_point m_schedule_time;
+    // Encodes waiting for the core - a handful at most, one per stream
+    std::vector<job_t> m_waiting;
+    std::unordered_map<uint64_t, stream_t> m_streams;
+    uint64_t m_next_stream_id = 1;
+    uint64_t m_next_sequence = 0;
+
+    EncoderScheduler() = default;
+    ~EncoderScheduler() = default;
+    // the waiting encode to run next at m_schedule_time, m_waiting must not be empty
+    std::vector<job_t>::iterator next_job();
+    void log_stats(const stream_t &stream);
+};
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file ewl_dmabuf_cache.hpp
+ * @brief Cache of the dmabufs shared with the encoder EWL, keyed by fd and inode
+ **/
+
+#pragma once
+#include <mutex>
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+extern "C"
+{
+#include "video_encoder/base_type.h"
+#include "video_encoder/ewl.h"
+}
+
+/** @defgroup ewl_dmabuf_cache_definitions MediaLibrary EWL dmabuf cache CPP API
+ * definitions
+ *  @{
+ */
+
+// Shared dmabufs kept by the cache - a few input pools of a few buffers with two planes each
+#define EWL_DMABUF_CACHE_CAPACITY (64)
+
+struct ewl_dmabuf_cache_stats_t
+{
+  // dmabuf planes shared for the encoder
+  uint64_t lookups;
+  // planes whose mapping was found in the cache
+  uint64_t hits;
+  // EWLShareDmabuf and EWLUnshareDmabuf calls made
+  uint64_t shares;
+  uint64_t unshares;
+};
+
+/**
+ * @brief Keeps the dmabufs shared with an EWL instance mapped across frames.
+ *
+ * Input buffers come from small fixed pools, so the same dmabufs are encoded again and again. Instead of a share
+ * and an unshare per plane per frame, a dmabuf allocated by the DmaMemoryAllocator is shared on its first frame and
+ * stays shared until its buffer is freed - the allocator notifies the cache before it closes the fd.
+ * Entries are keyed by fd and inode, so an fd number reused for another dmabuf is never taken for a cached one.
+ * Each share pins its entry until the matching release, so a dmabuf of a prepared input that is not encoded yet - held
+ * for its GOP or queued for the async encode - is never evicted. While all the entries are pinned the cache grows past
+ * its capacity, and shrinks back as they are released.
+ * Dmabufs from other allocators are shared and unshared per frame as before.
+ */
+class EwlDmabufCache
+{
+public:
+  EwlDmabufCache(const void *ewl, size_t capacity = EWL_DMABUF_CACHE_CAPACITY);
+  /**
+   * @brief Unshare all the cached dmabufs - must be destroyed before the EWL instance is released
+   */
+  ~EwlDmabufCache();
+  EwlDmabufCache(const EwlDmabufCache &) = delete;
+  EwlDmabufCache &operator=(const EwlDmabufCache &) = delete;
+
+  /**
+   * @brief Get the bus address of a dmabuf, sharing it with the EWL unless it is cached.
+   * A cached dmabuf stays pinned until release is called for it.
+   *
+   * @param[in] fd - dmabuf fd of the plane
+   * @param[out] bus_address - bus address of the plane for the encoder
+   * @return i32 - EWL_OK on success
+   */
+  i32 share(int fd, u32 *bus_address);
+
+  /**
+   * @brief Release a dmabuf after its frame is encoded - cached dmabufs are unpinned, the others are unshared
+   */
+  void release(int fd);
+
+  /**
+   * @brief Unshare all the cached dmabufs
+   */
+  void clear();
+
+  ewl_dmabuf_cache_stats_t get_stats();
+
+private:
+  struct entry_t
+  {
+    int fd;
+    ino_t inode;
+    u32 bus_address;
+    uint64_t last_used;
+    // shares not released yet - the inputs that hold the dmabuf until they are encoded
+    uint32_t pins;
+  };
+
+  const void *m_ewl;
+  size_t m_capacity;
+  std::vector<entry_t> m_entries;
+  uint64_t m_use_counter;
+  uint64_t m_free_listener_id;
+  ewl_dmabuf_cache_stats_t m_stats;
+  std::mutex m_mutex;
+
+  void unshare(int fd);
+  void invalidate(int fd, ino_t inode);
+};
+
+/** @} */ // end of ewl_dmabuf_cache_definitions
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file inference_backend.hpp
+ * @brief Interface of the inference backends that run the networks of the media library
+ **/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief A buffer bound to one tensor of a job
+ */
+struct inference_buffer_t
+{
+    void *data;
+    size_t size;
+    // dmabuf fd, or -1 for a buffer only reachable by its user address
+    int fd;
+};
+
+/**
+ * @brief Runs jobs of an opened network asynchronously.
+ *
+ * The HailoRT backend runs them on the device. Other backends stand in for it where there is no device,
+ * so the queueing and threading around the network can be exercised and measured.
+ * A backend is opened by its own factory or constructor, the engine only submits jobs to it.
+ */
+class InferenceBackend
+{
+public:
+    virtual ~InferenceBackend() = default;
+
+    /**
+     * @brief Get the frame size of each tensor, in the order buffers are passed to infer_async
+     */
+    virtual std::vector<size_t> get_frame_sizes() = 0;
+
+    /**
+     * @brief Whether the buffers bound to jobs have to be dmabufs, or host memory will do
+     */
+    virtual bool requires_dma_buffers()
+    {
+        return true;
+    }
+
+    /**
+     * @brief Register a buffer that is bound to jobs again and again, so the backend can map it once
+     */
+    virtual void map_buffer(void *buffer, size_t size)
+    {
+    }
+
+    /**
+     * @brief Prepare a buffer that is bound to the first output tensor of jobs again and again,
+     * so the first job on it does not pay for its setup
+     *
+     * @return 0 on success
+     */
+    virtual int prepare_output(void *buffer)
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Wait until the backend accepts another job
+     *
+     * @return 0 once a job can be started, or an error status on timeout
+     */
+    virtual int wait_for_ready(std::chrono::milliseconds timeout) = 0;
+
+    /**
+     * @brief Start a job on one buffer per tensor
+     *
+     * @param[in] buffers - the buffer of each tensor, in the order of get_frame_sizes
+     * @param[in] on_done - called with the status of the job from a backend thread, 0 on success
+     * @return 0 if the job was started
+     */
+    virtual int infer_async(const std::vector<inference_buffer_t> &buffers, std::function<void(int status)> on_done) = 0;
+};
+using InferenceBackendPtr = std::shared_ptr<InferenceBackend>;
@@ -462,6 +462,27 @@ private:
     }
 };
 
+struct denoise_bypass_config_t
+{
+public:
+    // decide per frame whether the scene is bright enough to skip the network
+    bool enabled;
+    // mean input luma (0-255) above which the denoise is bypassed
+    uint32_t luma_threshold;
+    // band around the threshold, in percent, the scene must cross to switch
+    uint32_t hysteresis;
+    // consecutive frames a new decision must hold before the denoise switches
+    uint32_t hold_frames;
+
+    denoise_bypass_config_t()
+    {
+        enabled = false;
+        luma_threshold = 110;
+        hysteresis = 10;
+        hold_frames = 30;
+    }
+};
+
 struct denoise_config_t
 {
 public:
@@ -469,6 +490,9 @@ public:
     std::string sensor;
     denoise_method_t denoising_quality;
     uint32_t loopback_count;
+    // frames inferred together on the device, applied on first configure only
+    uint32_t batch_size;
+    denoise_bypass_config_t bypass;
     feedback_network_config_t network_config;
 
     denoise_config_t()
@@ -477,6 +501,7 @@ public:
         sensor = "imx678";
         denoising_quality = DENOISE_METHOD_VD2;
         loopback_count = 1;
+        batch_size = 1;
     }
 
     media_library_return update(denoise_config_t &denoise_configs)
@@ -485,6 +510,8 @@ public:
         sensor = denoise_configs.sensor;
         denoising_quality = denoise_configs.denoising_quality;
         loopback_count = denoise_configs.loopback_count;
+        batch_size = denoise_configs.batch_size;
+        bypass = denoise_configs.bypass;
         network_config = denoise_configs.network_config;
 
         return MEDIA_LIBRARY_SUCCESS;
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mock_inference_backend.hpp
+ * @brief Inference backend that simulates a network on the CPU, for benchmarks and tests without a Hailo device
+ **/
+
+#pragma once
+#include "inference_backend.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Status returned when the mock does not accept a job
+#define MOCK_INFERENCE_STATUS_ERROR (-1)
+
+struct mock_inference_config_t
+{
+    // frame size of each tensor, in the order buffers are passed to infer_async
+    std::vector<size_t> frame_sizes;
+    // which tensors are outputs - the default transform copies the n-th input tensor to the n-th output tensor
+    std::vector<bool> outputs;
+    // time from the start of a job to its completion
+    std::chrono::microseconds latency{0};
+    // most jobs started per second, 0 for no limit - a job starts no earlier than 1/fps after the previous one
+    double fps = 0;
+    // jobs accepted at once, wait_for_ready blocks while they are all in flight
+    size_t max_in_flight = 4;
+    // spin until a job is due instead of sleeping, so the scheduler wakeup latency is not added to every job
+    bool busy_wait = true;
+    // replaces the default copy, runs on the worker before the job completes
+    std::function<void(const std::vector<inference_buffer_t> &buffers)> transform = nullptr;
+};
+
+/**
+ * @brief Completes jobs on a worker thread after the configured latency, limited to the configured throughput.
+ *
+ * A job starts when the previous one started 1/fps earlier and completes latency after its start, so like a
+ * pipelined device several jobs are in flight at once and they complete in submission order.
+ * The worker writes the outputs (copied from the inputs, or by the configured transform) and calls on_done.
+ */
+class MockInferenceBackend : public InferenceBackend
+{
+public:
+    MockInferenceBackend(const mock_inference_config_t &config) : m_config(config), m_worker(&MockInferenceBackend::worker_loop, this)
+    {
+    }
+
+    // Completes the jobs still in flight before returning
+    ~MockInferenceBackend()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cv.notify_all();
+        m_worker.join();
+    }
+
+    std::vector<size_t> get_frame_sizes() override
+    {
+        return m_config.frame_sizes;
+    }
+
+    bool requires_dma_buffers() override
+    {
+        // jobs run on the CPU, so the frame pools can be taken from the heap where there is no dma-heap
+        return false;
+    }
+
+    int wait_for_ready(std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool ready = m_cv.wait_for(lock, timeout, [this]
+                                   { return m_jobs.size() < m_config.max_in_flight; });
+        return ready ? 0 : MOCK_INFERENCE_STATUS_ERROR;
+    }
+
+    int infer_async(const std::vector<inference_buffer_t> &buffers, std::function<void(int status)> on_done) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_running || m_jobs.size() >= m_config.max_in_flight || buffers.size() != m_config.frame_sizes.size())
+        {
+            return MOCK_INFERENCE_STATUS_ERROR;
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        if (m_config.fps > 0 && m_jobs_started > 0)
+        {
+            auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / m_config.fps));
+            start_time = std::max(start_time, m_last_start_time + interval);
+        }
+        m_last_start_time = start_time;
+        m_jobs_started++;
+        m_jobs.push_back({buffers, on_done, start_time + m_config.latency});
+        m_cv.notify_all();
+
+        return 0;
+    }
+
+    uint64_t get_completed_jobs()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_jobs_completed;
+    }
+
+private:
+    struct job_t
+    {
+        std::vector<inference_buffer_t> buffers;
+        std::function<void(int status)> on_done;
+        std::chrono::steady_clock::time_point complete_time;
+    };
+
+    mock_inference_config_t m_config;
+    // jobs in flight, in submission order - a job leaves the queue once its on_done returned
+    std::deque<job_t> m_jobs;
+    std::chrono::steady_clock::time_point m_last_start_time;
+    uint64_t m_jobs_started = 0;
+    uint64_t m_jobs_completed = 0;
+    bool m_running = true;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            job_t job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]
+                          { return !m_jobs.empty() || !m_running; });
+                if (m_jobs.empty())
+                    return;
+                job = m_jobs.front();
+            }
+
+            if (m_config.busy_wait)
+            {
+                while (std::chrono::steady_clock::now() < job.complete_time)
+                    ;
+            }
+            else
+            {
+                std::this_thread::sleep_until(job.complete_time);
+            }
+
+            if (m_config.transform)
+                m_config.transform(job.buffers);
+            else
+                copy_inputs_to_outputs(job.buffers);
+            job.on_done(0);
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobs.pop_front();
+                m_jobs_completed++;
+            }
+            m_cv.notify_all();
+        }
+    }
+
+    void copy_inputs_to_outputs(const std::vector<inference_buffer_t> &buffers)
+    {
+        size_t input = 0;
+        for (size_t output = 0; output < buffers.size(); output++)
+        {
+            if (output >= m_config.outputs.size() || !m_config.outputs[output])
+                continue;
+            while (input < buffers.size() && input < m_config.outputs.size() && m_config.outputs[input])
+                input++;
+            if (input == buffers.size() || input >= m_config.outputs.size())
+                return;
+            size_t size = std::min({buffers[input].size, buffers[output].size, m_config.frame_sizes[output]});
+            memcpy(buffers[output].data, buffers[input].data, size);
+            input++;
+        }
+    }
+};
+using MockInferenceBackendPtr = std::shared_ptr<MockInferenceBackend>;
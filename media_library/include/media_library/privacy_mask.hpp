@@ -30,6 +30,7 @@
 #include <tl/expected.hpp>
 #include <nlohmann/json.hpp>
 #include <mutex>
+#include <unordered_set>
 #include "media_library_types.hpp"
 #include "privacy_mask_types.hpp"
 #include "buffer_pool.hpp"
@@ -41,6 +42,8 @@
 
 using namespace privacy_mask_types;
 
+class PrivacyMaskEdgeTable;
+
 class PrivacyMaskBlender : public std::enable_shared_from_this<PrivacyMaskBlender>
 {
     public:
@@ -107,6 +110,25 @@ class PrivacyMaskBlender : public std::enable_shared_from_this<PrivacyMaskBlende
         */
         media_library_return remove_privacy_mask(const std::string &id);
 
+        /**
+         * @brief Set the dynamic privacy masks of a frame
+         * Replaces all the dynamic masks, meant for masks following detections that are updated on every frame.
+         * Only the areas the masks moved out of and into are rasterized again.
+         * Updates of a frame older than the last applied one are dropped, so late detections do not move masks backwards.
+         * 
+         * @param frame_id - id of the frame the masks were detected on
+         * @param dynamic_masks - boxes and ellipses in the coordinates of the unrotated frame
+         * @return media_library_return - error code
+        */
+        media_library_return set_dynamic_privacy_masks(uint64_t frame_id, const std::vector<dynamic_mask_t> &dynamic_masks);
+
+        /**
+         * @brief Remove all the dynamic privacy masks
+         * 
+         * @return media_library_return - error code
+        */
+        media_library_return clear_dynamic_privacy_masks();
+
         /**
           * @brief Set color
           * 
@@ -115,10 +137,67 @@ class PrivacyMaskBlender : public std::enable_shared_from_this<PrivacyMaskBlende
         */
         media_library_return set_color(const rgb_color_t &color);
 
+        /**
+         * @brief Set the privacy mask mode
+         * In pixelate mode the masked cells are replaced by their average color instead of the mask color
+         * 
+         * @param mode - privacy mask mode
+         * @return media_library_return - error code
+        */
+        media_library_return set_mode(const privacy_mask_mode_t &mode);
+
+        /**
+         * @brief Get the privacy mask mode
+         * 
+         * @return tl::expected<privacy_mask_mode_t, media_library_return> - privacy mask mode
+        */
+        tl::expected<privacy_mask_mode_t, media_library_return> get_mode();
+
+        /**
+         * @brief Set the default quantization of the privacy masks
+         * Masks without their own quantization are snapped to square cells of this size,
+         * coarser cells trade edge precision for rasterization time. It is also the pixelation cell size.
+         * 
+         * @param quantization - cell size in frame pixels, a power of two between PRIVACY_MASK_MIN_QUANTIZATION and PRIVACY_MASK_MAX_QUANTIZATION
+         * @return media_library_return - error code
+        */
+        media_library_return set_quantization(const uint &quantization);
+
+        /**
+         * @brief Get the default quantization of the privacy masks
+         * 
+         * @return tl::expected<uint, media_library_return> - cell size in frame pixels
+        */
+        tl::expected<uint, media_library_return> get_quantization();
+
+        /**
+         * @brief Get the pixelation cells image the DSP averages the masked cells into
+         * The masked region of the input frame is resized to 2x2 pixels per cell as another crop of the multi resize
+         * operation, so the DSP reads the input frame once and never writes it. Uses the bitmask of the latest blend.
+         * 
+         * @param input_frame - NV12 frame in the current rotation the outputs are resized from
+         * @param cells_crop - set to the region of the input frame resized into the cells image
+         * @return tl::expected<dsp_image_properties_t *, media_library_return> - the cells image, nullptr when nothing is masked
+        */
+        tl::expected<dsp_image_properties_t *, media_library_return> get_pixelation_cells(hailo_media_library_buffer &input_frame,
+                                                                                          dsp_roi_t &cells_crop);
+
+        /**
+         * @brief Pixelate the masked cells of the outputs of a multi resize
+         * The masked cells of every output are filled with their average from the cells image of get_pixelation_cells,
+         * once the DSP operation wrote it. Only the masked cells of the outputs are written.
+         * 
+         * @param crop - crop of the input frame the outputs were resized from, in frame pixels
+         * @param output_frames - NV12 outputs, frames without a buffer are skipped
+         * @return media_library_return - error code
+        */
+        media_library_return pixelate(const roi_t &crop, std::vector<hailo_media_library_buffer> &output_frames);
+
         /**
          * @brief Set rotation
+         * Polygons stay in the coordinates of the unrotated frame, the bitmask is rotated on the next blend
          * 
-         * @param rotation - rotation angle
+         * @param rotation - rotation angle (clockwise)
          * @return media_library_return - error code
         */
         media_library_return set_rotation(const rotation_angle_t &rotation);
@@ -140,6 +219,7 @@ class PrivacyMaskBlender : public std::enable_shared_from_this<PrivacyMaskBlende
 
         /**
          * @brief Get frame size (width, height)
+         * The size of the unrotated frame, the polygons coordinates are relative to it
          * 
          * @return tl::expected<std::pair<uint, uint>, media_library_return> - frame size width and height
         */
@@ -167,12 +247,50 @@ class PrivacyMaskBlender : public std::enable_shared_from_this<PrivacyMaskBlende
         uint m_frame_width;
         uint m_frame_height;
         rotation_angle_t m_rotation;
+        // Rotation of the frames last given to set_frame_size - differs from m_rotation while a new rotation is pending
+        rotation_angle_t m_frame_rotation;
+        privacy_mask_mode_t m_mode;
+        // Size in frame pixels of the cells the masks without their own quantization are snapped to
+        uint m_quantization;
         MediaLibraryBufferPoolPtr m_buffer_pool;
         std::shared_ptr<std::mutex> m_privacy_mask_mutex;
         PrivacyMaskDataPtr m_latest_privacy_mask_data;
         bool m_update_required;
+        // Bitmask regions changed since the last blend - the bitmask buffer is kept and only these are rasterized
+        std::vector<roi_t> m_dirty_regions;
+        bool m_full_update_required;
+        // Boxes and ellipses replaced on every frame, and the id of the frame they belong to
+        std::vector<dynamic_mask_t> m_dynamic_masks;
+        uint64_t m_dynamic_masks_frame_id;
+        bool m_dynamic_masks_frame_id_valid;
+        // Ids of the polygons added, moved or removed since the last blend, only their edges are rebuilt
+        std::unordered_set<std::string> m_changed_privacy_masks;
+        bool m_dynamic_masks_changed;
+        // Scanline edge table of all the masks, rebuilt in full only when the frame or the quantization changes
+        std::shared_ptr<PrivacyMaskEdgeTable> m_edge_table;
+        // Bitmask of the frame rotated by 90 or 270 degrees
+        MediaLibraryBufferPoolPtr m_rotated_buffer_pool;
+        // Copy of the latest bitmask in the current rotation, only used while the frame is rotated
+        PrivacyMaskDataPtr m_rotated_privacy_mask_data;
+        bool m_rotated_full_update_required;
+        // The masked region of the input frame downscaled by the DSP to 2x2 pixels per pixelation cell
+        MediaLibraryBufferPoolPtr m_pixelation_buffer_pool;
+        hailo_media_library_buffer m_pixelation_cells;
+        // The cells image handed to the DSP, and the region, cell size, frame size and bitmask it was made for
+        dsp_image_properties_t m_pixelation_cells_image;
+        roi_t m_pixelation_region;
+        uint m_pixelation_cell_size;
+        uint m_pixelation_frame_width;
+        uint m_pixelation_frame_height;
+        PrivacyMaskDataPtr m_pixelation_mask_data;
         media_library_return init_buffer_pool();
         void clean_latest_privacy_mask_data();
+        void clean_rotated_privacy_mask_data();
+        media_library_return init_pixelation_buffer(uint cells_width, uint cells_height);
+        void clean_pixelation_buffer();
+        media_library_return update_rotated_privacy_mask_data(const std::vector<roi_t> &updated_regions);
+        PrivacyMaskDataPtr current_privacy_mask_data();
+        void mark_dirty(const polygon &privacy_mask);
 };
 using PrivacyMaskBlenderPtr = std::shared_ptr<PrivacyMaskBlender>;
 
@@ -32,7 +32,14 @@
 #include "media_library_types.hpp"
 #include "buffer_pool.hpp"
 
-#define MAX_NUM_OF_PRIVACY_MASKS  8
+#define MAX_NUM_OF_PRIVACY_MASKS  256
+#define MAX_NUM_OF_PRIVACY_MASK_VERTICES  64
+// Number of rois passed to the DSP, the masks bounding boxes are merged down to it
+#define MAX_NUM_OF_PRIVACY_MASK_ROIS  8
+#define MAX_NUM_OF_DYNAMIC_PRIVACY_MASKS  128
+// Size in frame pixels of the square cells the masks are snapped to, the finest is a single bitmask pixel
+#define PRIVACY_MASK_MIN_QUANTIZATION  4
+#define PRIVACY_MASK_MAX_QUANTIZATION  64
 
 /** @defgroup privacy_mask_types_definitions MediaLibrary Privacy Mask Types
  * API definitions
@@ -62,14 +69,40 @@ namespace privacy_mask_types
   {
       std::string id;
       std::vector<vertex> vertices;
+      // Size in frame pixels of the cells the mask is snapped to, 0 for the quantization of the blender
+      uint quantization = 0;
   };
   using PolygonPtr = std::shared_ptr<polygon>;
 
+  enum dynamic_mask_shape_t
+  {
+      DYNAMIC_MASK_SHAPE_BOX = 0,
+      DYNAMIC_MASK_SHAPE_ELLIPSE,
+  };
+
+  struct dynamic_mask_t
+  {
+      dynamic_mask_shape_t shape;
+      // Bounding box of the shape in frame coordinates, the ellipse is inscribed in it
+      int x, y;
+      uint width, height;
+      // Size in frame pixels of the cells the mask is snapped to, 0 for the quantization of the blender
+      uint quantization = 0;
+  };
+
+  enum privacy_mask_mode_t
+  {
+      // Masked cells are filled with the mask color by the DSP
+      PRIVACY_MASK_MODE_COLOR = 0,
+      // Masked cells of the outputs are replaced by their average color, averaged by the DSP in the resize operation
+      PRIVACY_MASK_MODE_PIXELATE,
+  };
+
   struct privacy_mask_data_t
   {
         hailo_media_library_buffer bitmask;
         yuv_color_t color;
-        roi_t rois[MAX_NUM_OF_PRIVACY_MASKS];
+        roi_t rois[MAX_NUM_OF_PRIVACY_MASK_ROIS];
         uint rois_count;
   };
   using PrivacyMaskDataPtr = std::shared_ptr<privacy_mask_data_t>;
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file vdevice_registry.hpp
+ * @brief Process-wide registry of shared HailoRT VDevices and the scheduling of their networks
+ **/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <tl/expected.hpp>
+
+#include "hailo/hailort.hpp"
+#include "media_library_types.hpp"
+
+/**
+ * @brief Scheduler settings of a network on a shared VDevice
+ */
+struct network_scheduling_t
+{
+    // networks with a higher priority are scheduled first when several have frames ready
+    uint8_t priority = HAILO_SCHEDULER_PRIORITY_NORMAL;
+    // frames to collect before the network is switched in
+    uint32_t threshold = 1;
+    // longest time to wait for the threshold to fill
+    uint32_t timeout_ms = 0;
+};
+
+/**
+ * @brief Utilization of a network since it was registered
+ */
+struct network_utilization_t
+{
+    std::string network_name;
+    std::string group_id;
+    network_scheduling_t scheduling;
+    uint64_t frames;
+    double fps;
+    // mean time from submitting a frame to its completion
+    double mean_latency_ms;
+    // share of the time the network had at least one frame on the device, waiting for other networks included
+    double active_share;
+    // time the network had frames on the device per frame, waiting for other networks included
+    double mean_active_ms;
+    // frames passed through without inference, in the same delivery order as the inferred frames
+    uint64_t bypassed_frames;
+    // mean time from passing a frame through to its delivery, behind the frames in flight
+    double mean_bypass_latency_ms;
+};
+
+/**
+ * @brief Handle of a registered network, records its inferences for the utilization stats.
+ * The network is removed from the stats when its last handle is released.
+ */
+class NetworkUsage
+{
+public:
+    NetworkUsage(const std::string &network_name, const std::string &group_id, const network_scheduling_t &scheduling);
+
+    /**
+     * @brief Record a finished inference. Completions must be recorded in submission order.
+     */
+    void record(std::chrono::steady_clock::time_point submit_time, std::chrono::steady_clock::time_point complete_time);
+
+    /**
+     * @brief Record a frame delivered without inference. It does not count as network activity.
+     */
+    void record_bypassed(std::chrono::steady_clock::time_point submit_time, std::chrono::steady_clock::time_point complete_time);
+
+    network_utilization_t get_utilization();
+
+private:
+    std::string m_network_name;
+    std::string m_group_id;
+    network_scheduling_t m_scheduling;
+    std::chrono::steady_clock::time_point m_start_time;
+    std::chrono::steady_clock::time_point m_last_complete_time;
+    std::mutex m_mutex;
+    uint64_t m_frames = 0;
+    std::chrono::nanoseconds m_total_latency{0};
+    std::chrono::nanoseconds m_active_time{0};
+    uint64_t m_bypassed_frames = 0;
+    std::chrono::nanoseconds m_total_bypass_latency{0};
+};
+using NetworkUsagePtr = std::shared_ptr<NetworkUsage>;
+
+/**
+ * @brief Shares one scheduled VDevice per group id between the denoise, defog and application networks of the process.
+ *
+ * Networks configured on the same VDevice are scheduled together by HailoRT, by their priority, threshold and timeout,
+ * instead of competing as independent devices. The application can override the scheduling of a network by its name
+ * before the network is registered.
+ */
+class VDeviceRegistry
+{
+public:
+    static VDeviceRegistry &get_instance()
+    {
+        static VDeviceRegistry instance;
+        return instance;
+    }
+
+    VDeviceRegistry(VDeviceRegistry const &) = delete;
+    void operator=(VDeviceRegistry const &) = delete;
+
+    /**
+     * @brief Get the VDevice of a group id, creating it with the scheduler enabled on first use.
+     * The VDevice is released when its last user drops it.
+     *
+     * @param[in] group_id - HailoRT device group id
+     * @return tl::expected<std::shared_ptr<hailort::VDevice>, media_library_return>
+     */
+    tl::expected<std::shared_ptr<hailort::VDevice>, media_library_return> acquire_vdevice(const std::string &group_id);
+
+    /**
+     * @brief Override the scheduling of a network, applied when the network is registered
+     *
+     * @param[in] network_name - name the network is registered with
+     * @param[in] scheduling - scheduler settings
+     */
+    void set_network_scheduling(const std::string &network_name, const network_scheduling_t &scheduling);
+
+    /**
+     * @brief Apply the scheduling of a network to its configured model and start tracking its utilization
+     *
+     * @param[in] network_name - name of the network, used to look up scheduling overrides
+     * @param[in] group_id - group id of the VDevice the network was configured on
+     * @param[in] configured_infer_model - the configured network
+     * @param[in] default_scheduling - scheduling to use if the application did not override it
+     * @return tl::expected<NetworkUsagePtr, media_library_return> - handle to record the network's inferences with
+     */
+    tl::expected<NetworkUsagePtr, media_library_return> register_network(const std::string &network_name, const std::string &group_id,
+                                                                         hailort::ConfiguredInferModel &configured_infer_model,
+                                                                         const network_scheduling_t &default_scheduling);
+
+    /**
+     * @brief Get the utilization of all the registered networks
+     */
+    std::vector<network_utilization_t> get_utilization();
+
+private:
+    VDeviceRegistry() = default;
+
+    std::mutex m_mutex;
+    std::map<std::string, std::weak_ptr<hailort::VDevice>> m_vdevices;
+    std::map<std::string, network_scheduling_t> m_scheduling_overrides;
+    std::vector<std::weak_ptr<NetworkUsage>> m_networks;
+};
@@ -23,6 +23,9 @@
 #include "buffer_pool.hpp"
 #include "media_library_logger.hpp"
 
+#include <cstdlib>
+#include <unistd.h>
+
 
 HailoBucket::HailoBucket(size_t buffer_size, size_t num_buffers,
                          HailoMemoryType memory_type)
@@ -49,7 +52,7 @@ media_library_return HailoBucket::allocate()
     for (size_t i = 0; i < buffers_to_allocate; i++)
     {
         void *buffer = NULL;
-        media_library_return result = DmaMemoryAllocator::get_instance().allocate_dma_buffer(m_buffer_size, &buffer);
+        media_library_return result = allocate_buffer(&buffer);
 
         if (result != MEDIA_LIBRARY_SUCCESS)
         {
@@ -63,6 +66,34 @@ media_library_return HailoBucket::allocate()
     return MEDIA_LIBRARY_SUCCESS;
 }
 
+media_library_return HailoBucket::allocate_buffer(void **buffer)
+{
+    switch (m_memory_type)
+    {
+    case CMA:
+        return DmaMemoryAllocator::get_instance().allocate_dma_buffer(m_buffer_size, buffer);
+    case HEAP:
+    {
+        // page aligned, as the dma-heap buffers are
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        *buffer = std::aligned_alloc(page_size, (m_buffer_size + page_size - 1) / page_size * page_size);
+        return *buffer != NULL ? MEDIA_LIBRARY_SUCCESS : MEDIA_LIBRARY_OUT_OF_RESOURCES;
+    }
+    default:
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+}
+
+media_library_return HailoBucket::free_buffer(void *buffer)
+{
+    if (m_memory_type == HEAP)
+    {
+        std::free(buffer);
+        return MEDIA_LIBRARY_SUCCESS;
+    }
+    return DmaMemoryAllocator::get_instance().free_dma_buffer(buffer);
+}
+
 media_library_return HailoBucket::free(bool fail_on_used_buffers)
 {
     std::unique_lock<std::mutex> lock(*m_bucket_mutex);
@@ -84,7 +115,7 @@ media_library_return HailoBucket::free(bool fail_on_used_buffers)
     while (!m_available_buffers.empty())
     {
         intptr_t buffer_ptr = m_available_buffers.front();
-        media_library_return result = DmaMemoryAllocator::get_instance().free_dma_buffer(reinterpret_cast<void*>(buffer_ptr));
+        media_library_return result = free_buffer(reinterpret_cast<void*>(buffer_ptr));
 
         if (result != MEDIA_LIBRARY_SUCCESS)
         {
@@ -145,7 +176,8 @@ MediaLibraryBufferPool::MediaLibraryBufferPool(uint width, uint height,
                                                dsp_image_format_t format,
                                                size_t max_buffers,
                                                HailoMemoryType memory_type, uint bytes_per_line, std::string owner_name)
-    : m_width(width), m_height(height), m_bytes_per_line(bytes_per_line), m_format(format), m_max_buffers(max_buffers)
+    : m_width(width), m_height(height), m_bytes_per_line(bytes_per_line), m_format(format), m_memory_type(memory_type),
+      m_max_buffers(max_buffers)
 {
     m_buffer_index = 0;
     m_name = "";    
@@ -269,7 +301,7 @@ MediaLibraryBufferPool::acquire_buffer(hailo_media_library_buffer &buffer)
         };
 
         int y_channel_fd; 
-        ret = DmaMemoryAllocator::get_instance().get_fd((void *)y_channel_ptr, y_channel_fd);
+        ret = get_plane_fd(y_channel_ptr, y_channel_fd);
 
         if (ret != MEDIA_LIBRARY_SUCCESS)
         {
@@ -295,7 +327,7 @@ MediaLibraryBufferPool::acquire_buffer(hailo_media_library_buffer &buffer)
         };
 
         int uv_channel_fd;
-        ret = DmaMemoryAllocator::get_instance().get_fd((void *)uv_channel_ptr, uv_channel_fd);
+        ret = get_plane_fd(uv_channel_ptr, uv_channel_fd);
         
         DspImagePropertiesPtr hailo_pix_buffer = std::make_shared<dsp_image_properties_t>();
         if (ret != MEDIA_LIBRARY_SUCCESS)
@@ -359,7 +391,7 @@ MediaLibraryBufferPool::acquire_buffer(hailo_media_library_buffer &buffer)
         };
 
         int channel_fd;
-        ret = DmaMemoryAllocator::get_instance().get_fd((void *)data_ptr, channel_fd);
+        ret = get_plane_fd(data_ptr, channel_fd);
 
         DspImagePropertiesPtr hailo_pix_buffer = std::make_shared<dsp_image_properties_t>();
         if (ret != MEDIA_LIBRARY_SUCCESS)
@@ -404,6 +436,14 @@ MediaLibraryBufferPool::acquire_buffer(hailo_media_library_buffer &buffer)
     return ret;
 }
 
+media_library_return MediaLibraryBufferPool::get_plane_fd(intptr_t plane_ptr, int &fd)
+{
+    // heap planes have no fd, they are passed by their user pointer
+    if (m_memory_type == HEAP)
+        return MEDIA_LIBRARY_BUFFER_NOT_FOUND;
+    return DmaMemoryAllocator::get_instance().get_fd((void *)plane_ptr, fd);
+}
+
 void MediaLibraryBufferPool::log_increase_ref_count(uint32_t plane_index, uint32_t ref_count, uint32_t buffer_index)
 {
     LOGGER__DEBUG("{}: Increasing ref count of plane {} to {} for buffer index {}",
@@ -422,11 +462,33 @@ int HailoBucket::available_buffers_count()
     return m_available_buffers.size();
 }
 
+std::vector<intptr_t> HailoBucket::all_buffers()
+{
+    std::unique_lock<std::mutex> lock(*m_bucket_mutex);
+    std::vector<intptr_t> buffers(m_available_buffers.begin(), m_available_buffers.end());
+    buffers.insert(buffers.end(), m_used_buffers.begin(), m_used_buffers.end());
+    return buffers;
+}
+
 int MediaLibraryBufferPool::get_available_buffers_count()
 {
     return m_buckets[0]->available_buffers_count();
 }
 
+media_library_return MediaLibraryBufferPool::get_plane_buffers(uint32_t plane_index, std::vector<void *> &buffers, size_t &buffer_size)
+{
+    if (plane_index >= m_buckets.size())
+    {
+        LOGGER__ERROR("{}: Invalid plane index {}, pool has {} planes", m_name, plane_index, m_buckets.size());
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+    buffers.clear();
+    for (intptr_t buffer_ptr : m_buckets[plane_index]->all_buffers())
+        buffers.push_back(reinterpret_cast<void *>(buffer_ptr));
+    buffer_size = m_buckets[plane_index]->m_buffer_size;
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
 media_library_return
 MediaLibraryBufferPool::release_plane(hailo_media_library_buffer *buffer,
                                       uint32_t plane_index)
@@ -40,6 +40,7 @@
 DmaMemoryAllocator::DmaMemoryAllocator()
 {
     fd_count = 0;
+    m_next_free_listener_id = 0;
     m_allocator_mutex = std::make_shared<std::mutex>();
     m_dma_heap_fd_open = false;
     if (dmabuf_fd_open() != MEDIA_LIBRARY_SUCCESS)
@@ -196,6 +197,13 @@ media_library_return DmaMemoryAllocator::free_dma_buffer(void *buffer)
     int fd = m_allocated_buffers[buffer].fd;
     auto length = m_allocated_buffers[buffer].len;
     m_allocated_buffers.erase(buffer);
+    // The listeners may call back into the allocator
+    lock.unlock();
+    {
+        std::unique_lock<std::mutex> listeners_lock(m_free_listeners_mutex);
+        for (auto &[id, listener] : m_free_listeners)
+            listener(fd);
+    }
 
     if (munmap(buffer, length) == -1)
     {
@@ -206,6 +214,7 @@ media_library_return DmaMemoryAllocator::free_dma_buffer(void *buffer)
 
     close(fd);
 
+    lock.lock();
     fd_count--;
     LOGGER__DEBUG("freeing dma buffer function-end: buffer = {}, size = {}, fd_count = {}", fmt::ptr(buffer), length, fd_count);
 
@@ -293,4 +302,29 @@ media_library_return DmaMemoryAllocator::get_ptr(uint fd, void **buffer)
 
     LOGGER__ERROR("buffer not found in m_allocated_buffers");
     return MEDIA_LIBRARY_BUFFER_NOT_FOUND;
-}
\ No newline at end of file
+}
+
+bool DmaMemoryAllocator::owns_fd(int fd)
+{
+    std::unique_lock<std::mutex> lock(*m_allocator_mutex);
+    for (auto const& [key, val] : m_allocated_buffers)
+    {
+        if (static_cast<int>(val.fd) == fd)
+            return true;
+    }
+    return false;
+}
+
+uint64_t DmaMemoryAllocator::register_free_listener(std::function<void(int)> listener)
+{
+    std::unique_lock<std::mutex> lock(m_free_listeners_mutex);
+    uint64_t id = m_next_free_listener_id++;
+    m_free_listeners[id] = listener;
+    return id;
+}
+
+void DmaMemoryAllocator::unregister_free_listener(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(m_free_listeners_mutex);
+    m_free_listeners.erase(id);
+}
@@ -314,6 +314,10 @@ namespace config_schemas
               "gop_length": {
                 "type": "integer"
               },
+              "output_buffer_headroom": {
+                "type": "integer",
+                "minimum": 0
+              },
               "quantization": {
                 "type": "object",
                 "properties": {
@@ -1458,6 +1462,39 @@ namespace config_schemas
           "loopback-count": {
             "type": "number"
           },
+          "batch-size": {
+            "type": "integer",
+            "minimum": 1
+          },
+          "bypass": {
+            "type": "object",
+            "properties": {
+              "enabled": {
+                "type": "boolean"
+              },
+              "luma-threshold": {
+                "type": "integer",
+                "minimum": 0,
+                "maximum": 255
+              },
+              "hysteresis": {
+                "type": "integer",
+                "minimum": 0,
+                "maximum": 100
+              },
+              "hold-frames": {
+                "type": "integer",
+                "minimum": 1
+              }
+            },
+            "additionalProperties": false,
+            "required": [
+              "enabled",
+              "luma-threshold",
+              "hysteresis",
+              "hold-frames"
+            ]
+          },
           "network": {
             "type": "object",
             "properties": {
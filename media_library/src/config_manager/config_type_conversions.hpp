@@ -409,6 +409,7 @@ void to_json(nlohmann::json &j, const rate_control_config_t &rc_conf)
         {"gop_length", rc_conf.gop_length}, 
         {"bitrate", rc_conf.bitrate},
         {"quantization", rc_conf.quantization},	
+        {"output_buffer_headroom", rc_conf.output_buffer_headroom},
     };
 }
 
@@ -423,6 +424,7 @@ void from_json(const nlohmann::json &j, rate_control_config_t &rc_conf)
     j.at("gop_length").get_to(rc_conf.gop_length);
     j.at("bitrate").get_to(rc_conf.bitrate);
     j.at("quantization").get_to(rc_conf.quantization);
+    rc_conf.output_buffer_headroom = j.value("output_buffer_headroom", (uint32_t)ENCODER_OUTPUT_BUFFER_HEADROOM_DEFAULT);
 }
 
 void to_json(nlohmann::json &j, const hailo_encoder_config_t &enc_conf)
@@ -771,6 +773,26 @@ void from_json(const nlohmann::json &j, network_config_t &net_conf)
     j.at("output_uv_channel").get_to(net_conf.output_uv_channel);
 }
 
+//------------------------ denoise_bypass_config_t ------------------------
+
+void to_json(nlohmann::json &j, const denoise_bypass_config_t &bypass_conf)
+{
+    j = nlohmann::json{
+        {"enabled", bypass_conf.enabled},
+        {"luma-threshold", bypass_conf.luma_threshold},
+        {"hysteresis", bypass_conf.hysteresis},
+        {"hold-frames", bypass_conf.hold_frames},
+    };
+}
+
+void from_json(const nlohmann::json &j, denoise_bypass_config_t &bypass_conf)
+{
+    j.at("enabled").get_to(bypass_conf.enabled);
+    j.at("luma-threshold").get_to(bypass_conf.luma_threshold);
+    j.at("hysteresis").get_to(bypass_conf.hysteresis);
+    j.at("hold-frames").get_to(bypass_conf.hold_frames);
+}
+
 //------------------------ denoise_config_t ------------------------
 
 void to_json(nlohmann::json &j, const denoise_config_t &d_conf)
@@ -781,6 +803,8 @@ void to_json(nlohmann::json &j, const denoise_config_t &d_conf)
             {"sensor", d_conf.sensor},
             {"method", d_conf.denoising_quality},
             {"loopback-count", d_conf.loopback_count},
+            {"batch-size", d_conf.batch_size},
+            {"bypass", d_conf.bypass},
             {"network", d_conf.network_config},
         }},
     };
@@ -793,6 +817,9 @@ void from_json(const nlohmann::json &j, denoise_config_t &d_conf)
     denoise.at("sensor").get_to(d_conf.sensor);
     denoise.at("method").get_to(d_conf.denoising_quality);
     denoise.at("loopback-count").get_to(d_conf.loopback_count);
+    d_conf.batch_size = denoise.value("batch-size", 1u);
+    if (denoise.contains("bypass"))
+        denoise.at("bypass").get_to(d_conf.bypass);
     denoise.at("network").get_to(d_conf.network_config);
 }
 
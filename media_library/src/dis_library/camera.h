@@ -115,6 +115,13 @@ struct FishEye : Camera
     static constexpr float inv_theta_step = 1.f / theta_step;
     float theta2r[theta2r_size];
 
+    /// Inverse LUT parameters - for each radius on a uniform grid, the index of the first theta2r entry which is
+    /// not smaller than it. Brackets the rad2theta() search to a couple of entries instead of a binary search.
+    static constexpr int r2theta_size = 1024;
+    float r_step = 1.f;
+    float inv_r_step = 1.f;
+    std::array<uint16_t, r2theta_size + 1> r2theta_ind;
+
     FishEye() { std::fill_n(theta2r, theta2r_size, 0.f); };
     FishEye(vec2 oc_, ivec2 res_, float (&theta2r_)[theta2r_size])
     {
@@ -126,6 +133,7 @@ struct FishEye : Camera
         res = res_;
         oc = oc_;
         std::copy_n(theta2r_, theta2r_size, theta2r);
+        init_r2theta();
         diag = vec2(res.x, res.y).len();
         flen = theta2r[1] / theta_step;
         fov = 2 * rad2theta(diag / 2);
@@ -144,14 +152,31 @@ struct FishEye : Camera
         diag_ltrb[3] = rad2theta(std::hypotf(oc.x, res.y - oc.y));
     };
 
+    /// @brief Builds the uniform radius grid inverse LUT. theta2r must be monotonically increasing.
+    void init_r2theta()
+    {
+        float max_radius = theta2r[theta2r_size - 1];
+        r_step = max_radius > 0 ? max_radius / r2theta_size : 1.f;
+        inv_r_step = 1.f / r_step;
+        for (int k = 0; k <= r2theta_size; k++)
+        {
+            r2theta_ind[k] = std::lower_bound(std::begin(theta2r), std::end(theta2r) - 2, k * r_step) -
+                             std::begin(theta2r);
+        }
+    }
+
     /// @brief Finds radius corresponding to an angle
     ///
     /// @param radius radius
     float rad2theta(float radius) const
     {
-        int i = std::lower_bound(std::begin(theta2r), std::end(theta2r) - 2,
-                                 radius) -
-                std::begin(theta2r);
+        // start from the grid bracket and walk to the exact std::lower_bound position (over theta2r[0..size-2])
+        int k = radius > 0 ? int(std::min(radius * inv_r_step, float(r2theta_size))) : 0;
+        int i = r2theta_ind[k];
+        while (i < theta2r_size - 2 && theta2r[i] < radius)
+            i++;
+        while (i > 0 && theta2r[i - 1] >= radius)
+            i--;
         return theta_step * (float(i) + (radius - theta2r[i]) /
                                             (theta2r[i + 1] - theta2r[i]));
     }
@@ -176,6 +201,64 @@ struct FishEye : Camera
         return oc + pt * (theta2rad(theta) / rad);
     }
 
+    /// @brief Batched ray2point(rot * ray), writing fixed point mesh vertexes.
+    /// Rays are given as separate x,y,z arrays (SoA) and processed in blocks, each pass being a simple loop over
+    /// the block so the compiler can vectorize it. atan2 is replaced by a polynomial approximation (see
+    /// atan_approx()), so results match ray2point() up to float rounding of theta.
+    ///
+    /// @param rot rotation applied to the rays
+    /// @param ray_x, ray_y, ray_z ray components
+    /// @param count number of rays
+    /// @param offset subtracted from the projected points (0.5 converts pixel coordinates to indexes)
+    /// @param fract_bits fixed point fraction bits of the mesh
+    /// @param mesh_table output, interleaved x,y per ray
+    void rays2mesh(const mat3 &rot, const float *ray_x, const float *ray_y, const float *ray_z, int count,
+                   float offset, int fract_bits, int *mesh_table) const
+    {
+        constexpr int block = 64;
+        const float scale = float(1 << fract_bits);
+        const float ocx = oc.x - offset;
+        const float ocy = oc.y - offset;
+        float rx[block], ry[block], rz[block], rad[block], theta[block];
+
+        for (int base = 0; base < count; base += block)
+        {
+            const int n = std::min(block, count - base);
+            const float *x = ray_x + base;
+            const float *y = ray_y + base;
+            const float *z = ray_z + base;
+
+            // rotation
+            for (int i = 0; i < n; i++)
+            {
+                rx[i] = rot[0] * x[i] + rot[1] * y[i] + rot[2] * z[i];
+                ry[i] = rot[3] * x[i] + rot[4] * y[i] + rot[5] * z[i];
+                rz[i] = rot[6] * x[i] + rot[7] * y[i] + rot[8] * z[i];
+            }
+
+            // angle from the optical axis
+            for (int i = 0; i < n; i++)
+            {
+                rad[i] = std::sqrt(rx[i] * rx[i] + ry[i] * ry[i]);
+                float a = atan_approx(rad[i] > 0 ? rad[i] / std::fabs(rz[i]) : 0.f);
+                theta[i] = rz[i] >= 0 ? a : float(M_PI) - a;
+            }
+
+            // theta2r lookup and projection
+            int *mesh = mesh_table + base * 2;
+            for (int i = 0; i < n; i++)
+            {
+                float fi = theta[i] * inv_theta_step;
+                int j = clamp(int(fi), 0, theta2r_size - 2);
+                fi -= j;
+                float r = theta2r[j] * (1.f - fi) + theta2r[j + 1] * fi;
+                float s = rad[i] > 0 ? r / rad[i] : 0.f;
+                mesh[i * 2] = (ocx + rx[i] * s) * scale;
+                mesh[i * 2 + 1] = (ocy + ry[i] * s) * scale;
+            }
+        }
+    }
+
     vec3 point2ray(const vec2 &pt) const override
     {
         vec2 pc(pt.x - oc.x, pt.y - oc.y);
@@ -432,21 +432,7 @@ RetCodes DIS::generate_grid(vec2 fmv, int32_t panning,
     }
 
     // project out-vertexes rays and generate grid
-    for (int y = 0; y < grid.mesh_height; y++)
-    {
-        for (int x = 0; x < grid.mesh_width; x++)
-        {
-            int ind = y * grid.mesh_width + x;
-
-            vec2 pt = in_cam.ray2point(stab_rot * out_rays[ind]);
-#if GRID_IS_IN_PIX_INDEXES
-            pt = pt - vec2(0.5f, 0.5f); // convert coordinate to index
-#endif
-
-            grid.mesh_table[ind * 2] = pt.x * (1 << MESH_FRACT_BITS);     // x
-            grid.mesh_table[ind * 2 + 1] = pt.y * (1 << MESH_FRACT_BITS); // y
-        }
-    }
+    project_out_rays(stab_rot, grid);
 
     frame_cnt++;
 
@@ -483,21 +469,10 @@ RetCodes DIS::dewarp_only_grid(FlipMirrorRot flip_mirror_rot,
         calc_out_rays(grid.mesh_width, grid.mesh_height, MESH_CELL_SIZE_PIX, flip_mirror_rot);
     }
 
-    for (int y = 0; y < grid.mesh_height; y++)
-    {
-        for (int x = 0; x < grid.mesh_width; x++)
-        {
-            int ind = y * grid.mesh_width + x;
-
-            vec2 pt = in_cam.ray2point(out_rays[ind]); // xi, yi
-#if GRID_IS_IN_PIX_INDEXES
-            pt = pt - vec2(0.5f, 0.5f); // convert coordinate to index
-#endif
-
-            grid.mesh_table[ind * 2] = pt.x * (1 << MESH_FRACT_BITS);     // x
-            grid.mesh_table[ind * 2 + 1] = pt.y * (1 << MESH_FRACT_BITS); // y
-        }
-    }
+    const mat3 identity = {1, 0, 0,
+                           0, 1, 0,
+                           0, 0, 1};
+    project_out_rays(identity, grid);
 
     frame_cnt++;
 
@@ -514,9 +489,11 @@ void DIS::calc_out_rays(int grid_w, int grid_h, int grid_sq, FlipMirrorRot flip_
     // Output image rotation is not related to the output camera - it is implemented as output image rotation,
     // i.e. es if the output image is generated without rotation (out_cam does not knoa about it) and then the
     // image is rotated/flipped/mirrored.
-    if (out_rays.size() != (uint32_t)(grid_w * grid_h))
+    if (out_rays_x.size() != (uint32_t)(grid_w * grid_h))
     {
-        out_rays.resize(grid_w * grid_h);
+        out_rays_x.resize(grid_w * grid_h);
+        out_rays_y.resize(grid_w * grid_h);
+        out_rays_z.resize(grid_w * grid_h);
     }
 
     mat2 rot_mat = ROT_MAT_MAP.at(static_cast<int>(flip_mirror_rot));
@@ -539,11 +516,27 @@ void DIS::calc_out_rays(int grid_w, int grid_h, int grid_sq, FlipMirrorRot flip_
             vec2 pt = rot_mat * pto + gc_cam;
 
             vec3 ray = out_cam->point2ray(pt);
-            out_rays[y * grid_w + x] = ray;
+            out_rays_x[y * grid_w + x] = ray.x;
+            out_rays_y[y * grid_w + x] = ray.y;
+            out_rays_z[y * grid_w + x] = ray.z;
         }
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// project_out_rays
+///////////////////////////////////////////////////////////////////////////////
+void DIS::project_out_rays(const mat3 &rot, DewarpT &grid)
+{
+#if GRID_IS_IN_PIX_INDEXES
+    const float offset = 0.5f; // convert coordinate to index
+#else
+    const float offset = 0.f;
+#endif
+    in_cam.rays2mesh(rot, out_rays_x.data(), out_rays_y.data(), out_rays_z.data(),
+                     grid.mesh_width * grid.mesh_height, offset, MESH_FRACT_BITS, grid.mesh_table);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // store_motion_vec
 ///////////////////////////////////////////////////////////////////////////////
@@ -624,4 +617,4 @@ bool DIS::black_corner_theta_adjust(float &stab_yaw)
     return limited;
 }
 
-///////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+///////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
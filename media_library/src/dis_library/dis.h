@@ -72,8 +72,10 @@ private:
     /// Gets free-ed automatically in destructor.
     /// out_cam orientation does not depend on the flip/mirrir/rot. Its resolution is as passed to dis_init()
     std::unique_ptr<Camera> out_cam;
-    /// Rays in output camera through grid vertices
-    std::vector<vec3> out_rays;
+    /// Rays in output camera through grid vertices, stored as separate x,y,z arrays (SoA) for batched projection
+    std::vector<float> out_rays_x;
+    std::vector<float> out_rays_y;
+    std::vector<float> out_rays_z;
 
     /// actual camera orientation, accumulated from frame-to-frame MVs, radians
     float in_la = 0;
@@ -137,7 +139,7 @@ public:
     /// 1025 values for radius in pixels for theta = 0: pi/1024 : pi. !!! MUST be monotonically increasing !!!
     int init_in_cam(dis_calibration_t calib);
 
-    /// @brief fills out output camera rays in field out_rays
+    /// @brief fills out output camera rays in fields out_rays_x/y/z
     /// @param grid_w grid width
     /// @param grid_h grid height
     /// @param grid_sq grid square size
@@ -158,6 +160,11 @@ public:
     RetCodes dewarp_only_grid(FlipMirrorRot flip_mirror_rot, DewarpT &grid);
 
 private:
+    /// @brief Projects the output rays, rotated by rot, on the input camera and writes them to the grid
+    /// @param rot rotation applied to the output rays
+    /// @param grid output grid
+    void project_out_rays(const mat3 &rot, DewarpT &grid);
+
     /// @brief Generates grid, which only resizes the input image into the output one. Used for debug.
     void gen_resize_grid(DewarpT &grid);
 
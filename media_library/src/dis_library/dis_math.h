@@ -60,6 +60,20 @@ static inline val_t clamp(val_t val, val_t min, val_t max)
     return std::min(std::max(val, min), max);
 }
 
+/// @brief arctangent of a non-negative value (including +inf), branch free so it vectorizes.
+/// Cephes atanf range reduction and polynomial - max error is a few float ulps.
+///
+/// @param x non-negative value
+static inline float atan_approx(float x)
+{
+    const bool big = x > 2.414213562373095f;  // tan(3pi/8)
+    const bool mid = x > 0.4142135623730950f; // tan(pi/8)
+    const float y = big ? float(M_PI_2) : (mid ? float(M_PI_4) : 0.f);
+    const float xr = big ? (-1.f / x) : (mid ? (x - 1.f) / (x + 1.f) : x);
+    const float z = xr * xr;
+    return y + ((((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * xr + xr);
+}
+
 typedef Vec3T<float> vec3;
 typedef Vec2T<float> vec2;
 
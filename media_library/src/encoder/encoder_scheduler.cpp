@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_scheduler.cpp
+ * @brief Earliest deadline first scheduling of the encodes of all the streams sharing the encoder core
+ **/
+
+#include <algorithm>
+
+#include "encoder_scheduler.hpp"
+#include "media_library_logger.hpp"
+
+uint64_t EncoderScheduler::register_stream(const std::string &name, uint32_t priority, std::chrono::microseconds deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t id = m_next_stream_id++;
+    m_streams[id] = stream_t{name, priority, deadline, {}, 0};
+    LOGGER__INFO("Encoder scheduler - stream {} ({}) registered with priority {} and a deadline of {} us",
+                 id, name, priority, deadline.count());
+    return id;
+}
+
+void EncoderScheduler::update_stream(uint64_t id, uint32_t priority, std::chrono::microseconds deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto stream = m_streams.find(id);
+    if (stream == m_streams.end())
+        return;
+    stream->second.priority = priority;
+    stream->second.deadline = deadline;
+}
+
+void EncoderScheduler::unregister_stream(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto stream = m_streams.find(id);
+    if (stream == m_streams.end())
+        return;
+    log_stats(stream->second);
+    m_streams.erase(stream);
+}
+
+std::vector<EncoderScheduler::job_t>::iterator EncoderScheduler::next_job()
+{
+    encoder_scheduler_clock::time_point now = m_schedule_time;
+    return std::min_element(m_waiting.begin(), m_waiting.end(), [now](const job_t &a, const job_t &b)
+                            {
+                                // Late encodes go first, by priority - their deadline is lost either way
+                                bool a_late = a.deadline <= now;
+                                bool b_late = b.deadline <= now;
+                                if (a_late != b_late)
+                                    return a_late;
+                                if (a_late && a.priority != b.priority)
+                                    return a.priority > b.priority;
+                                if (a.deadline != b.deadline)
+                                    return a.deadline < b.deadline;
+                                if (a.priority != b.priority)
+                                    return a.priority > b.priority;
+                                return a.sequence < b.sequence; });
+}
+
+void EncoderScheduler::acquire(uint64_t id, encoder_scheduler_clock::time_point submit_time)
+{
+    encoder_scheduler_clock::time_point request_time = encoder_scheduler_clock::now();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto stream = m_streams.find(id);
+    if (stream == m_streams.end())
+        return;
+
+    uint64_t sequence = m_next_sequence++;
+    m_waiting.push_back(job_t{id, submit_time + stream->second.deadline, stream->second.priority, sequence});
+    if (m_core_stream == 0)
+    {
+        // The new encode may change which waiting encode runs next, they all check again at the same time
+        m_schedule_time = request_time;
+        m_core_free.notify_all();
+    }
+    m_core_free.wait(lock, [this, sequence]
+                     { return m_core_stream == 0 && next_job()->sequence == sequence; });
+    m_waiting.erase(std::find_if(m_waiting.begin(), m_waiting.end(), [sequence](const job_t &job)
+                                 { return job.sequence == sequence; }));
+    m_core_stream = id;
+
+    // The stream may have been unregistered while it waited, and the map changed
+    stream = m_streams.find(id);
+    if (stream == m_streams.end())
+        return;
+    uint64_t queueing_delay_us = std::chrono::duration_cast<std::chrono::microseconds>(encoder_scheduler_clock::now() - request_time).count();
+    stream->second.total_queueing_delay_us += queueing_delay_us;
+    stream->second.stats.max_queueing_delay_us = std::max(stream->second.stats.max_queueing_delay_us, queueing_delay_us);
+}
+
+void EncoderScheduler::release(uint64_t id, encoder_scheduler_clock::time_point submit_time)
+{
+    encoder_scheduler_clock::time_point end_time = encoder_scheduler_clock::now();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // a stream that was not registered in acquire() did not take the core
+    if (m_core_stream != id)
+        return;
+
+    auto stream = m_streams.find(id);
+    // the core is freed even if the stream was unregistered while it encoded
+    if (stream != m_streams.end())
+    {
+        EncoderSchedulingStats &stats = stream->second.stats;
+        stats.jobs++;
+        stats.mean_queueing_delay_us = stream->second.total_queueing_delay_us / stats.jobs;
+        if (end_time > submit_time + stream->second.deadline)
+        {
+            stats.missed_deadlines++;
+            LOGGER__DEBUG("Encoder scheduler - stream {} missed its deadline by {} us", stream->second.name,
+                          std::chrono::duration_cast<std::chrono::microseconds>(end_time - submit_time - stream->second.deadline).count());
+        }
+    }
+    m_core_stream = 0;
+    m_schedule_time = end_time;
+    lock.unlock();
+    // The waiters check for themselves whether they run next
+    m_core_free.notify_all();
+}
+
+EncoderSchedulingStats EncoderScheduler::get_stats(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto stream = m_streams.find(id);
+    if (stream == m_streams.end())
+        return {};
+    return stream->second.stats;
+}
+
+void EncoderScheduler::log_stats(const stream_t &stream)
+{
+    LOGGER__INFO("Encoder scheduler - stream {} (priority {}, deadline {} us): {} encodes, {} missed deadlines, "
+                 "queueing delay mean {} us max {} us",
+                 stream.name, stream.priority, stream.deadline.count(), stream.stats.jobs,
+                 stream.stats.missed_deadlines, stream.stats.mean_queueing_delay_us,
+                 stream.stats.max_queueing_delay_us);
+}
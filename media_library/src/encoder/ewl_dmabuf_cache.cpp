@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ewl_dmabuf_cache.hpp"
+#include "dma_memory_allocator.hpp"
+#include "media_library_logger.hpp"
+#include <algorithm>
+#include <sys/stat.h>
+
+static ino_t dmabuf_inode(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return 0;
+    return st.st_ino;
+}
+
+EwlDmabufCache::EwlDmabufCache(const void *ewl, size_t capacity)
+    : m_ewl(ewl), m_capacity(capacity), m_use_counter(0), m_stats({0, 0, 0, 0})
+{
+    m_entries.reserve(capacity);
+    m_free_listener_id = DmaMemoryAllocator::get_instance().register_free_listener([this](int fd)
+                                                                                  { invalidate(fd, dmabuf_inode(fd)); });
+}
+
+EwlDmabufCache::~EwlDmabufCache()
+{
+    // unregistered first, so no free of a pool buffer races with the teardown
+    DmaMemoryAllocator::get_instance().unregister_free_listener(m_free_listener_id);
+    clear();
+    LOGGER__DEBUG("EWL dmabuf cache - {} planes shared for encoding, {} cache hits, {} shares and {} unshares",
+                  m_stats.lookups, m_stats.hits, m_stats.shares, m_stats.unshares);
+}
+
+i32 EwlDmabufCache::share(int fd, u32 *bus_address)
+{
+    ino_t inode = dmabuf_inode(fd);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stats.lookups++;
+    for (entry_t &entry : m_entries)
+    {
+        if (entry.fd == fd && entry.inode == inode)
+        {
+            entry.last_used = ++m_use_counter;
+            entry.pins++;
+            *bus_address = entry.bus_address;
+            m_stats.hits++;
+            return EWL_OK;
+        }
+    }
+
+    i32 ret = EWLShareDmabuf(m_ewl, fd, bus_address);
+    m_stats.shares++;
+    // Only buffers of the allocator notify the cache when they are freed, other dmabufs are unshared after their frame
+    if (ret != EWL_OK || inode == 0 || !DmaMemoryAllocator::get_instance().owns_fd(fd))
+        return ret;
+
+    while (m_entries.size() >= m_capacity)
+    {
+        // only entries no input holds can be evicted, unpinned ones sort first
+        auto lru = std::min_element(m_entries.begin(), m_entries.end(), [](const entry_t &a, const entry_t &b)
+                                    { return (a.pins == 0) != (b.pins == 0) ? a.pins == 0 : a.last_used < b.last_used; });
+        if (lru->pins > 0)
+            break;
+        unshare(lru->fd);
+        m_entries.erase(lru);
+    }
+    m_entries.push_back({fd, inode, *bus_address, ++m_use_counter, 1});
+    return EWL_OK;
+}
+
+void EwlDmabufCache::release(int fd)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // the inode was checked when the frame was shared, and the input holds the buffer until its release
+    for (entry_t &entry : m_entries)
+    {
+        if (entry.fd == fd)
+        {
+            if (entry.pins > 0)
+                entry.pins--;
+            return;
+        }
+    }
+    unshare(fd);
+}
+
+void EwlDmabufCache::clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (entry_t &entry : m_entries)
+        unshare(entry.fd);
+    m_entries.clear();
+}
+
+ewl_dmabuf_cache_stats_t EwlDmabufCache::get_stats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void EwlDmabufCache::unshare(int fd)
+{
+    m_stats.unshares++;
+    if (EWLUnshareDmabuf(m_ewl, fd) != EWL_OK)
+        LOGGER__ERROR("EWL dmabuf cache - could not unshare dmabuf fd {}", fd);
+}
+
+/**
+ * @brief Called by the allocator before the fd of a freed buffer is closed, while it still refers to the dmabuf
+ */
+void EwlDmabufCache::invalidate(int fd, ino_t inode)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [fd, inode](const entry_t &entry)
+                           { return entry.fd == fd && entry.inode == inode; });
+    if (it == m_entries.end())
+        return;
+    unshare(fd);
+    m_entries.erase(it);
+}
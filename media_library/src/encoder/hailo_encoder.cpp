@@ -21,6 +21,8 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include "hailo_encoder.hpp"
+#include "ewl_dmabuf_cache.hpp"
+#include "encoder_scheduler.hpp"
 
 void SetDefaultParameters(EncoderParams *enc_params, bool codecH264)
 {
@@ -503,6 +505,7 @@ int AllocRes(EncoderParams *enc_params)
     {
         return 1;
     }
+    enc_params->dmabuf_cache = new EwlDmabufCache(enc_params->ewl);
 
     /* Limited amount of memory on some test environment */
     outbufSize = ((u32)enc_params->outBufSizeMax * 1024 * 1024);
@@ -529,6 +532,14 @@ void FreeRes(EncoderParams *enc_params)
 {
     if (enc_params->outbufMem.virtualAddress != NULL)
         EWLFreeLinear((const void *)enc_params->ewl, &enc_params->outbufMem);
+    /* The cached dmabufs are unshared before the EWL instance is released */
+    delete enc_params->dmabuf_cache;
+    enc_params->dmabuf_cache = NULL;
+    if (enc_params->scheduler_stream != 0)
+    {
+        EncoderScheduler::get_instance().unregister_stream(enc_params->scheduler_stream);
+        enc_params->scheduler_stream = 0;
+    }
     if (NULL != enc_params->ewl)
         (void)EWLRelease((const void *)enc_params->ewl);
 }
@@ -548,8 +559,25 @@ VCEncRet EncodeFrame(EncoderParams *enc_params, VCEncInst encoder,
         enc_params->last_idr_picture_cnt = enc_params->picture_cnt;
     }
 
-    return VCEncStrmEncode(encoder, pEncIn, pEncOut, sliceReadyCbFunc,
-                           pAppData);
+    /* The stream shares the encoder core with the other encoders of the process.
+       It is registered on the first frame, once the frame rate is negotiated,
+       with a deadline of one frame interval. */
+    if (enc_params->scheduler_stream == 0)
+    {
+        std::chrono::microseconds deadline(std::chrono::seconds(1));
+        if (enc_params->frameRateNumer > 0 && enc_params->frameRateDenom > 0)
+            deadline = std::chrono::microseconds(1000000LL * enc_params->frameRateDenom / enc_params->frameRateNumer);
+        enc_params->scheduler_stream = EncoderScheduler::get_instance().register_stream(
+            "hailoenc " + std::to_string(enc_params->width) + "x" + std::to_string(enc_params->height), 0, deadline);
+    }
+
+    /* The slice callbacks run while the core is held */
+    encoder_scheduler_clock::time_point submit_time = encoder_scheduler_clock::now();
+    EncoderScheduler::get_instance().acquire(enc_params->scheduler_stream, submit_time);
+    VCEncRet ret = VCEncStrmEncode(encoder, pEncIn, pEncOut, sliceReadyCbFunc,
+                                   pAppData);
+    EncoderScheduler::get_instance().release(enc_params->scheduler_stream, submit_time);
+    return ret;
 }
 
 void ForceKeyframe(EncoderParams *enc_params, VCEncInst encoder)
@@ -22,9 +22,12 @@
  */
 
 #include "defog.hpp"
+#include "hailort_defog.hpp"
+#include "buffer_pool.hpp"
 #include "config_manager.hpp"
 #include "media_library_logger.hpp"
 #include "media_library_utils.hpp"
+#include "spsc_ring.hpp"
 #include <iostream>
 #include <linux/v4l2-controls.h>
 #include <linux/v4l2-subdev.h>
@@ -34,14 +37,22 @@
 #include <time.h>
 #include <tl/expected.hpp>
 #include <vector>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+
+#define DEFOG_BPOOL_MAX_SIZE 10
+// Frames inferred at once - each one holds its input frame and an output buffer from the pool
+#define DEFOG_MAX_IN_FLIGHT 2
+#define DEFOG_Q_SIZE DEFOG_MAX_IN_FLIGHT
 
 class MediaLibraryDefog::Impl final
 {
 public:
     static tl::expected<std::shared_ptr<MediaLibraryDefog::Impl>, media_library_return>
-    create(std::string config_string);
+    create(std::string config_string, InferenceBackendPtr inference_backend);
     // Constructor
-    Impl(media_library_return &status, std::string config_string);
+    Impl(media_library_return &status, std::string config_string, InferenceBackendPtr inference_backend);
     // Destructor
     ~Impl();
     // Move constructor
@@ -64,6 +75,12 @@ public:
     // get the enabled config status
     bool is_enabled();
 
+    // Perform defog on the input frame and pass the output frame to the callbacks
+    media_library_return handle_frame(HailoMediaLibraryBufferPtr input_frame, HailoMediaLibraryBufferPtr output_frame);
+
+    // set the callbacks object
+    media_library_return observe(const MediaLibraryDefog::callbacks_t &callbacks);
+
 private:
     // configured flag - to determine if first configuration was done
     bool m_configured;
@@ -73,15 +90,43 @@ private:
     // operation configurations
     defog_config_t m_defog_configs;
     hailort_t m_hailort_configs;
+    std::vector<MediaLibraryDefog::callbacks_t> m_callbacks;
+    // configuration mutex
+    std::shared_mutex rw_lock;
+    // HRT module, opened on the first frame so the GStreamer element, which runs the network in hailonet, never opens it
+    HailortAsyncDefogPtr m_hailort_defog;
+    bool m_hailort_initialized;
+    // backend the network runs on, nullptr to open it with HailoRT
+    InferenceBackendPtr m_inference_backend;
+    // output buffer pool, allocated on the first frame at its resolution
+    MediaLibraryBufferPoolPtr m_output_buffer_pool;
+    // inference controls
+    bool m_inferring;
+    std::atomic<bool> m_flushing;
+    // Each ring has a single producer and a single consumer thread:
+    // staging - handle_frame to callback thread, holds the input frames until their inference is done
+    std::unique_ptr<SpscRing<HailoMediaLibraryBufferPtr>> m_staging_ring;
+    // callback controls - HailoRT callback thread to callback thread
+    std::unique_ptr<SpscRing<HailoMediaLibraryBufferPtr>> m_inference_callback_ring;
+    std::thread m_inference_callback_thread;
+
     media_library_return reconfigure();
     media_library_return validate_configurations(defog_config_t &defog_configs, hailort_t &hailort_configs);
     media_library_return decode_config_json_string(defog_config_t &defog_configs,  hailort_t &hailort_configs, std::string config_string);
+    media_library_return initialize_hailort(HailoMediaLibraryBufferPtr input_buffer);
+    media_library_return perform_defog(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr output_buffer);
+    void pass_through(HailoMediaLibraryBufferPtr input_buffer);
+    void start_inference();
+    void stop_inference();
+    void inference_callback(HailoMediaLibraryBufferPtr output_buffer);
+    void inference_callback_thread();
+    void clear_queue(SpscRing<HailoMediaLibraryBufferPtr> &ring);
 };
 
 //------------------------ MediaLibraryDefog ------------------------
-tl::expected<std::shared_ptr<MediaLibraryDefog>, media_library_return> MediaLibraryDefog::create(std::string config_string)
+tl::expected<std::shared_ptr<MediaLibraryDefog>, media_library_return> MediaLibraryDefog::create(std::string config_string, InferenceBackendPtr inference_backend)
 {
-    auto impl_expected = Impl::create(config_string);
+    auto impl_expected = Impl::create(config_string, inference_backend);
     if (impl_expected.has_value())
         return std::make_shared<MediaLibraryDefog>(impl_expected.value());
     else
@@ -117,12 +162,22 @@ bool MediaLibraryDefog::is_enabled()
     return m_impl->is_enabled();
 }
 
+media_library_return MediaLibraryDefog::handle_frame(HailoMediaLibraryBufferPtr input_frame, HailoMediaLibraryBufferPtr output_frame)
+{
+    return m_impl->handle_frame(input_frame, output_frame);
+}
+
+media_library_return MediaLibraryDefog::observe(const MediaLibraryDefog::callbacks_t &callbacks)
+{
+    return m_impl->observe(callbacks);
+}
+
 //------------------------ MediaLibraryDefog::Impl ------------------------
 
-tl::expected<std::shared_ptr<MediaLibraryDefog::Impl>, media_library_return> MediaLibraryDefog::Impl::create(std::string config_string)
+tl::expected<std::shared_ptr<MediaLibraryDefog::Impl>, media_library_return> MediaLibraryDefog::Impl::create(std::string config_string, InferenceBackendPtr inference_backend)
 {
     media_library_return status = MEDIA_LIBRARY_UNINITIALIZED;
-    std::shared_ptr<MediaLibraryDefog::Impl> defog = std::make_shared<MediaLibraryDefog::Impl>(status, config_string);
+    std::shared_ptr<MediaLibraryDefog::Impl> defog = std::make_shared<MediaLibraryDefog::Impl>(status, config_string, inference_backend);
     if (status != MEDIA_LIBRARY_SUCCESS)
     {
         return tl::make_unexpected(status);
@@ -130,9 +185,17 @@ tl::expected<std::shared_ptr<MediaLibraryDefog::Impl>, media_library_return> Med
     return defog;
 }
 
-MediaLibraryDefog::Impl::Impl(media_library_return &status, std::string config_string)
+MediaLibraryDefog::Impl::Impl(media_library_return &status, std::string config_string, InferenceBackendPtr inference_backend)
 {
     m_configured = false;
+    m_hailort_initialized = false;
+    m_inference_backend = inference_backend;
+    m_inferring = false;
+    m_flushing = false;
+    m_hailort_defog = std::make_shared<HailortAsyncDefog>([this](HailoMediaLibraryBufferPtr output_buffer)
+                                                          { inference_callback(output_buffer); });
+    m_staging_ring = std::make_unique<SpscRing<HailoMediaLibraryBufferPtr>>(DEFOG_Q_SIZE);
+    m_inference_callback_ring = std::make_unique<SpscRing<HailoMediaLibraryBufferPtr>>(DEFOG_Q_SIZE);
     m_defog_config_manager = std::make_shared<ConfigManager>(ConfigSchema::CONFIG_SCHEMA_DEFOG);
     m_hailort_config_manager = std::make_shared<ConfigManager>(ConfigSchema::CONFIG_SCHEMA_HAILORT);
     if (decode_config_json_string(m_defog_configs, m_hailort_configs, config_string) != MEDIA_LIBRARY_SUCCESS)
@@ -147,6 +210,11 @@ MediaLibraryDefog::Impl::Impl(media_library_return &status, std::string config_s
 
 MediaLibraryDefog::Impl::~Impl()
 {
+    LOGGER__DEBUG("Defog - destructor");
+    stop_inference();
+    m_hailort_defog.reset();
+    clear_queue(*m_inference_callback_ring);
+    clear_queue(*m_staging_ring);
 }
 
 media_library_return MediaLibraryDefog::Impl::decode_config_json_string(defog_config_t &defog_configs, hailort_t &hailort_configs, std::string config_string)
@@ -188,13 +256,29 @@ media_library_return MediaLibraryDefog::Impl::validate_configurations(defog_conf
 media_library_return MediaLibraryDefog::Impl::configure(defog_config_t &defog_configs, hailort_t &hailort_configs)
 {
     LOGGER__INFO("Configuring defog");
+    std::unique_lock<std::shared_mutex> lock(rw_lock);
+
     if (validate_configurations(defog_configs, hailort_configs) != MEDIA_LIBRARY_SUCCESS)
     {
         LOGGER__ERROR("Failed to validate configurations");
         return MEDIA_LIBRARY_CONFIGURATION_ERROR;
     }
+    bool enabled_changed = m_defog_configs.enabled != defog_configs.enabled;
     m_defog_configs = defog_configs;
     m_hailort_configs = hailort_configs;
+
+    // check if disabling - frames in flight are dropped, the next frames pass through
+    if (!m_defog_configs.enabled && enabled_changed)
+    {
+        stop_inference();
+    }
+
+    // Call observing callbacks in case configuration changed
+    for (auto &callbacks : m_callbacks)
+    {
+        if ((!m_configured || enabled_changed) && callbacks.on_enable_changed)
+            callbacks.on_enable_changed(m_defog_configs.enabled);
+    }
     m_configured = true;
     return MEDIA_LIBRARY_SUCCESS;
 }
@@ -213,3 +297,201 @@ bool MediaLibraryDefog::Impl::is_enabled()
 {
     return m_defog_configs.enabled;
 }
+
+media_library_return MediaLibraryDefog::Impl::observe(const MediaLibraryDefog::callbacks_t &callbacks)
+{
+    m_callbacks.push_back(callbacks);
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+/**
+ * @brief Open the network and allocate the output pool at the resolution of the first frame.
+ * The pool buffers are mapped and bound to the network once, so frames are inferred with no copy in or out.
+ */
+media_library_return MediaLibraryDefog::Impl::initialize_hailort(HailoMediaLibraryBufferPtr input_buffer)
+{
+    if (m_hailort_defog->init(m_defog_configs.network_config, m_hailort_configs.device_id, DEFOG_MAX_IN_FLIGHT, m_inference_backend) != 0)
+    {
+        LOGGER__ERROR("Failed to init hailort");
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+
+    uint width = input_buffer->hailo_pix_buffer->width;
+    uint height = input_buffer->hailo_pix_buffer->height;
+    std::string name = "defog_output";
+    LOGGER__DEBUG("Creating buffer pool named {} for output resolution: width {} height {} in buffers size of {}", name, width, height, DEFOG_BPOOL_MAX_SIZE);
+    m_output_buffer_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, DEFOG_BPOOL_MAX_SIZE, CMA, name);
+    if (m_output_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("Failed to init buffer pool");
+        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+    }
+    if (m_hailort_defog->prepare_pool(m_output_buffer_pool) != 0)
+    {
+        LOGGER__ERROR("Failed to prepare hailort bindings of the defog buffer pool");
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+
+    m_hailort_initialized = true;
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return MediaLibraryDefog::Impl::handle_frame(HailoMediaLibraryBufferPtr input_frame, HailoMediaLibraryBufferPtr output_frame)
+{
+    std::unique_lock<std::shared_mutex> lock(rw_lock);
+
+    // check null for input and output buffer
+    if (input_frame == nullptr || output_frame == nullptr)
+    {
+        LOGGER__ERROR("input or output buffer is null");
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+
+    if (!m_defog_configs.enabled)
+    {
+        pass_through(input_frame);
+        return MEDIA_LIBRARY_SUCCESS;
+    }
+
+    if (!m_hailort_initialized)
+    {
+        media_library_return ret = initialize_hailort(input_frame);
+        if (ret != MEDIA_LIBRARY_SUCCESS)
+            return ret;
+    }
+    if (!m_inferring)
+    {
+        start_inference();
+    }
+
+    return perform_defog(input_frame, output_frame);
+}
+
+/**
+ * @brief Perform defog
+ * Acquire buffer for defog output and run the network on the NN core,
+ * the output is delivered by the inference callback thread
+ *
+ * @param[in] input_buffer - pointer to the input frame
+ * @param[out] output_buffer - defog output buffer
+ */
+media_library_return MediaLibraryDefog::Impl::perform_defog(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr output_buffer)
+{
+    if (input_buffer->hailo_pix_buffer->width != m_output_buffer_pool->get_width() ||
+        input_buffer->hailo_pix_buffer->height != m_output_buffer_pool->get_height())
+    {
+        LOGGER__ERROR("Input resolution {}x{} differs from the defog output resolution {}x{}", input_buffer->hailo_pix_buffer->width,
+                      input_buffer->hailo_pix_buffer->height, m_output_buffer_pool->get_width(), m_output_buffer_pool->get_height());
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+
+    // Acquire buffer for defog output
+    if (m_output_buffer_pool->acquire_buffer(*output_buffer.get()) != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("failed to acquire buffer for defog output");
+        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+    }
+
+    // The input is read by the network until its inference is done
+    input_buffer->increase_ref_count();
+    if (m_hailort_defog->process(input_buffer, output_buffer) != 0)
+    {
+        input_buffer->decrease_ref_count();
+        output_buffer->decrease_ref_count();
+        LOGGER__ERROR("Failed to process defog");
+        return MEDIA_LIBRARY_ERROR;
+    }
+    // Staged after it was submitted, so a failed submission leaves no input behind -
+    // the callback thread waits for it if the output is already done
+    if (!m_staging_ring->push(input_buffer))
+    {
+        // flushing - the output is released by the inference callback
+        input_buffer->decrease_ref_count();
+    }
+
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+/**
+ * @brief Deliver the input frame as is, holding a reference for the callbacks as a defog output would
+ */
+void MediaLibraryDefog::Impl::pass_through(HailoMediaLibraryBufferPtr input_buffer)
+{
+    input_buffer->increase_ref_count();
+    for (auto &callbacks : m_callbacks)
+    {
+        if (callbacks.on_buffer_ready)
+        {
+            callbacks.on_buffer_ready(input_buffer);
+        }
+    }
+}
+
+void MediaLibraryDefog::Impl::start_inference()
+{
+    m_flushing = false;
+    m_staging_ring->reopen();
+    m_inference_callback_ring->reopen();
+    m_inference_callback_thread = std::thread(&MediaLibraryDefog::Impl::inference_callback_thread, this);
+    m_inferring = true;
+}
+
+void MediaLibraryDefog::Impl::stop_inference()
+{
+    m_flushing = true;
+    // wake the callback thread waiting on the queues, we are flushing
+    m_inference_callback_ring->close();
+    m_staging_ring->close();
+    if (m_inference_callback_thread.joinable())
+        m_inference_callback_thread.join();
+    // The staged inputs are read by the jobs still in flight, their outputs are released since we are flushing.
+    // Once drained no old output can be paired with an input staged after a restart.
+    m_hailort_defog->drain();
+    clear_queue(*m_inference_callback_ring);
+    clear_queue(*m_staging_ring);
+    m_inferring = false;
+}
+
+void MediaLibraryDefog::Impl::inference_callback(HailoMediaLibraryBufferPtr output_buffer)
+{
+    if (m_flushing || !m_inference_callback_ring->push(output_buffer))
+    {
+        output_buffer->decrease_ref_count();
+    }
+}
+
+void MediaLibraryDefog::Impl::inference_callback_thread()
+{
+    while (!m_flushing)
+    {
+        std::optional<HailoMediaLibraryBufferPtr> output_buffer = m_inference_callback_ring->pop();
+        if (!output_buffer.has_value())
+        {
+            return;
+        }
+        // Outputs are delivered in submission order, so the oldest staged input is the one of this output
+        std::optional<HailoMediaLibraryBufferPtr> input_buffer = m_staging_ring->pop();
+        if (!input_buffer.has_value())
+        {
+            output_buffer.value()->decrease_ref_count();
+            return;
+        }
+        input_buffer.value()->decrease_ref_count();
+
+        for (auto &callbacks : m_callbacks)
+        {
+            if (callbacks.on_buffer_ready)
+            {
+                callbacks.on_buffer_ready(output_buffer.value());
+            }
+        }
+    }
+}
+
+void MediaLibraryDefog::Impl::clear_queue(SpscRing<HailoMediaLibraryBufferPtr> &ring)
+{
+    while (std::optional<HailoMediaLibraryBufferPtr> buffer = ring.try_pop())
+    {
+        buffer.value()->decrease_ref_count();
+    }
+}
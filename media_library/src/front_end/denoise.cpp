@@ -23,10 +23,12 @@
 
 #include "denoise.hpp"
 #include "hailort_denoise.hpp"
+#include "denoise_bypass.hpp"
 #include "buffer_pool.hpp"
 #include "config_manager.hpp"
 #include "media_library_logger.hpp"
 #include "media_library_utils.hpp"
+#include "spsc_ring.hpp"
 
 #include <iostream>
 #include <linux/v4l2-controls.h>
@@ -40,22 +42,33 @@
 #include <shared_mutex>
 #include <chrono>
 #include <ctime>
-#include <queue>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <thread>
-#include <condition_variable>
 
-#define BPOOL_MAX_SIZE 10
-#define Q_SIZE 2
+// Frame N is fed the output of frame N - loopback-count, so up to loopback-count frames are in flight.
+// Each one holds an output and a loopback buffer from the pool.
+#define DENOISE_MAX_LOOPBACK_COUNT 3
+// Outputs held by the consumers of on_buffer_ready on top of the loopback references
+#define DENOISE_DOWNSTREAM_BUFFERS 4
+// The loopback input is the output buffer of an earlier frame, retained by reference - the pool holds the outputs
+// in flight, the outputs retained for the loopback and the ones held downstream, with no loopback pool of its own
+#define DENOISE_BPOOL_SIZE(loopback_count) (2 * (loopback_count) + DENOISE_DOWNSTREAM_BUFFERS)
+#define DENOISE_OUTPUT_WIDTH 3840
+#define DENOISE_OUTPUT_HEIGHT 2160
+#define Q_SIZE DENOISE_MAX_LOOPBACK_COUNT
+// Longest the scheduler waits to fill a batch before sending a partial one
+#define DENOISE_SCHEDULER_TIMEOUT_MS 1000
 
 class MediaLibraryDenoise::Impl final
 {
 public:
-    static tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> create();
-    static tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> create(std::string config_string);
+    static tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> create(InferenceBackendPtr inference_backend);
+    static tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> create(std::string config_string, InferenceBackendPtr inference_backend);
     // Constructor
-    Impl(media_library_return &status);
-    Impl(media_library_return &status, std::string config_string);
+    Impl(media_library_return &status, InferenceBackendPtr inference_backend);
+    Impl(media_library_return &status, std::string config_string, InferenceBackendPtr inference_backend);
     // Destructor
     ~Impl();
     // Move constructor
@@ -84,6 +97,12 @@ public:
     // set the callbacks object
     media_library_return observe(const MediaLibraryDenoise::callbacks_t &callbacks);
 
+    // get the adaptive bypass statistics
+    denoise_bypass_stats_t get_bypass_stats();
+
+    // get the CMA usage of the output pool
+    denoise_cma_stats_t get_cma_stats();
+
 private:
     // configured flag - to determine if first configuration was done
     bool m_configured;
@@ -93,6 +112,8 @@ private:
     std::vector<MediaLibraryDenoise::callbacks_t> m_callbacks;
     // output buffer pool
     MediaLibraryBufferPoolPtr m_output_buffer_pool;
+    // loopback count the output pool is sized for, set on first configure
+    uint32_t m_pool_loopback_count;
     // operation configurations
     denoise_config_t m_denoise_configs;
     hailort_t m_hailort_configs;
@@ -100,40 +121,41 @@ private:
     std::shared_mutex rw_lock;
     // HRT module
     HailortAsyncDenoisePtr m_hailort_denoise;
+    // backend the network runs on, nullptr to open it with HailoRT
+    InferenceBackendPtr m_inference_backend;
+    // adaptive bypass of bright scenes
+    DenoiseBypass m_bypass;
     // loopback controls
-    uint8_t m_queue_size;
     uint8_t m_loop_counter;
     uint8_t m_callback_counter;
     uint8_t m_loopback_limit;
-    bool m_flushing;
-    std::unique_ptr<std::condition_variable> m_loopback_condvar;
-    std::shared_ptr<std::mutex> m_loopback_mutex;
-    std::queue<HailoMediaLibraryBufferPtr> m_loopback_queue;
-    std::unique_ptr<std::condition_variable> m_staging_condvar;
-    std::shared_ptr<std::mutex> m_staging_mutex;
-    std::queue<HailoMediaLibraryBufferPtr> m_staging_queue;
-    // callback controls
-    std::unique_ptr<std::condition_variable> m_inference_callback_condvar;
-    std::shared_ptr<std::mutex> m_inference_callback_mutex;
-    std::queue<HailoMediaLibraryBufferPtr> m_inference_callback_queue;
+    std::atomic<bool> m_flushing;
+    // Each ring has a single producer and a single consumer thread:
+    // loopback - callback thread to handle_frame, staging - handle_frame to callback thread
+    std::unique_ptr<SpscRing<HailoMediaLibraryBufferPtr>> m_loopback_ring;
+    std::unique_ptr<SpscRing<HailoMediaLibraryBufferPtr>> m_staging_ring;
+    // callback controls - HailoRT callback thread to callback thread
+    std::unique_ptr<SpscRing<HailoMediaLibraryBufferPtr>> m_inference_callback_ring;
 
     media_library_return reconfigure();
     media_library_return create_and_initialize_buffer_pools();
     media_library_return validate_configurations(denoise_config_t &denoise_configs, hailort_t &hailort_configs);
     media_library_return decode_config_json_string(denoise_config_t &denoise_configs, hailort_t &hailort_configs, std::string config_string);
     media_library_return perform_denoise(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr output_buffer);
-    void set_default_members();
+    void set_default_members(InferenceBackendPtr inference_backend);
     void stamp_time_and_log_fps(timespec &start_handle, timespec &end_handle);
     void inference_callback(HailoMediaLibraryBufferPtr output_buffer);
     void queue_loopback_buffer(HailoMediaLibraryBufferPtr buffer);
     HailoMediaLibraryBufferPtr dequeue_loopback_buffer();
     void clear_loopback_queue();
-    void queue_staging_buffer(HailoMediaLibraryBufferPtr buffer);
+    bool queue_staging_buffer(HailoMediaLibraryBufferPtr buffer);
     HailoMediaLibraryBufferPtr dequeue_staging_buffer();
     void clear_staging_queue();
-    void queue_buffer(HailoMediaLibraryBufferPtr buffer, std::queue<HailoMediaLibraryBufferPtr> &queue, std::shared_ptr<std::mutex> mutex, std::shared_ptr<std::condition_variable> condvar, uint8_t queue_size);  
-    HailoMediaLibraryBufferPtr dequeue_buffer(std::queue<HailoMediaLibraryBufferPtr> &queue, std::shared_ptr<std::mutex> mutex, std::shared_ptr<std::condition_variable> condvar);
-    void clear_queue(std::queue<HailoMediaLibraryBufferPtr> &queue, std::shared_ptr<std::mutex> mutex, std::shared_ptr<std::condition_variable> condvar);
+    bool queue_buffer(HailoMediaLibraryBufferPtr buffer, SpscRing<HailoMediaLibraryBufferPtr> &ring);
+    HailoMediaLibraryBufferPtr dequeue_buffer(SpscRing<HailoMediaLibraryBufferPtr> &ring);
+    void clear_queue(SpscRing<HailoMediaLibraryBufferPtr> &ring);
+    void close_queues();
+    void reopen_queues();
     void inference_callback_thread();
     std::thread m_inference_callback_thread;
     void queue_inference_callback_buffer(HailoMediaLibraryBufferPtr buffer);
@@ -142,18 +164,18 @@ private:
 };
 
 //------------------------ MediaLibraryDenoise ------------------------
-tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> MediaLibraryDenoise::create()
+tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> MediaLibraryDenoise::create(InferenceBackendPtr inference_backend)
 {
-    auto impl_expected = Impl::create();
+    auto impl_expected = Impl::create(inference_backend);
     if (impl_expected.has_value())
         return std::make_shared<MediaLibraryDenoise>(impl_expected.value());
     else
         return tl::make_unexpected(impl_expected.error());
 }
 
-tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> MediaLibraryDenoise::create(std::string config_string)
+tl::expected<std::shared_ptr<MediaLibraryDenoise>, media_library_return> MediaLibraryDenoise::create(std::string config_string, InferenceBackendPtr inference_backend)
 {
-    auto impl_expected = Impl::create(config_string);
+    auto impl_expected = Impl::create(config_string, inference_backend);
     if (impl_expected.has_value())
         return std::make_shared<MediaLibraryDenoise>(impl_expected.value());
     else
@@ -199,11 +221,21 @@ media_library_return MediaLibraryDenoise::observe(const MediaLibraryDenoise::cal
     return m_impl->observe(callbacks);
 }
 
+denoise_bypass_stats_t MediaLibraryDenoise::get_bypass_stats()
+{
+    return m_impl->get_bypass_stats();
+}
+
+denoise_cma_stats_t MediaLibraryDenoise::get_cma_stats()
+{
+    return m_impl->get_cma_stats();
+}
+
 //------------------------ MediaLibraryDenoise::Impl ------------------------
-tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> MediaLibraryDenoise::Impl::create()
+tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> MediaLibraryDenoise::Impl::create(InferenceBackendPtr inference_backend)
 {
     media_library_return status = MEDIA_LIBRARY_UNINITIALIZED;
-    std::shared_ptr<MediaLibraryDenoise::Impl> denoise = std::make_shared<MediaLibraryDenoise::Impl>(status);
+    std::shared_ptr<MediaLibraryDenoise::Impl> denoise = std::make_shared<MediaLibraryDenoise::Impl>(status, inference_backend);
     if (status != MEDIA_LIBRARY_SUCCESS)
     {
         return tl::make_unexpected(status);
@@ -211,10 +243,10 @@ tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> M
     return denoise;
 }
 
-tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> MediaLibraryDenoise::Impl::create(std::string config_string)
+tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> MediaLibraryDenoise::Impl::create(std::string config_string, InferenceBackendPtr inference_backend)
 {
     media_library_return status = MEDIA_LIBRARY_UNINITIALIZED;
-    std::shared_ptr<MediaLibraryDenoise::Impl> denoise = std::make_shared<MediaLibraryDenoise::Impl>(status, config_string);
+    std::shared_ptr<MediaLibraryDenoise::Impl> denoise = std::make_shared<MediaLibraryDenoise::Impl>(status, config_string, inference_backend);
     if (status != MEDIA_LIBRARY_SUCCESS)
     {
         return tl::make_unexpected(status);
@@ -222,40 +254,35 @@ tl::expected<std::shared_ptr<MediaLibraryDenoise::Impl>, media_library_return> M
     return denoise;
 }
 
-void MediaLibraryDenoise::Impl::set_default_members()
+void MediaLibraryDenoise::Impl::set_default_members(InferenceBackendPtr inference_backend)
 {
     m_configured = false;
+    m_inference_backend = inference_backend;
     m_denoise_config_manager = std::make_shared<ConfigManager>(ConfigSchema::CONFIG_SCHEMA_DENOISE);
     m_hailort_config_manager = std::make_shared<ConfigManager>(ConfigSchema::CONFIG_SCHEMA_HAILORT);
     m_hailort_denoise = std::make_shared<HailortAsyncDenoise>([this](HailoMediaLibraryBufferPtr output_buffer)
                                                               { inference_callback(output_buffer); });
 
+    m_pool_loopback_count = 0;
     m_loopback_limit = 1;
     m_loop_counter = 0;
     m_callback_counter = 0;
     m_flushing = false;
-    m_queue_size = Q_SIZE;
-    m_loopback_mutex = std::make_shared<std::mutex>();
-    m_loopback_condvar = std::make_unique<std::condition_variable>();
-    m_loopback_queue = std::queue<HailoMediaLibraryBufferPtr>();
-    m_staging_mutex = std::make_shared<std::mutex>();
-    m_staging_condvar = std::make_unique<std::condition_variable>();
-    m_staging_queue = std::queue<HailoMediaLibraryBufferPtr>();
-    m_inference_callback_mutex = std::make_shared<std::mutex>();
-    m_inference_callback_condvar = std::make_unique<std::condition_variable>();
-    m_inference_callback_queue = std::queue<HailoMediaLibraryBufferPtr>();
+    m_loopback_ring = std::make_unique<SpscRing<HailoMediaLibraryBufferPtr>>(Q_SIZE);
+    m_staging_ring = std::make_unique<SpscRing<HailoMediaLibraryBufferPtr>>(Q_SIZE);
+    m_inference_callback_ring = std::make_unique<SpscRing<HailoMediaLibraryBufferPtr>>(Q_SIZE);
 }
 
-MediaLibraryDenoise::Impl::Impl(media_library_return &status)
+MediaLibraryDenoise::Impl::Impl(media_library_return &status, InferenceBackendPtr inference_backend)
 {
-    set_default_members();
+    set_default_members(inference_backend);
 
     status = MEDIA_LIBRARY_SUCCESS;
 }
 
-MediaLibraryDenoise::Impl::Impl(media_library_return &status, std::string config_string)
+MediaLibraryDenoise::Impl::Impl(media_library_return &status, std::string config_string, InferenceBackendPtr inference_backend)
 {
-    set_default_members();
+    set_default_members(inference_backend);
 
     if (decode_config_json_string(m_denoise_configs, m_hailort_configs, config_string) != MEDIA_LIBRARY_SUCCESS)
     {
@@ -280,11 +307,10 @@ MediaLibraryDenoise::Impl::~Impl()
 {
     LOGGER__DEBUG("Denoise - destructor");
     m_flushing = true;
-    m_inference_callback_condvar->notify_one();
-    m_loopback_condvar->notify_one();
-    m_staging_condvar->notify_one();
+    close_queues();
     if (m_inference_callback_thread.joinable())
     	m_inference_callback_thread.join();
+    // drains the in flight jobs, their outputs are released since we are flushing
     m_hailort_denoise.reset();
     clear_inference_callback_queue();
     clear_loopback_queue();
@@ -323,7 +349,25 @@ media_library_return MediaLibraryDenoise::Impl::configure(std::string config_str
 
 media_library_return MediaLibraryDenoise::Impl::validate_configurations(denoise_config_t &denoise_configs, hailort_t &hailort_configs)
 {
-    // TODO: add validation
+    if (denoise_configs.loopback_count < 1 || denoise_configs.loopback_count > DENOISE_MAX_LOOPBACK_COUNT)
+    {
+        LOGGER__ERROR("Invalid loopback count {}, must be between 1 and {}", denoise_configs.loopback_count, DENOISE_MAX_LOOPBACK_COUNT);
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+    // The batch size is set on the network once, on first configure
+    uint32_t batch_size = m_configured ? m_denoise_configs.batch_size : denoise_configs.batch_size;
+    if (batch_size < 1 || batch_size > denoise_configs.loopback_count)
+    {
+        // a batch can never fill with fewer frames in flight, every frame would wait for the scheduler timeout
+        LOGGER__ERROR("Invalid batch size {}, must be between 1 and the loopback count {}", batch_size, denoise_configs.loopback_count);
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+    // The output pool is sized for the loopback count of the first configure, more loopback frames would starve it
+    if (m_configured && denoise_configs.loopback_count > m_pool_loopback_count)
+    {
+        LOGGER__ERROR("Invalid loopback count {}, the output pool is sized for up to {}", denoise_configs.loopback_count, m_pool_loopback_count);
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
     return MEDIA_LIBRARY_SUCCESS;
 }
 
@@ -341,11 +385,14 @@ media_library_return MediaLibraryDenoise::Impl::configure(denoise_config_t &deno
     m_denoise_configs = denoise_configs;
     m_hailort_configs = hailort_configs;
     bool enabled_changed = m_denoise_configs.enabled != prev_enabled;
+    m_bypass.configure(m_denoise_configs.bypass);
 
     // on first configure
     if (!m_configured)
     {
-        int status = m_hailort_denoise->init(m_denoise_configs.network_config, m_hailort_configs.device_id, 1, 1000);
+        int status = m_hailort_denoise->init(m_denoise_configs.network_config, m_hailort_configs.device_id, DENOISE_MAX_LOOPBACK_COUNT,
+                                             m_denoise_configs.batch_size, m_denoise_configs.batch_size, DENOISE_SCHEDULER_TIMEOUT_MS,
+                                             m_inference_backend);
         if (status != 0)
         {
             LOGGER__ERROR("Failed to init hailort");
@@ -358,14 +405,21 @@ media_library_return MediaLibraryDenoise::Impl::configure(denoise_config_t &deno
             LOGGER__ERROR("Failed to allocate denoise buffer pool");
             return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
         }
+        if (m_hailort_denoise->prepare_pool(m_output_buffer_pool) != 0)
+        {
+            LOGGER__ERROR("Failed to prepare hailort bindings of the denoise buffer pool");
+            return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+        }
     }
 
     // check if enabling
     if (m_denoise_configs.enabled && (enabled_changed || !m_configured))
     {
+        m_loopback_limit = m_denoise_configs.loopback_count;
         m_loop_counter = 0;
         m_callback_counter = 0;
         m_flushing = false;
+        reopen_queues();
         m_inference_callback_thread = std::thread(&MediaLibraryDenoise::Impl::inference_callback_thread, this);
     }
 
@@ -373,12 +427,13 @@ media_library_return MediaLibraryDenoise::Impl::configure(denoise_config_t &deno
     if (!m_denoise_configs.enabled && enabled_changed)
     {
         m_flushing = true;
-        // notify all queues that we are flushing
-        m_inference_callback_condvar->notify_one();
-        m_loopback_condvar->notify_one();
-        m_staging_condvar->notify_one();
+        // wake all the threads waiting on the queues, we are flushing
+        close_queues();
         if (m_inference_callback_thread.joinable())
             m_inference_callback_thread.join();
+        // Up to DENOISE_MAX_LOOPBACK_COUNT jobs still read their staged inputs and loopback buffers - their outputs
+        // are released since we are flushing. Once drained no old output can reach the queues of a re-enable.
+        m_hailort_denoise->drain();
         clear_inference_callback_queue();
         clear_loopback_queue();
         clear_staging_queue();
@@ -399,21 +454,28 @@ media_library_return MediaLibraryDenoise::Impl::create_and_initialize_buffer_poo
 {
     // Only support 4k for now
     uint width, height;
-    width = 3840;
-    height = 2160;
+    width = DENOISE_OUTPUT_WIDTH;
+    height = DENOISE_OUTPUT_HEIGHT;
     std::string name = "denoise_output";
     if (m_output_buffer_pool)
     {
         return MEDIA_LIBRARY_SUCCESS;
     }
     // Create output buffer pool
-    LOGGER__DEBUG("Creating buffer pool named {} for output resolution: width {} height {} in buffers size of {}", name, width, height, BPOOL_MAX_SIZE);
-    m_output_buffer_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, BPOOL_MAX_SIZE, CMA, name);
+    m_pool_loopback_count = m_denoise_configs.loopback_count;
+    uint pool_size = DENOISE_BPOOL_SIZE(m_pool_loopback_count);
+    LOGGER__DEBUG("Creating buffer pool named {} for output resolution: width {} height {} in buffers size of {}", name, width, height, pool_size);
+    HailoMemoryType memory_type = m_inference_backend == nullptr || m_inference_backend->requires_dma_buffers() ? CMA : HEAP;
+    m_output_buffer_pool = std::make_shared<MediaLibraryBufferPool>(width, height, DSP_IMAGE_FORMAT_NV12, pool_size, memory_type, name);
     if (m_output_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
     {
         LOGGER__ERROR("Failed to init buffer pool");
         return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
     }
+    denoise_cma_stats_t cma_stats = get_cma_stats();
+    // a copying loopback frees its output buffers on delivery, but takes a loopback pool of its own
+    LOGGER__INFO("Denoise output pool takes {} bytes of CMA, with a copying loopback it would take {} bytes", cma_stats.pool_bytes,
+                 cma_stats.pool_bytes - m_pool_loopback_count * cma_stats.buffer_size + cma_stats.copy_loopback_pool_bytes);
 
     return MEDIA_LIBRARY_SUCCESS;
 }
@@ -438,15 +500,6 @@ media_library_return MediaLibraryDenoise::Impl::perform_denoise(
     HailoMediaLibraryBufferPtr input_buffer,
     HailoMediaLibraryBufferPtr output_buffer)
 {
-
-    // Acquire buffer for denoise output
-    if (m_output_buffer_pool->acquire_buffer(*output_buffer.get()) !=
-        MEDIA_LIBRARY_SUCCESS)
-    {
-        LOGGER__ERROR("failed to acquire buffer for denoise output");
-        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
-    }
-
     // check null for input and output buffer
     if (input_buffer == nullptr || output_buffer == nullptr)
     {
@@ -455,11 +508,28 @@ media_library_return MediaLibraryDenoise::Impl::perform_denoise(
         return MEDIA_LIBRARY_INVALID_ARGUMENT;
     }
 
+    // A bypassed frame stands in for its own denoised output - it takes the same ordered delivery and loopback
+    // path as an inferred frame, so the feedback stays consistent when the network resumes
+    bool bypass = m_bypass.update(input_buffer);
+    HailoMediaLibraryBufferPtr denoised_buffer = output_buffer;
+    if (bypass)
+    {
+        input_buffer->increase_ref_count();
+        denoised_buffer = input_buffer;
+    }
+    // Acquire buffer for denoise output
+    else if (m_output_buffer_pool->acquire_buffer(*output_buffer.get()) !=
+             MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("failed to acquire buffer for denoise output");
+        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+    }
+
     // Perform denoise
     int ret = -1;
     if (m_loop_counter < m_loopback_limit)
     {
-        ret = m_hailort_denoise->process(input_buffer, input_buffer, output_buffer);
+        ret = bypass ? m_hailort_denoise->bypass(denoised_buffer) : m_hailort_denoise->process(input_buffer, input_buffer, output_buffer);
         m_loop_counter++;
     }
     else
@@ -467,6 +537,7 @@ media_library_return MediaLibraryDenoise::Impl::perform_denoise(
         HailoMediaLibraryBufferPtr loopback_buffer = dequeue_loopback_buffer();
         if (loopback_buffer == nullptr)
         {
+            denoised_buffer->decrease_ref_count();
             if (m_flushing)
             {
                 return MEDIA_LIBRARY_SUCCESS;
@@ -474,8 +545,14 @@ media_library_return MediaLibraryDenoise::Impl::perform_denoise(
             LOGGER__ERROR("loopback buffer is null");
             return MEDIA_LIBRARY_ERROR;
         }
-        queue_staging_buffer(loopback_buffer);
-        ret = m_hailort_denoise->process(input_buffer, loopback_buffer, output_buffer);
+        if (!queue_staging_buffer(loopback_buffer))
+        {
+            // flushing - the staging queue no longer holds the loopback buffer until its inference is done
+            loopback_buffer->decrease_ref_count();
+            denoised_buffer->decrease_ref_count();
+            return MEDIA_LIBRARY_SUCCESS;
+        }
+        ret = bypass ? m_hailort_denoise->bypass(denoised_buffer) : m_hailort_denoise->process(input_buffer, loopback_buffer, output_buffer);
     }
     if (ret != 0)
     {
@@ -526,6 +603,37 @@ media_library_return MediaLibraryDenoise::Impl::observe(const MediaLibraryDenois
     return MEDIA_LIBRARY_SUCCESS;
 }
 
+denoise_bypass_stats_t MediaLibraryDenoise::Impl::get_bypass_stats()
+{
+    network_utilization_t utilization = m_hailort_denoise->get_network_utilization();
+    denoise_bypass_stats_t stats;
+    stats.inferred_frames = m_bypass.get_inferred_frames();
+    stats.bypassed_frames = m_bypass.get_bypassed_frames();
+    stats.bypassing = m_bypass.is_bypassing();
+    stats.inference_latency_ms = utilization.mean_latency_ms;
+    stats.bypass_latency_ms = utilization.mean_bypass_latency_ms;
+    // saved only once both kinds of frames were measured
+    stats.saved_latency_ms = utilization.frames > 0 && utilization.bypassed_frames > 0 ? std::max(0.0, stats.inference_latency_ms - stats.bypass_latency_ms) : 0;
+    // active time per inferred frame, times the frames that were not inferred
+    stats.saved_active_ms = utilization.mean_active_ms * stats.bypassed_frames;
+    return stats;
+}
+
+denoise_cma_stats_t MediaLibraryDenoise::Impl::get_cma_stats()
+{
+    denoise_cma_stats_t stats = {};
+    // NV12 - a full resolution Y plane and a half resolution interleaved UV plane
+    stats.buffer_size = DENOISE_OUTPUT_WIDTH * DENOISE_OUTPUT_HEIGHT * 3 / 2;
+    if (!m_output_buffer_pool)
+        return stats;
+    stats.pool_buffers = m_output_buffer_pool->get_size();
+    stats.pool_bytes = stats.pool_buffers * stats.buffer_size;
+    // waiting to be fed back, or fed back to an inference that is not done yet
+    stats.loopback_buffers = m_loopback_ring->size() + m_staging_ring->size();
+    stats.copy_loopback_pool_bytes = (m_pool_loopback_count + 1) * stats.buffer_size;
+    return stats;
+}
+
 void MediaLibraryDenoise::Impl::inference_callback_thread()
 {
     while (!m_flushing)
@@ -544,6 +652,11 @@ void MediaLibraryDenoise::Impl::inference_callback_thread()
         if (m_callback_counter >= m_loopback_limit)
         {
             HailoMediaLibraryBufferPtr staging_buffer = dequeue_staging_buffer();
+            if (staging_buffer == nullptr)
+            {
+                output_buffer->decrease_ref_count();
+                return;
+            }
             staging_buffer->decrease_ref_count();
         }
         else
@@ -579,158 +692,100 @@ void MediaLibraryDenoise::Impl::inference_callback(HailoMediaLibraryBufferPtr ou
 
 void MediaLibraryDenoise::Impl::queue_loopback_buffer(HailoMediaLibraryBufferPtr buffer)
 {
-    std::unique_lock<std::mutex> lock(*(m_loopback_mutex));
-    m_loopback_condvar->wait(lock, [this]
-                          { return m_loopback_queue.size() < m_queue_size; });
-    m_loopback_queue.push(buffer);
-    m_loopback_condvar->notify_one();
+    if (!queue_buffer(buffer, *m_loopback_ring))
+        buffer->decrease_ref_count();
 }
 
 HailoMediaLibraryBufferPtr MediaLibraryDenoise::Impl::dequeue_loopback_buffer()
 {
-    std::unique_lock<std::mutex> lock(*(m_loopback_mutex));
-    m_loopback_condvar->wait(lock, [this]
-                          { return !m_loopback_queue.empty() || m_flushing; });
-    if (m_loopback_queue.empty())
-    {
-        return nullptr;
-    }
-    HailoMediaLibraryBufferPtr buffer = m_loopback_queue.front();
-    m_loopback_queue.pop();
-    m_loopback_condvar->notify_one();
-    return buffer;
+    return dequeue_buffer(*m_loopback_ring);
 }
 
 void MediaLibraryDenoise::Impl::clear_loopback_queue()
 {
-    std::unique_lock<std::mutex> lock(*(m_loopback_mutex));
-    while (!m_loopback_queue.empty())
-    {
-        HailoMediaLibraryBufferPtr buffer = m_loopback_queue.front();
-        m_loopback_queue.pop();
-        buffer->decrease_ref_count();
-    }
-    m_loopback_condvar->notify_one();
+    clear_queue(*m_loopback_ring);
 }
 
 // Staging queue controls
 
-void MediaLibraryDenoise::Impl::queue_staging_buffer(HailoMediaLibraryBufferPtr buffer)
+bool MediaLibraryDenoise::Impl::queue_staging_buffer(HailoMediaLibraryBufferPtr buffer)
 {
-    std::unique_lock<std::mutex> lock(*(m_staging_mutex));
-    m_staging_condvar->wait(lock, [this]
-                          { return m_staging_queue.size() < m_queue_size; });
-    m_staging_queue.push(buffer);
-    m_staging_condvar->notify_one();
+    return queue_buffer(buffer, *m_staging_ring);
 }
 
 HailoMediaLibraryBufferPtr MediaLibraryDenoise::Impl::dequeue_staging_buffer()
 {
-    std::unique_lock<std::mutex> lock(*(m_staging_mutex));
-    m_staging_condvar->wait(lock, [this]
-                          { return !m_staging_queue.empty() || m_flushing; });
-    if (m_staging_queue.empty())
-    {
-        return nullptr;
-    }
-    HailoMediaLibraryBufferPtr buffer = m_staging_queue.front();
-    m_staging_queue.pop();
-    m_staging_condvar->notify_one();
-    return buffer;
+    return dequeue_buffer(*m_staging_ring);
 }
 
 void MediaLibraryDenoise::Impl::clear_staging_queue()
 {
-    std::unique_lock<std::mutex> lock(*(m_staging_mutex));
-    while (!m_staging_queue.empty())
-    {
-        HailoMediaLibraryBufferPtr buffer = m_staging_queue.front();
-        m_staging_queue.pop();
-        buffer->decrease_ref_count();
-    }
-    m_staging_condvar->notify_one();
+    clear_queue(*m_staging_ring);
 }
 
 // Thread queue controls
 
 void MediaLibraryDenoise::Impl::queue_inference_callback_buffer(HailoMediaLibraryBufferPtr buffer)
 {
-    std::unique_lock<std::mutex> lock(*(m_inference_callback_mutex));
-    m_inference_callback_condvar->wait(lock, [this]
-                          { return m_inference_callback_queue.size() < m_queue_size; });
-    m_inference_callback_queue.push(buffer);
-    m_inference_callback_condvar->notify_one();
+    if (!queue_buffer(buffer, *m_inference_callback_ring))
+        buffer->decrease_ref_count();
 }
 
 HailoMediaLibraryBufferPtr MediaLibraryDenoise::Impl::dequeue_inference_callback_buffer()
 {
-    std::unique_lock<std::mutex> lock(*(m_inference_callback_mutex));
-    m_inference_callback_condvar->wait(lock, [this]
-                          { return !m_inference_callback_queue.empty() || m_flushing; });
-    if (m_inference_callback_queue.empty())
-    {
-        return nullptr;
-    }
-    HailoMediaLibraryBufferPtr buffer = m_inference_callback_queue.front();
-    m_inference_callback_queue.pop();
-    m_inference_callback_condvar->notify_one();
-    return buffer;
+    return dequeue_buffer(*m_inference_callback_ring);
 }
 
 void MediaLibraryDenoise::Impl::clear_inference_callback_queue()
 {
-    std::unique_lock<std::mutex> lock(*(m_inference_callback_mutex));
-    while (!m_inference_callback_queue.empty())
-    {
-        HailoMediaLibraryBufferPtr buffer = m_inference_callback_queue.front();
-        m_inference_callback_queue.pop();
-        buffer->decrease_ref_count();
-    }
-    m_inference_callback_condvar->notify_one();
+    clear_queue(*m_inference_callback_ring);
 }
 
 // Generic Queue Control
 
-void MediaLibraryDenoise::Impl::queue_buffer(HailoMediaLibraryBufferPtr buffer,
-                                             std::queue<HailoMediaLibraryBufferPtr> &queue,
-                                             std::shared_ptr<std::mutex> mutex,
-                                             std::shared_ptr<std::condition_variable> condvar,
-                                             uint8_t queue_size)
+/**
+ * @brief Queue a buffer, waiting while the queue is full
+ *
+ * @return false if the queue was closed for flushing, the buffer is not queued
+ */
+bool MediaLibraryDenoise::Impl::queue_buffer(HailoMediaLibraryBufferPtr buffer, SpscRing<HailoMediaLibraryBufferPtr> &ring)
 {
-    std::unique_lock<std::mutex> lock(*mutex);
-    condvar->wait(lock, [queue, queue_size]
-                  { return queue.size() < queue_size; });
-    queue.push(buffer);
-    condvar->notify_one();
+    return ring.push(buffer);
 }
 
-HailoMediaLibraryBufferPtr MediaLibraryDenoise::Impl::dequeue_buffer(std::queue<HailoMediaLibraryBufferPtr> &queue,
-                                                                    std::shared_ptr<std::mutex> mutex,
-                                                                    std::shared_ptr<std::condition_variable> condvar)
+/**
+ * @brief Dequeue a buffer, waiting while the queue is empty
+ *
+ * @return the buffer, or nullptr if the queue is empty and closed for flushing
+ */
+HailoMediaLibraryBufferPtr MediaLibraryDenoise::Impl::dequeue_buffer(SpscRing<HailoMediaLibraryBufferPtr> &ring)
 {
-    std::unique_lock<std::mutex> lock(*mutex);
-    condvar->wait(lock, [queue, this]
-                  { return !queue.empty() || m_flushing; });
-    if (queue.empty())
+    std::optional<HailoMediaLibraryBufferPtr> buffer = ring.pop();
+    if (!buffer.has_value())
     {
         return nullptr;
     }
-    HailoMediaLibraryBufferPtr buffer = queue.front();
-    queue.pop();
-    condvar->notify_one();
-    return buffer;
+    return buffer.value();
 }
 
-void MediaLibraryDenoise::Impl::clear_queue(std::queue<HailoMediaLibraryBufferPtr> &queue,
-                                            std::shared_ptr<std::mutex> mutex,
-                                            std::shared_ptr<std::condition_variable> condvar)
+void MediaLibraryDenoise::Impl::clear_queue(SpscRing<HailoMediaLibraryBufferPtr> &ring)
 {
-    std::unique_lock<std::mutex> lock(*mutex);
-    while (!queue.empty())
+    while (std::optional<HailoMediaLibraryBufferPtr> buffer = ring.try_pop())
     {
-        HailoMediaLibraryBufferPtr buffer = queue.front();
-        queue.pop();
-        buffer->decrease_ref_count();
+        buffer.value()->decrease_ref_count();
     }
-    condvar->notify_one();
+}
+
+void MediaLibraryDenoise::Impl::close_queues()
+{
+    m_inference_callback_ring->close();
+    m_loopback_ring->close();
+    m_staging_ring->close();
+}
+
+void MediaLibraryDenoise::Impl::reopen_queues()
+{
+    m_inference_callback_ring->reopen();
+    m_loopback_ring->reopen();
+    m_staging_ring->reopen();
 }
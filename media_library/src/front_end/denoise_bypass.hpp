@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file denoise_bypass.hpp
+ * @brief Per frame decision whether the denoise network can be skipped for a bright scene
+ **/
+
+#pragma once
+
+#include "buffer_pool.hpp"
+#include "media_library_logger.hpp"
+#include "media_library_types.hpp"
+#include <atomic>
+#include <cstdint>
+
+// Luma is sampled every Nth pixel of every Nth row - about 32K samples in 4K
+#define DENOISE_BYPASS_LUMA_SAMPLE_STEP (16)
+
+/**
+ * @brief Decides per frame whether to bypass the denoise network.
+ *
+ * The scene is judged by the mean luma of the input, sampled sparsely. The ISP reports no sensor gain with the frames,
+ * and its AE average luma stays at the AE target until the exposure saturates.
+ * The decision switches only after the scene crossed the hysteresis band around the threshold for hold_frames frames.
+ */
+class DenoiseBypass
+{
+public:
+    void configure(const denoise_bypass_config_t &config)
+    {
+        m_config = config;
+        if (!m_config.enabled)
+            m_bypassing = false;
+        m_pending_frames = 0;
+    }
+
+    /**
+     * @brief Update the decision with a new input frame
+     *
+     * @return true if the frame should bypass the network
+     */
+    bool update(HailoMediaLibraryBufferPtr input_buffer)
+    {
+        if (!m_config.enabled)
+        {
+            m_inferred_frames.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        bool bright = m_bypassing ? !crossed_to_dark(input_buffer) : crossed_to_bright(input_buffer);
+        if (bright != m_bypassing)
+        {
+            if (++m_pending_frames >= m_config.hold_frames)
+            {
+                m_bypassing = bright;
+                m_pending_frames = 0;
+                LOGGER__INFO("Denoise {} after {} inferred and {} bypassed frames", m_bypassing ? "bypassed" : "resumed",
+                             m_inferred_frames.load(std::memory_order_relaxed), m_bypassed_frames.load(std::memory_order_relaxed));
+            }
+        }
+        else
+        {
+            m_pending_frames = 0;
+        }
+
+        (m_bypassing ? m_bypassed_frames : m_inferred_frames).fetch_add(1, std::memory_order_relaxed);
+        return m_bypassing;
+    }
+
+    bool is_bypassing()
+    {
+        return m_bypassing;
+    }
+
+    uint64_t get_inferred_frames()
+    {
+        return m_inferred_frames.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_bypassed_frames()
+    {
+        return m_bypassed_frames.load(std::memory_order_relaxed);
+    }
+
+private:
+    denoise_bypass_config_t m_config;
+    std::atomic<bool> m_bypassing{false};
+    uint32_t m_pending_frames = 0;
+    std::atomic<uint64_t> m_inferred_frames{0};
+    std::atomic<uint64_t> m_bypassed_frames{0};
+
+    // Inferring - the scene has to get brighter than the upper edge of the band to bypass
+    bool crossed_to_bright(HailoMediaLibraryBufferPtr input_buffer)
+    {
+        float band = m_config.hysteresis / 100.0f;
+        return mean_luma(input_buffer) > m_config.luma_threshold * (1 + band);
+    }
+
+    // Bypassing - the scene has to get darker than the lower edge of the band to infer again
+    bool crossed_to_dark(HailoMediaLibraryBufferPtr input_buffer)
+    {
+        float band = m_config.hysteresis / 100.0f;
+        return mean_luma(input_buffer) < m_config.luma_threshold * (1 - band);
+    }
+
+    static float mean_luma(HailoMediaLibraryBufferPtr input_buffer)
+    {
+        uint8_t *y_plane = static_cast<uint8_t *>(input_buffer->get_plane(0));
+        if (y_plane == nullptr)
+            return 0;
+        size_t width = input_buffer->hailo_pix_buffer->width;
+        size_t height = input_buffer->hailo_pix_buffer->height;
+        size_t stride = input_buffer->get_plane_stride(0);
+
+        bool synced = input_buffer->is_dmabuf() && input_buffer->sync_start() == MEDIA_LIBRARY_SUCCESS;
+        uint64_t sum = 0;
+        uint64_t samples = 0;
+        for (size_t y = DENOISE_BYPASS_LUMA_SAMPLE_STEP / 2; y < height; y += DENOISE_BYPASS_LUMA_SAMPLE_STEP)
+        {
+            const uint8_t *row = y_plane + y * stride;
+            for (size_t x = DENOISE_BYPASS_LUMA_SAMPLE_STEP / 2; x < width; x += DENOISE_BYPASS_LUMA_SAMPLE_STEP)
+            {
+                sum += row[x];
+                samples++;
+            }
+        }
+        if (synced)
+            input_buffer->sync_end();
+
+        return samples > 0 ? static_cast<float>(sum) / samples : 0;
+    }
+};
@@ -442,14 +442,19 @@ media_library_return MediaLibraryDewarp::Impl::perform_dewarp(
     }
 
     // Perform dewarp
-    dsp_dewarp_mesh_t *mesh = m_dewarp_mesh_ctx->get();
+    std::shared_ptr<dsp_dewarp_mesh_t> mesh = m_dewarp_mesh_ctx->get();
+    if (mesh == nullptr)
+    {
+        LOGGER__ERROR("Dewarp mesh is not initialized");
+        return MEDIA_LIBRARY_UNINITIALIZED;
+    }
     dsp_image_properties_t *image = dewarp_output_buffer.hailo_pix_buffer.get();
     LOGGER__TRACE("Performing dewarp with mesh (w={}, h={}) interpolation type {}", mesh->mesh_width, mesh->mesh_height, m_ldc_configs.dewarp_config.interpolation_type);
     clock_gettime(CLOCK_MONOTONIC, &start_dewarp);
 
     if (m_ldc_configs.dis_config.angular_dis_config.enabled)
     {
-        media_library_return ret = perform_angular_dis_dewarp(input_buffer, dewarp_output_buffer, image, mesh);
+        media_library_return ret = perform_angular_dis_dewarp(input_buffer, dewarp_output_buffer, image, mesh.get());
         if (ret != MEDIA_LIBRARY_SUCCESS)
             return ret;
     }
@@ -457,7 +462,7 @@ media_library_return MediaLibraryDewarp::Impl::perform_dewarp(
     {
         dsp_status ret = dsp_utils::perform_dsp_dewarp(
             input_buffer.hailo_pix_buffer.get(),
-            image, mesh,
+            image, mesh.get(),
             m_ldc_configs.dewarp_config.interpolation_type);
 
         if (ret != DSP_SUCCESS)
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file hailort_async_engine.hpp
+ * @brief Asynchronous inference of video frames, with the pool buffers bound and mapped to the device once
+ **/
+
+#pragma once
+
+#include "hailort_inference_backend.hpp"
+#include "buffer_pool.hpp"
+#include <condition_variable>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+// Time to wait for a free job slot or for the backend to accept a job before failing the frame
+#define HAILORT_ENGINE_SUBMIT_TIMEOUT_MS (10000)
+// Time to wait for the in flight jobs to finish on drain and destruction
+#define HAILORT_ENGINE_DRAIN_TIMEOUT_MS (1000)
+
+/**
+ * @brief A plane of a buffer, bound to one tensor of the network
+ */
+struct hailort_engine_plane_t
+{
+    HailoMediaLibraryBufferPtr buffer;
+    uint32_t plane;
+};
+
+/**
+ * @brief Runs a network on frames asynchronously, delivering the output buffers in submission order.
+ *
+ * Jobs run on the HailoRT backend, which opens the network on the shared vdevice of its group, or on
+ * another inference backend given on init - a mock one runs the same frame flow without a device.
+ */
+class HailortAsyncEngine
+{
+private:
+    std::function<void(HailoMediaLibraryBufferPtr output_buffer)> m_on_infer_finish;
+    hailort_engine_config_t m_config;
+
+    InferenceBackendPtr m_backend;
+    NetworkUsagePtr m_network_usage;
+    // Frame size of each tensor, looked up once on init
+    std::vector<size_t> m_frame_sizes;
+    // Buffers of the job being submitted, reused so submitting does not allocate
+    std::vector<inference_buffer_t> m_job_buffers;
+
+    /**
+     * @brief One in flight inference
+     */
+    struct infer_job_slot_t
+    {
+        HailoMediaLibraryBufferPtr output_buffer;
+        std::chrono::steady_clock::time_point submit_time;
+        // passed through without inference, kept in a slot only to preserve the delivery order
+        bool bypassed = false;
+        bool in_flight = false;
+        bool done = false;
+        int status = SUCCESS;
+    };
+    // Jobs are submitted and completed in ring order - m_next_submit is the next slot to fill,
+    // m_next_complete the oldest job not delivered yet
+    std::vector<infer_job_slot_t> m_job_slots;
+    size_t m_next_submit = 0;
+    size_t m_next_complete = 0;
+    std::mutex m_job_slots_mutex;
+    std::condition_variable m_job_slots_cv;
+
+public:
+    HailortAsyncEngine(std::function<void(HailoMediaLibraryBufferPtr output_buffer)> on_infer_finish) : m_on_infer_finish(on_infer_finish)
+    {
+    }
+
+    ~HailortAsyncEngine()
+    {
+        // Wait for the in flight jobs to finish, the backend is released after them
+        drain();
+    }
+
+    /**
+     * @brief Open the network and prepare the job slots
+     *
+     * @param[in] config - the network, its tensors and its scheduling
+     * @param[in] backend - an opened backend to run the jobs on, or nullptr to open the network with HailoRT
+     */
+    int init(const hailort_engine_config_t &config, InferenceBackendPtr backend = nullptr)
+    {
+        if (config.max_in_flight == 0 || config.batch_size == 0)
+        {
+            LOGGER__ERROR("Invalid {} pipeline depth {} or batch size {}", config.network_name, config.max_in_flight, config.batch_size);
+            return ERROR;
+        }
+        m_config = config;
+
+        if (backend == nullptr)
+        {
+            HailortInferenceBackendPtr hailort_backend = std::make_shared<HailortInferenceBackend>();
+            int status = hailort_backend->open(m_config);
+            if (status != SUCCESS)
+            {
+                return status;
+            }
+            m_network_usage = hailort_backend->get_network_usage();
+            m_backend = hailort_backend;
+        }
+        else
+        {
+            // Not on a device - the utilization is recorded without registering the network
+            m_network_usage = std::make_shared<NetworkUsage>(m_config.network_name, m_config.group_id, m_config.scheduling);
+            m_backend = backend;
+        }
+
+        m_frame_sizes = m_backend->get_frame_sizes();
+        if (m_frame_sizes.size() != m_config.tensors.size())
+        {
+            LOGGER__ERROR("Inference backend of {} has {} tensors, expected {}", m_config.network_name, m_frame_sizes.size(), m_config.tensors.size());
+            return ERROR;
+        }
+        m_job_buffers.resize(m_config.tensors.size());
+
+        m_job_slots = std::vector<infer_job_slot_t>(m_config.max_in_flight);
+        m_next_submit = 0;
+        m_next_complete = 0;
+
+        return SUCCESS;
+    }
+
+    /**
+     * @brief Map the pool buffers to the device and prepare each output buffer, once
+     *
+     * @param[in] pool - pool of the output buffers, its first plane is bound to the first output tensor
+     * @param[in] planes_count - number of planes of the pool's buffers
+     */
+    int prepare_pool(MediaLibraryBufferPoolPtr pool, uint32_t planes_count)
+    {
+        size_t buffers_count = 0;
+        for (uint32_t plane = 0; plane < planes_count; plane++)
+        {
+            std::vector<void *> buffers;
+            size_t size;
+            if (pool->get_plane_buffers(plane, buffers, size) != MEDIA_LIBRARY_SUCCESS)
+            {
+                LOGGER__ERROR("Failed to get the buffers of pool {}", pool->get_name());
+                return ERROR;
+            }
+
+            for (void *buffer : buffers)
+            {
+                m_backend->map_buffer(buffer, size);
+                if (plane == 0 && m_backend->prepare_output(buffer) != SUCCESS)
+                    return ERROR;
+            }
+            buffers_count += buffers.size();
+        }
+        LOGGER__INFO("Prepared {} bindings for the {} plane buffers of pool {}", m_config.network_name, buffers_count, pool->get_name());
+
+        return SUCCESS;
+    }
+
+    /**
+     * @brief Submit a frame for inference, waiting only if all the job slots are in flight.
+     * Output buffers are passed to on_infer_finish in submission order.
+     *
+     * @param[in] planes - the plane bound to each tensor, in the order of the configured tensors
+     * @param[in] output_buffer - the buffer delivered when the job is done
+     */
+    int process(std::initializer_list<hailort_engine_plane_t> planes, HailoMediaLibraryBufferPtr output_buffer)
+    {
+        if (planes.size() != m_config.tensors.size())
+        {
+            LOGGER__ERROR("Got {} planes for the {} tensors of {}", planes.size(), m_config.tensors.size(), m_config.network_name);
+            return ERROR;
+        }
+
+        size_t slot_index = acquire_job_slot();
+        if (slot_index == m_job_slots.size())
+        {
+            return ERROR;
+        }
+
+        size_t tensor = 0;
+        for (const hailort_engine_plane_t &plane : planes)
+        {
+            int fd = plane.buffer->is_dmabuf() ? plane.buffer->get_fd(plane.plane) : -1;
+            m_job_buffers[tensor] = {plane.buffer->get_plane(plane.plane), m_frame_sizes[tensor], fd};
+            tensor++;
+        }
+
+        if (infer(slot_index, output_buffer) != SUCCESS)
+        {
+            return ERROR;
+        }
+
+        return SUCCESS;
+    }
+
+    /**
+     * @brief Deliver a frame without inference, after the frames already in flight
+     */
+    int bypass(HailoMediaLibraryBufferPtr buffer)
+    {
+        size_t slot_index = acquire_job_slot();
+        if (slot_index == m_job_slots.size())
+        {
+            return ERROR;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+            infer_job_slot_t &slot = m_job_slots[slot_index];
+            slot.output_buffer = buffer;
+            slot.submit_time = std::chrono::steady_clock::now();
+            slot.bypassed = true;
+            slot.in_flight = true;
+            slot.done = false;
+            m_next_submit = (m_next_submit + 1) % m_job_slots.size();
+        }
+        complete_job(slot_index, SUCCESS);
+
+        return SUCCESS;
+    }
+
+    /**
+     * @brief Wait for the jobs in flight to finish, their outputs are passed to on_infer_finish.
+     * Their input buffers are no longer read by the device once it returns true.
+     *
+     * @return false if jobs were still in flight at the timeout
+     */
+    bool drain(std::chrono::milliseconds timeout = std::chrono::milliseconds(HAILORT_ENGINE_DRAIN_TIMEOUT_MS))
+    {
+        std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+        bool drained = m_job_slots_cv.wait_for(lock, timeout, [this]
+                                               { return in_flight_count() == 0; });
+        if (!drained)
+        {
+            LOGGER__ERROR("Failed to wait for {} {} infer jobs to finish", in_flight_count(), m_config.network_name);
+        }
+        return drained;
+    }
+
+    network_utilization_t get_network_utilization()
+    {
+        return m_network_usage ? m_network_usage->get_utilization() : network_utilization_t{};
+    }
+
+private:
+    size_t in_flight_count()
+    {
+        size_t count = 0;
+        for (const infer_job_slot_t &slot : m_job_slots)
+            count += slot.in_flight;
+        return count;
+    }
+
+    /**
+     * @brief Wait for the next slot in submission order to be free
+     *
+     * @return the slot index, or the number of slots if it stayed in flight until the timeout
+     */
+    size_t acquire_job_slot()
+    {
+        std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+        if (m_job_slots.empty())
+        {
+            LOGGER__ERROR("{} infer job slots are not initialized", m_config.network_name);
+            return 0;
+        }
+        size_t slot_index = m_next_submit;
+        bool free = m_job_slots_cv.wait_for(lock, std::chrono::milliseconds(HAILORT_ENGINE_SUBMIT_TIMEOUT_MS), [this, slot_index]
+                                            { return !m_job_slots[slot_index].in_flight; });
+        if (!free)
+        {
+            LOGGER__ERROR("Timed out waiting for a free {} infer job slot", m_config.network_name);
+            return m_job_slots.size();
+        }
+        return slot_index;
+    }
+
+    /**
+     * @brief Mark a job done and deliver all the finished jobs that are next in submission order.
+     * Delivering under the lock keeps on_infer_finish called in order and from one thread at a time.
+     */
+    void complete_job(size_t slot_index, int status)
+    {
+        auto complete_time = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+        m_job_slots[slot_index].done = true;
+        m_job_slots[slot_index].status = status;
+
+        while (m_job_slots[m_next_complete].in_flight && m_job_slots[m_next_complete].done)
+        {
+            infer_job_slot_t &slot = m_job_slots[m_next_complete];
+            HailoMediaLibraryBufferPtr output_buffer = std::move(slot.output_buffer);
+            if (slot.status != SUCCESS)
+            {
+                std::cerr << "[" << m_config.network_name << "] Failed to run async infer, status = " << slot.status << std::endl;
+            }
+            else
+            {
+                if (slot.bypassed)
+                    m_network_usage->record_bypassed(slot.submit_time, complete_time);
+                else
+                    m_network_usage->record(slot.submit_time, complete_time);
+                m_on_infer_finish(output_buffer);
+            }
+            slot.in_flight = false;
+            slot.done = false;
+            m_next_complete = (m_next_complete + 1) % m_job_slots.size();
+        }
+        m_job_slots_cv.notify_all();
+    }
+
+    int infer(size_t slot_index, HailoMediaLibraryBufferPtr output_buffer)
+    {
+        int status = m_backend->wait_for_ready(std::chrono::milliseconds(HAILORT_ENGINE_SUBMIT_TIMEOUT_MS));
+        if (status != SUCCESS)
+        {
+            return status;
+        }
+
+        infer_job_slot_t &slot = m_job_slots[slot_index];
+        {
+            std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+            slot.output_buffer = output_buffer;
+            slot.submit_time = std::chrono::steady_clock::now();
+            slot.bypassed = false;
+            slot.in_flight = true;
+            slot.done = false;
+        }
+
+        status = m_backend->infer_async(m_job_buffers, [slot_index, this](int job_status)
+                                        { complete_job(slot_index, job_status); });
+        if (status != SUCCESS)
+        {
+            std::unique_lock<std::mutex> lock(m_job_slots_mutex);
+            slot.output_buffer = nullptr;
+            slot.in_flight = false;
+            return status;
+        }
+
+        m_next_submit = (m_next_submit + 1) % m_job_slots.size();
+
+        return SUCCESS;
+    }
+};
+using HailortAsyncEnginePtr = std::shared_ptr<HailortAsyncEngine>;
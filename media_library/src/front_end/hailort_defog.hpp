@@ -0,0 +1,80 @@
+#pragma once
+
+#include "hailort_async_engine.hpp"
+
+// Name of the defog network in the vdevice registry, for scheduling overrides and utilization stats
+#define HAILORT_DEFOG_NETWORK_NAME "defog"
+// Defog is in the video path - scheduled ahead of application networks sharing the device, like the denoise
+#define HAILORT_DEFOG_SCHEDULER_PRIORITY (HAILO_SCHEDULER_PRIORITY_NORMAL + 1)
+
+class HailortAsyncDefog
+{
+private:
+    HailortAsyncEngine m_engine;
+
+public:
+    HailortAsyncDefog(std::function<void(HailoMediaLibraryBufferPtr output_buffer)> on_infer_finish) : m_engine(on_infer_finish)
+    {
+    }
+
+    /**
+     * @brief Open the network and prepare the job slots
+     *
+     * @param[in] max_in_flight - number of jobs that can run at once
+     * @param[in] backend - backend to run the network on, or nullptr to open it with HailoRT
+     */
+    int init(network_config_t network_config, std::string group_id, uint32_t max_in_flight, InferenceBackendPtr backend = nullptr)
+    {
+        hailort_engine_config_t config;
+        config.network_name = HAILORT_DEFOG_NETWORK_NAME;
+        config.network_path = network_config.network_path;
+        config.group_id = group_id;
+        // Same tensor layouts as the hailonet path, which copies the raw output tensors into the NV12 planes
+        config.tensors = {
+            {network_config.y_channel, false, HAILO_FORMAT_ORDER_NHCW},
+            {network_config.uv_channel, false, HAILO_FORMAT_ORDER_NHWC},
+            {network_config.output_y_channel, true, HAILO_FORMAT_ORDER_NHCW},
+            {network_config.output_uv_channel, true, HAILO_FORMAT_ORDER_NHWC},
+        };
+        config.max_in_flight = max_in_flight;
+        config.batch_size = 1;
+        config.scheduling.priority = HAILORT_DEFOG_SCHEDULER_PRIORITY;
+
+        return m_engine.init(config, backend);
+    }
+
+    /**
+     * @brief Map the output pool buffers to the device and create their bindings, once
+     */
+    int prepare_pool(MediaLibraryBufferPoolPtr pool)
+    {
+        return m_engine.prepare_pool(pool, 2);
+    }
+
+    /**
+     * @brief Submit a frame for inference, the network writes straight into the planes of the output buffer.
+     * Output buffers are passed to on_infer_finish in submission order.
+     */
+    int process(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr output_buffer)
+    {
+        return m_engine.process({{input_buffer, 0},
+                                 {input_buffer, 1},
+                                 {output_buffer, 0},
+                                 {output_buffer, 1}},
+                                output_buffer);
+    }
+
+    /**
+     * @brief Wait for the jobs in flight to finish, after which their inputs are no longer read
+     */
+    bool drain()
+    {
+        return m_engine.drain();
+    }
+
+    network_utilization_t get_network_utilization()
+    {
+        return m_engine.get_network_utilization();
+    }
+};
+using HailortAsyncDefogPtr = std::shared_ptr<HailortAsyncDefog>;
@@ -1,220 +1,98 @@
 #pragma once
 
-#include "hailo/hailort.hpp"
-#include "media_library_utils.hpp"
-#include "media_library_logger.hpp"
-#include "buffer_pool.hpp"
+#include "hailort_async_engine.hpp"
 
-#define ERROR -1
-#define SUCCESS 0
+// Name of the denoise network in the vdevice registry, for scheduling overrides and utilization stats
+#define HAILORT_DENOISE_NETWORK_NAME "denoise"
+// Denoise is in the video path - scheduled ahead of application networks sharing the device, which get the rest
+#define HAILORT_DENOISE_SCHEDULER_PRIORITY (HAILO_SCHEDULER_PRIORITY_NORMAL + 1)
 
 class HailortAsyncDenoise
 {
 private:
-    std::function<void(HailoMediaLibraryBufferPtr output_buffer)> m_on_infer_finish;
-    std::string m_group_id;
-    int m_scheduler_threshold;
-    int m_scheduler_timeout_in_ms;
-    feedback_network_config_t m_network_config;
-    std::shared_ptr<hailort::AsyncInferJob> m_last_infer_job;
-
-    std::unique_ptr<hailort::VDevice> m_vdevice;
-    std::shared_ptr<hailort::InferModel> m_infer_model;
-    hailort::ConfiguredInferModel m_configured_infer_model;
-    hailort::ConfiguredInferModel::Bindings m_bindings;
+    HailortAsyncEngine m_engine;
 
 public:
-    HailortAsyncDenoise(std::function<void(HailoMediaLibraryBufferPtr output_buffer)> on_infer_finish) : m_on_infer_finish(on_infer_finish)
+    HailortAsyncDenoise(std::function<void(HailoMediaLibraryBufferPtr output_buffer)> on_infer_finish) : m_engine(on_infer_finish)
     {
-        m_last_infer_job = nullptr;
     }
 
-    ~HailortAsyncDenoise()
+    /**
+     * @brief Open the network and prepare the job slots
+     *
+     * @param[in] max_in_flight - number of jobs that can run at once
+     * @param[in] batch_size - frames the device infers at once, the scheduler collects scheduler_threshold frames
+     * or waits scheduler_timeout_in_ms before sending a partial batch.
+     * The network runs on the given backend, or is opened with HailoRT when it is nullptr.
+     */
+    int init(feedback_network_config_t network_config, std::string group_id, uint32_t max_in_flight, uint32_t batch_size,
+             int scheduler_threshold, int scheduler_timeout_in_ms, InferenceBackendPtr backend = nullptr)
     {
-        // Wait for last infer to finish
-        if (m_last_infer_job) {
-            auto status = m_last_infer_job->wait(std::chrono::milliseconds(1000));
-            if (HAILO_SUCCESS != status) {
-                LOGGER__ERROR("Failed to wait for infer to finish, status = {}", status);
-            }
-        }
+        hailort_engine_config_t config;
+        config.network_name = HAILORT_DENOISE_NETWORK_NAME;
+        config.network_path = network_config.network_path;
+        config.group_id = group_id;
+        // Same order as the planes passed to the engine in process()
+        config.tensors = {
+            {network_config.y_channel, false, HAILO_FORMAT_ORDER_NHCW},
+            {network_config.uv_channel, false, HAILO_FORMAT_ORDER_NHWC},
+            {network_config.feedback_y_channel, false, HAILO_FORMAT_ORDER_NHCW},
+            {network_config.feedback_uv_channel, false, HAILO_FORMAT_ORDER_NHWC},
+            {network_config.output_y_channel, true, HAILO_FORMAT_ORDER_NHCW},
+            {network_config.output_uv_channel, true, HAILO_FORMAT_ORDER_FCR},
+        };
+        config.max_in_flight = max_in_flight;
+        config.batch_size = batch_size;
+        config.scheduling.priority = HAILORT_DENOISE_SCHEDULER_PRIORITY;
+        config.scheduling.threshold = scheduler_threshold;
+        config.scheduling.timeout_ms = scheduler_timeout_in_ms;
+
+        return m_engine.init(config, backend);
     }
 
-    int init(feedback_network_config_t network_config, std::string group_id, int scheduler_threshold, int scheduler_timeout_in_ms)
+    /**
+     * @brief Map the pool buffers to the device and create the bindings of each output buffer, once.
+     * The pool's buffers are both outputs and loopback inputs of the network.
+     */
+    int prepare_pool(MediaLibraryBufferPoolPtr pool)
     {
-        m_group_id = group_id;
-        m_scheduler_threshold = scheduler_threshold;
-        m_scheduler_timeout_in_ms = scheduler_timeout_in_ms;
-        m_network_config = network_config;
-
-        hailo_vdevice_params_t vdevice_params = {0};
-        hailo_init_vdevice_params(&vdevice_params);
-        vdevice_params.group_id = m_group_id.c_str();
-
-        auto vdevice_exp = hailort::VDevice::create(vdevice_params);
-        if (!vdevice_exp)
-        {
-            std::cerr << "Failed create vdevice, status = " << vdevice_exp.status() << std::endl;
-            return vdevice_exp.status();
-        }
-        m_vdevice = vdevice_exp.release();
-
-        auto infer_model_exp = m_vdevice->create_infer_model(m_network_config.network_path.c_str());
-        if (!infer_model_exp)
-        {
-            std::cerr << "Failed to create infer model, status = " << infer_model_exp.status() << std::endl;
-            return infer_model_exp.status();
-        }
-        m_infer_model = infer_model_exp.release();
-        m_infer_model->set_batch_size(1);
-
-        // input order
-        m_infer_model->input(m_network_config.y_channel)->set_format_order(HAILO_FORMAT_ORDER_NHCW);
-        m_infer_model->input(m_network_config.uv_channel)->set_format_order(HAILO_FORMAT_ORDER_NHWC);
-        m_infer_model->input(m_network_config.feedback_y_channel)->set_format_order(HAILO_FORMAT_ORDER_NHCW);
-        m_infer_model->input(m_network_config.feedback_uv_channel)->set_format_order(HAILO_FORMAT_ORDER_NHWC);
-        // output order
-        m_infer_model->output(m_network_config.output_y_channel)->set_format_order(HAILO_FORMAT_ORDER_NHCW);
-        m_infer_model->output(m_network_config.output_uv_channel)->set_format_order(HAILO_FORMAT_ORDER_FCR);
-
-        auto configured_infer_model_exp = m_infer_model->configure();
-        if (!configured_infer_model_exp)
-        {
-            std::cerr << "Failed to create configured infer model, status = " << configured_infer_model_exp.status() << std::endl;
-            return configured_infer_model_exp.status();
-        }
-        m_configured_infer_model = configured_infer_model_exp.release();
-        m_configured_infer_model.set_scheduler_threshold(m_scheduler_threshold);
-        m_configured_infer_model.set_scheduler_timeout(std::chrono::milliseconds(m_scheduler_timeout_in_ms));
-
-        auto bindings = m_configured_infer_model.create_bindings();
-        if (!bindings)
-        {
-            std::cerr << "Failed to create infer bindings, status = " << bindings.status() << std::endl;
-            return bindings.status();
-        }
-        m_bindings = bindings.release();
-
-        return SUCCESS;
+        return m_engine.prepare_pool(pool, 2);
     }
 
+    /**
+     * @brief Submit a frame for inference, waiting only if all the job slots are in flight.
+     * Output buffers are passed to on_infer_finish in submission order.
+     */
     int process(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr loopback_input_buffer, HailoMediaLibraryBufferPtr output_buffer)
     {
-        if (set_input_buffers(input_buffer, loopback_input_buffer) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (set_output_buffers(output_buffer) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (infer(output_buffer) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        return SUCCESS;
-    }
-
-private:
-    int set_input_buffer(void *buffer_p, std::string tensor_name)
-    {
-        auto input_frame_size = m_infer_model->input(tensor_name)->get_frame_size();
-        auto status = m_bindings.input(tensor_name)->set_buffer(hailort::MemoryView(buffer_p, input_frame_size));
-        if (HAILO_SUCCESS != status)
-        {
-            std::cerr << "Failed to set infer input buffer, status = " << status << std::endl;
-            return status;
-        }
-
-        return SUCCESS;
-    }
-
-    int set_input_buffers(HailoMediaLibraryBufferPtr input_buffer, HailoMediaLibraryBufferPtr loopback_buffer)
-    {
-        if (set_input_buffer(input_buffer->get_plane(0), m_network_config.y_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (set_input_buffer(input_buffer->get_plane(1), m_network_config.uv_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (set_input_buffer(loopback_buffer->get_plane(0), m_network_config.feedback_y_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (set_input_buffer(loopback_buffer->get_plane(1), m_network_config.feedback_uv_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        return SUCCESS;
+        return m_engine.process({{input_buffer, 0},
+                                 {input_buffer, 1},
+                                 {loopback_input_buffer, 0},
+                                 {loopback_input_buffer, 1},
+                                 {output_buffer, 0},
+                                 {output_buffer, 1}},
+                                output_buffer);
     }
 
-    int set_output_buffer(void *buffer_p, std::string tensor_name)
+    /**
+     * @brief Deliver a frame without inference, after the frames already in flight
+     */
+    int bypass(HailoMediaLibraryBufferPtr buffer)
     {
-        auto output_frame_size = m_infer_model->output(tensor_name)->get_frame_size();
-        auto status = m_bindings.output(tensor_name)->set_buffer(hailort::MemoryView(buffer_p, output_frame_size));
-        if (HAILO_SUCCESS != status)
-        {
-            std::cerr << "Failed to set infer input buffer, status = " << status << std::endl;
-            return status;
-        }
-
-        return SUCCESS;
+        return m_engine.bypass(buffer);
     }
 
-    int set_output_buffers(HailoMediaLibraryBufferPtr output_buffer)
+    /**
+     * @brief Wait for the jobs in flight to finish, after which their inputs are no longer read
+     */
+    bool drain()
     {
-        if (set_output_buffer(output_buffer->get_plane(0), m_network_config.output_y_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        if (set_output_buffer(output_buffer->get_plane(1), m_network_config.output_uv_channel) != SUCCESS)
-        {
-            return ERROR;
-        }
-
-        return SUCCESS;
+        return m_engine.drain();
     }
 
-    int infer(HailoMediaLibraryBufferPtr output_buffer)
+    network_utilization_t get_network_utilization()
     {
-        auto status = m_configured_infer_model.wait_for_async_ready(std::chrono::milliseconds(10000));
-        if (HAILO_SUCCESS != status)
-        {
-            std::cerr << "Failed to wait for async ready, status = " << status << std::endl;
-            return status;
-        }
-
-        auto job = m_configured_infer_model.run_async(m_bindings, [output_buffer, this](const hailort::AsyncInferCompletionInfo &completion_info)
-                                                      {
-            if (completion_info.status != HAILO_SUCCESS) {
-                std::cerr << "[Denoise] Failed to run async infer, status = " << completion_info.status << std::endl;
-                return ERROR;
-            }
-
-            m_on_infer_finish(output_buffer);
-
-            return SUCCESS; });
-
-        if (!job)
-        {
-            std::cerr << "Failed to start async infer job, status = " << job.status() << std::endl;
-            return job.status();
-        }
-
-        job->detach();
-        m_last_infer_job = std::make_shared<hailort::AsyncInferJob>(job.release());
-
-        return SUCCESS;
+        return m_engine.get_network_utilization();
     }
 };
 using HailortAsyncDenoisePtr = std::shared_ptr<HailortAsyncDenoise>;
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file hailort_inference_backend.hpp
+ * @brief Inference backend running a network on the Hailo device, with its buffers bound and mapped once
+ **/
+
+#pragma once
+
+#include "hailo/hailort.hpp"
+#include "inference_backend.hpp"
+#include "media_library_utils.hpp"
+#include "media_library_logger.hpp"
+#include "dma_memory_allocator.hpp"
+#include "vdevice_registry.hpp"
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#define ERROR -1
+#define SUCCESS 0
+
+struct hailort_engine_tensor_t
+{
+    std::string name;
+    bool output;
+    hailo_format_order_t format_order;
+};
+
+struct hailort_engine_config_t
+{
+    // name of the network in the vdevice registry, for scheduling overrides and utilization stats
+    std::string network_name;
+    std::string network_path;
+    std::string group_id;
+    // tensors in the order their buffers are passed to process()
+    std::vector<hailort_engine_tensor_t> tensors;
+    // number of jobs that can run at once
+    uint32_t max_in_flight;
+    // frames the device infers at once
+    uint32_t batch_size;
+    network_scheduling_t scheduling;
+};
+
+/**
+ * @brief Runs a network on the shared vdevice of its group, registered for scheduling and utilization stats.
+ *
+ * The bindings of each output buffer are created once and a buffer is only bound again when it changed,
+ * so a pool of output buffers is bound and mapped to the device once instead of per frame.
+ */
+class HailortInferenceBackend : public InferenceBackend
+{
+private:
+    hailort_engine_config_t m_config;
+
+    std::shared_ptr<hailort::VDevice> m_vdevice;
+    NetworkUsagePtr m_network_usage;
+    std::shared_ptr<hailort::InferModel> m_infer_model;
+    hailort::ConfiguredInferModel m_configured_infer_model;
+
+    // Frame size of each tensor, looked up once on open
+    std::vector<size_t> m_frame_sizes;
+    // The first output tensor - its buffer keys the prepared bindings
+    size_t m_key_tensor = 0;
+
+    /**
+     * @brief Bindings of one output buffer, with its tensor streams looked up once.
+     * A buffer is only bound again when it differs from the one already set on the stream.
+     */
+    struct prepared_bindings_t
+    {
+        hailort::ConfiguredInferModel::Bindings bindings;
+        std::vector<hailort::ConfiguredInferModel::Bindings::InferStream> streams;
+        std::vector<void *> bound_buffers;
+    };
+    // Keyed by the first output buffer - an output buffer is in a single job at a time, so its bindings are never shared
+    std::unordered_map<void *, prepared_bindings_t> m_prepared_bindings;
+    struct mapped_buffer_t
+    {
+        void *buffer;
+        // dmabuf fd, or -1 if the buffer is mapped by its user address
+        int fd;
+        size_t size;
+    };
+    // Pool buffers mapped to the device once, instead of importing or pinning them on every transfer
+    std::vector<mapped_buffer_t> m_mapped_buffers;
+    // Cleared if HailoRT rejects a dmabuf binding, buffers are then bound by user address
+    bool m_dmabuf_supported = true;
+
+public:
+    // The jobs must be done before the backend is destroyed, the engine drains them first
+    ~HailortInferenceBackend()
+    {
+        for (mapped_buffer_t &mapped : m_mapped_buffers)
+        {
+            unmap_buffer(mapped);
+        }
+    }
+
+    /**
+     * @brief Open the network.
+     * With a batch size above 1 the scheduler collects scheduling.threshold frames or waits scheduling.timeout_ms
+     * before sending a partial batch.
+     */
+    int open(const hailort_engine_config_t &config)
+    {
+        auto key_tensor = std::find_if(config.tensors.begin(), config.tensors.end(), [](const hailort_engine_tensor_t &tensor)
+                                       { return tensor.output; });
+        if (key_tensor == config.tensors.end())
+        {
+            LOGGER__ERROR("Network {} has no output tensor", config.network_name);
+            return ERROR;
+        }
+        m_config = config;
+        m_key_tensor = key_tensor - config.tensors.begin();
+
+        // Shared with the other networks of the process on the same group, so they are scheduled together
+        auto vdevice_exp = VDeviceRegistry::get_instance().acquire_vdevice(m_config.group_id);
+        if (!vdevice_exp)
+        {
+            std::cerr << "Failed to acquire vdevice, status = " << vdevice_exp.error() << std::endl;
+            return ERROR;
+        }
+        m_vdevice = vdevice_exp.value();
+
+        auto infer_model_exp = m_vdevice->create_infer_model(m_config.network_path.c_str());
+        if (!infer_model_exp)
+        {
+            std::cerr << "Failed to create infer model, status = " << infer_model_exp.status() << std::endl;
+            return infer_model_exp.status();
+        }
+        m_infer_model = infer_model_exp.release();
+        m_infer_model->set_batch_size(m_config.batch_size);
+
+        for (const hailort_engine_tensor_t &tensor : m_config.tensors)
+        {
+            if (tensor.output)
+                m_infer_model->output(tensor.name)->set_format_order(tensor.format_order);
+            else
+                m_infer_model->input(tensor.name)->set_format_order(tensor.format_order);
+        }
+
+        auto configured_infer_model_exp = m_infer_model->configure();
+        if (!configured_infer_model_exp)
+        {
+            std::cerr << "Failed to create configured infer model, status = " << configured_infer_model_exp.status() << std::endl;
+            return configured_infer_model_exp.status();
+        }
+        m_configured_infer_model = configured_infer_model_exp.release();
+
+        auto network_usage_exp = VDeviceRegistry::get_instance().register_network(m_config.network_name, m_config.group_id,
+                                                                                  m_configured_infer_model, m_config.scheduling);
+        if (!network_usage_exp)
+        {
+            std::cerr << "Failed to register " << m_config.network_name << " network, status = " << network_usage_exp.error() << std::endl;
+            return ERROR;
+        }
+        m_network_usage = network_usage_exp.value();
+
+        m_frame_sizes.clear();
+        for (const hailort_engine_tensor_t &tensor : m_config.tensors)
+        {
+            m_frame_sizes.push_back(tensor.output ? m_infer_model->output(tensor.name)->get_frame_size()
+                                                  : m_infer_model->input(tensor.name)->get_frame_size());
+        }
+
+        return SUCCESS;
+    }
+
+    NetworkUsagePtr get_network_usage()
+    {
+        return m_network_usage;
+    }
+
+    std::vector<size_t> get_frame_sizes() override
+    {
+        return m_frame_sizes;
+    }
+
+    /**
+     * @brief Map a pool buffer to the device - by its dmabuf fd if it has one, by its user address otherwise.
+     * Mapping is an optimization only, an unmapped buffer is imported or pinned by the driver on each transfer.
+     */
+    void map_buffer(void *buffer, size_t size) override
+    {
+#ifndef HAILORT_4_16
+        int fd = -1;
+        if (m_dmabuf_supported && DmaMemoryAllocator::get_instance().get_fd(buffer, fd) == MEDIA_LIBRARY_SUCCESS)
+        {
+            auto status = m_vdevice->dma_map_dmabuf(fd, size, HAILO_DMA_BUFFER_DIRECTION_BOTH);
+            if (HAILO_SUCCESS == status)
+            {
+                m_mapped_buffers.push_back({buffer, fd, size});
+                return;
+            }
+            LOGGER__INFO("Failed to map {} dmabuf {}, status = {}, mapping by address", m_config.network_name, fd, status);
+        }
+
+        auto status = m_vdevice->dma_map(buffer, size, HAILO_DMA_BUFFER_DIRECTION_BOTH);
+        if (HAILO_SUCCESS != status)
+        {
+            LOGGER__INFO("Failed to map {} buffer, status = {}, it will be pinned per transfer", m_config.network_name, status);
+            return;
+        }
+        m_mapped_buffers.push_back({buffer, -1, size});
+#endif
+    }
+
+    int prepare_output(void *buffer) override
+    {
+        return get_prepared_bindings(buffer) == nullptr ? ERROR : SUCCESS;
+    }
+
+    int wait_for_ready(std::chrono::milliseconds timeout) override
+    {
+        // Only blocks while HailoRT's own async queue is full
+        auto status = m_configured_infer_model.wait_for_async_ready(timeout);
+        if (HAILO_SUCCESS != status)
+        {
+            std::cerr << "Failed to wait for async ready, status = " << status << std::endl;
+            return status;
+        }
+        return SUCCESS;
+    }
+
+    int infer_async(const std::vector<inference_buffer_t> &buffers, std::function<void(int status)> on_done) override
+    {
+        prepared_bindings_t *prepared = get_prepared_bindings(buffers[m_key_tensor].data);
+        if (prepared == nullptr)
+        {
+            return ERROR;
+        }
+
+        for (size_t tensor = 0; tensor < buffers.size(); tensor++)
+        {
+            if (set_buffer(*prepared, tensor, buffers[tensor]) != SUCCESS)
+            {
+                return ERROR;
+            }
+        }
+
+        auto job = m_configured_infer_model.run_async(prepared->bindings, [on_done](const hailort::AsyncInferCompletionInfo &completion_info)
+                                                      { on_done(completion_info.status); });
+        if (!job)
+        {
+            std::cerr << "Failed to start async infer job, status = " << job.status() << std::endl;
+            return job.status();
+        }
+        job->detach();
+
+        return SUCCESS;
+    }
+
+private:
+    void unmap_buffer(mapped_buffer_t &mapped)
+    {
+#ifndef HAILORT_4_16
+        auto status = mapped.fd >= 0 ? m_vdevice->dma_unmap_dmabuf(mapped.fd, mapped.size, HAILO_DMA_BUFFER_DIRECTION_BOTH)
+                                     : m_vdevice->dma_unmap(mapped.buffer, mapped.size, HAILO_DMA_BUFFER_DIRECTION_BOTH);
+        if (HAILO_SUCCESS != status)
+        {
+            LOGGER__ERROR("Failed to unmap {} buffer, status = {}", m_config.network_name, status);
+        }
+#endif
+    }
+
+    /**
+     * @brief Get the bindings of an output buffer, creating them on first use of a buffer that was not prepared
+     */
+    prepared_bindings_t *get_prepared_bindings(void *key_buffer)
+    {
+        auto it = m_prepared_bindings.find(key_buffer);
+        if (it != m_prepared_bindings.end())
+        {
+            return &it->second;
+        }
+
+        auto bindings = m_configured_infer_model.create_bindings();
+        if (!bindings)
+        {
+            std::cerr << "Failed to create infer bindings, status = " << bindings.status() << std::endl;
+            return nullptr;
+        }
+        prepared_bindings_t prepared;
+        prepared.bindings = bindings.release();
+        for (const hailort_engine_tensor_t &tensor : m_config.tensors)
+        {
+            auto stream = tensor.output ? prepared.bindings.output(tensor.name) : prepared.bindings.input(tensor.name);
+            if (!stream)
+            {
+                std::cerr << "Failed to get infer stream " << tensor.name << ", status = " << stream.status() << std::endl;
+                return nullptr;
+            }
+            prepared.streams.push_back(stream.release());
+        }
+        prepared.bound_buffers.assign(m_config.tensors.size(), nullptr);
+
+        return &m_prepared_bindings.emplace(key_buffer, std::move(prepared)).first->second;
+    }
+
+    /**
+     * @brief Bind a buffer to a tensor - by its dmabuf fd when it has one, so the driver imports the
+     * buffer instead of pinning its user pages. Falls back to the user address if HailoRT rejects dmabufs.
+     */
+    int set_buffer(prepared_bindings_t &prepared, size_t tensor, const inference_buffer_t &buffer)
+    {
+        if (prepared.bound_buffers[tensor] == buffer.data)
+        {
+            return SUCCESS;
+        }
+        prepared.bound_buffers[tensor] = nullptr;
+
+#ifndef HAILORT_4_16
+        if (m_dmabuf_supported && buffer.fd >= 0)
+        {
+            hailo_dma_buffer_t dma_buffer = {buffer.fd, m_frame_sizes[tensor]};
+            auto status = prepared.streams[tensor].set_dma_buffer(dma_buffer);
+            if (HAILO_SUCCESS == status)
+            {
+                prepared.bound_buffers[tensor] = buffer.data;
+                return SUCCESS;
+            }
+            LOGGER__INFO("Failed to set infer dmabuf {}, status = {}, binding buffers by address", m_config.tensors[tensor].name, status);
+            m_dmabuf_supported = false;
+        }
+#endif
+
+        auto status = prepared.streams[tensor].set_buffer(hailort::MemoryView(buffer.data, m_frame_sizes[tensor]));
+        if (HAILO_SUCCESS != status)
+        {
+            std::cerr << "Failed to set infer buffer " << m_config.tensors[tensor].name << ", status = " << status << std::endl;
+            return status;
+        }
+        prepared.bound_buffers[tensor] = buffer.data;
+
+        return SUCCESS;
+    }
+};
+using HailortInferenceBackendPtr = std::shared_ptr<HailortInferenceBackend>;
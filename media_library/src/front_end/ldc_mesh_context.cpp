@@ -7,10 +7,8 @@
 #include <fstream>
 #include <iostream>
 #include <mutex>
-#include <opencv2/opencv.hpp>
 #include <stdio.h>
 
-#define CALIBRATION_VECOTR_SIZE 1024
 #define DEFAULT_ALPHA 0.1f
 
 LdcMeshContext::LdcMeshContext(ldc_config_t &config)
@@ -27,28 +25,11 @@ LdcMeshContext::~LdcMeshContext()
 {
     media_library_return result = MEDIA_LIBRARY_SUCCESS;
 
-    // Free ldc mesh context
-    if (m_dis_ctx != nullptr)
-    {
-        result = free_dis_context();
-        if (result != MEDIA_LIBRARY_SUCCESS)
-        {
-            LOGGER__ERROR("failed releasing ldc mesh context on error {}", result);
-        }
-    }
+    // Stop generation and prefetching and release the cached meshes
+    m_mesh_engine.reset();
 
-    // Free dewarp mesh buffer
     if(m_is_initialized)
     {
-        if (m_dewarp_mesh.mesh_table != nullptr)
-        {
-            result = DmaMemoryAllocator::get_instance().free_dma_buffer(m_dewarp_mesh.mesh_table);
-            if (result != MEDIA_LIBRARY_SUCCESS)
-            {
-                LOGGER__ERROR("failed releasing mesh dsp buffer on error {}", result);
-            }
-        }
-
         // Free angular dis columns buffer
         if(m_angular_dis_params != nullptr)
         {
@@ -91,70 +72,6 @@ media_library_return LdcMeshContext::read_vsm_config()
     return m_config_manager->config_string_to_struct<vsm_config_t>(vsm_string, m_vsm_config);
 }
 
-tl::expected<dis_calibration_t, media_library_return> LdcMeshContext::read_calibration_file(const char *name)
-{
-    dis_calibration_t calib{{}, {1, 1}, {}};
-    std::ifstream file(name);
-    if (!file.is_open())
-    {
-        LOGGER__ERROR("read_calibration_file failed, could not open file {}", name);
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    }
-
-    file.seekg(0);
-
-    // Ignore first line - it is a comment
-    file.ignore(1024, '\n');
-
-    std::string row;
-    std::getline(file, row);
-    calib.res.x = atoi(row.c_str());
-    if (file.eof())
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    std::getline(file, row);
-    calib.res.y = atoi(row.c_str());
-    if (file.eof())
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    std::getline(file, row);
-    calib.oc.x = atof(row.c_str());
-    if (file.eof())
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    std::getline(file, row);
-    calib.oc.y = atof(row.c_str());
-    if (file.eof())
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    std::getline(file, row);
-    calib.theta2radius.push_back(atof(row.c_str()));
-    if (file.eof())
-    {
-        LOGGER__ERROR("read_calibration_file failed, invalid data");
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    }
-    if (calib.theta2radius[0] != 0)
-    {
-        LOGGER__ERROR("Improper calibration file theta2radius[0] must be 0, but it is {}", calib.theta2radius[0]);
-        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-    }
-
-    for (uint32_t i = 1; !file.eof() && i < CALIBRATION_VECOTR_SIZE; ++i)
-    {
-        std::getline(file, row);
-        calib.theta2radius.push_back(atof(row.c_str()));
-
-        if (calib.theta2radius[i] <= 0)
-        {
-            LOGGER__ERROR("theta2radius[{}] contain positive radii. is {}", i, calib.theta2radius[i]);
-            return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-        }
-        if (calib.theta2radius[i] < calib.theta2radius[i - 1])
-        {
-            LOGGER__ERROR("Improper calibration file theta2radius[{}] must be monotonically increasing, but it is not ({})", i, calib.theta2radius[i]);
-            return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
-        }
-    }
-    return calib;
-};
-
 FlipMirrorRot LdcMeshContext::get_flip_value(flip_direction_t flip_dir, rotation_angle_t rotation_angle)
 {
     FlipMirrorRot flip_mirror_rot;
@@ -276,77 +193,14 @@ FlipMirrorRot LdcMeshContext::get_flip_value(flip_direction_t flip_dir, rotation
 
 media_library_return LdcMeshContext::initialize_dis_context()
 {
-    DewarpT dewarp_mesh;
-
-    // Read the sensor calibration and dewarp configuration files
+    // Read the VSM configuration file, the sensor calibration is read by the mesh engine
     m_config_manager = std::make_shared<ConfigManager>(ConfigSchema::CONFIG_SCHEMA_VSM);
-    std::vector<char> calib_file;
     media_library_return vsm_status = read_vsm_config();
     if (vsm_status != MEDIA_LIBRARY_SUCCESS)
     {
         LOGGER__ERROR("dewarp mesh initialization failed when reading vsm_config");
         return MEDIA_LIBRARY_CONFIGURATION_ERROR;
     }
-    auto expected_calib = read_calibration_file(m_ldc_configs.dewarp_config.sensor_calib_path.c_str());
-    if (!expected_calib.has_value())
-    {
-        LOGGER__ERROR("dewarp mesh initialization failed when reading calib_file");
-        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
-    }
-    auto calib = expected_calib.value();
-
-    if (m_ldc_configs.optical_zoom_config.enabled && m_magnification != 1.0) // set calibration according to zoom
-    {
-        // crop
-        auto cropped = calib.theta2radius;
-        size_t crop_size = static_cast<size_t>(CALIBRATION_VECOTR_SIZE / m_magnification);
-        cropped.erase(cropped.begin() + crop_size, cropped.end());
-
-        // convert cropped to difference series
-        for (size_t i = 0; i < cropped.size() - 1; ++i)
-        {
-            cropped[i] = cropped[i + 1] - cropped[i];
-        }
-
-        // Resize the matrix using cv::resize
-        cv::Mat originalMat(1, crop_size, CV_32FC1, cropped.data());
-        cv::Mat resizedMat;
-        cv::resize(originalMat, resizedMat, cv::Size(CALIBRATION_VECOTR_SIZE, 1));
-        std::vector<float> resizedVector(resizedMat.begin<float>(), resizedMat.end<float>());
-
-        // convert resizedVector from difference series to cumulative series
-        calib.theta2radius = std::vector<float>{0};
-        for (size_t i = 0; i < CALIBRATION_VECOTR_SIZE; ++i)
-        {
-            calib.theta2radius.push_back(resizedVector[i] + calib.theta2radius[i]);
-        }
-    }
-
-    // Initialize dis dewarp mesh object using DIS library
-    RetCodes ret = dis_init(&m_dis_ctx, m_ldc_configs.dis_config, calib,
-                            m_input_width, m_input_height,
-                            m_ldc_configs.dewarp_config.camera_type, m_ldc_configs.dewarp_config.camera_fov, &dewarp_mesh);
-    if (ret != DIS_OK)
-    {
-        LOGGER__ERROR("dewarp mesh initialization failed on error {}", ret);
-        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
-    }
-
-    // Convert stuct to dsp_dewarp_mesh_t
-    m_dewarp_mesh.mesh_width = dewarp_mesh.mesh_width;
-    m_dewarp_mesh.mesh_height = dewarp_mesh.mesh_height;
-    LOGGER__INFO("dewarp mesh initialization finished {}x{}", dewarp_mesh.mesh_width, dewarp_mesh.mesh_height);
-    return MEDIA_LIBRARY_SUCCESS;
-}
-
-media_library_return LdcMeshContext::free_dis_context()
-{
-    RetCodes ret = dis_deinit(&m_dis_ctx);
-    if (ret != DIS_OK)
-    {
-        LOGGER__ERROR("dewarp mesh free failed on error {}", ret);
-        return MEDIA_LIBRARY_DSP_OPERATION_ERROR;
-    }
     return MEDIA_LIBRARY_SUCCESS;
 }
 
@@ -412,35 +266,18 @@ media_library_return LdcMeshContext::initialize_angular_dis()
 }
 
 
-media_library_return LdcMeshContext::initialize_dewarp_mesh()
+mesh_engine_params_t LdcMeshContext::mesh_params()
 {
-    DewarpT mesh = {(int)m_dewarp_mesh.mesh_width,
-                    (int)m_dewarp_mesh.mesh_height,
-                    (int *)m_dewarp_mesh.mesh_table};
-
     flip_direction_t flip_dir = FLIP_DIRECTION_NONE;
     rotation_angle_t rotation_angle = ROTATION_ANGLE_0;
     if (m_ldc_configs.flip_config.enabled)
         flip_dir = m_ldc_configs.flip_config.direction;
     if (m_ldc_configs.rotation_config.enabled)
         rotation_angle = m_ldc_configs.rotation_config.angle;
-    FlipMirrorRot flip_mirror_rot = get_flip_value(flip_dir, rotation_angle);
-    DmaMemoryAllocator::get_instance().dmabuf_sync_start((void*)m_dewarp_mesh.mesh_table);
-    RetCodes ret = dis_dewarp_only_grid(m_dis_ctx, m_input_width, m_input_height, flip_mirror_rot, &mesh);
-    DmaMemoryAllocator::get_instance().dmabuf_sync_end((void*)m_dewarp_mesh.mesh_table);
-    if (ret != DIS_OK)
-    {
-        LOGGER__ERROR("Failed to generate mesh, status: {}", ret);
-        return MEDIA_LIBRARY_ERROR;
-    }
-
-    m_dewarp_mesh.mesh_table = mesh.mesh_table;
-    m_dewarp_mesh.mesh_width = mesh.mesh_width;
-    m_dewarp_mesh.mesh_height = mesh.mesh_height;
 
-
-    LOGGER__INFO("generated base dewarp mesh grid {}x{}", mesh.mesh_width, mesh.mesh_height);
-    return MEDIA_LIBRARY_SUCCESS;
+    return {m_ldc_configs.dewarp_config, m_ldc_configs.dis_config, (uint32_t)m_input_width, (uint32_t)m_input_height,
+            get_flip_value(flip_dir, rotation_angle), m_ldc_configs.optical_zoom_config.enabled,
+            m_ldc_configs.optical_zoom_config.magnification};
 }
 
 media_library_return LdcMeshContext::configure(ldc_config_t &ldc_configs)
@@ -450,7 +287,6 @@ media_library_return LdcMeshContext::configure(ldc_config_t &ldc_configs)
     m_ldc_configs = ldc_configs;
     m_input_width = m_ldc_configs.input_video_config.resolution.dimensions.destination_width;
     m_input_height = m_ldc_configs.input_video_config.resolution.dimensions.destination_height;
-    m_magnification = m_ldc_configs.optical_zoom_config.magnification;
 
     if(!m_ldc_configs.dewarp_config.enabled)
         return MEDIA_LIBRARY_SUCCESS;
@@ -458,28 +294,20 @@ media_library_return LdcMeshContext::configure(ldc_config_t &ldc_configs)
     if (!m_is_initialized) // initialize mesh for the first time
     {
         m_angular_dis_params = std::make_shared<angular_dis_params_t>();
+        // Frames must not wait for DIS, stabilized meshes are generated on the engine worker
+        m_mesh_engine = std::make_unique<MeshEngine>();
 
         LOGGER__INFO("Initiazing dewarp mesh context");
         ret = initialize_dis_context();
         if(ret != MEDIA_LIBRARY_SUCCESS)
             return ret;
-
-        // Allocate memory for mesh table - doing it outside of initialize_dewarp_mesh for reuse of the buffer
-        size_t mesh_size = m_dewarp_mesh.mesh_width * m_dewarp_mesh.mesh_height * 2 * 4;
-
-        media_library_return result = DmaMemoryAllocator::get_instance().allocate_dma_buffer(mesh_size, (void **)&m_dewarp_mesh.mesh_table);
-        if (result != MEDIA_LIBRARY_SUCCESS)
-        {
-            LOGGER__ERROR("dewarp mesh initialization failed in the buffer allocation process (tried to allocate buffer in size of {})", mesh_size);
-            return MEDIA_LIBRARY_DSP_OPERATION_ERROR;
-        }
     }
 
     ret = initialize_angular_dis();
     if(ret != MEDIA_LIBRARY_SUCCESS)
         return ret;
 
-    ret = initialize_dewarp_mesh();
+    ret = m_mesh_engine->configure(mesh_params());
     if(ret != MEDIA_LIBRARY_SUCCESS)
         return ret;
 
@@ -508,34 +336,14 @@ media_library_return LdcMeshContext::on_frame_vsm_update(struct hailo15_vsm &vsm
         return MEDIA_LIBRARY_SUCCESS;
 
     std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_mesh_engine == nullptr)
+        return MEDIA_LIBRARY_UNINITIALIZED;
 
-    // Update dewarp mesh with the VSM data to perform DIS
+    // Queue the VSM data to update the dewarp mesh and perform DIS - the mesh is generated by the mesh engine
     LOGGER__DEBUG("Updating mesh with VSM");
-    DewarpT mesh = {(int)m_dewarp_mesh.mesh_width,
-                    (int)m_dewarp_mesh.mesh_height,
-                    (int *)m_dewarp_mesh.mesh_table};
-
-    flip_direction_t flip_dir = FLIP_DIRECTION_NONE;
-    rotation_angle_t rotation_angle = ROTATION_ANGLE_0;
-    if (m_ldc_configs.flip_config.enabled)
-        flip_dir = m_ldc_configs.flip_config.direction;
-    if (m_ldc_configs.rotation_config.enabled)
-        rotation_angle = m_ldc_configs.rotation_config.angle;
-    FlipMirrorRot flip_mirror_rot = get_flip_value(flip_dir, rotation_angle);
-
-    DmaMemoryAllocator::get_instance().dmabuf_sync_start((void*)m_dewarp_mesh.mesh_table);
-    RetCodes ret = dis_generate_grid(m_dis_ctx, m_input_width, m_input_height, vsm.dx,
-                                     vsm.dy, 0, flip_mirror_rot, m_angular_dis_params, &mesh);
-    DmaMemoryAllocator::get_instance().dmabuf_sync_end((void*)m_dewarp_mesh.mesh_table);
-    if (ret != DIS_OK)
-    {
-        LOGGER__ERROR("Failed to update mesh with VSM, status: {}", ret);
-        return MEDIA_LIBRARY_ERROR;
-    }
-
-    m_dewarp_mesh.mesh_table = mesh.mesh_table;
-    m_dewarp_mesh.mesh_width = mesh.mesh_width;
-    m_dewarp_mesh.mesh_height = mesh.mesh_height;
+    media_library_return ret = m_mesh_engine->submit_vsm((float)vsm.dx, (float)vsm.dy, m_angular_dis_params);
+    if (ret != MEDIA_LIBRARY_SUCCESS)
+        return ret;
 
     if (update_isp_vsm(vsm) != MEDIA_LIBRARY_SUCCESS)
     {
@@ -548,24 +356,22 @@ media_library_return LdcMeshContext::on_frame_vsm_update(struct hailo15_vsm &vsm
 
 media_library_return LdcMeshContext::set_optical_zoom(float magnification)
 {
-    std::unique_lock<std::shared_mutex> lock(m_mutex);
-    media_library_return ret = MEDIA_LIBRARY_SUCCESS;
-    m_magnification = magnification;
-
-    // upon optical zoom, dis_library should be reinitialized with modified calibration
-    ret = free_dis_context();
-    if (ret != MEDIA_LIBRARY_SUCCESS)
-        return ret;
-
-    ret = initialize_dis_context();
-    if (ret != MEDIA_LIBRARY_SUCCESS)
-        return ret;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_ldc_configs.optical_zoom_config.magnification = magnification;
+        if (m_mesh_engine == nullptr)
+            return MEDIA_LIBRARY_SUCCESS;
+    }
 
-    return initialize_dewarp_mesh();
+    // upon optical zoom, the mesh of the new magnification is taken from the engine cache
+    return m_mesh_engine->set_optical_zoom(magnification);
 }
 
-dsp_dewarp_mesh_t *LdcMeshContext::get()
+std::shared_ptr<dsp_dewarp_mesh_t> LdcMeshContext::get()
 {
     std::shared_lock<std::shared_mutex> lock(m_mutex);
-    return &m_dewarp_mesh;
-}
\ No newline at end of file
+    if (m_mesh_engine == nullptr)
+        return nullptr;
+    // Latest completed mesh - the mesh buffer is kept until the returned pointer is released
+    return m_mesh_engine->get();
+}
@@ -4,6 +4,7 @@
 #include "config_manager.hpp"
 #include "media_library_types.hpp"
 #include "media_library_utils.hpp"
+#include "mesh_engine.hpp"
 #include "hailo_v4l2/hailo_v4l2.h"
 #include <memory>
 #include <shared_mutex>
@@ -20,29 +21,22 @@ private:
     vsm_config_t m_vsm_config;
     // configuration manager
     std::shared_ptr<ConfigManager> m_config_manager;
-    // Pointer to internally allocated DIS instance. used for DIS library mesh generation
-    void *m_dis_ctx = nullptr;
-    // dewarp mesh object
-    dsp_dewarp_mesh_t m_dewarp_mesh;
+    // Calibration, cached meshes per zoom level and rotation, and asynchronous generation of stabilized meshes
+    std::unique_ptr<MeshEngine> m_mesh_engine;
     // Angular DIS
     std::shared_ptr<angular_dis_params_t> m_angular_dis_params;
 
-    // optical zoom magnification level - used for dewarping
-    float m_magnification;
     bool m_is_initialized = false;
     std::shared_mutex m_mutex;
 
-    media_library_return
-    initialize_dewarp_mesh();
     media_library_return initialize_dis_context();
-    media_library_return free_dis_context();
     media_library_return free_angular_dis_resources();
     media_library_return initialize_angular_dis();
     media_library_return update_isp_vsm(struct hailo15_vsm &vsm);
     media_library_return angular_dis(struct hailo15_vsm &vsm);
     media_library_return read_vsm_config();
     FlipMirrorRot get_flip_value(flip_direction_t flip_dir, rotation_angle_t rotation_angle);
-    tl::expected<dis_calibration_t, media_library_return> read_calibration_file(const char *name);
+    mesh_engine_params_t mesh_params();
 
 public:
     LdcMeshContext(ldc_config_t &config);
@@ -51,5 +45,5 @@ public:
     media_library_return on_frame_vsm_update(struct hailo15_vsm &vsm);
     media_library_return set_optical_zoom(float magnification);
     std::shared_ptr<angular_dis_params_t> get_angular_dis_params();
-    dsp_dewarp_mesh_t *get();
+    std::shared_ptr<dsp_dewarp_mesh_t> get();
 };
\ No newline at end of file
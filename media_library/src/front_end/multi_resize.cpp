@@ -296,6 +296,14 @@ media_library_return MediaLibraryMultiResize::Impl::set_output_rotation(const ro
 
     m_multi_resize_config.set_output_dimensions_rotation(rotation);
 
+    // The input frame is rotated upstream, rotate the privacy masks with it
+    media_library_return blender_status = m_privacy_mask_blender->set_rotation(rotation);
+    if (blender_status != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("Failed to set privacy mask blender rotation");
+        return blender_status;
+    }
+
     // recreate buffer pools if needed
     media_library_return ret = create_and_initialize_buffer_pools();
     if (ret != MEDIA_LIBRARY_SUCCESS)
@@ -488,10 +496,11 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
         return MEDIA_LIBRARY_ERROR;
     }
 
-    dsp_crop_resize_params_t crop_resize_params;
+    // The outputs, and in pixelate mode the masked region resized into the pixelation cells by the same operation
+    dsp_crop_resize_params_t crop_resize_params[2] = {};
     dsp_multi_crop_resize_params_t multi_crop_resize_params = {
         .src = input_buffer.hailo_pix_buffer.get(),
-        .crop_resize_params = &crop_resize_params,
+        .crop_resize_params = crop_resize_params,
         .crop_resize_params_count = 1,
         .interpolation = m_multi_resize_config.output_video_config.interpolation_type,
         .helper_plane = m_resize_helper_buffer.hailo_pix_buffer.get(),
@@ -515,7 +524,7 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
             return MEDIA_LIBRARY_ERROR;
         }
 
-        crop_resize_params.dst[num_bufs_to_resize] = output_frame;
+        crop_resize_params[0].dst[num_bufs_to_resize] = output_frame;
         LOGGER__DEBUG("Multi resize output frame ({}) - y_ptr = {}, uv_ptr = {}. dims: width {} output frame height {}", i, fmt::ptr(output_frame->planes[0].userptr), fmt::ptr(output_frame->planes[1].userptr), output_frame->width, output_frame->height);
         num_bufs_to_resize++;
     }
@@ -577,10 +586,31 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
 
     PrivacyMaskDataPtr privacy_mask_data = blender_expected.value();
 
+    // The DSP blend fills masks with a single color, pixelated masks are averaged into cells by the resize,
+    // with the interpolation of the outputs, and filled into the outputs after it
+    bool pixelate = privacy_mask_data->rois_count > 0 &&
+                    m_privacy_mask_blender->get_mode().value() == PRIVACY_MASK_MODE_PIXELATE;
+    dsp_roi_t cells_crop;
+    if (pixelate)
+    {
+        auto cells_expected = m_privacy_mask_blender->get_pixelation_cells(input_buffer, cells_crop);
+        if (!cells_expected.has_value())
+        {
+            LOGGER__ERROR("Failed to get the privacy mask pixelation cells");
+            return MEDIA_LIBRARY_ERROR;
+        }
+        if (cells_expected.value() != nullptr)
+        {
+            crop_resize_params[1].crop = &cells_crop;
+            crop_resize_params[1].dst[0] = cells_expected.value();
+            multi_crop_resize_params.crop_resize_params_count = 2;
+        }
+    }
+
     // Perform multi resize
     clock_gettime(CLOCK_MONOTONIC, &start_resize);
     dsp_status ret = DSP_SUCCESS;
-    if (privacy_mask_data->rois_count == 0)
+    if (privacy_mask_data->rois_count == 0 || pixelate)
     {
         LOGGER__DEBUG("Performing multi resize on the DSP with digital zoom ROI: start_x {} start_y {} end_x {} end_y {}", start_x, start_y, end_x, end_y);
         dsp_roi_t crop = {
@@ -589,7 +619,7 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
             .end_x = end_x,
             .end_y = end_y
         };
-        crop_resize_params.crop = &crop;
+        crop_resize_params[0].crop = &crop;
         ret = dsp_utils::perform_dsp_multi_resize(&multi_crop_resize_params);
     }
     else
@@ -620,7 +650,7 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
             .end_x = end_x,
             .end_y = end_y
         };
-        crop_resize_params.crop = &crop;
+        crop_resize_params[0].crop = &crop;
         ret = dsp_utils::perform_dsp_multi_resize(&multi_crop_resize_params, &dsp_privacy_mask);
     }
 
@@ -631,6 +661,22 @@ media_library_return MediaLibraryMultiResize::Impl::perform_multi_resize(hailo_m
     if (ret != DSP_SUCCESS)
         return MEDIA_LIBRARY_DSP_OPERATION_ERROR;
 
+    // The input frame may be shared with other consumers, it is only read - the outputs are pixelated
+    roi_t crop = {start_x, start_y, end_x - start_x, end_y - start_y};
+    if (pixelate)
+    {
+        struct timespec start_pixelate, end_pixelate;
+        clock_gettime(CLOCK_MONOTONIC, &start_pixelate);
+        if (m_privacy_mask_blender->pixelate(crop, output_frames) != MEDIA_LIBRARY_SUCCESS)
+        {
+            LOGGER__ERROR("Failed to pixelate privacy mask");
+            return MEDIA_LIBRARY_ERROR;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end_pixelate);
+        [[maybe_unused]] long pixelate_ms = (long)media_library_difftimespec_ms(end_pixelate, start_pixelate);
+        LOGGER__TRACE("privacy mask pixelate took {} milliseconds", pixelate_ms);
+    }
+
     return MEDIA_LIBRARY_SUCCESS;
 }
 
@@ -1,6 +1,3 @@
-#include "opencv2/imgproc.hpp"
-#include "opencv2/imgcodecs.hpp"
-#include "opencv2/highgui.hpp"
 #include <bitset>
 #include <iostream>
 #include <time.h>
@@ -16,412 +13,684 @@
 #include <float.h>
 #include <fstream>
 #include <numbers>
+#include <tuple>
+#include <string_view>
+#include <unordered_set>
 
-#include "opencv2/core/core.hpp"
-#include "opencv2/core/types_c.h"
-#include <opencv2/core/mat.hpp>
 #include "media_library_utils.hpp"
 #include "media_library_logger.hpp"
 #include "polygon_math.hpp"
 
-using namespace cv;
-
 // Local definitions - Use enum becuase they are only valid within the scope in which they are defined
 enum
 {
-    CV_AA = 16,
     XY_SHIFT = 16,
     XY_ONE = 1 << XY_SHIFT,
-    DRAWING_STORAGE_BLOCK = (1 << 12) - 256
+    // Regions the greedy roi merge searches, more are first merged by their position
+    ROIS_GREEDY_MAX_REGIONS = 64
 };
 
-struct PolyEdge
+struct mask_point_t
 {
-    PolyEdge() : y0(0), y1(0), x(0), dx(0), next(0) {}
-
-    int y0, y1;
-    int x, dx;
-    PolyEdge *next;
-};
-
-struct CmpEdges
-{
-    bool operator()(const PolyEdge &e1, const PolyEdge &e2)
-    {
-        return e1.y0 - e2.y0 ? e1.y0 < e2.y0 : e1.x - e2.x ? e1.x < e2.x
-                                                           : e1.dx < e2.dx;
-    }
+    int x, y;
 };
 
 /**
- * Fills a packaged array with a line segment.
+ * Sets a span of pixels in a row of the packed bitmask.
  *
- * The binary image is represented as a vector of bytes (packaged_array),
- * where each byte represents 8 pixels in the image.
- * The line is specified by its y-coordinate (y) and the x-coordinates of its start and end points (x1 and x2).
+ * Each byte represents 8 pixels, the first pixel in the most significant bit.
  *
- * @param width The width of the array.
- * @param y The y-coordinate of the line.
- * @param x1 The starting x-coordinate of the line.
- * @param x2 The ending x-coordinate of the line.
- * @param packaged_array The vector representing the packaged array.
+ * @param row The first byte of the row.
+ * @param x1 The first pixel of the span.
+ * @param x2 The last pixel of the span (inclusive).
  */
-static void fill_packaged_array_with_line(uint width, uint y, uint x1, uint x2, std::vector<uint8_t> &packaged_array)
+static void fill_packaged_array_with_line(uint8_t *row, uint x1, uint x2)
 {
-    uint offset_mod, packaged_array_offset, num_of_bytes, bytes_mod = 0;
-    uint8_t byte_mask;
-    int num_of_pixels = (x2 - x1) + 1;
-
-    // Create a mask for the first byte
-    offset_mod = (y * width + x1) % 8;
+    uint first_byte = x1 / 8;
+    uint last_byte = x2 / 8;
+    uint8_t first_mask = 255 >> (x1 % 8);
+    uint8_t last_mask = 255 << (7 - x2 % 8);
 
-    num_of_pixels -= (8 - offset_mod);
-    // Byte mask is 255 shifted (right) by the offset
-    byte_mask = 255 >> offset_mod;
-    if (num_of_pixels < 0)
+    if (first_byte == last_byte)
     {
-        // Not a full byte left - we should zero num_of_pixels bits from the byte_mask:
-        // mask = 1 << num_of_pixels * (-1)
-        // mask = mask -1
-        uint8_t mask = (1 << (num_of_pixels * -1)) - 1;
-
-        // byte_mask = byte_mask AND (NOT mask)
-        byte_mask &= ~mask;
-        num_of_pixels = 0;
+        row[first_byte] |= first_mask & last_mask;
+        return;
     }
 
-    // Calculate the offset in the packaged array
-    packaged_array_offset = (y * width + x1) / 8;
-    // Set the first byte of the row
-    packaged_array[packaged_array_offset] |= byte_mask;
-
-    num_of_bytes = num_of_pixels / 8;
-
+    row[first_byte] |= first_mask;
     // memset the full bytes with 255
-    if (num_of_pixels >= 8)
-        memset(&packaged_array[packaged_array_offset + 1], 255, num_of_bytes);
-
-    bytes_mod = num_of_pixels % 8;
-    // Create a mask for the last byte
-    byte_mask = 255 << (8 - bytes_mod);
-    // Set the last byte of the row
-    packaged_array[(packaged_array_offset + num_of_bytes + 1)] |= byte_mask;
+    if (last_byte > first_byte + 1)
+        memset(&row[first_byte + 1], 255, last_byte - first_byte - 1);
+    row[last_byte] |= last_mask;
 }
 
-static void
-fill_edge_collection(Mat &img, std::vector<PolyEdge> &edges, const void *color, uint stride, std::vector<uint8_t> &packaged_array)
+/**
+ * Quantizes polygon vertices to bitmask coordinates.
+ *
+ * @param vertices The polygon vertices in frame coordinates.
+ * @param roi The bounding box of the quantized polygon, clipped to the bitmask.
+ * @param points Optional output of the quantized vertices.
+ */
+static void quantize_vertices(const std::vector<privacy_mask_types::vertex> &vertices, roi_t &roi, const uint &frame_width, const uint &frame_height,
+                              std::vector<mask_point_t> *points)
 {
-    PolyEdge tmp;
-    int i, y, total = (int)edges.size();
-    Size size = img.size();
-    PolyEdge *e;
-    int y_max = INT_MIN, y_min = INT_MAX;
-    int64 x_max = 0xFFFFFFFFFFFFFFFF, x_min = 0x7FFFFFFFFFFFFFFF;
+    int min_x = INT_MAX;
+    int min_y = INT_MAX;
+    int max_x = 0;
+    int max_y = 0;
 
-    if (total < 2)
-        return;
+    if (points != nullptr)
+    {
+        points->clear();
+        points->reserve(vertices.size());
+    }
 
-    for (i = 0; i < total; i++)
+    for (const auto &vertex : vertices)
     {
-        PolyEdge &e1 = edges[i];
-        CV_Assert(e1.y0 < e1.y1);
-        // Determine x-coordinate of the end of the edge.
-        // (This is not necessary x-coordinate of any vertex in the array.)
-        int64 x1 = e1.x + (e1.y1 - e1.y0) * e1.dx;
-        y_min = std::min<int>(y_min, e1.y0);
-        y_max = std::max<int>(y_max, e1.y1);
-        x_min = std::min<int>(x_min, e1.x);
-        x_max = std::max<int>(x_max, e1.x);
-        x_min = std::min<int>(x_min, x1);
-        x_max = std::max<int>(x_max, x1);
+        mask_point_t point = {(int)(vertex.x * PRIVACY_MASK_QUANTIZATION), (int)(vertex.y * PRIVACY_MASK_QUANTIZATION)};
+        if (points != nullptr)
+            points->emplace_back(point);
+
+        min_x = std::min(min_x, point.x);
+        min_y = std::min(min_y, point.y);
+        max_x = std::max(max_x, point.x);
+        max_y = std::max(max_y, point.y);
     }
 
-    if (y_max < 0 || y_min >= size.height || x_max < 0 || x_min >= ((int64)size.width << XY_SHIFT))
-        return;
+    // CLIP min and max to be within the bitmask
+    min_x = std::clamp(min_x, 0, (int)(frame_width * PRIVACY_MASK_QUANTIZATION));
+    min_y = std::clamp(min_y, 0, (int)(frame_height * PRIVACY_MASK_QUANTIZATION));
+    max_x = std::clamp(max_x, 0, (int)(frame_width * PRIVACY_MASK_QUANTIZATION));
+    max_y = std::clamp(max_y, 0, (int)(frame_height * PRIVACY_MASK_QUANTIZATION));
 
-    std::sort(edges.begin(), edges.end(), CmpEdges());
+    roi.x = min_x;
+    roi.y = min_y;
+    roi.width = max_x - min_x;
+    roi.height = max_y - min_y;
+}
 
-    // start drawing
-    tmp.y0 = INT_MAX;
-    edges.push_back(tmp); // after this point we do not add
-                          // any elements to edges, thus we can use pointers
-    i = 0;
-    tmp.next = 0;
-    e = &edges[i];
-    y_max = MIN(y_max, size.height);
+/**
+ * Quantizes the bounding box of a dynamic mask to inclusive bitmask bounds.
+ * The bounds are rounded outwards, so the whole shape is covered.
+ */
+static void quantize_dynamic_mask(const privacy_mask_types::dynamic_mask_t &dynamic_mask, int &x0, int &y0, int &x1, int &y1)
+{
+    x0 = (int)std::floor(dynamic_mask.x * PRIVACY_MASK_QUANTIZATION);
+    y0 = (int)std::floor(dynamic_mask.y * PRIVACY_MASK_QUANTIZATION);
+    x1 = (int)std::ceil((dynamic_mask.x + (int)dynamic_mask.width) * PRIVACY_MASK_QUANTIZATION) - 1;
+    y1 = (int)std::ceil((dynamic_mask.y + (int)dynamic_mask.height) * PRIVACY_MASK_QUANTIZATION) - 1;
+}
 
-    for (y = e->y0; y < y_max; y++)
-    {
-        PolyEdge *last, *prelast, *keep_prelast;
-        int draw = 0;
-        int clipline = y < 0;
+// Cell sizes are powers of two, these round towards -inf and +inf also for negative coordinates
+static int align_down_to_cell(int value, int cell_size)
+{
+    return value & ~(cell_size - 1);
+}
 
-        prelast = &tmp;
-        last = tmp.next;
-        while (last || e->y0 == y)
-        {
-            if (last && last->y1 == y)
-            {
-                // exclude edge if y reaches its lower point
-                prelast->next = last->next;
-                last = last->next;
-                continue;
-            }
-            keep_prelast = prelast;
-            if (last && (e->y0 > y || last->x < e->x))
-            {
-                // go to the next edge in active list
-                prelast = last;
-                last = last->next;
-            }
-            else if (i < total)
-            {
-                // insert new edge into active list if y reaches its upper point
-                prelast->next = e;
-                e->next = last;
-                prelast = e;
-                e = &edges[++i];
-            }
-            else
-                break;
+static int align_up_to_cell(int value, int cell_size)
+{
+    return (value + cell_size - 1) & ~(cell_size - 1);
+}
 
-            if (draw)
-            {
-                if (!clipline)
-                {
-                    // convert x's from fixed-point to image coordinates
-                    int x1, x2;
+static roi_t clip_mask_region(int x0, int y0, int x1, int y1, int mask_width, int mask_height)
+{
+    x0 = std::clamp(x0, 0, mask_width);
+    y0 = std::clamp(y0, 0, mask_height);
+    x1 = std::clamp(x1 + 1, 0, mask_width);
+    y1 = std::clamp(y1 + 1, 0, mask_height);
+    return {(uint)x0, (uint)y0, (uint)std::max(x1 - x0, 0), (uint)std::max(y1 - y0, 0)};
+}
 
-                    if (keep_prelast->x > prelast->x)
-                    {
-                        x1 = (int)((prelast->x + XY_ONE - 1) >> XY_SHIFT);
-                        x2 = (int)(keep_prelast->x >> XY_SHIFT);
-                    }
-                    else
-                    {
-                        x1 = (int)((keep_prelast->x + XY_ONE - 1) >> XY_SHIFT);
-                        x2 = (int)(prelast->x >> XY_SHIFT);
-                    }
+/**
+ * Widens a bitmask region to whole cells, clipped to the bitmask.
+ */
+static roi_t align_mask_region_to_cells(const roi_t &region, int cell_size, uint mask_width, uint mask_height)
+{
+    if (cell_size == 1)
+        return region;
+    uint x_begin = align_down_to_cell(region.x, cell_size);
+    uint y_begin = align_down_to_cell(region.y, cell_size);
+    uint x_end = std::min((uint)align_up_to_cell(region.x + region.width, cell_size), mask_width);
+    uint y_end = std::min((uint)align_up_to_cell(region.y + region.height, cell_size), mask_height);
+    return {x_begin, y_begin, x_end > x_begin ? x_end - x_begin : 0, y_end > y_begin ? y_end - y_begin : 0};
+}
 
-                    // clip and draw the line
-                    if (x1 < size.width && x2 >= 0)
-                    {
-                        if (x1 < 0)
-                            x1 = 0;
-                        if (x2 >= size.width)
-                            x2 = size.width - 1;
+/**
+ * Get the size in bitmask pixels of the cells of a mask, masks without their own quantization take default_cell_size.
+ */
+static int get_mask_cell_size(uint quantization, uint default_cell_size)
+{
+    if (quantization == 0)
+        return std::max(default_cell_size, 1u);
+    return std::max((uint)(quantization * PRIVACY_MASK_QUANTIZATION), 1u);
+}
 
-                        fill_packaged_array_with_line(stride, y, x1, x2, packaged_array);
-                    }
-                }
-                keep_prelast->x += keep_prelast->dx;
-                prelast->x += prelast->dx;
-            }
-            draw ^= 1;
-        }
+static bool regions_intersect(const roi_t &a, const roi_t &b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
 
-        // sort edges (using bubble sort)
-        keep_prelast = 0;
+static roi_t union_regions(const roi_t &a, const roi_t &b)
+{
+    uint x = std::min(a.x, b.x);
+    uint y = std::min(a.y, b.y);
+    return {x, y, std::max(a.x + a.width, b.x + b.width) - x, std::max(a.y + a.height, b.y + b.height) - y};
+}
 
-        do
-        {
-            prelast = &tmp;
-            last = tmp.next;
-            PolyEdge *last_exchange = 0;
+roi_t get_dynamic_mask_dirty_region(const privacy_mask_types::dynamic_mask_t &dynamic_mask, const uint &frame_width, const uint &frame_height,
+                                    uint cell_size)
+{
+    int x0, y0, x1, y1;
+    uint mask_width = frame_width * PRIVACY_MASK_QUANTIZATION;
+    uint mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+    quantize_dynamic_mask(dynamic_mask, x0, y0, x1, y1);
+    return align_mask_region_to_cells(clip_mask_region(x0, y0, x1, y1, mask_width, mask_height),
+                                      get_mask_cell_size(dynamic_mask.quantization, cell_size), mask_width, mask_height);
+}
 
-            while (last != keep_prelast && last->next != 0)
+std::vector<roi_t> merge_dirty_regions(const std::vector<roi_t> &regions)
+{
+    // A moving polygon dirties its previous and its new bounding box, which usually overlap -
+    // merge overlapping regions so no pixel is rasterized twice
+    std::vector<roi_t> merged;
+    for (const roi_t &region : regions)
+    {
+        if (region.width == 0 || region.height == 0)
+            continue;
+        roi_t current = region;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto it = merged.begin(); it != merged.end(); it++)
             {
-                PolyEdge *te = last->next;
-
-                // swap edges
-                if (last->x > te->x)
+                if (regions_intersect(*it, current))
                 {
-                    prelast->next = te;
-                    last->next = te->next;
-                    te->next = last;
-                    prelast = te;
-                    last_exchange = prelast;
-                }
-                else
-                {
-                    prelast = last;
-                    last = te;
+                    current = union_regions(*it, current);
+                    merged.erase(it);
+                    changed = true;
+                    break;
                 }
             }
-            if (last_exchange == NULL)
-                break;
-            keep_prelast = last_exchange;
-        } while (keep_prelast != tmp.next && keep_prelast != &tmp);
+        }
+        merged.push_back(current);
     }
+    return merged;
 }
 
-static std::vector<Point> convert_vertices_to_points(const std::vector<privacy_mask_types::vertex> &vertices, roi_t &roi, const uint &frame_width, const uint &frame_height)
+static uint64_t region_area(const roi_t &region)
 {
-    int min_x = INT_MAX;
-    int min_y = INT_MAX;
-    int max_x = 0;
-    int max_y = 0;
+    return (uint64_t)region.width * region.height;
+}
 
-    std::vector<Point> points;
-    points.reserve(vertices.size());
+// The pixels a merge adds to the area of two regions - negative when they overlap
+static int64_t merge_growth(const roi_t &a, const roi_t &b)
+{
+    return (int64_t)region_area(union_regions(a, b)) - (int64_t)region_area(a) - (int64_t)region_area(b);
+}
 
-    for (const auto &vertex : vertices)
+/**
+ * Merges the regions whose centers fall in the same tile of a grid of about max_tiles tiles over their bounds.
+ * Bounds the number of regions the greedy merge searches, a merge adds at most the area around a tile.
+ */
+static std::vector<roi_t> bucket_regions(const std::vector<roi_t> &regions, size_t max_tiles)
+{
+    roi_t bounds = regions.front();
+    for (const roi_t &region : regions)
+        bounds = union_regions(bounds, region);
+    uint side = std::max<uint>(std::sqrt(double(region_area(bounds)) / max_tiles), 1);
+    uint columns = (bounds.width + side - 1) / side;
+    uint rows = (bounds.height + side - 1) / side;
+
+    std::vector<roi_t> tiles((size_t)columns * rows, roi_t{0, 0, 0, 0});
+    for (const roi_t &region : regions)
+    {
+        uint column = (region.x + region.width / 2 - bounds.x) / side;
+        uint row = (region.y + region.height / 2 - bounds.y) / side;
+        roi_t &tile = tiles[(size_t)row * columns + column];
+        tile = tile.width == 0 ? region : union_regions(tile, region);
+    }
+    std::vector<roi_t> bucketed;
+    for (const roi_t &tile : tiles)
     {
-        int x = vertex.x;
-        int y = vertex.y;
+        if (tile.width != 0)
+            bucketed.push_back(tile);
+    }
+    return bucketed;
+}
 
-        Point point(x * PRIVACY_MASK_QUANTIZATION, y * PRIVACY_MASK_QUANTIZATION);
-        points.emplace_back(point);
+/**
+ * Merges the regions handed to the DSP down to max_regions, always merging the pair whose union grows the least.
+ * Overlapping regions are merged as well, so no pixel is blended twice.
+ * The DSP blend time follows the area of the regions, so the least area is added to reach the DSP roi count.
+ */
+static std::vector<roi_t> bound_regions(const std::vector<roi_t> &regions, size_t max_regions)
+{
+    // The region each region grows the least with
+    struct partner_t
+    {
+        int64_t growth;
+        uint32_t region;
+    };
 
-        min_x = std::min(min_x, point.x);
-        min_y = std::min(min_y, point.y);
-        max_x = std::max(max_x, point.x);
-        max_y = std::max(max_y, point.y);
+    std::vector<roi_t> merged;
+    for (const roi_t &region : regions)
+    {
+        if (region.width != 0 && region.height != 0)
+            merged.push_back(region);
     }
+    // The greedy search is quadratic in the number of regions, many small regions are first merged by their position
+    if (merged.size() > ROIS_GREEDY_MAX_REGIONS)
+        merged = bucket_regions(merged, ROIS_GREEDY_MAX_REGIONS);
+    size_t count = merged.size();
+    std::vector<bool> alive(count, true);
+    std::vector<partner_t> partners(count);
+    auto find_partner = [&](uint32_t region)
+    {
+        partners[region] = {INT64_MAX, region};
+        for (uint32_t other = 0; other < merged.size(); other++)
+        {
+            if (other == region || !alive[other])
+                continue;
+            int64_t growth = merge_growth(merged[region], merged[other]);
+            if (growth < partners[region].growth)
+                partners[region] = {growth, other};
+        }
+    };
+    for (uint32_t region = 0; region < count; region++)
+        find_partner(region);
 
-    // CLIP min and max to be within the bitmask
-    min_x = std::clamp(min_x, 0, (int)(frame_width * PRIVACY_MASK_QUANTIZATION));
-    min_y = std::clamp(min_y, 0, (int)(frame_height * PRIVACY_MASK_QUANTIZATION));
-    max_x = std::clamp(max_x, 0, (int)(frame_width * PRIVACY_MASK_QUANTIZATION));
-    max_y = std::clamp(max_y, 0, (int)(frame_height * PRIVACY_MASK_QUANTIZATION));
-
-    roi.x = min_x;
-    roi.y = min_y;
-    roi.width = max_x - min_x;
-    roi.height = max_y - min_y;
+    // Partners merged into another region are looked up again only when their region is picked
+    std::vector<bool> stale(count, false);
+    while (count > 1)
+    {
+        uint32_t a = UINT32_MAX;
+        for (uint32_t region = 0; region < merged.size(); region++)
+        {
+            if (alive[region] && (a == UINT32_MAX || partners[region].growth < partners[a].growth))
+                a = region;
+        }
+        if (stale[a])
+        {
+            find_partner(a);
+            stale[a] = false;
+            continue;
+        }
+        uint32_t b = partners[a].region;
+        bool overlapping = partners[a].growth <= 0;
+        if (!overlapping && count <= max_regions)
+            break;
+
+        merged[a] = union_regions(merged[a], merged[b]);
+        alive[b] = false;
+        count--;
+        find_partner(a);
+        // Regions partnered with a merged region need a new partner, the rest might now prefer the union
+        for (uint32_t region = 0; region < merged.size(); region++)
+        {
+            if (region == a || !alive[region])
+                continue;
+            if (partners[region].region == a || partners[region].region == b)
+            {
+                stale[region] = true;
+                continue;
+            }
+            int64_t union_growth = merge_growth(merged[region], merged[a]);
+            if (union_growth < partners[region].growth)
+                partners[region] = {union_growth, a};
+        }
+    }
 
-    return points;
+    std::vector<roi_t> bounded;
+    for (uint32_t region = 0; region < merged.size(); region++)
+    {
+        if (alive[region])
+            bounded.push_back(merged[region]);
+    }
+    return bounded;
 }
 
-static void
-collect_poly_edges(Mat &img, const Point2l *v, int count, std::vector<PolyEdge> &edges,
-                   const void *color, int line_type, int shift, Point offset)
+bool PrivacyMaskEdgeTable::configure(uint frame_width, uint frame_height, uint cell_size)
 {
-    int i, delta = offset.y + ((1 << shift) >> 1);
-    Point2l pt0 = v[count - 1], pt1;
-    pt0.x = (pt0.x + offset.x) << (XY_SHIFT - shift);
-    pt0.y = (pt0.y + delta) >> shift;
+    cell_size = std::max(cell_size, 1u);
+    if (frame_width == m_frame_width && frame_height == m_frame_height && cell_size == m_cell_size)
+        return false;
+
+    m_frame_width = frame_width;
+    m_frame_height = frame_height;
+    m_mask_width = frame_width * PRIVACY_MASK_QUANTIZATION;
+    m_mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+    m_cell_size = cell_size;
+    m_polygons.clear();
+    m_shapes.clear();
+    m_dsp_rois_valid = false;
+    return true;
+}
 
-    edges.reserve(edges.size() + count);
+void PrivacyMaskEdgeTable::build(const std::vector<privacy_mask_types::PolygonPtr> &polygons, const std::vector<privacy_mask_types::dynamic_mask_t> &dynamic_masks,
+                                 uint frame_width, uint frame_height, uint cell_size)
+{
+    configure(frame_width, frame_height, cell_size);
+    // The entries of the polygons kept are reused, so their edge vectors are not allocated again
+    for (const privacy_mask_types::PolygonPtr &polygon : polygons)
+        set_polygon(*polygon);
+    if (m_polygons.size() > polygons.size())
+    {
+        std::unordered_set<std::string_view> ids;
+        for (const privacy_mask_types::PolygonPtr &polygon : polygons)
+            ids.insert(polygon->id);
+        for (auto it = m_polygons.begin(); it != m_polygons.end();)
+            it = ids.count(it->first) ? std::next(it) : m_polygons.erase(it);
+    }
+    set_dynamic_masks(dynamic_masks);
+}
 
-    for (i = 0; i < count; i++, pt0 = pt1)
+void PrivacyMaskEdgeTable::set_polygon(const privacy_mask_types::polygon &polygon)
+{
+    m_dsp_rois_valid = false;
+    roi_t roi;
+    std::vector<mask_point_t> points;
+    quantize_vertices(polygon.vertices, roi, m_frame_width, m_frame_height, &points);
+    if (points.size() < 3)
     {
-        Point2l t0, t1;
-        PolyEdge edge;
+        m_polygons.erase(polygon.id);
+        return;
+    }
 
-        pt1 = v[i];
-        pt1.x = (pt1.x + offset.x) << (XY_SHIFT - shift);
-        pt1.y = (pt1.y + delta) >> shift;
+    polygon_edges_t &entry = m_polygons[polygon.id];
+    entry.edges.clear();
+    entry.cell_spans.clear();
+    entry.cell = get_mask_cell_size(polygon.quantization, m_cell_size);
+    // The bounds include the last row and column of the polygon, and so do the DSP rois when they are whole cells
+    entry.bounds = align_mask_region_to_cells({roi.x, roi.y, roi.width + 1, roi.height + 1}, entry.cell, m_mask_width, m_mask_height);
+    entry.dsp_roi = entry.cell > 1 ? entry.bounds : roi;
 
-        if (line_type < CV_AA)
-        {
-            t0.y = pt0.y;
-            t1.y = pt1.y;
-            t0.x = (pt0.x + (XY_ONE >> 1)) >> XY_SHIFT;
-            t1.x = (pt1.x + (XY_ONE >> 1)) >> XY_SHIFT;
-        }
-        else
+    mask_point_t pt0 = points.back();
+    for (const mask_point_t &pt1 : points)
+    {
+        // Horizontal edges never cross a row center
+        if (pt0.y != pt1.y)
         {
-            t0.x = pt0.x;
-            t1.x = pt1.x;
-            t0.y = pt0.y << XY_SHIFT;
-            t1.y = pt1.y << XY_SHIFT;
+            const mask_point_t &top = pt0.y < pt1.y ? pt0 : pt1;
+            const mask_point_t &bottom = pt0.y < pt1.y ? pt1 : pt0;
+            edge_t edge;
+            edge.y0 = top.y;
+            edge.y1 = bottom.y;
+            edge.x = (int64_t)top.x << XY_SHIFT;
+            edge.dx = (((int64_t)pt1.x - pt0.x) << XY_SHIFT) / (pt1.y - pt0.y);
+            edge.polygon = 0;
+            // Rows beyond the bitmask are never rasterized
+            if (edge.y0 < 0)
+            {
+                edge.x -= edge.y0 * edge.dx;
+                edge.y0 = 0;
+            }
+            if (edge.y1 > edge.y0 && edge.y0 < (int)m_mask_height)
+                entry.edges.push_back(edge);
         }
+        pt0 = pt1;
+    }
 
-        if (pt0.y == pt1.y)
-            continue;
-
-        if (pt0.y < pt1.y)
+    if (entry.cell == 1)
+        return;
+    // A polygon fills every cell between its leftmost and rightmost crossings of the rows of the cell, so no masked pixel is left out.
+    // The spans are kept, so rasterizing the polygon visits no edges
+    int cell = entry.cell;
+    int y_end = entry.bounds.y + entry.bounds.height;
+    for (int y = entry.bounds.y; y < y_end; y += cell)
+    {
+        int last_y = std::min(y + cell, (int)m_mask_height) - 1;
+        int64_t x1 = INT64_MAX;
+        int64_t x2 = INT64_MIN;
+        for (const edge_t &edge : entry.edges)
         {
-            edge.y0 = (int)(pt0.y);
-            edge.y1 = (int)(pt1.y);
-            edge.x = pt0.x;
+            if (edge.y0 > last_y || edge.y1 <= y)
+                continue;
+            // An edge is straight, its crossings of the rows it spans within the row of cells are between its first and last ones
+            int64_t x_first = edge.x + (std::max(y, edge.y0) - edge.y0) * edge.dx;
+            int64_t x_last = edge.x + (std::min(last_y, edge.y1 - 1) - edge.y0) * edge.dx;
+            x1 = std::min(x1, std::min(x_first, x_last));
+            x2 = std::max(x2, std::max(x_first, x_last));
         }
-        else
+        if (x1 > x2)
         {
-            edge.y0 = (int)(pt1.y);
-            edge.y1 = (int)(pt0.y);
-            edge.x = pt1.x;
+            entry.cell_spans.emplace_back(1, 0);
+            continue;
         }
-        edge.dx = (pt1.x - pt0.x) / (pt1.y - pt0.y);
-        edges.push_back(edge);
+        // convert x's from fixed-point to image coordinates
+        x1 = align_down_to_cell((x1 + XY_ONE - 1) >> XY_SHIFT, cell);
+        x2 = align_up_to_cell((x2 >> XY_SHIFT) + 1, cell) - 1;
+        entry.cell_spans.emplace_back(x1, x2);
     }
 }
 
-void scalar_to_raw_data(const Scalar &s, void *_buf, int type, int unroll_to)
+void PrivacyMaskEdgeTable::remove_polygon(const std::string &id)
 {
-    int i, depth = CV_MAT_DEPTH(type), cn = CV_MAT_CN(type);
-    CV_Assert(cn <= 4);
-    switch (depth)
-    {
-    case CV_8U:
+    if (m_polygons.erase(id) > 0)
+        m_dsp_rois_valid = false;
+}
+
+void PrivacyMaskEdgeTable::set_dynamic_masks(const std::vector<privacy_mask_types::dynamic_mask_t> &dynamic_masks)
+{
+    m_dsp_rois_valid = false;
+    m_shapes.clear();
+    // Boxes and ellipses are filled row by row from their bounds, they need no edges
+    for (const privacy_mask_types::dynamic_mask_t &dynamic_mask : dynamic_masks)
     {
-        uchar *buf = (uchar *)_buf;
-        for (i = 0; i < cn; i++)
-            buf[i] = saturate_cast<uchar>(s.val[i]);
-        for (; i < unroll_to; i++)
-            buf[i] = buf[i - cn];
-    }
-    break;
-    default:
-        CV_Error(CV_StsUnsupportedFormat, "");
+        shape_t shape;
+        shape.shape = dynamic_mask.shape;
+        shape.cell = get_mask_cell_size(dynamic_mask.quantization, m_cell_size);
+        quantize_dynamic_mask(dynamic_mask, shape.x0, shape.y0, shape.x1, shape.y1);
+        roi_t roi = clip_mask_region(shape.x0, shape.y0, shape.x1, shape.y1, m_mask_width, m_mask_height);
+        if (roi.width == 0 || roi.height == 0)
+            continue;
+        shape.roi = align_mask_region_to_cells(roi, shape.cell, m_mask_width, m_mask_height);
+        m_shapes.push_back(shape);
     }
 }
 
-void fill_poly_internal(InputOutputArray _img, const Point **pts, const int *npts, int ncontours,
-                        const Scalar &color, int line_type,
-                        int shift, Point offset, uint stride, std::vector<uint8_t> &packaged_array)
+void PrivacyMaskEdgeTable::rasterize(const std::vector<roi_t> &regions, uint8_t *bitmask, uint bytes_per_line) const
 {
+    // Edges of the polygons crossing the current region, sorted by their first row
+    std::vector<edge_t> edges;
+    std::vector<uint32_t> row_offsets;
+    std::vector<const polygon_edges_t *> crossed;
+    std::vector<const edge_t *> active;
+    // (polygon, x) of every active edge at the current row
+    std::vector<std::pair<uint32_t, int64_t>> crossings;
+
+    for (const roi_t &region : regions)
+    {
+        // Widen the region to whole bytes, so it is cleared with memset
+        uint x_begin = region.x & ~7;
+        uint x_end = std::min((region.x + region.width + 7) & ~7, bytes_per_line * 8);
+        int y_begin = region.y;
+        int y_end = std::min(region.y + region.height, m_mask_height);
+        if (x_begin >= x_end || y_begin >= y_end)
+            continue;
 
-    Mat img = _img.getMat();
+        for (int y = y_begin; y < y_end; y++)
+            memset(bitmask + (size_t)y * bytes_per_line + x_begin / 8, 0, (x_end - x_begin) / 8);
 
-    if (line_type == CV_AA && img.depth() != CV_8U)
-        line_type = 8;
+        // Pixels beyond the mask width are padding and stay clear
+        x_end = std::min(x_end, m_mask_width);
+        if (x_begin >= x_end)
+            continue;
+        int64_t clip_x1 = x_begin;
+        int64_t clip_x2 = x_end - 1;
 
-    CV_Assert(pts && npts && ncontours >= 0 && 0 <= shift && shift <= XY_SHIFT);
+        // Only the polygons crossing the region are visited, polygons snapped to larger cells fill their kept spans
+        roi_t clipped = {x_begin, (uint)y_begin, x_end - x_begin, (uint)(y_end - y_begin)};
+        crossed.clear();
+        for (const auto &[id, polygon] : m_polygons)
+        {
+            if (!regions_intersect(polygon.bounds, clipped))
+                continue;
+            if (polygon.cell == 1)
+            {
+                crossed.push_back(&polygon);
+                continue;
+            }
+            int polygon_y_end = std::min<int>(polygon.bounds.y + polygon.bounds.height, y_end);
+            for (int y = std::max<int>(polygon.bounds.y, y_begin); y < polygon_y_end; y++)
+            {
+                const auto &[span_x1, span_x2] = polygon.cell_spans[(y - polygon.bounds.y) / polygon.cell];
+                int64_t x1 = std::max<int64_t>(span_x1, clip_x1);
+                int64_t x2 = std::min<int64_t>(span_x2, clip_x2);
+                if (x1 <= x2)
+                    fill_packaged_array_with_line(bitmask + (size_t)y * bytes_per_line, x1, x2);
+            }
+        }
 
-    double buf[4];
-    scalar_to_raw_data(color, buf, img.type(), 0);
+        // Bucket the edges by the first row of the region they cross, edges starting above the region go first
+        row_offsets.assign(y_end - y_begin + 1, 0);
+        size_t num_of_edges = 0;
+        for (const polygon_edges_t *polygon : crossed)
+        {
+            for (const edge_t &edge : polygon->edges)
+            {
+                if (edge.y0 < y_end && edge.y1 > y_begin)
+                {
+                    row_offsets[std::max(edge.y0 - y_begin, 0) + 1]++;
+                    num_of_edges++;
+                }
+            }
+        }
+        for (size_t row = 1; row < row_offsets.size(); row++)
+            row_offsets[row] += row_offsets[row - 1];
+        edges.resize(num_of_edges);
+        for (uint32_t polygon_index = 0; polygon_index < crossed.size(); polygon_index++)
+        {
+            for (const edge_t &edge : crossed[polygon_index]->edges)
+            {
+                if (edge.y0 < y_end && edge.y1 > y_begin)
+                {
+                    edge_t &bucketed = edges[row_offsets[std::max(edge.y0 - y_begin, 0)]++];
+                    bucketed = edge;
+                    bucketed.polygon = polygon_index;
+                }
+            }
+        }
 
-    std::vector<PolyEdge> edges;
+        active.clear();
+        size_t next = 0;
+        for (int y = y_begin; y < y_end; y++)
+        {
+            for (; next < edges.size() && edges[next].y0 <= y; next++)
+                active.push_back(&edges[next]);
+            active.erase(std::remove_if(active.begin(), active.end(), [y](const edge_t *edge)
+                                        { return edge->y1 <= y; }),
+                         active.end());
+            if (active.empty())
+            {
+                // Skip to the row the next edge starts at
+                if (next == edges.size())
+                    break;
+                y = std::max(y, edges[next].y0 - 1);
+                continue;
+            }
 
-    int i, total = 0;
-    for (i = 0; i < ncontours; i++)
-        total += npts[i];
+            crossings.clear();
+            for (const edge_t *edge : active)
+                crossings.emplace_back(edge->polygon, edge->x + (y - edge->y0) * edge->dx);
+            std::sort(crossings.begin(), crossings.end());
 
-    edges.reserve(total + 1);
-    for (i = 0; i < ncontours; i++)
-    {
-        std::vector<Point2l> _pts(pts[i], pts[i] + npts[i]);
-        collect_poly_edges(img, _pts.data(), npts[i], edges, buf, line_type, shift, offset);
-    }
+            // Each polygon is filled between pairs of its own crossings, overlapping polygons are OR'ed
+            uint8_t *row = bitmask + (size_t)y * bytes_per_line;
+            size_t i = 0;
+            while (i + 1 < crossings.size())
+            {
+                if (crossings[i].first != crossings[i + 1].first)
+                {
+                    i++;
+                    continue;
+                }
+                // convert x's from fixed-point to image coordinates
+                int64_t x1 = std::max((crossings[i].second + XY_ONE - 1) >> XY_SHIFT, clip_x1);
+                int64_t x2 = std::min(crossings[i + 1].second >> XY_SHIFT, clip_x2);
+                i += 2;
+                if (x1 <= x2)
+                    fill_packaged_array_with_line(row, x1, x2);
+            }
+        }
 
-    fill_edge_collection(img, edges, buf, stride, packaged_array);
+        for (const shape_t &shape : m_shapes)
+        {
+            if (!regions_intersect(shape.roi, clipped))
+                continue;
+            // A shape covers whole rows of its cells
+            int cell = shape.cell;
+            int shape_y_begin = std::max(align_down_to_cell(shape.y0, cell), y_begin);
+            int shape_y_end = std::min(align_up_to_cell(shape.y1 + 1, cell), y_end);
+            if (shape_y_begin >= shape_y_end || shape.x1 < clip_x1 || shape.x0 > clip_x2)
+                continue;
+
+            // Ellipse rows are spans around the center, sampled at the row center
+            float center_x = (shape.x0 + shape.x1 + 1) / 2.0f;
+            float center_y = (shape.y0 + shape.y1 + 1) / 2.0f;
+            float radius_x = (shape.x1 - shape.x0 + 1) / 2.0f;
+            float radius_y = (shape.y1 - shape.y0 + 1) / 2.0f;
+            int64_t x1 = 0;
+            int64_t x2 = -1;
+            for (int y = shape_y_begin; y < shape_y_end; y++)
+            {
+                // The span is the same on all the rows of a row of cells
+                int cell_y = align_down_to_cell(y, cell);
+                if (y == shape_y_begin || y == cell_y)
+                {
+                    x1 = shape.x0;
+                    x2 = shape.x1;
+                    if (shape.shape == privacy_mask_types::DYNAMIC_MASK_SHAPE_ELLIPSE)
+                    {
+                        // A row of cells takes the span of its row closest to the center, the widest one
+                        float row_y = std::clamp(center_y, std::max(cell_y, shape.y0) + 0.5f, std::min(cell_y + cell - 1, shape.y1) + 0.5f);
+                        float dy = (row_y - center_y) / radius_y;
+                        float half_width = radius_x * std::sqrt(std::max(0.0f, 1.0f - dy * dy));
+                        x1 = std::max<int64_t>(x1, (int64_t)std::floor(center_x - half_width));
+                        x2 = std::min<int64_t>(x2, (int64_t)std::ceil(center_x + half_width) - 1);
+                    }
+                    if (cell > 1)
+                    {
+                        x1 = align_down_to_cell(x1, cell);
+                        x2 = align_up_to_cell(x2 + 1, cell) - 1;
+                    }
+                    x1 = std::max(x1, clip_x1);
+                    x2 = std::min(x2, clip_x2);
+                }
+                if (x1 <= x2)
+                    fill_packaged_array_with_line(bitmask + (size_t)y * bytes_per_line, x1, x2);
+            }
+        }
+    }
 }
 
-media_library_return fill_poly_packaged_array(InputOutputArray img, InputArrayOfArrays pts,
-                                              const Scalar &color, int lineType, int shift, uint stride, std::vector<uint8_t> &packaged_array)
+const std::vector<roi_t> &PrivacyMaskEdgeTable::get_dsp_rois() const
 {
-
-    bool manyContours = pts.kind() == _InputArray::STD_VECTOR_VECTOR ||
-                        pts.kind() == _InputArray::STD_VECTOR_MAT;
-    int i, ncontours = manyContours ? (int)pts.total() : 1;
-    if (ncontours == 0)
-        return media_library_return::MEDIA_LIBRARY_SUCCESS;
-    AutoBuffer<Point *> _ptsptr(ncontours);
-    AutoBuffer<int> _npts(ncontours);
-    Point **ptsptr = _ptsptr.data();
-    int *npts = _npts.data();
-
-    for (i = 0; i < ncontours; i++)
+    if (!m_dsp_rois_valid)
     {
-        Mat p = pts.getMat(manyContours ? i : -1);
-        CV_Assert(p.checkVector(2, CV_32S) >= 0);
-        ptsptr[i] = p.ptr<Point>();
-        npts[i] = p.rows * p.cols * p.channels() / 2;
+        std::vector<roi_t> rois;
+        rois.reserve(m_polygons.size() + m_shapes.size());
+        for (const auto &[id, polygon] : m_polygons)
+            rois.push_back(polygon.dsp_roi);
+        for (const shape_t &shape : m_shapes)
+            rois.push_back(shape.roi);
+        m_dsp_rois = bound_regions(rois, MAX_NUM_OF_PRIVACY_MASK_ROIS);
+        m_dsp_rois_valid = true;
     }
-    fill_poly_internal(img, (const Point **)ptsptr, npts, (int)ncontours, color, lineType, shift, Point(), stride, packaged_array);
-    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+    return m_dsp_rois;
+}
+
+size_t PrivacyMaskEdgeTable::get_num_of_edges() const
+{
+    size_t num_of_edges = 0;
+    for (const auto &[id, polygon] : m_polygons)
+        num_of_edges += polygon.edges.size();
+    return num_of_edges;
+}
+
+uint PrivacyMaskEdgeTable::get_cell_size() const
+{
+    return m_cell_size;
 }
 
 privacy_mask_types::yuv_color_t rgb_to_yuv(const privacy_mask_types::rgb_color_t &rgb_color)
@@ -464,58 +733,312 @@ media_library_return rotate_polygons(std::vector<privacy_mask_types::PolygonPtr>
     return media_library_return::MEDIA_LIBRARY_SUCCESS;
 }
 
-media_library_return write_polygons_to_privacy_mask_data(std::vector<privacy_mask_types::PolygonPtr> &polygons, const uint &frame_width, const uint &frame_height, const privacy_mask_types::rgb_color_t &color, privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data)
+roi_t get_polygon_mask_roi(const privacy_mask_types::polygon &polygon, const uint &frame_width, const uint &frame_height)
 {
-    struct timespec start_fill_polly, end_fill_polly;
-    clock_gettime(CLOCK_MONOTONIC, &start_fill_polly);
+    roi_t roi;
+    quantize_vertices(polygon.vertices, roi, frame_width, frame_height, nullptr);
+    return roi;
+}
 
-    // Quantize the frame size
-    int mask_width = frame_width * PRIVACY_MASK_QUANTIZATION;
-    int mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+roi_t get_polygon_dirty_region(const privacy_mask_types::polygon &polygon, const uint &frame_width, const uint &frame_height, uint cell_size)
+{
+    // The fill includes the last row and column of the bounding box
+    roi_t roi = get_polygon_mask_roi(polygon, frame_width, frame_height);
+    roi.width += 1;
+    roi.height += 1;
+    return align_mask_region_to_cells(roi, get_mask_cell_size(polygon.quantization, cell_size),
+                                      frame_width * PRIVACY_MASK_QUANTIZATION, frame_height * PRIVACY_MASK_QUANTIZATION);
+}
+
+roi_t rotate_mask_roi(const roi_t &roi, const rotation_angle_t &rotation, const uint &mask_width, const uint &mask_height)
+{
+    // Rotations are clockwise, the same as rotate_polygon
+    uint right = std::min(roi.x + roi.width, mask_width);
+    uint bottom = std::min(roi.y + roi.height, mask_height);
+    switch (rotation)
+    {
+    case ROTATION_ANGLE_90:
+        return {mask_height - bottom, roi.x, roi.height, roi.width};
+    case ROTATION_ANGLE_180:
+        return {mask_width - right, mask_height - bottom, roi.width, roi.height};
+    case ROTATION_ANGLE_270:
+        return {roi.y, mask_width - right, roi.height, roi.width};
+    default:
+        return roi;
+    }
+}
 
-    // Initialize a matrix of zeros
-    Mat mask = Mat::zeros(Size(mask_width, mask_height), CV_8UC1);
-    auto white = Scalar(255, 255, 255);
+/**
+ * Loads the 8 pixels of a bitmask row ending 8 * i pixels before the end of the row.
+ *
+ * @param row The row, nullptr for a row outside of the bitmask.
+ * @param i The index of the pixels counted from the end of the row, less than row_bytes.
+ * @param row_bytes The number of bytes holding the pixels of the row.
+ * @param shift The number of padding pixels in the last byte of the row.
+ */
+static inline uint8_t load_mask_byte_from_end(const uint8_t *row, uint i, uint row_bytes, uint shift)
+{
+    if (row == nullptr)
+        return 0;
+    uint8_t high = i + 1 < row_bytes ? row[row_bytes - 2 - i] : 0;
+    return (uint8_t)((high << (8 - shift)) | (row[row_bytes - 1 - i] >> shift));
+}
 
-    // Round up frame_width to byte_size / quantization (32)
-    int line_division = 8 / PRIVACY_MASK_QUANTIZATION;
-    int bytes_per_line = (frame_width/line_division + 7) & ~7;
-    // Handle padding (aligned to 8)
-    int mask_width_with_stride = bytes_per_line*8;
+static inline uint8_t reverse_byte(uint8_t b)
+{
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
 
-    // To represent a bit per pixel structure - set packaged array size to /8 and add one if it is not a multiple of 8
-    uint packaged_array_size = (mask_width_with_stride * mask_height) / 8 + ((mask_width_with_stride * mask_height) % 8 == 0 ? 0 : 1);
-    std::vector<uint8_t> packaged_array(packaged_array_size, 0);
+/**
+ * Transposes an 8x8 bit block - bit k of output row j is bit j of input row k (bits counted from the MSB).
+ */
+static inline void transpose_mask_block(const uint8_t in[8], uint8_t out[8])
+{
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++)
+        x = (x << 8) | in[i];
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    for (int i = 7; i >= 0; i--)
+    {
+        out[i] = x & 0xFF;
+        x >>= 8;
+    }
+}
 
-    // Set the rois count and YUV color in the privacy mask data
-    privacy_mask_data->rois_count = polygons.size();
-    privacy_mask_data->color = rgb_to_yuv(color);
+void rotate_privacy_mask_regions(const uint8_t *src, uint src_bytes_per_line, uint mask_width, uint mask_height,
+                                 const rotation_angle_t &rotation, const std::vector<roi_t> &regions,
+                                 uint8_t *dst, uint dst_bytes_per_line)
+{
+    bool transposed = rotation == ROTATION_ANGLE_90 || rotation == ROTATION_ANGLE_270;
+    int dst_height = transposed ? mask_width : mask_height;
+    int src_height = mask_height;
+    // The rows are read backwards from their last pixel, which does not have to end a byte
+    uint row_bytes = (mask_width + 7) / 8;
+    uint shift = row_bytes * 8 - mask_width;
+    auto src_row = [&](int y) -> const uint8_t *
+    {
+        return (y >= 0 && y < src_height) ? src + (size_t)y * src_bytes_per_line : nullptr;
+    };
 
-    uint i = 0;
-    for (const auto &polygon : polygons)
+    for (const roi_t &region : regions)
     {
-        std::vector<Point> pts = convert_vertices_to_points(polygon->vertices, privacy_mask_data->rois[i], frame_width, frame_height);
+        roi_t rotated = rotate_mask_roi(region, rotation, mask_width, mask_height);
+        // Whole destination bytes are recomputed from the source, and whole 8 row blocks when transposing
+        int bx_begin = rotated.x / 8;
+        int bx_end = std::min((rotated.x + rotated.width + 7) / 8, dst_bytes_per_line);
+        int y_begin = transposed ? rotated.y & ~7 : rotated.y;
+        int y_end = std::min((int)(rotated.y + rotated.height), dst_height);
+
+        if (!transposed)
+        {
+            for (int y = y_begin; y < y_end; y++)
+            {
+                const uint8_t *row = src_row(src_height - 1 - y);
+                uint8_t *out = dst + (size_t)y * dst_bytes_per_line;
+                for (int bx = bx_begin; bx < bx_end; bx++)
+                    out[bx] = (uint)bx < row_bytes ? reverse_byte(load_mask_byte_from_end(row, bx, row_bytes, shift)) : 0;
+            }
+            continue;
+        }
 
-        if (fill_poly_packaged_array(mask, pts, white, 8, 0, mask_width_with_stride, packaged_array) != media_library_return::MEDIA_LIBRARY_SUCCESS)
+        uint8_t block[8], transposed_block[8];
+        for (int y = y_begin; y < y_end; y += 8)
         {
-            LOGGER__ERROR("Failed to fill polygon");
-            return media_library_return::MEDIA_LIBRARY_ERROR;
+            int rows = std::min(8, y_end - y);
+            uint src_byte = y / 8;
+            for (int bx = bx_begin; bx < bx_end; bx++)
+            {
+                // Destination column bx * 8 + k is a source row, read across 8 destination rows
+                if (rotation == ROTATION_ANGLE_90)
+                {
+                    for (int k = 0; k < 8; k++)
+                    {
+                        const uint8_t *row = src_row(src_height - 1 - (bx * 8 + k));
+                        block[k] = row != nullptr ? row[src_byte] : 0;
+                    }
+                }
+                else
+                {
+                    for (int k = 0; k < 8; k++)
+                        block[k] = load_mask_byte_from_end(src_row(bx * 8 + k), src_byte, row_bytes, shift);
+                }
+                transpose_mask_block(block, transposed_block);
+                uint8_t *out = dst + (size_t)y * dst_bytes_per_line + bx;
+                for (int j = 0; j < rows; j++)
+                    out[(size_t)j * dst_bytes_per_line] = transposed_block[rotation == ROTATION_ANGLE_90 ? j : 7 - j];
+            }
         }
-        i++;
     }
+}
+
+media_library_return write_privacy_mask_rois(const PrivacyMaskEdgeTable &edge_table, const privacy_mask_types::rgb_color_t &color,
+                                             privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data)
+{
+    // The rois cover little more than the masks, so the DSP blend cost follows the masked area
+    const std::vector<roi_t> &rois = edge_table.get_dsp_rois();
+    privacy_mask_data->rois_count = rois.size();
+    privacy_mask_data->color = rgb_to_yuv(color);
+    std::copy(rois.begin(), rois.end(), privacy_mask_data->rois);
+
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
 
-    if (privacy_mask_data->bitmask.hailo_pix_buffer->planes[0].bytesused != packaged_array_size)
+media_library_return write_polygons_to_privacy_mask_data(const PrivacyMaskEdgeTable &edge_table, const uint &frame_width, const uint &frame_height,
+                                                         const privacy_mask_types::rgb_color_t &color, privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data)
+{
+    struct timespec start_fill_polly, end_fill_polly;
+    clock_gettime(CLOCK_MONOTONIC, &start_fill_polly);
+
+    // Round up frame_width to byte_size / quantization (32), and the line to be aligned to 8 bytes
+    int line_division = 8 / PRIVACY_MASK_QUANTIZATION;
+    uint bytes_per_line = (frame_width / line_division + 7) & ~7;
+    uint mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+
+    if (privacy_mask_data->bitmask.get_plane_size(0) != bytes_per_line * mask_height)
     {
         LOGGER__ERROR("Failed to fill polygon - privacy mask buffer size is not equal to the packaged array size");
         return media_library_return::MEDIA_LIBRARY_ERROR;
     }
-    // memcopy packaged array to privacy_mask_data void pointer bit mask
-    memcpy(privacy_mask_data->bitmask.get_plane(0), packaged_array.data(), packaged_array_size);
+
+    write_privacy_mask_rois(edge_table, color, privacy_mask_data);
+
+    // Rasterize straight into the bitmask buffer
+    edge_table.rasterize({{0, 0, bytes_per_line * 8, mask_height}}, (uint8_t *)privacy_mask_data->bitmask.get_plane(0), bytes_per_line);
 
     clock_gettime(CLOCK_MONOTONIC, &end_fill_polly);
     [[maybe_unused]] long ms = (long)media_library_difftimespec_ms(end_fill_polly, start_fill_polly);
-    LOGGER__DEBUG("perform fill polygon took {} milliseconds ({} fps)", ms, (1000 / ms));
-
+    LOGGER__DEBUG("perform fill polygon took {} milliseconds", ms);
 
     return media_library_return::MEDIA_LIBRARY_SUCCESS;
-}
\ No newline at end of file
+}
+
+/**
+ * Checks whether any bit of a cell is set.
+ * A rotated bitmask is not aligned to the cell grid, so the cells can be partially masked.
+ */
+static bool cell_is_masked(const uint8_t *bitmask, uint bytes_per_line, int x_begin, int y_begin, int x_end, int y_end)
+{
+    for (int y = y_begin; y < y_end; y++)
+    {
+        const uint8_t *row = bitmask + (size_t)y * bytes_per_line;
+        for (int x = x_begin; x < x_end; x++)
+        {
+            if (row[x / 8] & (0x80 >> (x % 8)))
+                return true;
+        }
+    }
+    return false;
+}
+
+roi_t get_pixelation_region(const roi_t *rois, uint rois_count, uint cell_size, uint frame_width, uint frame_height)
+{
+    int mask_width = frame_width * PRIVACY_MASK_QUANTIZATION;
+    int mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+    int cell = std::max(cell_size, 1u);
+    int x_begin = mask_width, y_begin = mask_height, x_end = 0, y_end = 0;
+    for (uint i = 0; i < rois_count; i++)
+    {
+        x_begin = std::min(x_begin, align_down_to_cell(rois[i].x, cell));
+        y_begin = std::min(y_begin, align_down_to_cell(rois[i].y, cell));
+        x_end = std::max(x_end, align_up_to_cell(rois[i].x + rois[i].width + 1, cell));
+        y_end = std::max(y_end, align_up_to_cell(rois[i].y + rois[i].height + 1, cell));
+    }
+    if (x_begin >= x_end || y_begin >= y_end)
+        return {0, 0, 0, 0};
+
+    // NV12 crops start and end on even pixels, cells are at least 4x4 pixels
+    uint x0 = x_begin / PRIVACY_MASK_QUANTIZATION;
+    uint y0 = y_begin / PRIVACY_MASK_QUANTIZATION;
+    uint x1 = std::min<uint>(x_end / PRIVACY_MASK_QUANTIZATION, frame_width) & ~1u;
+    uint y1 = std::min<uint>(y_end / PRIVACY_MASK_QUANTIZATION, frame_height) & ~1u;
+    if (x0 >= x1 || y0 >= y1)
+        return {0, 0, 0, 0};
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+/**
+ * Maps the frame span [begin, end) to the output pixels sampled from it.
+ * Output pixel o is scaled from frame pixel crop_start + o * crop_size / output_size.
+ */
+static std::pair<uint, uint> map_span_to_output(uint begin, uint end, uint crop_start, uint crop_size, uint output_size)
+{
+    int64_t first = std::clamp<int64_t>((int64_t)begin - crop_start, 0, crop_size);
+    int64_t last = std::clamp<int64_t>((int64_t)end - crop_start, 0, crop_size);
+    return {(uint)((first * output_size + crop_size - 1) / crop_size), (uint)((last * output_size + crop_size - 1) / crop_size)};
+}
+
+void fill_pixelated_cells(const uint8_t *bitmask, uint bytes_per_line, const roi_t *rois, uint rois_count, uint cell_size,
+                          const roi_t &region, const uint8_t *cells_y, uint cells_y_stride, const uint8_t *cells_uv, uint cells_uv_stride,
+                          uint frame_width, uint frame_height, const roi_t &crop,
+                          uint8_t *y_plane, uint y_stride, uint8_t *uv_plane, uint uv_stride,
+                          uint output_width, uint output_height)
+{
+    int mask_width = frame_width * PRIVACY_MASK_QUANTIZATION;
+    int mask_height = frame_height * PRIVACY_MASK_QUANTIZATION;
+    int cell = std::max(cell_size, 1u);
+    uint cell_pixels = cell / PRIVACY_MASK_QUANTIZATION;
+    if (crop.width == 0 || crop.height == 0 || region.width == 0 || region.height == 0)
+        return;
+
+    for (uint i = 0; i < rois_count; i++)
+    {
+        const roi_t &roi = rois[i];
+        int x_begin = align_down_to_cell(roi.x, cell);
+        int y_begin = align_down_to_cell(roi.y, cell);
+        int x_end = std::min((int)(roi.x + roi.width + 1), mask_width);
+        int y_end = std::min((int)(roi.y + roi.height + 1), mask_height);
+        for (int mask_y = y_begin; mask_y < y_end; mask_y += cell)
+        {
+            uint y0 = mask_y / PRIVACY_MASK_QUANTIZATION;
+            if (y0 < region.y || y0 >= region.y + region.height)
+                continue;
+            auto [output_y0, output_y1] = map_span_to_output(y0, std::min(y0 + cell_pixels, frame_height), crop.y, crop.height, output_height);
+            if (output_y0 >= output_y1)
+                continue;
+            // The cell row in the downscaled region, each cell is 2x2 luma pixels and one chroma pair
+            uint cell_row = (y0 - region.y) / cell_pixels;
+            const uint8_t *cells_y_row = cells_y + (size_t)cell_row * 2 * cells_y_stride;
+            const uint8_t *cells_uv_row = cells_uv + (size_t)cell_row * cells_uv_stride;
+
+            for (int mask_x = x_begin; mask_x < x_end; mask_x += cell)
+            {
+                uint x0 = mask_x / PRIVACY_MASK_QUANTIZATION;
+                if (x0 < region.x || x0 >= region.x + region.width)
+                    continue;
+                auto [output_x0, output_x1] = map_span_to_output(x0, std::min(x0 + cell_pixels, frame_width), crop.x, crop.width, output_width);
+                if (output_x0 >= output_x1 ||
+                    !cell_is_masked(bitmask, bytes_per_line, mask_x, mask_y, std::min(mask_x + cell, mask_width), std::min(mask_y + cell, mask_height)))
+                    continue;
+
+                uint cell_column = (x0 - region.x) / cell_pixels * 2;
+                uint y_sum = cells_y_row[cell_column] + cells_y_row[cell_column + 1] +
+                             cells_y_row[cells_y_stride + cell_column] + cells_y_row[cells_y_stride + cell_column + 1];
+                uint8_t y_value = (y_sum + 2) / 4;
+                uint8_t u_value = cells_uv_row[cell_column];
+                uint8_t v_value = cells_uv_row[cell_column + 1];
+
+                for (uint y = output_y0; y < output_y1; y++)
+                    memset(y_plane + (size_t)y * y_stride + output_x0, y_value, output_x1 - output_x0);
+                // A chroma pair belongs to the cell of its top left luma pixel
+                for (uint y = (output_y0 + 1) / 2; y < (output_y1 + 1) / 2; y++)
+                {
+                    uint8_t *uv_row = uv_plane + (size_t)y * uv_stride;
+                    for (uint x = (output_x0 + 1) / 2; x < (output_x1 + 1) / 2; x++)
+                    {
+                        uv_row[2 * x] = u_value;
+                        uv_row[2 * x + 1] = v_value;
+                    }
+                }
+            }
+        }
+    }
+}
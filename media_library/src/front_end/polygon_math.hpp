@@ -28,26 +28,145 @@
 #pragma once
 #include "media_library_types.hpp"
 #include "privacy_mask_types.hpp"
+#include <map>
+#include <string>
 
 #define PRIVACY_MASK_QUANTIZATION (0.25)
 
+/**
+ * @brief Scanline edge table of all the privacy mask polygons, updated mask by mask.
+ * 
+ * The edges of each polygon are kept with its bounds, so an update only quantizes the masks that changed,
+ * and rasterizing a region only visits the edges of the masks crossing it.
+ * The rasterization cost follows the masked area rather than the number of polygons.
+ * Each mask is snapped to cells of its own quantization, a polygon with cells larger than a bitmask pixel
+ * keeps the span of each row of its cells instead of visiting its edges.
+ */
+class PrivacyMaskEdgeTable
+{
+public:
+    /**
+     * @brief Sets the bitmask the masks are rasterized into. Drops all the masks if it changed.
+     * 
+     * @param frame_width The width of the frame.
+     * @param frame_height The height of the frame.
+     * @param cell_size Size in bitmask pixels of the square cells the masks without their own quantization
+     *                  are snapped to (a power of two).
+     * @return true if the bitmask changed and the masks were dropped.
+     */
+    bool configure(uint frame_width, uint frame_height, uint cell_size = 1);
+
+    /**
+     * @brief Builds the table from all the polygons and the dynamic masks.
+     * 
+     * @param polygons Vector of all the polygons of the mask.
+     * @param dynamic_masks Vector of the boxes and ellipses of the mask.
+     * @param frame_width The width of the frame.
+     * @param frame_height The height of the frame.
+     * @param cell_size Size in bitmask pixels of the cells of the masks without their own quantization, see configure.
+     */
+    void build(const std::vector<privacy_mask_types::PolygonPtr> &polygons, const std::vector<privacy_mask_types::dynamic_mask_t> &dynamic_masks,
+               uint frame_width, uint frame_height, uint cell_size = 1);
+
+    /**
+     * @brief Adds a polygon, or replaces the edges of the polygon with the same id.
+     */
+    void set_polygon(const privacy_mask_types::polygon &polygon);
+
+    /**
+     * @brief Removes the edges of the polygon with the given id, if it is in the table.
+     */
+    void remove_polygon(const std::string &id);
+
+    /**
+     * @brief Replaces all the boxes and ellipses.
+     */
+    void set_dynamic_masks(const std::vector<privacy_mask_types::dynamic_mask_t> &dynamic_masks);
+
+    /**
+     * @brief Re-rasterizes regions of the packed bitmask in place.
+     * 
+     * Each region is widened to whole bytes and cleared, then filled with the polygons and dynamic masks clipped to it.
+     * Bits outside of the regions are not touched, the regions of changed masks must cover their whole cells
+     * (see get_polygon_dirty_region).
+     * 
+     * @param regions The regions to re-rasterize, in bitmask coordinates.
+     * @param bitmask The packed bitmask.
+     * @param bytes_per_line The stride of the packed bitmask.
+     */
+    void rasterize(const std::vector<roi_t> &regions, uint8_t *bitmask, uint bytes_per_line) const;
+
+    /**
+     * @brief Get the rois passed to the DSP - the masks bounding boxes, merged down to at most
+     * MAX_NUM_OF_PRIVACY_MASK_ROIS while adding the least area to blend.
+     */
+    const std::vector<roi_t> &get_dsp_rois() const;
+
+    size_t get_num_of_edges() const;
+
+    uint get_cell_size() const;
+
+private:
+    struct edge_t
+    {
+        int y0, y1;
+        // fixed-point x at row y0, and its step per row
+        int64_t x, dx;
+        uint32_t polygon;
+    };
+
+    // The edges of a polygon, and the bitmask region they are rasterized into
+    struct polygon_edges_t
+    {
+        std::vector<edge_t> edges;
+        roi_t bounds;
+        roi_t dsp_roi;
+        // Size of the cells the polygon is snapped to
+        int cell;
+        // Inclusive span of each row of cells from the top of the bounds, only when the cells are larger than a pixel
+        std::vector<std::pair<int, int>> cell_spans;
+    };
+
+    // A dynamic mask in bitmask coordinates, bounds are inclusive
+    struct shape_t
+    {
+        privacy_mask_types::dynamic_mask_shape_t shape;
+        int x0, y0, x1, y1;
+        roi_t roi;
+        // Size of the cells the shape is snapped to
+        int cell;
+    };
+
+    // Ordered by id, so the DSP rois do not depend on the order of the updates
+    std::map<std::string, polygon_edges_t> m_polygons;
+    std::vector<shape_t> m_shapes;
+    // Merged from the polygons and shapes rois when they are first asked for after an update
+    mutable std::vector<roi_t> m_dsp_rois;
+    mutable bool m_dsp_rois_valid = false;
+    uint m_frame_width = 0;
+    uint m_frame_height = 0;
+    uint m_mask_width = 0;
+    uint m_mask_height = 0;
+    // Size of the cells of the masks without their own quantization
+    uint m_cell_size = 1;
+};
+
 /**
  * @brief Fills a privacy mask data structure with polygons.
  * 
- * The target is to represent the binary image as a vector of bytes (packaged_array),
+ * The target is to represent the binary image as a packed bitmask,
  * Where each pixel represents 4 pixels in the original image,
  * and each byte in memory (uint8) contains 8 pixels
- * Then it is copied into void* bitmask, this way it can be send to the HailoDSP later.
- * 
- * We use the OpenCV fillPoly functionality to fill the bitmask using Scanline Fill Algorithm.
+ * The polygons are rasterized straight into the bitmask buffer, this way it can be send to the HailoDSP later.
  * 
- * @param polygons Vector of polygons to fill.
+ * @param edge_table Edge table of the polygons to fill.
  * @param frame_width The width of the frame.
  * @param frame_height The height of the frame.
  * @param color The color of the polygons (RGB).
  * @param privacy_mask_data The privacy mask data structure to fill.
  */
-media_library_return write_polygons_to_privacy_mask_data(std::vector<privacy_mask_types::PolygonPtr> &polygons, const uint &frame_width, const uint &frame_height, const privacy_mask_types::rgb_color_t &color, privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data);
+media_library_return write_polygons_to_privacy_mask_data(const PrivacyMaskEdgeTable &edge_table, const uint &frame_width, const uint &frame_height,
+                                                         const privacy_mask_types::rgb_color_t &color, privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data);
 
 /**
  * @brief Rotates a vector of polygons.
@@ -64,3 +183,113 @@ media_library_return rotate_polygons(std::vector<privacy_mask_types::PolygonPtr>
  * @param rotation_angle The rotation angle.
 */
 media_library_return rotate_polygon(privacy_mask_types::PolygonPtr polygon, double rotation_angle, uint frame_width, uint frame_height);
+
+
+/**
+ * @brief Get the bounding box of a polygon in bitmask coordinates, clipped to the bitmask.
+ */
+roi_t get_polygon_mask_roi(const privacy_mask_types::polygon &polygon, const uint &frame_width, const uint &frame_height);
+
+/**
+ * @brief Get the bitmask region a polygon is rasterized into - its bounding box including the last row and column,
+ * widened to the cells of the polygon.
+ * 
+ * @param cell_size Size in bitmask pixels of the cells of the masks without their own quantization.
+ */
+roi_t get_polygon_dirty_region(const privacy_mask_types::polygon &polygon, const uint &frame_width, const uint &frame_height,
+                               uint cell_size = 1);
+
+/**
+ * @brief Get the bitmask region a dynamic mask is rasterized into, widened to its cells and clipped to the bitmask.
+ * 
+ * @param cell_size Size in bitmask pixels of the cells of the masks without their own quantization.
+ */
+roi_t get_dynamic_mask_dirty_region(const privacy_mask_types::dynamic_mask_t &dynamic_mask, const uint &frame_width, const uint &frame_height,
+                                    uint cell_size = 1);
+
+/**
+ * @brief Merges overlapping dirty regions, so no bitmask pixel is rasterized twice.
+ */
+std::vector<roi_t> merge_dirty_regions(const std::vector<roi_t> &regions);
+
+/**
+ * @brief Rotates a bitmask roi clockwise, the same way the frame is rotated.
+ * 
+ * @param roi The roi in bitmask coordinates of the unrotated frame.
+ * @param rotation The rotation angle.
+ * @param mask_width The width of the unrotated bitmask.
+ * @param mask_height The height of the unrotated bitmask.
+ */
+roi_t rotate_mask_roi(const roi_t &roi, const rotation_angle_t &rotation, const uint &mask_width, const uint &mask_height);
+
+/**
+ * @brief Copies regions of a packed bitmask into a rotated packed bitmask.
+ * 
+ * The bits are transposed 8x8 at a time, so a rotation change does not rasterize the polygons again.
+ * Bits of the destination outside of the rotated regions are not touched.
+ * 
+ * @param src The bitmask of the unrotated frame.
+ * @param src_bytes_per_line The stride of the unrotated bitmask.
+ * @param mask_width The width of the unrotated bitmask in pixels.
+ * @param mask_height The height of the unrotated bitmask in pixels.
+ * @param rotation The rotation angle (clockwise).
+ * @param regions The regions to copy, in unrotated bitmask coordinates.
+ * @param dst The rotated bitmask.
+ * @param dst_bytes_per_line The stride of the rotated bitmask.
+ */
+void rotate_privacy_mask_regions(const uint8_t *src, uint src_bytes_per_line, uint mask_width, uint mask_height,
+                                 const rotation_angle_t &rotation, const std::vector<roi_t> &regions,
+                                 uint8_t *dst, uint dst_bytes_per_line);
+
+/**
+ * @brief Sets the rois and the YUV color of a privacy mask data structure, without touching its bitmask.
+ */
+media_library_return write_privacy_mask_rois(const PrivacyMaskEdgeTable &edge_table, const privacy_mask_types::rgb_color_t &color,
+                                             privacy_mask_types::PrivacyMaskDataPtr privacy_mask_data);
+
+/**
+ * @brief Get the frame region the pixelated cells are averaged from.
+ * 
+ * The region starts at a cell and is clipped to the frame, the DSP downscales it to 2x2 pixels per cell
+ * so each cell gets its average Y and a single UV.
+ * 
+ * @param rois The rois of the bitmask.
+ * @param rois_count The number of rois.
+ * @param cell_size Size of the pixelation cells in bitmask pixels.
+ * @param frame_width The width of the frame.
+ * @param frame_height The height of the frame.
+ * @return roi_t The region in frame pixels, empty if there are no rois.
+ */
+roi_t get_pixelation_region(const roi_t *rois, uint rois_count, uint cell_size, uint frame_width, uint frame_height);
+
+/**
+ * @brief Fills the masked cells of an NV12 output frame with the average colors of their cells.
+ * 
+ * The output is the crop of the frame scaled to the output size, as the multi resize makes it.
+ * The frame itself is not written, only the masked cells of the output are.
+ * 
+ * @param bitmask The packed bitmask of the frame.
+ * @param bytes_per_line The stride of the packed bitmask.
+ * @param rois The rois of the bitmask, only cells inside them are checked.
+ * @param rois_count The number of rois.
+ * @param cell_size Size of the pixelation cells in bitmask pixels.
+ * @param region The region returned by get_pixelation_region.
+ * @param cells_y The luma plane of the region downscaled to 2x2 pixels per cell.
+ * @param cells_y_stride The stride of the downscaled luma plane.
+ * @param cells_uv The chroma plane of the region downscaled to 2x2 pixels per cell.
+ * @param cells_uv_stride The stride of the downscaled chroma plane.
+ * @param frame_width The width of the frame.
+ * @param frame_height The height of the frame.
+ * @param crop The crop of the frame the output is scaled from, in frame pixels.
+ * @param y_plane The luma plane of the output.
+ * @param y_stride The stride of the output luma plane.
+ * @param uv_plane The interleaved chroma plane of the output, at half the resolution of the luma plane.
+ * @param uv_stride The stride of the output chroma plane.
+ * @param output_width The width of the output.
+ * @param output_height The height of the output.
+ */
+void fill_pixelated_cells(const uint8_t *bitmask, uint bytes_per_line, const roi_t *rois, uint rois_count, uint cell_size,
+                          const roi_t &region, const uint8_t *cells_y, uint cells_y_stride, const uint8_t *cells_uv, uint cells_uv_stride,
+                          uint frame_width, uint frame_height, const roi_t &crop,
+                          uint8_t *y_plane, uint y_stride, uint8_t *uv_plane, uint uv_stride,
+                          uint output_width, uint output_height);
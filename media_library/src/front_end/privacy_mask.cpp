@@ -25,47 +25,82 @@
 #include "media_library_logger.hpp"
 #include "polygon_math.hpp"
 #include <tl/expected.hpp>
+#include <cstring>
 
 using namespace privacy_mask_types;
 
 PrivacyMaskBlender::PrivacyMaskBlender()
 {
   m_privacy_masks.reserve(MAX_NUM_OF_PRIVACY_MASKS);
+  m_edge_table = std::make_shared<PrivacyMaskEdgeTable>();
 
   // Black color for default
   m_color = {0, 0, 0};
   m_frame_width = 0;
   m_frame_height = 0;
+  m_rotation = ROTATION_ANGLE_0;
+  m_frame_rotation = ROTATION_ANGLE_0;
+  m_mode = PRIVACY_MASK_MODE_COLOR;
+  m_quantization = PRIVACY_MASK_MIN_QUANTIZATION;
   m_privacy_mask_mutex = std::make_shared<std::mutex>();
 
   m_buffer_pool = NULL;
+  m_rotated_buffer_pool = NULL;
+  m_pixelation_buffer_pool = NULL;
+  m_pixelation_cells_image = {};
+  m_pixelation_region = {0, 0, 0, 0};
+  m_pixelation_cell_size = 0;
+  m_pixelation_frame_width = 0;
+  m_pixelation_frame_height = 0;
+  m_pixelation_mask_data = NULL;
   m_update_required = true;
+  m_full_update_required = true;
+  m_rotated_full_update_required = true;
   m_latest_privacy_mask_data = NULL;
+  m_rotated_privacy_mask_data = NULL;
+  m_dynamic_masks_frame_id = 0;
+  m_dynamic_masks_frame_id_valid = false;
+  m_dynamic_masks_changed = true;
 }
 
 PrivacyMaskBlender::PrivacyMaskBlender(uint frame_width, uint frame_height)
 {
 
   m_privacy_masks.reserve(MAX_NUM_OF_PRIVACY_MASKS);
+  m_edge_table = std::make_shared<PrivacyMaskEdgeTable>();
 
   // Black color for default
   m_color = {0, 0, 0};
-  m_frame_width = frame_width;
-  m_frame_height = frame_height;
+  m_frame_width = 0;
+  m_frame_height = 0;
+  m_rotation = ROTATION_ANGLE_0;
+  m_frame_rotation = ROTATION_ANGLE_0;
+  m_mode = PRIVACY_MASK_MODE_COLOR;
+  m_quantization = PRIVACY_MASK_MIN_QUANTIZATION;
   m_privacy_mask_mutex = std::make_shared<std::mutex>();
+  m_buffer_pool = NULL;
+  m_rotated_buffer_pool = NULL;
+  m_pixelation_buffer_pool = NULL;
+  m_pixelation_cells_image = {};
+  m_pixelation_region = {0, 0, 0, 0};
+  m_pixelation_cell_size = 0;
+  m_pixelation_frame_width = 0;
+  m_pixelation_frame_height = 0;
+  m_pixelation_mask_data = NULL;
+  m_latest_privacy_mask_data = NULL;
+  m_rotated_privacy_mask_data = NULL;
+  m_dynamic_masks_frame_id = 0;
+  m_dynamic_masks_frame_id_valid = false;
+  m_dynamic_masks_changed = true;
 
   set_frame_size(frame_width, frame_height);
-  m_latest_privacy_mask_data = NULL;
 }
 
 PrivacyMaskBlender::~PrivacyMaskBlender()
 {
     std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
-    if (m_latest_privacy_mask_data != NULL)
-    {
-      m_latest_privacy_mask_data->bitmask.decrease_ref_count();
-      m_latest_privacy_mask_data = NULL;
-    }
+    clean_latest_privacy_mask_data();
+    clean_pixelation_buffer();
     m_privacy_masks.clear();
     dsp_status status = dsp_utils::release_device();
     if (status != DSP_SUCCESS)
@@ -84,9 +119,50 @@ tl::expected<PrivacyMaskBlenderPtr, media_library_return> PrivacyMaskBlender::cr
   return create(frame_width, frame_height, nlohmann::json());
 }
 
+/**
+ * Cells are whole bitmask pixels, and a power of two so they are aligned in the packed bitmask.
+ */
+static bool is_valid_quantization(uint quantization)
+{
+  return quantization >= PRIVACY_MASK_MIN_QUANTIZATION && quantization <= PRIVACY_MASK_MAX_QUANTIZATION &&
+         (quantization & (quantization - 1)) == 0;
+}
+
+/**
+ * Applies the optional "quantization" (default cell size in frame pixels) and "mode" ("color" or "pixelate") keys of a configuration.
+ */
+static media_library_return configure_blender(PrivacyMaskBlenderPtr privacy_mask_blender, const nlohmann::json &config)
+{
+  if (!config.is_object())
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+
+  if (config.contains("quantization") &&
+      privacy_mask_blender->set_quantization(config["quantization"].get<uint>()) != media_library_return::MEDIA_LIBRARY_SUCCESS)
+    return media_library_return::MEDIA_LIBRARY_CONFIGURATION_ERROR;
+
+  if (config.contains("mode"))
+  {
+    std::string mode = config["mode"].get<std::string>();
+    if (mode == "color")
+      privacy_mask_blender->set_mode(PRIVACY_MASK_MODE_COLOR);
+    else if (mode == "pixelate")
+      privacy_mask_blender->set_mode(PRIVACY_MASK_MODE_PIXELATE);
+    else
+    {
+      LOGGER__ERROR("PrivacyMaskBlender: Unknown privacy mask mode {}", mode);
+      return media_library_return::MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+  }
+
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
+
 tl::expected<PrivacyMaskBlenderPtr, media_library_return> PrivacyMaskBlender::create(const nlohmann::json &config)
 {
   PrivacyMaskBlenderPtr privacy_mask_blender_ptr = std::make_shared<PrivacyMaskBlender>();
+  media_library_return config_ret = configure_blender(privacy_mask_blender_ptr, config);
+  if (config_ret != media_library_return::MEDIA_LIBRARY_SUCCESS)
+    return tl::make_unexpected(config_ret);
 
   dsp_status dsp_ret = dsp_utils::acquire_device();
   if (dsp_ret != DSP_SUCCESS)
@@ -101,6 +177,9 @@ tl::expected<PrivacyMaskBlenderPtr, media_library_return> PrivacyMaskBlender::cr
 tl::expected<PrivacyMaskBlenderPtr, media_library_return> PrivacyMaskBlender::create(uint frame_width, uint frame_height, const nlohmann::json &config)
 {
   PrivacyMaskBlenderPtr privacy_mask_blender_ptr = std::make_shared<PrivacyMaskBlender>(frame_width, frame_height);
+  media_library_return config_ret = configure_blender(privacy_mask_blender_ptr, config);
+  if (config_ret != media_library_return::MEDIA_LIBRARY_SUCCESS)
+    return tl::make_unexpected(config_ret);
 
   dsp_status dsp_ret = dsp_utils::acquire_device();
   if (dsp_ret != DSP_SUCCESS)
@@ -112,34 +191,71 @@ tl::expected<PrivacyMaskBlenderPtr, media_library_return> PrivacyMaskBlender::cr
   return privacy_mask_blender_ptr;
 }
 
-media_library_return PrivacyMaskBlender::init_buffer_pool()
+static MediaLibraryBufferPoolPtr create_bitmask_buffer_pool(uint width, uint height, size_t max_buffers, const std::string &name)
 {
-    // Round up m_frame_width to be a multiple of byte_size / PRIVACY_MASK_QUANTIZATION (32)
+    // Round up width to be a multiple of byte_size / PRIVACY_MASK_QUANTIZATION (32)
     int line_division = 8 / PRIVACY_MASK_QUANTIZATION;
-    uint frame_width = ((m_frame_width + (line_division-1)) & ~(line_division-1))/line_division;
+    uint frame_width = ((width + (line_division-1)) & ~(line_division-1))/line_division;
     // Round bytes_per_line to be a multiple of byte_size (8)
     uint bytes_per_line = (frame_width + 7) & ~7;
-    uint frame_height = m_frame_height/4;
-    std::string name = "privacy_mask";
-    // TODO: set pool size
-    m_buffer_pool = std::make_shared<MediaLibraryBufferPool>(frame_width, frame_height, DSP_IMAGE_FORMAT_GRAY8, 1, CMA, bytes_per_line, name);
-    if (m_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
+    uint frame_height = height/4;
+    MediaLibraryBufferPoolPtr buffer_pool = std::make_shared<MediaLibraryBufferPool>(frame_width, frame_height, DSP_IMAGE_FORMAT_GRAY8, max_buffers, CMA, bytes_per_line, name);
+    if (buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
     {
-      LOGGER__ERROR("PrivacyMaskBlender::PrivacyMaskBlender: Failed to initialize buffer pool");
-      return media_library_return::MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+      LOGGER__ERROR("PrivacyMaskBlender::PrivacyMaskBlender: Failed to initialize buffer pool {}", name);
+      return NULL;
     }
 
-    LOGGER__INFO("PrivacyMaskBlender::PrivacyMaskBlender: Buffer pool initialized successfully with frame size {}x{} bytes_per_line {}", frame_width, frame_height, bytes_per_line);
+    LOGGER__INFO("PrivacyMaskBlender::PrivacyMaskBlender: Buffer pool {} initialized successfully with frame size {}x{} bytes_per_line {}", name, frame_width, frame_height, bytes_per_line);
+    return buffer_pool;
+}
+
+media_library_return PrivacyMaskBlender::init_buffer_pool()
+{
+    // The bitmask of the unrotated frame, and its copy rotated by 180 degrees
+    // TODO: set pool size
+    m_buffer_pool = create_bitmask_buffer_pool(m_frame_width, m_frame_height, 2, "privacy_mask");
+    // The bitmask rotated by 90 or 270 degrees - allocated up front so a rotation change does not allocate
+    m_rotated_buffer_pool = create_bitmask_buffer_pool(m_frame_height, m_frame_width, 1, "privacy_mask_rotated");
+    if (m_buffer_pool == NULL || m_rotated_buffer_pool == NULL)
+      return media_library_return::MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+
     return media_library_return::MEDIA_LIBRARY_SUCCESS;
 }
 
 void PrivacyMaskBlender::clean_latest_privacy_mask_data()
 {
-  if (m_update_required && m_latest_privacy_mask_data != NULL)
+  // The bitmask buffer is reused across updates, it is released only when the buffer pool changes
+  if (m_latest_privacy_mask_data != NULL)
   {
-    m_latest_privacy_mask_data->bitmask.decrease_ref_count();
+    if (m_latest_privacy_mask_data->bitmask.hailo_pix_buffer != nullptr)
+      m_latest_privacy_mask_data->bitmask.decrease_ref_count();
     m_latest_privacy_mask_data = NULL;
   }
+  clean_rotated_privacy_mask_data();
+  m_dirty_regions.clear();
+  m_full_update_required = true;
+  m_update_required = true;
+}
+
+void PrivacyMaskBlender::clean_rotated_privacy_mask_data()
+{
+  if (m_rotated_privacy_mask_data != NULL)
+  {
+    if (m_rotated_privacy_mask_data->bitmask.hailo_pix_buffer != nullptr)
+      m_rotated_privacy_mask_data->bitmask.decrease_ref_count();
+    m_rotated_privacy_mask_data = NULL;
+  }
+  m_rotated_full_update_required = true;
+}
+
+void PrivacyMaskBlender::mark_dirty(const polygon &privacy_mask)
+{
+  m_changed_privacy_masks.insert(privacy_mask.id);
+  if (m_frame_width == 0 || m_frame_height == 0)
+    return;
+  m_dirty_regions.emplace_back(get_polygon_dirty_region(privacy_mask, m_frame_width, m_frame_height, m_quantization * PRIVACY_MASK_QUANTIZATION));
+  m_update_required = true;
 }
 
 media_library_return PrivacyMaskBlender::add_privacy_mask(const polygon &privacy_mask)
@@ -151,31 +267,42 @@ media_library_return PrivacyMaskBlender::add_privacy_mask(const polygon &privacy
     return media_library_return::MEDIA_LIBRARY_ERROR;
   }
 
-  if (privacy_mask.vertices.size() > 8)
+  if (privacy_mask.vertices.size() > MAX_NUM_OF_PRIVACY_MASK_VERTICES)
   {
-    LOGGER__ERROR("PrivacyMaskBlender::add_privacy_mask: Polygon cannot have more than 8 vertices");
+    LOGGER__ERROR("PrivacyMaskBlender::add_privacy_mask: Polygon cannot have more than {} vertices", MAX_NUM_OF_PRIVACY_MASK_VERTICES);
     return media_library_return::MEDIA_LIBRARY_ERROR;
   }
 
-  PolygonPtr polygon = std::make_shared<privacy_mask_types::polygon>(privacy_mask);
+  if (privacy_mask.quantization != 0 && !is_valid_quantization(privacy_mask.quantization))
+  {
+    LOGGER__ERROR("PrivacyMaskBlender::add_privacy_mask: Quantization {} must be a power of two between {} and {}",
+                  privacy_mask.quantization, PRIVACY_MASK_MIN_QUANTIZATION, PRIVACY_MASK_MAX_QUANTIZATION);
+    return media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT;
+  }
 
-  // double rotation_angle = m_rotation;
-  // rotate_polygon(polygon, rotation_angle, m_frame_width, m_frame_height);
+  PolygonPtr polygon = std::make_shared<privacy_mask_types::polygon>(privacy_mask);
   m_privacy_masks.emplace_back(polygon);
 
-  m_update_required = true;
+  mark_dirty(*polygon);
 
   return media_library_return::MEDIA_LIBRARY_SUCCESS;
 }
 
 media_library_return PrivacyMaskBlender::set_privacy_mask(const polygon &privacy_mask)
 {
-  if (privacy_mask.vertices.size() > 8)
+  if (privacy_mask.vertices.size() > MAX_NUM_OF_PRIVACY_MASK_VERTICES)
   {
-    LOGGER__ERROR("PrivacyMaskBlender::add_privacy_mask: Polygon cannot have more than 8 vertices");
+    LOGGER__ERROR("PrivacyMaskBlender::add_privacy_mask: Polygon cannot have more than {} vertices", MAX_NUM_OF_PRIVACY_MASK_VERTICES);
     return media_library_return::MEDIA_LIBRARY_ERROR;
   }
 
+  if (privacy_mask.quantization != 0 && !is_valid_quantization(privacy_mask.quantization))
+  {
+    LOGGER__ERROR("PrivacyMaskBlender::set_privacy_mask: Quantization {} must be a power of two between {} and {}",
+                  privacy_mask.quantization, PRIVACY_MASK_MIN_QUANTIZATION, PRIVACY_MASK_MAX_QUANTIZATION);
+    return media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT;
+  }
+
   std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
   //find the specific privacy mask
   auto it = std::find_if(m_privacy_masks.begin(), m_privacy_masks.end(), [&privacy_mask](const PolygonPtr &privacy_mask_ptr)
@@ -187,13 +314,13 @@ media_library_return PrivacyMaskBlender::set_privacy_mask(const polygon &privacy
   }
 
   PolygonPtr privacy_mask_to_update = *it;
+  // Both the area the polygon moved out of and the area it moved into are rasterized again
+  mark_dirty(*privacy_mask_to_update);
   // Update polygon
   privacy_mask_to_update->vertices = privacy_mask.vertices;
+  privacy_mask_to_update->quantization = privacy_mask.quantization;
+  mark_dirty(*privacy_mask_to_update);
 
-  m_update_required = true;
-
-  // double rotation_angle = m_rotation;
-  // rotate_polygon(privacy_mask_to_update, rotation_angle, m_frame_width, m_frame_height);
   return media_library_return::MEDIA_LIBRARY_SUCCESS;
 }
 
@@ -207,8 +334,66 @@ media_library_return PrivacyMaskBlender::remove_privacy_mask(const std::string &
     LOGGER__ERROR("PrivacyMaskBlender::remove_privacy_mask: Privacy mask with id {} not found", id);
     return media_library_return::MEDIA_LIBRARY_ERROR;
   }
+  mark_dirty(**it);
   m_privacy_masks.erase(it);
 
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return PrivacyMaskBlender::set_dynamic_privacy_masks(uint64_t frame_id, const std::vector<dynamic_mask_t> &dynamic_masks)
+{
+  if (dynamic_masks.size() > MAX_NUM_OF_DYNAMIC_PRIVACY_MASKS)
+  {
+    LOGGER__ERROR("PrivacyMaskBlender::set_dynamic_privacy_masks: Max number of dynamic privacy masks is {}", MAX_NUM_OF_DYNAMIC_PRIVACY_MASKS);
+    return media_library_return::MEDIA_LIBRARY_ERROR;
+  }
+
+  for (const dynamic_mask_t &dynamic_mask : dynamic_masks)
+  {
+    if (dynamic_mask.quantization != 0 && !is_valid_quantization(dynamic_mask.quantization))
+    {
+      LOGGER__ERROR("PrivacyMaskBlender::set_dynamic_privacy_masks: Quantization {} must be a power of two between {} and {}",
+                    dynamic_mask.quantization, PRIVACY_MASK_MIN_QUANTIZATION, PRIVACY_MASK_MAX_QUANTIZATION);
+      return media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  if (m_dynamic_masks_frame_id_valid && frame_id < m_dynamic_masks_frame_id)
+  {
+    LOGGER__DEBUG("PrivacyMaskBlender::set_dynamic_privacy_masks: Dropping masks of frame {}, masks of frame {} are already set", frame_id, m_dynamic_masks_frame_id);
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+  }
+  m_dynamic_masks_frame_id = frame_id;
+  m_dynamic_masks_frame_id_valid = true;
+
+  // Both the areas the masks moved out of and the areas they moved into are rasterized again
+  if (m_frame_width != 0 && m_frame_height != 0)
+  {
+    uint cell_size = m_quantization * PRIVACY_MASK_QUANTIZATION;
+    for (const dynamic_mask_t &dynamic_mask : m_dynamic_masks)
+      m_dirty_regions.emplace_back(get_dynamic_mask_dirty_region(dynamic_mask, m_frame_width, m_frame_height, cell_size));
+    for (const dynamic_mask_t &dynamic_mask : dynamic_masks)
+      m_dirty_regions.emplace_back(get_dynamic_mask_dirty_region(dynamic_mask, m_frame_width, m_frame_height, cell_size));
+  }
+  m_dynamic_masks = dynamic_masks;
+  m_dynamic_masks_changed = true;
+  m_update_required = true;
+
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return PrivacyMaskBlender::clear_dynamic_privacy_masks()
+{
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  if (m_frame_width != 0 && m_frame_height != 0)
+  {
+    for (const dynamic_mask_t &dynamic_mask : m_dynamic_masks)
+      m_dirty_regions.emplace_back(get_dynamic_mask_dirty_region(dynamic_mask, m_frame_width, m_frame_height,
+                                                                 m_quantization * PRIVACY_MASK_QUANTIZATION));
+  }
+  m_dynamic_masks.clear();
+  m_dynamic_masks_changed = true;
   m_update_required = true;
 
   return media_library_return::MEDIA_LIBRARY_SUCCESS;
@@ -216,55 +401,192 @@ media_library_return PrivacyMaskBlender::remove_privacy_mask(const std::string &
 
 media_library_return PrivacyMaskBlender::set_color(const rgb_color_t &color)
 {
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
   m_color = color;
+  m_update_required = true;
   return media_library_return::MEDIA_LIBRARY_SUCCESS;
 }
 
 media_library_return PrivacyMaskBlender::set_rotation(const rotation_angle_t &rotation)
 {
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
   if(m_rotation == rotation)
   {
     LOGGER__WARNING("PrivacyMaskBlender::set_rotation: Rotation is already set to {}, skipping update", rotation);
     return media_library_return::MEDIA_LIBRARY_SUCCESS;
   }
 
+  // Polygons and the primary bitmask stay in the coordinates of the unrotated frame,
+  // the next blend copies the primary bitmask into the rotated one instead of rasterizing again
+  LOGGER__INFO("PrivacyMaskBlender::set_rotation: Rotating privacy masks from {} to {}", m_rotation, rotation);
+  clean_rotated_privacy_mask_data();
+  m_rotation = rotation;
+  m_update_required = true;
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
+
+tl::expected<rgb_color_t, media_library_return> PrivacyMaskBlender::get_color()
+{
+  return m_color;
+}
+
+media_library_return PrivacyMaskBlender::set_mode(const privacy_mask_mode_t &mode)
+{
   std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  m_mode = mode;
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
 
-  // Rotate polygons
-  // double rotation_angle = rotation - m_rotation;
-  // LOGGER__INFO("PrivacyMaskBlender::set_rotation: Rotating polygons by {} degrees", rotation_angle);
-  // if (rotate_polygons(m_privacy_masks, rotation_angle, m_frame_width, m_frame_height) != media_library_return::MEDIA_LIBRARY_SUCCESS)
-  // {
-  //   LOGGER__ERROR("PrivacyMaskBlender::set_rotation: Failed to rotate polygons");
-  //   return media_library_return::MEDIA_LIBRARY_ERROR;
-  // }
+tl::expected<privacy_mask_mode_t, media_library_return> PrivacyMaskBlender::get_mode()
+{
+  return m_mode;
+}
 
-  // Swap frame width and height if needed
-  if ((m_rotation == ROTATION_ANGLE_0 || m_rotation == ROTATION_ANGLE_180) && (rotation == ROTATION_ANGLE_90 || rotation == ROTATION_ANGLE_270))
+media_library_return PrivacyMaskBlender::set_quantization(const uint &quantization)
+{
+  if (!is_valid_quantization(quantization))
   {
-    std::swap(m_frame_width, m_frame_height);
+    LOGGER__ERROR("PrivacyMaskBlender::set_quantization: Quantization {} must be a power of two between {} and {}",
+                  quantization, PRIVACY_MASK_MIN_QUANTIZATION, PRIVACY_MASK_MAX_QUANTIZATION);
+    return media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT;
   }
-  else if ((m_rotation == ROTATION_ANGLE_90 || m_rotation == ROTATION_ANGLE_270) && (rotation == ROTATION_ANGLE_0 || rotation == ROTATION_ANGLE_180))
+
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  if (m_quantization == quantization)
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+
+  // Every mask without its own quantization moves to the new grid
+  m_quantization = quantization;
+  m_dirty_regions.clear();
+  m_full_update_required = true;
+  m_update_required = true;
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
+
+tl::expected<uint, media_library_return> PrivacyMaskBlender::get_quantization()
+{
+  return m_quantization;
+}
+
+media_library_return PrivacyMaskBlender::init_pixelation_buffer(uint cells_width, uint cells_height)
+{
+  // The buffer is sized for the largest region at the current quantization, smaller regions use part of it
+  if (m_pixelation_buffer_pool != NULL && m_pixelation_buffer_pool->get_width() >= cells_width &&
+      m_pixelation_buffer_pool->get_height() >= cells_height)
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+
+  clean_pixelation_buffer();
+  m_pixelation_buffer_pool = std::make_shared<MediaLibraryBufferPool>(cells_width, cells_height, DSP_IMAGE_FORMAT_NV12, 1, CMA,
+                                                                      dsp_utils::get_dsp_desired_stride_from_width(cells_width),
+                                                                      "privacy_mask_pixelation");
+  if (m_pixelation_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS ||
+      m_pixelation_buffer_pool->acquire_buffer(m_pixelation_cells) != MEDIA_LIBRARY_SUCCESS)
   {
-    std::swap(m_frame_width, m_frame_height);
+    LOGGER__ERROR("PrivacyMaskBlender::init_pixelation_buffer: Failed to allocate a {}x{} pixelation buffer", cells_width, cells_height);
+    m_pixelation_buffer_pool = NULL;
+    return media_library_return::MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
   }
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
 
-  m_update_required = true;
+void PrivacyMaskBlender::clean_pixelation_buffer()
+{
+  if (m_pixelation_cells.hailo_pix_buffer != nullptr)
+    m_pixelation_cells.decrease_ref_count();
+  m_pixelation_cells = hailo_media_library_buffer();
+  m_pixelation_buffer_pool = NULL;
+  m_pixelation_mask_data = NULL;
+}
 
-  // Initialize buffer pool with new dimensions
-  if (init_buffer_pool() != media_library_return::MEDIA_LIBRARY_SUCCESS)
+tl::expected<dsp_image_properties_t *, media_library_return> PrivacyMaskBlender::get_pixelation_cells(hailo_media_library_buffer &input_frame,
+                                                                                                      dsp_roi_t &cells_crop)
+{
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  m_pixelation_mask_data = NULL;
+  PrivacyMaskDataPtr privacy_mask_data = current_privacy_mask_data();
+  if (privacy_mask_data == NULL || privacy_mask_data->rois_count == 0)
+    return nullptr;
+
+  // The frame is rotated upstream, just like the bitmask of the blend
+  uint frame_width = m_frame_width;
+  uint frame_height = m_frame_height;
+  if (m_rotation == ROTATION_ANGLE_90 || m_rotation == ROTATION_ANGLE_270)
+    std::swap(frame_width, frame_height);
+
+  if (input_frame.hailo_pix_buffer == nullptr || input_frame.hailo_pix_buffer->format != DSP_IMAGE_FORMAT_NV12)
   {
-    LOGGER__ERROR("PrivacyMaskBlender::set_rotation: Failed to initialize buffer pool");
-    return media_library_return::MEDIA_LIBRARY_ERROR;
+    LOGGER__ERROR("PrivacyMaskBlender::get_pixelation_cells: Only NV12 frames can be pixelated");
+    return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT);
   }
 
-  m_rotation = rotation;
-  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+  if (input_frame.hailo_pix_buffer->width != frame_width || input_frame.hailo_pix_buffer->height != frame_height)
+  {
+    LOGGER__ERROR("PrivacyMaskBlender::get_pixelation_cells: Frame size {}x{} does not match the privacy mask frame size {}x{}",
+                  input_frame.hailo_pix_buffer->width, input_frame.hailo_pix_buffer->height, frame_width, frame_height);
+    return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT);
+  }
+
+  uint cell_size = m_quantization * PRIVACY_MASK_QUANTIZATION;
+  roi_t region = get_pixelation_region(privacy_mask_data->rois, privacy_mask_data->rois_count, cell_size, frame_width, frame_height);
+  if (region.width == 0 || region.height == 0)
+    return nullptr;
+
+  // Each cell of m_quantization frame pixels becomes 2x2 pixels, so it keeps its own chroma
+  media_library_return ret = init_pixelation_buffer((frame_width + m_quantization - 1) / m_quantization * 2,
+                                                    (frame_height + m_quantization - 1) / m_quantization * 2);
+  if (ret != media_library_return::MEDIA_LIBRARY_SUCCESS)
+    return tl::make_unexpected(ret);
+
+  m_pixelation_cells_image = *m_pixelation_cells.hailo_pix_buffer;
+  m_pixelation_cells_image.width = (region.width + m_quantization - 1) / m_quantization * 2;
+  m_pixelation_cells_image.height = (region.height + m_quantization - 1) / m_quantization * 2;
+  m_pixelation_region = region;
+  m_pixelation_cell_size = cell_size;
+  m_pixelation_frame_width = frame_width;
+  m_pixelation_frame_height = frame_height;
+  m_pixelation_mask_data = privacy_mask_data;
+  cells_crop = {
+      .start_x = region.x,
+      .start_y = region.y,
+      .end_x = region.x + region.width,
+      .end_y = region.y + region.height};
+  return &m_pixelation_cells_image;
 }
 
-tl::expected<rgb_color_t, media_library_return> PrivacyMaskBlender::get_color()
+media_library_return PrivacyMaskBlender::pixelate(const roi_t &crop, std::vector<hailo_media_library_buffer> &output_frames)
 {
-  return m_color;
+  std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
+  // The bitmask and the cells image of get_pixelation_cells, the next blend may already have changed the masks
+  PrivacyMaskDataPtr privacy_mask_data = m_pixelation_mask_data;
+  m_pixelation_mask_data = NULL;
+  if (privacy_mask_data == NULL)
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+
+  media_library_return ret = media_library_return::MEDIA_LIBRARY_SUCCESS;
+  m_pixelation_cells.sync_start();
+  for (hailo_media_library_buffer &output_frame : output_frames)
+  {
+    if (output_frame.hailo_pix_buffer == nullptr)
+      continue;
+    if (output_frame.hailo_pix_buffer->format != DSP_IMAGE_FORMAT_NV12)
+    {
+      LOGGER__ERROR("PrivacyMaskBlender::pixelate: Only NV12 outputs can be pixelated");
+      ret = media_library_return::MEDIA_LIBRARY_INVALID_ARGUMENT;
+      break;
+    }
+    output_frame.sync_start();
+    fill_pixelated_cells((uint8_t *)privacy_mask_data->bitmask.get_plane(0), privacy_mask_data->bitmask.get_plane_stride(0),
+                         privacy_mask_data->rois, privacy_mask_data->rois_count, m_pixelation_cell_size, m_pixelation_region,
+                         (uint8_t *)m_pixelation_cells.get_plane(0), m_pixelation_cells.get_plane_stride(0),
+                         (uint8_t *)m_pixelation_cells.get_plane(1), m_pixelation_cells.get_plane_stride(1),
+                         m_pixelation_frame_width, m_pixelation_frame_height, crop,
+                         (uint8_t *)output_frame.get_plane(0), output_frame.get_plane_stride(0),
+                         (uint8_t *)output_frame.get_plane(1), output_frame.get_plane_stride(1),
+                         output_frame.hailo_pix_buffer->width, output_frame.hailo_pix_buffer->height);
+    output_frame.sync_end();
+  }
+  m_pixelation_cells.sync_end();
+  return ret;
 }
 
 tl::expected<polygon, media_library_return> PrivacyMaskBlender::get_privacy_mask(const std::string &id)
@@ -293,10 +615,39 @@ tl::expected<std::pair<uint, uint>, media_library_return> PrivacyMaskBlender::ge
 media_library_return PrivacyMaskBlender::set_frame_size(const uint &width, const uint &height)
 {
   std::unique_lock<std::mutex> lock(*m_privacy_mask_mutex);
-  m_frame_width = width;
-  m_frame_height = height;
+  // The frame size is given as blended, the polygons and the primary bitmask are kept in the unrotated frame
+  uint frame_width = width;
+  uint frame_height = height;
+  if (m_rotation == ROTATION_ANGLE_90 || m_rotation == ROTATION_ANGLE_270)
+    std::swap(frame_width, frame_height);
+  if (frame_width == m_frame_width && frame_height == m_frame_height && m_buffer_pool != NULL)
+  {
+    LOGGER__DEBUG("PrivacyMaskBlender::set_frame_size: Frame size {}x{} matches the current frame, keeping the privacy masks", width, height);
+    m_frame_rotation = m_rotation;
+    return media_library_return::MEDIA_LIBRARY_SUCCESS;
+  }
 
-  m_update_required = true;
+  // The rotation is set before the frames are rotated upstream - until then they keep the orientation of the previous
+  // rotation, and the masks with them
+  if (m_frame_rotation != m_rotation && m_buffer_pool != NULL)
+  {
+    uint pending_width = width;
+    uint pending_height = height;
+    if (m_frame_rotation == ROTATION_ANGLE_90 || m_frame_rotation == ROTATION_ANGLE_270)
+      std::swap(pending_width, pending_height);
+    if (pending_width == m_frame_width && pending_height == m_frame_height)
+    {
+      LOGGER__DEBUG("PrivacyMaskBlender::set_frame_size: Frame size {}x{} is the current frame before its pending rotation to {}, keeping the privacy masks",
+                    width, height, m_rotation);
+      return media_library_return::MEDIA_LIBRARY_SUCCESS;
+    }
+  }
+
+  m_frame_width = frame_width;
+  m_frame_height = frame_height;
+  m_frame_rotation = m_rotation;
+
+  clean_latest_privacy_mask_data();
 
   // Initialize buffer pool
   if (init_buffer_pool() != media_library_return::MEDIA_LIBRARY_SUCCESS)
@@ -325,40 +676,161 @@ tl::expected<PrivacyMaskDataPtr, media_library_return> PrivacyMaskBlender::blend
   
   if(!m_update_required && m_latest_privacy_mask_data != NULL)
   {
-    return m_latest_privacy_mask_data;
+    return current_privacy_mask_data();
   }
 
-  clean_latest_privacy_mask_data();
-
-  m_latest_privacy_mask_data = std::make_shared<privacy_mask_data_t>();
-  if (m_privacy_masks.empty())
+  if (m_latest_privacy_mask_data == NULL)
   {
+    m_latest_privacy_mask_data = std::make_shared<privacy_mask_data_t>();
     m_latest_privacy_mask_data->rois_count = 0;
+  }
+
+  bool bitmask_acquired = m_latest_privacy_mask_data->bitmask.hailo_pix_buffer != nullptr;
+  if (m_privacy_masks.empty() && m_dynamic_masks.empty() && !bitmask_acquired)
+  {
+    // Nothing was rasterized yet, there is nothing to clear - the first blend builds the whole edge table
+    m_dirty_regions.clear();
+    m_changed_privacy_masks.clear();
+    m_dynamic_masks_changed = false;
+    m_update_required = false;
     return m_latest_privacy_mask_data;
   }
 
   if (m_buffer_pool == NULL)
   {
-      LOGGER__ERROR("PrivacyMaskBlender::set_rotation: buffer pool is uninitialized");
+      LOGGER__ERROR("PrivacyMaskBlender::blend: buffer pool is uninitialized");
       return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_ERROR);
   }
 
-  // allocate memory for bitmask
-  if (m_buffer_pool->acquire_buffer(m_latest_privacy_mask_data->bitmask) != MEDIA_LIBRARY_SUCCESS)
+  // allocate memory for bitmask once, later updates are written into the same buffer
+  if (!bitmask_acquired)
   {
-    LOGGER__ERROR("PrivacyMaskBlender::blend: Failed to acquire buffer");
-    return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_ERROR);
+    if (m_buffer_pool->acquire_buffer(m_latest_privacy_mask_data->bitmask) != MEDIA_LIBRARY_SUCCESS)
+    {
+      LOGGER__ERROR("PrivacyMaskBlender::blend: Failed to acquire buffer");
+      return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_ERROR);
+    }
+    m_full_update_required = true;
   }
-  
+
+  // Blend runs on the frame thread before the DSP operation, so the buffer is not read while it is written
+  media_library_return ret = media_library_return::MEDIA_LIBRARY_SUCCESS;
+  uint8_t *bitmask = (uint8_t *)m_latest_privacy_mask_data->bitmask.get_plane(0);
+  uint bytes_per_line = m_latest_privacy_mask_data->bitmask.get_plane_stride(0);
+  std::vector<roi_t> updated_regions;
   m_latest_privacy_mask_data->bitmask.sync_start();
-  if (write_polygons_to_privacy_mask_data(m_privacy_masks, m_frame_width, m_frame_height, m_color, m_latest_privacy_mask_data) != media_library_return::MEDIA_LIBRARY_SUCCESS)
+  bool geometry_changed = m_edge_table->configure(m_frame_width, m_frame_height, m_quantization * PRIVACY_MASK_QUANTIZATION);
+  if (geometry_changed || m_full_update_required)
+  {
+    m_edge_table->build(m_privacy_masks, m_dynamic_masks, m_frame_width, m_frame_height, m_quantization * PRIVACY_MASK_QUANTIZATION);
+  }
+  else
+  {
+    // Only the edges of the masks changed since the last blend are rebuilt
+    for (const std::string &id : m_changed_privacy_masks)
+    {
+      auto it = std::find_if(m_privacy_masks.begin(), m_privacy_masks.end(), [&id](const PolygonPtr &privacy_mask)
+                             { return privacy_mask->id == id; });
+      if (it != m_privacy_masks.end())
+        m_edge_table->set_polygon(**it);
+      else
+        m_edge_table->remove_polygon(id);
+    }
+    if (m_dynamic_masks_changed)
+      m_edge_table->set_dynamic_masks(m_dynamic_masks);
+  }
+  m_changed_privacy_masks.clear();
+  m_dynamic_masks_changed = false;
+  if (geometry_changed || m_full_update_required)
+  {
+    ret = write_polygons_to_privacy_mask_data(*m_edge_table, m_frame_width, m_frame_height, m_color, m_latest_privacy_mask_data);
+    updated_regions = {{0, 0, bytes_per_line * 8, (uint)(m_frame_height * PRIVACY_MASK_QUANTIZATION)}};
+  }
+  else
+  {
+    // The dirty regions cover the whole cells of the masks, so the rotated copy follows them
+    updated_regions = merge_dirty_regions(m_dirty_regions);
+    m_edge_table->rasterize(updated_regions, bitmask, bytes_per_line);
+    ret = write_privacy_mask_rois(*m_edge_table, m_color, m_latest_privacy_mask_data);
+  }
+  m_latest_privacy_mask_data->bitmask.sync_end();
+
+  if (ret != media_library_return::MEDIA_LIBRARY_SUCCESS)
   {
     LOGGER__ERROR("PrivacyMaskBlender::blend: Failed to write polygon");
-    m_latest_privacy_mask_data->bitmask.sync_end();
+    // The bitmask might be partially written - rebuild it on the next blend
+    m_full_update_required = true;
     return tl::make_unexpected(media_library_return::MEDIA_LIBRARY_ERROR);
   }
 
-  m_latest_privacy_mask_data->bitmask.sync_end();
+  m_dirty_regions.clear();
+  m_full_update_required = false;
+
+  if (m_rotation != ROTATION_ANGLE_0)
+  {
+    ret = update_rotated_privacy_mask_data(updated_regions);
+    if (ret != media_library_return::MEDIA_LIBRARY_SUCCESS)
+      return tl::make_unexpected(ret);
+  }
+
   m_update_required = false;
+  return current_privacy_mask_data();
+}
+
+PrivacyMaskDataPtr PrivacyMaskBlender::current_privacy_mask_data()
+{
+  if (m_rotation != ROTATION_ANGLE_0 && m_rotated_privacy_mask_data != NULL)
+    return m_rotated_privacy_mask_data;
   return m_latest_privacy_mask_data;
 }
+
+media_library_return PrivacyMaskBlender::update_rotated_privacy_mask_data(const std::vector<roi_t> &updated_regions)
+{
+  if (m_rotated_privacy_mask_data == NULL)
+  {
+    m_rotated_privacy_mask_data = std::make_shared<privacy_mask_data_t>();
+    m_rotated_privacy_mask_data->rois_count = 0;
+  }
+
+  if (m_rotated_privacy_mask_data->bitmask.hailo_pix_buffer == nullptr)
+  {
+    // The pools are allocated with the frame size, a rotation change only acquires a buffer
+    MediaLibraryBufferPoolPtr buffer_pool = m_rotation == ROTATION_ANGLE_180 ? m_buffer_pool : m_rotated_buffer_pool;
+    if (buffer_pool == NULL || buffer_pool->acquire_buffer(m_rotated_privacy_mask_data->bitmask) != MEDIA_LIBRARY_SUCCESS)
+    {
+      LOGGER__ERROR("PrivacyMaskBlender::blend: Failed to acquire rotated buffer");
+      return media_library_return::MEDIA_LIBRARY_ERROR;
+    }
+    m_rotated_full_update_required = true;
+  }
+
+  uint mask_width = m_frame_width * PRIVACY_MASK_QUANTIZATION;
+  uint mask_height = m_frame_height * PRIVACY_MASK_QUANTIZATION;
+  uint8_t *rotated_bitmask = (uint8_t *)m_rotated_privacy_mask_data->bitmask.get_plane(0);
+
+  m_rotated_privacy_mask_data->bitmask.sync_start();
+  std::vector<roi_t> regions = updated_regions;
+  if (m_rotated_full_update_required)
+  {
+    // Bits are only set inside the rois - clear the rotated bitmask and copy just them, including their last row and column
+    memset(rotated_bitmask, 0, m_rotated_privacy_mask_data->bitmask.get_plane_size(0));
+    regions.clear();
+    for (uint i = 0; i < m_latest_privacy_mask_data->rois_count; i++)
+    {
+      roi_t roi = m_latest_privacy_mask_data->rois[i];
+      regions.push_back({roi.x, roi.y, roi.width + 1, roi.height + 1});
+    }
+  }
+  rotate_privacy_mask_regions((uint8_t *)m_latest_privacy_mask_data->bitmask.get_plane(0), m_latest_privacy_mask_data->bitmask.get_plane_stride(0),
+                              mask_width, mask_height, m_rotation, regions,
+                              rotated_bitmask, m_rotated_privacy_mask_data->bitmask.get_plane_stride(0));
+  m_rotated_privacy_mask_data->bitmask.sync_end();
+
+  m_rotated_privacy_mask_data->color = m_latest_privacy_mask_data->color;
+  m_rotated_privacy_mask_data->rois_count = m_latest_privacy_mask_data->rois_count;
+  for (uint i = 0; i < m_latest_privacy_mask_data->rois_count; i++)
+    m_rotated_privacy_mask_data->rois[i] = rotate_mask_roi(m_latest_privacy_mask_data->rois[i], m_rotation, mask_width, mask_height);
+
+  m_rotated_full_update_required = false;
+  return media_library_return::MEDIA_LIBRARY_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file vdevice_registry.cpp
+ * @brief Process-wide registry of shared HailoRT VDevices and the scheduling of their networks
+ **/
+
+#include "vdevice_registry.hpp"
+#include "media_library_logger.hpp"
+
+#include <algorithm>
+
+NetworkUsage::NetworkUsage(const std::string &network_name, const std::string &group_id, const network_scheduling_t &scheduling)
+    : m_network_name(network_name), m_group_id(group_id), m_scheduling(scheduling),
+      m_start_time(std::chrono::steady_clock::now()), m_last_complete_time(m_start_time)
+{
+}
+
+void NetworkUsage::record(std::chrono::steady_clock::time_point submit_time, std::chrono::steady_clock::time_point complete_time)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frames++;
+    m_total_latency += complete_time - submit_time;
+    // Overlapping jobs are only counted once - from the later of the submission and the previous completion
+    m_active_time += complete_time - std::max(submit_time, m_last_complete_time);
+    m_last_complete_time = complete_time;
+}
+
+void NetworkUsage::record_bypassed(std::chrono::steady_clock::time_point submit_time, std::chrono::steady_clock::time_point complete_time)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bypassed_frames++;
+    m_total_bypass_latency += complete_time - submit_time;
+}
+
+network_utilization_t NetworkUsage::get_utilization()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start_time).count();
+    network_utilization_t utilization;
+    utilization.network_name = m_network_name;
+    utilization.group_id = m_group_id;
+    utilization.scheduling = m_scheduling;
+    utilization.frames = m_frames;
+    utilization.fps = elapsed_s > 0 ? m_frames / elapsed_s : 0;
+    utilization.mean_latency_ms = m_frames > 0 ? std::chrono::duration<double, std::milli>(m_total_latency).count() / m_frames : 0;
+    utilization.active_share = elapsed_s > 0 ? std::chrono::duration<double>(m_active_time).count() / elapsed_s : 0;
+    utilization.mean_active_ms = m_frames > 0 ? std::chrono::duration<double, std::milli>(m_active_time).count() / m_frames : 0;
+    utilization.bypassed_frames = m_bypassed_frames;
+    utilization.mean_bypass_latency_ms = m_bypassed_frames > 0 ? std::chrono::duration<double, std::milli>(m_total_bypass_latency).count() / m_bypassed_frames : 0;
+    return utilization;
+}
+
+tl::expected<std::shared_ptr<hailort::VDevice>, media_library_return> VDeviceRegistry::acquire_vdevice(const std::string &group_id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_vdevices.find(group_id);
+    if (it != m_vdevices.end())
+    {
+        if (std::shared_ptr<hailort::VDevice> vdevice = it->second.lock())
+        {
+            return vdevice;
+        }
+    }
+
+    hailo_vdevice_params_t vdevice_params = {0};
+    hailo_init_vdevice_params(&vdevice_params);
+    vdevice_params.group_id = group_id.c_str();
+    vdevice_params.scheduling_algorithm = HAILO_SCHEDULING_ALGORITHM_ROUND_ROBIN;
+
+    auto vdevice_exp = hailort::VDevice::create(vdevice_params);
+    if (!vdevice_exp)
+    {
+        LOGGER__ERROR("Failed to create vdevice for group {}, status = {}", group_id, vdevice_exp.status());
+        return tl::make_unexpected(MEDIA_LIBRARY_ERROR);
+    }
+    std::shared_ptr<hailort::VDevice> vdevice = vdevice_exp.release();
+    m_vdevices[group_id] = vdevice;
+    LOGGER__INFO("Created shared vdevice for group {}", group_id);
+
+    return vdevice;
+}
+
+void VDeviceRegistry::set_network_scheduling(const std::string &network_name, const network_scheduling_t &scheduling)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_scheduling_overrides[network_name] = scheduling;
+}
+
+tl::expected<NetworkUsagePtr, media_library_return> VDeviceRegistry::register_network(const std::string &network_name, const std::string &group_id,
+                                                                                      hailort::ConfiguredInferModel &configured_infer_model,
+                                                                                      const network_scheduling_t &default_scheduling)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto override_it = m_scheduling_overrides.find(network_name);
+    network_scheduling_t scheduling = override_it != m_scheduling_overrides.end() ? override_it->second : default_scheduling;
+
+    auto status = configured_infer_model.set_scheduler_priority(scheduling.priority);
+    if (HAILO_SUCCESS != status)
+    {
+        LOGGER__ERROR("Failed to set scheduler priority of network {}, status = {}", network_name, status);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+    status = configured_infer_model.set_scheduler_threshold(scheduling.threshold);
+    if (HAILO_SUCCESS != status)
+    {
+        LOGGER__ERROR("Failed to set scheduler threshold of network {}, status = {}", network_name, status);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+    status = configured_infer_model.set_scheduler_timeout(std::chrono::milliseconds(scheduling.timeout_ms));
+    if (HAILO_SUCCESS != status)
+    {
+        LOGGER__ERROR("Failed to set scheduler timeout of network {}, status = {}", network_name, status);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+
+    NetworkUsagePtr usage = std::make_shared<NetworkUsage>(network_name, group_id, scheduling);
+    // Drop the networks that were released
+    m_networks.erase(std::remove_if(m_networks.begin(), m_networks.end(), [](const std::weak_ptr<NetworkUsage> &network)
+                                    { return network.expired(); }),
+                     m_networks.end());
+    m_networks.push_back(usage);
+    LOGGER__INFO("Registered network {} on group {}: priority {} threshold {} timeout {} ms", network_name, group_id,
+                 scheduling.priority, scheduling.threshold, scheduling.timeout_ms);
+
+    return usage;
+}
+
+std::vector<network_utilization_t> VDeviceRegistry::get_utilization()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<network_utilization_t> utilization;
+    for (std::weak_ptr<NetworkUsage> &network : m_networks)
+    {
+        if (NetworkUsagePtr usage = network.lock())
+        {
+            utilization.push_back(usage->get_utilization());
+        }
+    }
+    return utilization;
+}
@@ -40,6 +40,7 @@ Encoder::~Encoder() = default;
 Encoder::Impl::~Impl()
 {
     LOGGER__DEBUG("Encoder - Destructor");
+    stop_async();
     release();
     dispose();
 }
@@ -47,7 +48,6 @@ Encoder::Impl::~Impl()
 int Encoder::Impl::allocate_output_memory()
 {
     i32 ret;
-    u32 outbufSize;
     EWLInitParam_t ewl_params;
     ewl_params.clientType = EWL_CLIENT_TYPE_HEVC_ENC;
     m_ewl = (void *)EWLInit(&ewl_params);
@@ -55,21 +55,84 @@ int Encoder::Impl::allocate_output_memory()
     {
         return 1;
     }
+    m_ewl_instance = std::shared_ptr<void>(m_ewl, [](void *ewl)
+                                           { (void)EWLRelease((const void *)ewl); });
+    m_dmabuf_cache = std::make_unique<EwlDmabufCache>(m_ewl);
+
+    m_copied_frames = 0;
+    m_ring_overflow_frames = 0;
+    m_sliced_frames = 0;
+    m_sliced_ring_frames = 0;
+    auto output_ring = EncoderOutputRing::create(m_ewl_instance, ENCODER_OUTPUT_RING_SIZE);
+    if (output_ring.has_value())
+    {
+        m_output_ring = output_ring.value();
+    }
+    else
+    {
+        LOGGER__WARNING("Encoder - Failed to allocate the output ring, encoded frames are copied");
+        m_output_ring = nullptr;
+    }
 
-    /* Limited amount of memory on some test environment */
-    outbufSize = (12 * 1024 * 1024);
-
-    ret = EWLMallocLinear((const void *)m_ewl, outbufSize, 0, &m_output_memory);
+    // With the ring the scratch memory only holds the stream headers, until the ring has no room for a frame
+    uint32_t scratch_size = (m_output_ring != nullptr) ? ENCODER_OUTPUT_SCRATCH_SIZE : ENCODER_OUTPUT_FRAME_MAX_SIZE;
+    ret = EWLMallocLinear((const void *)m_ewl, scratch_size, 0, &m_output_memory);
     if (ret != EWL_OK)
     {
         m_output_memory.virtualAddress = NULL;
         return 1;
     }
+    use_scratch_output_memory();
+    LOGGER__INFO("Encoder - output memory takes {} KB of CMA", (scratch_size + (m_output_ring != nullptr ? m_output_ring->size() : 0)) / 1024);
+    return 0;
+}
+
+media_library_return Encoder::Impl::grow_scratch_output_memory()
+{
+    if (m_output_memory.size >= ENCODER_OUTPUT_FRAME_MAX_SIZE)
+        return MEDIA_LIBRARY_SUCCESS;
 
+    LOGGER__WARNING("Encoder - the output ring has no room for a frame, growing the scratch output memory to {} KB of CMA",
+                    ENCODER_OUTPUT_FRAME_MAX_SIZE / 1024);
+    EWLLinearMem_t memory;
+    if (EWLMallocLinear((const void *)m_ewl, ENCODER_OUTPUT_FRAME_MAX_SIZE, 0, &memory) != EWL_OK)
+    {
+        LOGGER__ERROR("Encoder - Failed to grow the scratch output memory");
+        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+    }
+    EWLFreeLinear((const void *)m_ewl, &m_output_memory);
+    m_output_memory = memory;
+    use_scratch_output_memory();
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+void Encoder::Impl::use_scratch_output_memory()
+{
     m_enc_in.busOutBuf = m_output_memory.busAddress;
     m_enc_in.outBufSize = m_output_memory.size;
     m_enc_in.pOutBuf = m_output_memory.virtualAddress;
-    return 0;
+}
+
+uint32_t Encoder::Impl::get_output_buffer_size()
+{
+    uint32_t frame_size = m_vc_cfg.width * m_vc_cfg.height;
+    hailo_encoder_config_t config = m_config->get_hailo_config();
+    rate_control_config_t &rate_control = config.rate_control;
+    uint32_t framerate = config.input_stream.framerate;
+    // Without rate control the frame size is not bounded by the bitrate
+    if (!rate_control.picture_rc || rate_control.bitrate.target_bitrate == 0 || framerate == 0)
+        return frame_size;
+
+    // An IDR frame takes a few average frames of its GOP budget, all of it with a GOP of one frame
+    uint64_t average_frame_size = rate_control.bitrate.target_bitrate / 8 / framerate;
+    uint64_t idr_factor = rate_control.gop_length;
+    if (idr_factor == 0 || idr_factor > ENCODER_OUTPUT_IDR_FRAME_FACTOR)
+        idr_factor = ENCODER_OUTPUT_IDR_FRAME_FACTOR;
+    uint64_t size = average_frame_size * idr_factor * (100 + rate_control.output_buffer_headroom) / 100 +
+                    ENCODER_OUTPUT_HEADER_RESERVE;
+
+    size = std::max<uint64_t>(size, ENCODER_OUTPUT_BUFFER_MIN_SIZE);
+    return static_cast<uint32_t>(std::min<uint64_t>(size, frame_size));
 }
 
 void Encoder::Impl::init_buffer_pool(uint pool_size)
@@ -77,19 +140,29 @@ void Encoder::Impl::init_buffer_pool(uint pool_size)
     if (m_buffer_pool == nullptr)
     {
         std::string name = "encoder_output";
+        m_output_buffer_size = get_output_buffer_size();
+        m_overflow_frames = 0;
         m_buffer_pool = std::make_shared<MediaLibraryBufferPool>(
-            m_vc_cfg.width, m_vc_cfg.height, DSP_IMAGE_FORMAT_GRAY8, (pool_size), CMA, name);
+            m_output_buffer_size, 1, DSP_IMAGE_FORMAT_GRAY8, (pool_size), CMA, name);
         if (m_buffer_pool->init() != MEDIA_LIBRARY_SUCCESS)
         {
             LOGGER__ERROR(
                 "Encoder - init_buffer_pool - Failed to init buffer pool");
+            return;
         }
+        LOGGER__INFO("Encoder - output pool of {} buffers of {} bytes takes {} KB of CMA, {} KB with width*height buffers",
+                     pool_size, m_output_buffer_size, ((uint64_t)pool_size * m_output_buffer_size) / 1024,
+                     ((uint64_t)pool_size * m_vc_cfg.width * m_vc_cfg.height) / 1024);
     }
 }
 
 Encoder::Impl::Impl(std::string json_string)
     : m_config(std::make_unique<EncoderConfig>(json_string))
 {
+    m_slice_size = 0;
+    m_scheduler_stream = 0;
+    m_scheduling_priority = 0;
+    m_scheduling_deadline_us = 0;
     m_state = ENCODER_STATE_UNINITIALIZED;
     init();
 }
@@ -120,8 +193,27 @@ media_library_return Encoder::Impl::release()
     VCEncRelease(m_inst);
     if (m_output_memory.virtualAddress != NULL)
         EWLFreeLinear((const void *)m_ewl, &m_output_memory);
-    if (NULL != m_ewl)
-        (void)EWLRelease((const void *)m_ewl);
+    if (m_overflow_frames > 0)
+        LOGGER__INFO("Encoder - {} frames overflowed the {} byte output buffers", m_overflow_frames, m_output_buffer_size);
+    if (m_output_ring != nullptr)
+    {
+        encoder_output_ring_stats_t stats = m_output_ring->get_stats();
+        LOGGER__INFO("Encoder - {} frames handed out of the output ring, {} copied, ring exhausted {} times, {} frames overflowed their ring region, {} still referenced",
+                     stats.commits, m_copied_frames, stats.exhausted, m_ring_overflow_frames, stats.outstanding);
+        if (m_sliced_frames > 0 && m_sliced_ring_frames == 0)
+            LOGGER__ERROR("Encoder - none of the {} sliced frames got a region of the output ring, every slice was copied", m_sliced_frames);
+        // frames still referenced keep the ring and the EWL instance alive
+        m_output_ring.reset();
+    }
+    // the cached dmabufs are unshared before the EWL instance is released
+    m_dmabuf_cache.reset();
+    m_ewl_instance.reset();
+    m_ewl = NULL;
+    if (m_scheduler_stream != 0)
+    {
+        EncoderScheduler::get_instance().unregister_stream(m_scheduler_stream);
+        m_scheduler_stream = 0;
+    }
     
     m_state = ENCODER_STATE_UNINITIALIZED;
 
@@ -165,6 +257,7 @@ media_library_return Encoder::Impl::init()
     init_rate_control_config();
     m_update_required = {};
     m_stream_restart = STREAM_RESTART_NONE;
+    update_scheduling();
     m_state = ENCODER_STATE_INITIALIZED;
     m_header.buffer = nullptr;
     m_header.size = 0;
@@ -178,6 +271,7 @@ media_library_return Encoder::configure(std::string json_string)
 
 media_library_return Encoder::Impl::configure(std::string json_string)
 {
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
     if (m_config->configure(json_string) != MEDIA_LIBRARY_SUCCESS)
     {
         LOGGER__ERROR("Failed to configure encoder");
@@ -194,6 +288,7 @@ media_library_return Encoder::configure(const encoder_config_t &config)
 
 media_library_return Encoder::Impl::configure(const encoder_config_t &config)
 {
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
     m_update_required = {ENCODER_CONFIG_CODING_CONTROL, ENCODER_CONFIG_PRE_PROCESSING, ENCODER_CONFIG_RATE_CONTROL};
 
     bool gop_update_required = gop_config_update_required(std::get<hailo_encoder_config_t>(config));
@@ -405,6 +500,7 @@ void Encoder::force_keyframe() { m_impl->force_keyframe(); }
 
 void Encoder::Impl::force_keyframe()
 {
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
     LOGGER__INFO("Encoder - Force Keyframe");
     m_enc_in.codingType = m_next_coding_type = VCENC_INTRA_FRAME;
     m_enc_in.poc = 0;
@@ -416,7 +512,11 @@ encoder_config_t Encoder::get_config()
     return m_impl->get_config();
 }
 
-encoder_config_t Encoder::Impl::get_config() { return m_config->get_config(); }
+encoder_config_t Encoder::Impl::get_config()
+{
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
+    return m_config->get_config();
+}
 
 EncoderOutputBuffer Encoder::start() { return m_impl->start(); }
 
@@ -455,6 +555,7 @@ EncoderOutputBuffer Encoder::stop() { return m_impl->stop(); }
 
 EncoderOutputBuffer Encoder::Impl::stop()
 {
+    stop_async();
     VCEncStrmEnd(m_inst, &m_enc_in, &m_enc_out);
     EncoderOutputBuffer output;
     auto ret = create_output_buffer(output);
@@ -469,16 +570,18 @@ EncoderOutputBuffer Encoder::Impl::stop()
     return output;
 }
 
-media_library_return Encoder::Impl::update_input_buffer(HailoMediaLibraryBufferPtr buf)
+media_library_return Encoder::Impl::prepare_input(HailoMediaLibraryBufferPtr buf, encoder_input_t &input)
 {
     int ret;
     uint32_t num_of_planes = buf->get_num_of_planes();
     u32 *plane_ptr = nullptr;
     int planeFd = -1;
     u32 plane_size = 0;
-    std::array<u32 *, 3> bus_addresses = {&(m_enc_in.busLuma),
-                                          &(m_enc_in.busChromaU),
-                                          &(m_enc_in.busChromaV)};
+    input.buffer = buf;
+    input.bus_addresses = {0, 0, 0};
+    input.stride = buf->get_plane_stride(0);
+    input.submit_time = encoder_scheduler_clock::now();
+    input.dmabuf_shared = false;
 
     if (num_of_planes == 0 || num_of_planes > 3)
     {
@@ -497,17 +600,18 @@ media_library_return Encoder::Impl::update_input_buffer(HailoMediaLibraryBufferP
                 LOGGER__ERROR("Could not get dmabuf fd of plane {}", i);
                 return MEDIA_LIBRARY_BUFFER_NOT_FOUND;
             }
-            ret = EWLShareDmabuf(m_ewl, planeFd, bus_addresses[i]);
+            ret = m_dmabuf_cache->share(planeFd, &input.bus_addresses[i]);
             if (ret != EWL_OK)
             {
                 LOGGER__ERROR("Could not get physical address of plane {}", i);
                 for (uint32_t j = 0; j < i; j++)
                 {
-                    EWLUnshareDmabuf(m_ewl, buf->get_fd(j));
+                    m_dmabuf_cache->release(buf->get_fd(j));
                 }
                 return MEDIA_LIBRARY_ENCODER_COULD_NOT_GET_PHYSICAL_ADDRESS;
             }
         }
+        input.dmabuf_shared = true;
     }
     else
     {
@@ -520,7 +624,7 @@ media_library_return Encoder::Impl::update_input_buffer(HailoMediaLibraryBufferP
                 LOGGER__ERROR("Could not get plane {} of buffer", i);
                 return MEDIA_LIBRARY_ENCODER_COULD_NOT_GET_PHYSICAL_ADDRESS;
             }
-            ret = EWLGetBusAddress(m_ewl, plane_ptr, bus_addresses[i], plane_size);
+            ret = EWLGetBusAddress(m_ewl, plane_ptr, &input.bus_addresses[i], plane_size);
             if (ret != EWL_OK)
             {
                 LOGGER__ERROR("Could not get physical address of plane {}", i);
@@ -528,10 +632,27 @@ media_library_return Encoder::Impl::update_input_buffer(HailoMediaLibraryBufferP
             }
         }
     }
-    update_stride(buf->get_plane_stride(0));
     return MEDIA_LIBRARY_SUCCESS;
 }
 
+void Encoder::Impl::release_input(encoder_input_t &input)
+{
+    if (!input.dmabuf_shared)
+        return;
+    for (uint32_t i = 0; i < input.buffer->get_num_of_planes(); i++)
+    {
+        int planeFd = input.buffer->get_fd(i);
+        if (planeFd <= 0)
+        {
+            LOGGER__ERROR("Could not get dmabuf fd of plane {}", i);
+            continue;
+        }
+        // cached planes stay shared for the next frame of their buffer
+        m_dmabuf_cache->release(planeFd);
+    }
+    input.dmabuf_shared = false;
+}
+
 media_library_return
 Encoder::Impl::create_output_buffer(EncoderOutputBuffer &output_buf)
 {
@@ -542,7 +663,7 @@ Encoder::Impl::create_output_buffer(EncoderOutputBuffer &output_buf)
         buffer_ptr = output_buf.buffer;
         offset = output_buf.size;
     }
-    else
+    else if (m_enc_out.streamSize <= m_output_buffer_size)
     {
         hailo_media_library_buffer buffer;
         if (m_buffer_pool->acquire_buffer(buffer) != MEDIA_LIBRARY_SUCCESS)
@@ -553,6 +674,28 @@ Encoder::Impl::create_output_buffer(EncoderOutputBuffer &output_buf)
         buffer_ptr = std::make_shared<hailo_media_library_buffer>(std::move(buffer));
     }
 
+    if (buffer_ptr == nullptr || offset + m_enc_out.streamSize > buffer_ptr->get_plane_size(0))
+    {
+        // Frames above the bitrate budget - mostly IDR frames - get a buffer of their own, of their exact size
+        uint32_t size = offset + m_enc_out.streamSize;
+        uint8_t *data = new uint8_t[size];
+        LOGGER__DEBUG("Encoder - frame of {} bytes overflows the {} byte output buffers", size, m_output_buffer_size);
+        if (buffer_ptr != nullptr)
+        {
+            // Keep what was already written, the stream header of an IDR frame
+            bool is_dmabuf = buffer_ptr->is_dmabuf();
+            if (is_dmabuf)
+                DmaMemoryAllocator::get_instance().dmabuf_sync_start(buffer_ptr->get_plane(0));
+            memcpy(data, buffer_ptr->get_plane(0), offset);
+            if (is_dmabuf)
+                DmaMemoryAllocator::get_instance().dmabuf_sync_end(buffer_ptr->get_plane(0));
+            buffer_ptr->decrease_ref_count();
+        }
+        buffer_ptr = encoder_create_userptr_buffer(data, size, [data]()
+                                                   { delete[] data; });
+        m_overflow_frames++;
+    }
+
     bool is_dmabuf = buffer_ptr->is_dmabuf();
     if (is_dmabuf)
         DmaMemoryAllocator::get_instance().dmabuf_sync_start(buffer_ptr->get_plane(0));
@@ -566,6 +709,86 @@ Encoder::Impl::create_output_buffer(EncoderOutputBuffer &output_buf)
     return MEDIA_LIBRARY_SUCCESS;
 }
 
+void Encoder::Impl::copy_header(uint8_t *destination)
+{
+    bool is_dmabuf = m_header.buffer->is_dmabuf();
+    if (is_dmabuf)
+        DmaMemoryAllocator::get_instance().dmabuf_sync_start(m_header.buffer->get_plane(0));
+    memcpy(destination, m_header.buffer->get_plane(0), m_header.size);
+    if (is_dmabuf)
+        DmaMemoryAllocator::get_instance().dmabuf_sync_end(m_header.buffer->get_plane(0));
+}
+
+void Encoder::Impl::slice_ready(VCEncSliceReady *slice)
+{
+    Impl *impl = static_cast<Impl *>(slice->pAppData);
+    if (impl->m_slice_last_delivered)
+        return;
+
+    // The slices finished since the previous callback, the first callback of a frame with the NAL units before them
+    uint32_t first = (slice->slicesReadyPrev == 0) ? 0 : slice->nalUnitInfoNum + slice->slicesReadyPrev;
+    uint32_t size = 0;
+    for (uint32_t i = first; i < slice->nalUnitInfoNum + slice->slicesReady; i++)
+        size += slice->sliceSizes[i];
+    impl->deliver_slice(size, slice->slicesReady >= impl->m_slices_per_frame);
+}
+
+void Encoder::Impl::deliver_slice(uint32_t size, bool last)
+{
+    EncoderOutputSlice slice;
+    slice.first = (m_slice_delivered == 0);
+    slice.last = last;
+    uint32_t header_size = slice.first ? m_slice_header_size : 0;
+    uint8_t *data = m_slice_ptr + m_slice_delivered;
+    slice.size = header_size + size;
+    if (m_slice_region != nullptr)
+    {
+        // The stream header was copied in front of the frame, the slice references the ring region
+        slice.buffer = encoder_create_userptr_buffer(data - header_size, slice.size, [region = m_slice_region]() {});
+    }
+    else
+    {
+        // The ring is exhausted, the slice is copied out of the scratch memory
+        uint8_t *copy = new uint8_t[slice.size];
+        if (header_size > 0)
+            copy_header(copy);
+        memcpy(copy + header_size, data, size);
+        slice.buffer = encoder_create_userptr_buffer(copy, slice.size, [copy]()
+                                                     { delete[] copy; });
+    }
+    m_slice_delivered += size;
+    m_slice_last_delivered = last;
+    m_slice_callback(slice);
+}
+
+media_library_return Encoder::set_slice_output(uint32_t slice_size, EncoderSliceCallback callback)
+{
+    return m_impl->set_slice_output(slice_size, callback);
+}
+
+media_library_return Encoder::Impl::set_slice_output(uint32_t slice_size, EncoderSliceCallback callback)
+{
+    if (m_state == ENCODER_STATE_START)
+    {
+        LOGGER__ERROR("Encoder - slice output can not be changed while the stream is started");
+        return MEDIA_LIBRARY_ERROR;
+    }
+    if (slice_size > 0 && callback == nullptr)
+    {
+        LOGGER__ERROR("Encoder - slice output requires a callback");
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+
+    m_slice_size = slice_size;
+    m_slice_callback = callback;
+    if (m_state != ENCODER_STATE_UNINITIALIZED && init_coding_control_config() != VCENC_OK)
+    {
+        LOGGER__ERROR("Encoder - Failed to set the slice size to {}", slice_size);
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
 media_library_return
 Encoder::Impl::encode_multiple_frames(std::vector<EncoderOutputBuffer> &outputs)
 {
@@ -578,12 +801,17 @@ Encoder::Impl::encode_multiple_frames(std::vector<EncoderOutputBuffer> &outputs)
         return MEDIA_LIBRARY_ERROR;
     }
 
+    // The GOP can only be encoded from the submission of its last frame, its frames are due one deadline
+    // after the other from then - counted from their own submission the first frames would always be late
+    encoder_scheduler_clock::time_point gop_ready_time = m_inputs.back().submit_time;
+    std::chrono::microseconds deadline = get_scheduling_deadline();
     // Assuming enc_params->encIn.gopSize is not 0.
     for (uint8_t i = 0; i < gop_size; i++)
     {
         auto idx = m_enc_in.gopPicIdx +
                    m_gop_cfg->get_gop_cfg_offset()[m_enc_in.gopSize];
         auto poc = m_gop_cfg->get_gop_pic_cfg()[idx].poc;
+        m_inputs[poc - 1].submit_time = gop_ready_time + i * deadline;
         ret = encode_frame(m_inputs[poc - 1], outputs);
         if (ret != MEDIA_LIBRARY_SUCCESS)
         {
@@ -601,37 +829,18 @@ static int64_t time_diff(const struct timespec after,
            ((int64_t)after.tv_nsec - (int64_t)before.tv_nsec) / 1000000;
 }
 
-static void releaseDmabuf(HailoMediaLibraryBufferPtr buf, void *ewl)
-{
-    for (uint32_t i = 0; i < buf->get_num_of_planes(); i++)
-    {
-        int planeFd = buf->get_fd(i);
-        if (planeFd <= 0)
-        {
-            LOGGER__ERROR("Could not get dmabuf fd of plane {}", i);
-            continue;
-        }
-        if (EWLUnshareDmabuf(ewl, planeFd) != EWL_OK)
-        {
-            LOGGER__ERROR("Could not get physical address of plane {}", i);
-        }
-    }
-}
-
 media_library_return
-Encoder::Impl::encode_frame(HailoMediaLibraryBufferPtr buf,
+Encoder::Impl::encode_frame(encoder_input_t &input,
                             std::vector<EncoderOutputBuffer> &outputs)
 {
     LOGGER__DEBUG("Encoder - encode_frame");
     VCEncRet enc_ret = VCENC_OK;
     media_library_return ret = MEDIA_LIBRARY_UNINITIALIZED;
     struct timespec start_encode, end_encode;
-    ret = update_input_buffer(buf);
-    if (ret != MEDIA_LIBRARY_SUCCESS)
-    {
-        LOGGER__ERROR("Encoder - encode_frame - Failed to update input buffer");
-        return ret;
-    }
+    m_enc_in.busLuma = input.bus_addresses[0];
+    m_enc_in.busChromaU = input.bus_addresses[1];
+    m_enc_in.busChromaV = input.bus_addresses[2];
+    update_stride(input.stride);
 
     m_enc_in.codingType =
         (m_enc_in.poc == 0) ? VCENC_INTRA_FRAME : m_next_coding_type;
@@ -640,8 +849,79 @@ Encoder::Impl::encode_frame(HailoMediaLibraryBufferPtr buf,
         m_enc_in.poc = 0;
         m_counters.last_idr_picture_cnt = m_counters.picture_cnt;
     }
+    // Encode straight into the output ring, with room for the stream header an IDR frame starts with
+    std::optional<uint32_t> ring_offset;
+    uint32_t header_size = 0;
+    uint32_t frame_offset = 0;
+    if (m_enc_in.codingType == VCENC_INTRA_FRAME && m_header.buffer != nullptr)
+        header_size = m_header.size;
+    if (m_output_ring != nullptr)
+    {
+        uint32_t aligned_header_size = (header_size + ENCODER_OUTPUT_RING_ALIGNMENT - 1) & ~(uint32_t)(ENCODER_OUTPUT_RING_ALIGNMENT - 1);
+        // The frame may take all the contiguous free room of the ring - the largest frame when the ring is empty.
+        // Only the part it used is taken from the ring once it is encoded.
+        uint32_t available = 0;
+        ring_offset = m_output_ring->reserve(aligned_header_size + ENCODER_OUTPUT_RING_FRAME_SIZE, &available);
+        if (ring_offset.has_value())
+        {
+            uint32_t frame_size = std::min<uint32_t>(available - aligned_header_size, ENCODER_OUTPUT_FRAME_MAX_SIZE);
+            frame_offset = ring_offset.value() + aligned_header_size;
+            m_enc_in.busOutBuf = m_output_ring->bus_address(frame_offset);
+            m_enc_in.pOutBuf = m_output_ring->virtual_address(frame_offset);
+            m_enc_in.outBufSize = frame_size;
+            // Only the small stream header is copied, in front of the frame the encoder writes
+            if (header_size > 0)
+                copy_header(reinterpret_cast<uint8_t *>(m_enc_in.pOutBuf) - header_size);
+            if (m_multislice_encoding)
+                m_slice_region = m_output_ring->hold(ring_offset.value(), aligned_header_size + frame_size);
+        }
+        else
+        {
+            LOGGER__DEBUG("Encoder - encode_frame - Output ring exhausted, copying the frame");
+        }
+    }
+    if (!ring_offset.has_value() && grow_scratch_output_memory() != MEDIA_LIBRARY_SUCCESS)
+    {
+        release_input(input);
+        return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+    }
+    if (m_multislice_encoding)
+    {
+        m_sliced_frames++;
+        if (m_slice_region != nullptr)
+            m_sliced_ring_frames++;
+        m_slice_ptr = reinterpret_cast<uint8_t *>(m_enc_in.pOutBuf);
+        m_slice_header_size = header_size;
+        m_slice_delivered = 0;
+        m_slice_last_delivered = false;
+    }
+
     clock_gettime(CLOCK_MONOTONIC, &start_encode);
-    enc_ret = VCEncStrmEncode(m_inst, &m_enc_in, &m_enc_out, NULL, NULL);
+    // The core is shared with the other encoders in the process, the frame with the earliest deadline goes first.
+    // The slice callbacks run inside the encode, their time counts as core time.
+    EncoderScheduler::get_instance().acquire(m_scheduler_stream, input.submit_time);
+    enc_ret = VCEncStrmEncode(m_inst, &m_enc_in, &m_enc_out, m_multislice_encoding ? &Encoder::Impl::slice_ready : NULL, this);
+    if (enc_ret == VCENC_OUTPUT_BUFFER_OVERFLOW && ring_offset.has_value())
+    {
+        m_ring_overflow_frames++;
+        if (m_multislice_encoding)
+        {
+            // Its first slices were already delivered, the frame can not be encoded again
+            LOGGER__ERROR("Encoder - encode_frame - Sliced frame overflowed the {} bytes free in the output ring", m_enc_in.outBufSize);
+        }
+        else if (grow_scratch_output_memory() == MEDIA_LIBRARY_SUCCESS)
+        {
+            // The encoder drops a frame that overflows its output buffer - encode it again into the scratch memory,
+            // which holds the largest frame, and copy it out
+            LOGGER__DEBUG("Encoder - encode_frame - Frame overflowed the {} bytes free in the output ring, encoding it again", m_enc_in.outBufSize);
+            ring_offset.reset();
+            use_scratch_output_memory();
+            enc_ret = VCEncStrmEncode(m_inst, &m_enc_in, &m_enc_out, NULL, this);
+        }
+    }
+    EncoderScheduler::get_instance().release(m_scheduler_stream, input.submit_time);
+    if (ring_offset.has_value())
+        use_scratch_output_memory();
 
     clock_gettime(CLOCK_MONOTONIC, &end_encode);
     LOGGER__DEBUG("Encoding of frame took {} ms", time_diff(end_encode, start_encode));
@@ -658,8 +938,22 @@ Encoder::Impl::encode_frame(HailoMediaLibraryBufferPtr buf,
         }
         else
         {
-            if (!m_multislice_encoding)
+            if (m_multislice_encoding)
+            {
+                // The rest of the frame, if the encoder reported fewer slices than expected
+                if (m_slice_delivered < m_enc_out.streamSize || !m_slice_last_delivered)
+                    deliver_slice(m_enc_out.streamSize - m_slice_delivered, true);
+            }
+            else if (ring_offset.has_value())
             {
+                EncoderOutputBuffer output;
+                output.size = header_size + m_enc_out.streamSize;
+                output.buffer = m_output_ring->commit(ring_offset.value(), frame_offset - header_size, output.size);
+                outputs.emplace_back(std::move(output));
+            }
+            else
+            {
+                m_copied_frames++;
                 EncoderOutputBuffer output;
                 if (m_enc_in.codingType == VCENC_INTRA_FRAME)
                 {
@@ -671,9 +965,7 @@ Encoder::Impl::encode_frame(HailoMediaLibraryBufferPtr buf,
                 {
                     LOGGER__ERROR("Encoder - encode_frame - Failed to create "
                                   "output buffer");
-                    if (buf->is_dmabuf()){
-                        releaseDmabuf(buf, m_ewl);
-                    }
+                    release_input(input);
                     return ret;
                 }
                 outputs.emplace_back(std::move(output));
@@ -704,9 +996,13 @@ Encoder::Impl::encode_frame(HailoMediaLibraryBufferPtr buf,
         break;
     }
     }
-    if (buf->is_dmabuf()){
-        releaseDmabuf(buf, m_ewl);
+    if (m_slice_region != nullptr)
+    {
+        // The slices handed out keep the used part of the region
+        m_output_ring->shrink(ring_offset.value(), frame_offset - ring_offset.value() + m_slice_delivered);
+        m_slice_region.reset();
     }
+    release_input(input);
     return ret;
 }
 
@@ -718,7 +1014,26 @@ std::vector<EncoderOutputBuffer> Encoder::handle_frame(HailoMediaLibraryBufferPt
 std::vector<EncoderOutputBuffer>
 Encoder::Impl::handle_frame(HailoMediaLibraryBufferPtr buf)
 {
-    LOGGER__DEBUG("Start Handling Frame with plane 0 of size {} for buffer id {}", buf->get_plane_size(0), buf->buffer_index);
+    if (m_async_queue != nullptr)
+    {
+        // The encode thread owns the coding state while async encode runs
+        LOGGER__ERROR("Encoder - handle_frame can not be called while async encode runs, use submit_frame");
+        return {};
+    }
+    encoder_input_t input;
+    if (prepare_input(buf, input) != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("Encoder - handle_frame - Failed to update input buffer");
+        return {};
+    }
+    return handle_input(input);
+}
+
+std::vector<EncoderOutputBuffer>
+Encoder::Impl::handle_input(encoder_input_t &input)
+{
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
+    LOGGER__DEBUG("Start Handling Frame with plane 0 of size {} for buffer id {}", input.buffer->get_plane_size(0), input.buffer->buffer_index);
     std::vector<EncoderOutputBuffer> outputs;
     outputs.clear();
     media_library_return ret = MEDIA_LIBRARY_UNINITIALIZED;
@@ -738,26 +1053,31 @@ Encoder::Impl::handle_frame(HailoMediaLibraryBufferPtr buf)
     {
     case VCENC_INTRA_FRAME:
     {
-        ret = encode_frame(buf, outputs);
+        ret = encode_frame(input, outputs);
         break;
     }
     case VCENC_PREDICTED_FRAME:
     {
         if (m_inputs.size() == (size_t)m_enc_in.gopSize - 1)
         {
-            buf->increase_ref_count();
-            m_inputs.emplace_back(buf);
+            input.buffer->increase_ref_count();
+            m_inputs.emplace_back(input);
             ret = encode_multiple_frames(outputs);
-            for (auto &input : m_inputs)
+            for (auto &gop_input : m_inputs)
             {
-                input->decrease_ref_count();
+                // frames left unencoded after an error
+                release_input(gop_input);
+                gop_input.buffer->decrease_ref_count();
             }
             m_inputs.clear();
+            input.dmabuf_shared = false;
         }
         else if (m_inputs.size() < (size_t)m_enc_in.gopSize - 1)
         {
-            buf->increase_ref_count();
-            m_inputs.emplace_back(buf);
+            input.buffer->increase_ref_count();
+            m_inputs.emplace_back(input);
+            // shared until the GOP is encoded
+            input.dmabuf_shared = false;
             ret = MEDIA_LIBRARY_SUCCESS;
         }
         else
@@ -779,6 +1099,8 @@ Encoder::Impl::handle_frame(HailoMediaLibraryBufferPtr buf)
     }
     }
 
+    // a frame that was not encoded or kept for its GOP
+    release_input(input);
     if (ret != MEDIA_LIBRARY_SUCCESS)
     {
         LOGGER__ERROR("Encoder Error - encoding frame returned {}", ret);
@@ -789,6 +1111,164 @@ Encoder::Impl::handle_frame(HailoMediaLibraryBufferPtr buf)
     return outputs;
 }
 
+media_library_return Encoder::start_async(EncoderOutputCallback callback, uint32_t queue_size)
+{
+    return m_impl->start_async(callback, queue_size);
+}
+
+media_library_return Encoder::submit_frame(HailoMediaLibraryBufferPtr buf)
+{
+    return m_impl->submit_frame(buf);
+}
+
+media_library_return Encoder::stop_async()
+{
+    return m_impl->stop_async();
+}
+
+media_library_return Encoder::Impl::start_async(EncoderOutputCallback callback, uint32_t queue_size)
+{
+    if (m_state != ENCODER_STATE_START)
+    {
+        LOGGER__ERROR("Encoder - async encode requires a started stream");
+        return MEDIA_LIBRARY_ERROR;
+    }
+    if (m_async_queue != nullptr)
+    {
+        LOGGER__ERROR("Encoder - async encode is already running");
+        return MEDIA_LIBRARY_ERROR;
+    }
+    if (callback == nullptr || queue_size == 0)
+    {
+        LOGGER__ERROR("Encoder - async encode requires a callback and a queue of at least one frame");
+        return MEDIA_LIBRARY_INVALID_ARGUMENT;
+    }
+
+    m_output_callback = callback;
+    m_async_queue = std::make_unique<SpscRing<encoder_input_t>>(queue_size);
+    m_async_thread = std::thread(&Encoder::Impl::async_loop, this);
+    LOGGER__INFO("Encoder - async encode started with a queue of {} frames", queue_size);
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return Encoder::Impl::submit_frame(HailoMediaLibraryBufferPtr buf)
+{
+    if (m_async_queue == nullptr)
+    {
+        LOGGER__ERROR("Encoder - submit_frame requires async encode to be started");
+        return MEDIA_LIBRARY_ERROR;
+    }
+
+    // The bus addresses are set up here, while the encode thread encodes the previous frame
+    encoder_input_t input;
+    media_library_return ret = prepare_input(buf, input);
+    if (ret != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("Encoder - submit_frame - Failed to update input buffer");
+        return ret;
+    }
+    buf->increase_ref_count();
+    if (!m_async_queue->push(input))
+    {
+        LOGGER__ERROR("Encoder - submit_frame - async encode is stopping");
+        release_input(input);
+        buf->decrease_ref_count();
+        return MEDIA_LIBRARY_ERROR;
+    }
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return Encoder::Impl::stop_async()
+{
+    if (m_async_queue == nullptr)
+        return MEDIA_LIBRARY_SUCCESS;
+
+    // The queued frames are still encoded before the thread exits
+    m_async_queue->close();
+    if (m_async_thread.joinable())
+        m_async_thread.join();
+    m_async_queue.reset();
+    m_output_callback = nullptr;
+    LOGGER__INFO("Encoder - async encode stopped");
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+void Encoder::Impl::async_loop()
+{
+    while (std::optional<encoder_input_t> input = m_async_queue->pop())
+    {
+        std::vector<EncoderOutputBuffer> outputs = handle_input(*input);
+        input->buffer->decrease_ref_count();
+        if (!outputs.empty())
+            m_output_callback(outputs);
+    }
+}
+
+media_library_return Encoder::set_scheduling(uint32_t priority, uint32_t deadline_us)
+{
+    return m_impl->set_scheduling(priority, deadline_us);
+}
+
+EncoderSchedulingStats Encoder::get_scheduling_stats()
+{
+    return m_impl->get_scheduling_stats();
+}
+
+media_library_return Encoder::Impl::set_scheduling(uint32_t priority, uint32_t deadline_us)
+{
+    m_scheduling_priority = priority;
+    m_scheduling_deadline_us = deadline_us;
+    if (m_scheduler_stream != 0)
+        EncoderScheduler::get_instance().update_stream(m_scheduler_stream, priority, get_scheduling_deadline());
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+EncoderOutputStats Encoder::get_output_stats()
+{
+    return m_impl->get_output_stats();
+}
+
+EncoderOutputStats Encoder::Impl::get_output_stats()
+{
+    std::unique_lock<std::mutex> lock(m_encode_mutex);
+    EncoderOutputStats stats = {};
+    if (m_output_ring != nullptr)
+        stats.ring_frames = m_output_ring->get_stats().commits;
+    stats.copied_frames = m_copied_frames;
+    stats.ring_overflow_frames = m_ring_overflow_frames;
+    stats.sliced_frames = m_sliced_frames;
+    stats.sliced_ring_frames = m_sliced_ring_frames;
+    return stats;
+}
+
+EncoderSchedulingStats Encoder::Impl::get_scheduling_stats()
+{
+    if (m_scheduler_stream == 0)
+        return {};
+    return EncoderScheduler::get_instance().get_stats(m_scheduler_stream);
+}
+
+std::chrono::microseconds Encoder::Impl::get_scheduling_deadline()
+{
+    if (m_scheduling_deadline_us != 0)
+        return std::chrono::microseconds(m_scheduling_deadline_us);
+    if (m_vc_cfg.frameRateNum == 0)
+        return std::chrono::microseconds(0);
+    return std::chrono::microseconds((uint64_t)1000000 * m_vc_cfg.frameRateDenom / m_vc_cfg.frameRateNum);
+}
+
+void Encoder::Impl::update_scheduling()
+{
+    if (m_scheduler_stream != 0)
+    {
+        EncoderScheduler::get_instance().update_stream(m_scheduler_stream, m_scheduling_priority, get_scheduling_deadline());
+        return;
+    }
+    std::string name = std::to_string(m_vc_cfg.width) + "x" + std::to_string(m_vc_cfg.height) + "@" +
+                       std::to_string(m_vc_cfg.frameRateNum);
+    m_scheduler_stream = EncoderScheduler::get_instance().register_stream(name, m_scheduling_priority, get_scheduling_deadline());
+}
+
 VCEncPictureCodingType Encoder::Impl::find_next_pic()
 {
     VCEncPictureCodingType nextCodingType;
@@ -349,7 +349,12 @@ VCEncRet Encoder::Impl::init_coding_control_config()
         return ret;
     }
 
-    m_vc_coding_cfg.sliceSize = 0;
+    // Slices are delivered as soon as they are encoded, see set_slice_output
+    m_vc_coding_cfg.sliceSize = m_slice_size;
+    m_multislice_encoding = (m_slice_size > 0);
+    uint32_t ctb_size = m_vc_cfg.codecH264 ? ENCODER_H264_MACROBLOCK_SIZE : ENCODER_HEVC_CTB_SIZE;
+    uint32_t ctb_rows = (m_vc_cfg.height + ctb_size - 1) / ctb_size;
+    m_slices_per_frame = (m_slice_size > 0) ? (ctb_rows + m_slice_size - 1) / m_slice_size : 1;
     m_vc_coding_cfg.disableDeblockingFilter = 0;
     m_vc_coding_cfg.tc_Offset = coding_control.deblocking_filter.tc_offset;
     m_vc_coding_cfg.beta_Offset = coding_control.deblocking_filter.beta_offset;
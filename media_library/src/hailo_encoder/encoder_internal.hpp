@@ -21,8 +21,11 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #pragma once
+#include <array>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 extern "C"
@@ -37,7 +40,30 @@ extern "C"
 #include "buffer_pool.hpp"
 #include "encoder_class.hpp"
 #include "encoder_gop_config.hpp"
+#include "ewl_dmabuf_cache.hpp"
+#include "encoder_output_ring.hpp"
 #include "encoder_internal.hpp"
+#include "encoder_scheduler.hpp"
+#include "spsc_ring.hpp"
+
+// Largest frame the encoder may write
+#define ENCODER_OUTPUT_FRAME_MAX_SIZE (12 * 1024 * 1024)
+// Room for the stream header prepended to an IDR frame
+#define ENCODER_OUTPUT_HEADER_RESERVE (4 * 1024)
+// Linear memory of the output ring - the largest frame fits in the empty ring
+#define ENCODER_OUTPUT_RING_SIZE (ENCODER_OUTPUT_FRAME_MAX_SIZE + ENCODER_OUTPUT_HEADER_RESERVE)
+// Least room a frame needs in the ring, it may grow into all the contiguous free room -
+// a non-sliced frame larger than that room is encoded again into the scratch memory
+#define ENCODER_OUTPUT_RING_FRAME_SIZE (4 * 1024 * 1024)
+// Linear memory for the stream headers while frames go to the ring, grown to the largest frame the first time
+// the ring has no room for a frame
+#define ENCODER_OUTPUT_SCRATCH_SIZE (64 * 1024)
+// Largest share of the GOP bitrate budget an IDR frame is assumed to take, in average frames
+#define ENCODER_OUTPUT_IDR_FRAME_FACTOR (8)
+#define ENCODER_OUTPUT_BUFFER_MIN_SIZE (64 * 1024)
+// Height of the block rows a slice is made of
+#define ENCODER_HEVC_CTB_SIZE (64)
+#define ENCODER_H264_MACROBLOCK_SIZE (16)
 
 enum encoder_stream_restart_t
 {
@@ -54,6 +80,18 @@ enum encoder_config_type_t
   ENCODER_CONFIG_GOP,
   ENCODER_CONFIG_STREAM
 };
+// An input frame with its bus addresses, ready for the encoder
+struct encoder_input_t
+{
+  HailoMediaLibraryBufferPtr buffer;
+  std::array<u32, 3> bus_addresses;
+  uint32_t stride;
+  // the deadline of the frame counts from its submission, moved to its turn in the GOP once the GOP can be encoded
+  encoder_scheduler_clock::time_point submit_time;
+  // the dmabuf planes are shared with the EWL until the frame is encoded
+  bool dmabuf_shared;
+};
+
 struct EncoderCounters
 {
   i32 picture_cnt;
@@ -98,23 +136,67 @@ private:
   VCEncPictureCodingType m_next_coding_type;
   EncoderCounters m_counters;
   void *m_ewl;
+  // released with the last output ring buffer, which may outlive the encoder
+  std::shared_ptr<void> m_ewl_instance;
+  // input dmabufs stay shared with the EWL across frames
+  std::unique_ptr<EwlDmabufCache> m_dmabuf_cache;
   bool m_multislice_encoding;
+  // slice output, in block rows per slice
+  uint32_t m_slice_size;
+  uint32_t m_slices_per_frame;
+  EncoderSliceCallback m_slice_callback;
+  // the frame being delivered slice by slice
+  uint8_t *m_slice_ptr;
+  uint32_t m_slice_header_size;
+  uint32_t m_slice_delivered;
+  bool m_slice_last_delivered;
+  // the ring region of the frame, held by the slices handed out
+  std::shared_ptr<void> m_slice_region;
   EWLLinearMem_t m_output_memory;
-  std::vector<HailoMediaLibraryBufferPtr> m_inputs;
+  // encoded frames are handed out of the ring without a copy
+  EncoderOutputRingPtr m_output_ring;
+  uint64_t m_copied_frames;
+  uint64_t m_ring_overflow_frames;
+  // frames delivered slice by slice, and those of them delivered out of the ring
+  uint64_t m_sliced_frames;
+  uint64_t m_sliced_ring_frames;
+  std::vector<encoder_input_t> m_inputs;
+  // async encode - frames prepared on the submitting thread, encoded on m_async_thread
+  std::unique_ptr<SpscRing<encoder_input_t>> m_async_queue;
+  std::thread m_async_thread;
+  EncoderOutputCallback m_output_callback;
+  // id of the stream in the encoder scheduler, 0 while not registered
+  uint64_t m_scheduler_stream;
+  uint32_t m_scheduling_priority;
+  // 0 for one frame interval
+  uint32_t m_scheduling_deadline_us;
   EncoderOutputBuffer m_header;
   std::shared_ptr<EncoderConfig> m_config;
   class gopConfig;
   std::unique_ptr<gopConfig> m_gop_cfg;
   MediaLibraryBufferPoolPtr m_buffer_pool;
+  uint32_t m_output_buffer_size;
+  // frames that did not fit in an output pool buffer
+  uint64_t m_overflow_frames;
   encoder_stream_restart_t m_stream_restart;
   encoder_state_t m_state;
 
   std::vector<encoder_config_type_t> m_update_required;
+  // configure() may be called from any thread while frames are encoded on the async thread -
+  // guards m_config, m_update_required, m_stream_restart and the coding state for the length of an encode
+  std::mutex m_encode_mutex;
 
 public:
   Impl(std::string json_string);
   ~Impl();
   std::vector<EncoderOutputBuffer> handle_frame(HailoMediaLibraryBufferPtr buf);
+  media_library_return set_slice_output(uint32_t slice_size, EncoderSliceCallback callback);
+  media_library_return start_async(EncoderOutputCallback callback, uint32_t queue_size);
+  media_library_return submit_frame(HailoMediaLibraryBufferPtr buf);
+  media_library_return stop_async();
+  media_library_return set_scheduling(uint32_t priority, uint32_t deadline_us);
+  EncoderSchedulingStats get_scheduling_stats();
+  EncoderOutputStats get_output_stats();
   void force_keyframe();
   void update_stride(uint32_t stride);
   int get_gop_size();
@@ -135,6 +217,7 @@ private:
   int init_gop_config();
   void create_gop_config();
   void init_buffer_pool(uint pool_size);
+  uint32_t get_output_buffer_size();
   VCEncRet init_coding_control_config();
   VCEncRet init_rate_control_config();
   VCEncRet init_preprocessing_config();
@@ -143,15 +226,25 @@ private:
   VCEncLevel get_level(std::string level, bool codecH264);
   VCEncPictureType get_input_format(std::string format);
   VCEncPictureCodingType find_next_pic();
-  media_library_return update_input_buffer(HailoMediaLibraryBufferPtr buf);
+  media_library_return prepare_input(HailoMediaLibraryBufferPtr buf, encoder_input_t &input);
+  void release_input(encoder_input_t &input);
+  std::vector<EncoderOutputBuffer> handle_input(encoder_input_t &input);
+  void async_loop();
+  std::chrono::microseconds get_scheduling_deadline();
+  void update_scheduling();
   media_library_return create_output_buffer(EncoderOutputBuffer &output_buf);
   int allocate_output_memory();
+  void use_scratch_output_memory();
+  media_library_return grow_scratch_output_memory();
+  void copy_header(uint8_t *destination);
+  static void slice_ready(VCEncSliceReady *slice);
+  void deliver_slice(uint32_t size, bool last);
   media_library_return update_configurations();
   media_library_return update_gop_configurations();
   media_library_return stream_restart();
   media_library_return encode_header();
   media_library_return
-  encode_frame(HailoMediaLibraryBufferPtr buf,
+  encode_frame(encoder_input_t &input,
                std::vector<EncoderOutputBuffer> &outputs);
   media_library_return
   encode_multiple_frames(std::vector<EncoderOutputBuffer> &outputs);
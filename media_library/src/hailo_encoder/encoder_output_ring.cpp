@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_output_ring.cpp
+ * @brief Ring of encoded frames over EWL linear memory, handed out without a copy
+ **/
+
+#include "encoder_output_ring.hpp"
+#include "media_library_logger.hpp"
+
+static inline uint32_t ring_align(uint32_t size)
+{
+    return (size + ENCODER_OUTPUT_RING_ALIGNMENT - 1) & ~(uint32_t)(ENCODER_OUTPUT_RING_ALIGNMENT - 1);
+}
+
+tl::expected<std::shared_ptr<EncoderOutputRing>, media_library_return> EncoderOutputRing::create(std::shared_ptr<void> ewl, uint32_t size)
+{
+    EWLLinearMem_t memory;
+    if (EWLMallocLinear((const void *)ewl.get(), size, ENCODER_OUTPUT_RING_ALIGNMENT, &memory) != EWL_OK)
+    {
+        LOGGER__ERROR("Encoder output ring - Failed to allocate {} bytes of linear memory", size);
+        return tl::make_unexpected(MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR);
+    }
+    LOGGER__DEBUG("Encoder output ring - Allocated {} bytes of linear memory", memory.size);
+    return std::shared_ptr<EncoderOutputRing>(new EncoderOutputRing(ewl, memory));
+}
+
+EncoderOutputRing::EncoderOutputRing(std::shared_ptr<void> ewl, EWLLinearMem_t memory) : m_ewl(ewl), m_memory(memory)
+{
+}
+
+EncoderOutputRing::~EncoderOutputRing()
+{
+    LOGGER__DEBUG("Encoder output ring - {} frames handed out, ring exhausted {} times", m_commits, m_exhausted);
+    EWLFreeLinear((const void *)m_ewl.get(), &m_memory);
+}
+
+std::optional<uint32_t> EncoderOutputRing::reserve(uint32_t size, uint32_t *available)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    size = ring_align(size);
+    uint32_t offset = 0;
+    uint32_t free_size = 0;
+    if (m_slots.empty())
+    {
+        m_tail = 0;
+        free_size = m_memory.size;
+    }
+    else
+    {
+        uint32_t head = m_slots.front().offset;
+        if (m_tail > head)
+        {
+            // Free space at the end of the ring, and before the oldest region once the end is skipped
+            offset = m_tail;
+            free_size = m_memory.size - m_tail;
+            if (free_size < size)
+            {
+                offset = 0;
+                free_size = head;
+            }
+        }
+        else
+        {
+            // Wrapped - the free space is between the newest and the oldest region
+            offset = m_tail;
+            free_size = head - m_tail;
+        }
+    }
+
+    if (free_size < size)
+    {
+        m_exhausted++;
+        return std::nullopt;
+    }
+    if (available != nullptr)
+        *available = free_size & ~(uint32_t)(ENCODER_OUTPUT_RING_ALIGNMENT - 1);
+    return offset;
+}
+
+HailoMediaLibraryBufferPtr encoder_create_userptr_buffer(void *data, uint32_t size, std::function<void()> on_destroy)
+{
+    DspImagePropertiesPtr hailo_pix_buffer = std::make_shared<dsp_image_properties_t>();
+    dsp_data_plane_t *plane = new dsp_data_plane_t[1];
+    plane[0] = {};
+    plane[0].userptr = data;
+    plane[0].bytesperline = size;
+    plane[0].bytesused = size;
+    hailo_pix_buffer->width = size;
+    hailo_pix_buffer->height = 1;
+    hailo_pix_buffer->planes = plane;
+    hailo_pix_buffer->planes_count = 1;
+    hailo_pix_buffer->format = DSP_IMAGE_FORMAT_GRAY8;
+    hailo_pix_buffer->memory = DSP_MEMORY_TYPE_USERPTR;
+
+    // The memory is released with the buffer, not with its plane reference count - users release the plane
+    // before they are done with the data pointer
+    HailoMediaLibraryBufferPtr buffer(new hailo_media_library_buffer,
+                                      [on_destroy](hailo_media_library_buffer *buffer)
+                                      {
+                                          // a plane still referenced is released here, disposing the buffer
+                                          if (buffer->hailo_pix_buffer != nullptr && buffer->refcount(0) > 0)
+                                          {
+                                              while (buffer->hailo_pix_buffer != nullptr && buffer->decrease_ref_count(0))
+                                                  ;
+                                          }
+                                          delete buffer;
+                                          on_destroy();
+                                      });
+    buffer->create(nullptr, hailo_pix_buffer);
+    buffer->increase_ref_count();
+    return buffer;
+}
+
+HailoMediaLibraryBufferPtr EncoderOutputRing::commit(uint32_t offset, uint32_t data_offset, uint32_t data_size)
+{
+    std::shared_ptr<void> region = hold(offset, data_offset + data_size - offset);
+    return encoder_create_userptr_buffer(reinterpret_cast<uint8_t *>(m_memory.virtualAddress) + data_offset, data_size,
+                                         [region]() {});
+}
+
+std::shared_ptr<void> EncoderOutputRing::hold(uint32_t offset, uint32_t size)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size = ring_align(size);
+        m_slots.push_back({offset, size, false});
+        m_tail = offset + size;
+        m_commits++;
+    }
+
+    std::shared_ptr<EncoderOutputRing> ring = shared_from_this();
+    return std::shared_ptr<void>(nullptr, [ring, offset](void *)
+                                 { ring->release(offset); });
+}
+
+void EncoderOutputRing::shrink(uint32_t offset, uint32_t size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Only the newest region borders the free space - once it is released it may already be gone
+    if (m_slots.empty() || m_slots.back().offset != offset)
+        return;
+    m_slots.back().size = ring_align(size);
+    m_tail = offset + m_slots.back().size;
+}
+
+void EncoderOutputRing::release(uint32_t offset)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (slot_t &slot : m_slots)
+    {
+        if (slot.offset == offset && !slot.released)
+        {
+            slot.released = true;
+            break;
+        }
+    }
+    while (!m_slots.empty() && m_slots.front().released)
+        m_slots.pop_front();
+}
+
+encoder_output_ring_stats_t EncoderOutputRing::get_stats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    size_t outstanding = 0;
+    for (const slot_t &slot : m_slots)
+    {
+        if (!slot.released)
+            outstanding++;
+    }
+    return {m_commits, m_exhausted, outstanding};
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file encoder_output_ring.hpp
+ * @brief Ring of encoded frames over EWL linear memory, handed out without a copy
+ **/
+
+#pragma once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tl/expected.hpp>
+
+extern "C"
+{
+#include "video_encoder/base_type.h"
+#include "video_encoder/ewl.h"
+}
+
+#include "buffer_pool.hpp"
+#include "media_library_types.hpp"
+
+// Alignment of the regions the encoder writes to
+#define ENCODER_OUTPUT_RING_ALIGNMENT (64)
+
+struct encoder_output_ring_stats_t
+{
+    // number of frames handed out of the ring
+    uint64_t commits;
+    // number of reservations that did not fit in the free part of the ring
+    uint64_t exhausted;
+    // number of frames still referenced by their users
+    size_t outstanding;
+};
+
+/**
+ * @brief Ring of encoded frames in one EWL linear memory allocation.
+ *
+ * The encoder writes a frame straight into a reserved region of the ring, the region is then committed and handed out
+ * as a single plane buffer pointing into the ring. The region is recycled when the last reference to its buffer is
+ * dropped, frames may be released in any order. A reservation only succeeds if a contiguous region of the requested
+ * size is free - the caller falls back to its own memory when the ring is exhausted.
+ * The ring and the buffers it handed out keep the EWL instance alive, so they may outlive the encoder.
+ */
+class EncoderOutputRing : public std::enable_shared_from_this<EncoderOutputRing>
+{
+public:
+    /**
+     * @brief Allocate a ring of linear memory on an EWL instance.
+     *
+     * @param[in] ewl - EWL instance the memory is allocated on, released with the last reference
+     * @param[in] size - size of the ring in bytes
+     * @return tl::expected<std::shared_ptr<EncoderOutputRing>, media_library_return> - the ring or an error
+     */
+    static tl::expected<std::shared_ptr<EncoderOutputRing>, media_library_return> create(std::shared_ptr<void> ewl, uint32_t size);
+
+    ~EncoderOutputRing();
+    EncoderOutputRing(const EncoderOutputRing &) = delete;
+    EncoderOutputRing &operator=(const EncoderOutputRing &) = delete;
+
+    /**
+     * @brief Find a free contiguous region for the next frame. Only one reservation may be open at a time.
+     * Nothing is taken from the ring until the region is committed.
+     *
+     * @param[in] size - least size of the region in bytes
+     * @param[out] available - if not null, the contiguous free bytes from the offset, at least size - the region may
+     * grow into them up to the commit
+     * @return std::optional<uint32_t> - aligned offset of the region, or nothing if the ring is exhausted
+     */
+    std::optional<uint32_t> reserve(uint32_t size, uint32_t *available = nullptr);
+
+    /**
+     * @brief Take the used part of a reserved region and hand out its data as a buffer.
+     *
+     * @param[in] offset - offset of the region, as returned by reserve
+     * @param[in] data_offset - offset of the data in the ring, inside the region
+     * @param[in] data_size - size of the data in bytes
+     * @return HailoMediaLibraryBufferPtr - buffer referencing the data, its region is recycled when it is destroyed
+     */
+    HailoMediaLibraryBufferPtr commit(uint32_t offset, uint32_t data_offset, uint32_t data_size);
+
+    /**
+     * @brief Take a reserved region while the encoder still writes to it, for data handed out before it is complete.
+     *
+     * @param[in] offset - offset of the region, as returned by reserve
+     * @param[in] size - size of the region in bytes
+     * @return std::shared_ptr<void> - the region is recycled when the last copy is dropped
+     */
+    std::shared_ptr<void> hold(uint32_t offset, uint32_t size);
+
+    /**
+     * @brief Give back the unused end of the newest held region, once the encoder is done with it.
+     */
+    void shrink(uint32_t offset, uint32_t size);
+
+    u32 *virtual_address(uint32_t offset)
+    {
+        return reinterpret_cast<u32 *>(reinterpret_cast<uint8_t *>(m_memory.virtualAddress) + offset);
+    }
+
+    ptr_t bus_address(uint32_t offset)
+    {
+        return m_memory.busAddress + offset;
+    }
+
+    uint32_t size()
+    {
+        return m_memory.size;
+    }
+
+    encoder_output_ring_stats_t get_stats();
+
+private:
+    struct slot_t
+    {
+        uint32_t offset;
+        uint32_t size;
+        bool released;
+    };
+
+    std::shared_ptr<void> m_ewl;
+    EWLLinearMem_t m_memory;
+    std::mutex m_mutex;
+    // Committed regions in ring order, the front is the oldest
+    std::deque<slot_t> m_slots;
+    // Offset the next region is taken from
+    uint32_t m_tail = 0;
+
+    // statistics
+    uint64_t m_commits = 0;
+    uint64_t m_exhausted = 0;
+
+    EncoderOutputRing(std::shared_ptr<void> ewl, EWLLinearMem_t memory);
+    void release(uint32_t offset);
+};
+using EncoderOutputRingPtr = std::shared_ptr<EncoderOutputRing>;
+
+/**
+ * @brief Wrap memory the encoder output is written to in a single plane buffer, outside of any buffer pool.
+ *
+ * @param[in] data - the encoded data
+ * @param[in] size - size of the data in bytes
+ * @param[in] on_destroy - called when the last reference to the buffer is dropped, to release the memory
+ * @return HailoMediaLibraryBufferPtr - the buffer, with its plane referenced once
+ */
+HailoMediaLibraryBufferPtr encoder_create_userptr_buffer(void *data, uint32_t size, std::function<void()> on_destroy);
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "mesh_cache.hpp"
+#include "dis_interface.h"
+#include "dma_memory_allocator.hpp"
+#include "media_library_logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+
+mesh_cache_entry_t::~mesh_cache_entry_t()
+{
+    if (dis_ctx != nullptr)
+    {
+        RetCodes ret = dis_deinit(&dis_ctx);
+        if (ret != DIS_OK)
+        {
+            LOGGER__ERROR("failed releasing cached dis context on error {}", ret);
+        }
+    }
+
+    if (mesh.mesh_table != nullptr)
+    {
+        media_library_return result = DmaMemoryAllocator::get_instance().free_dma_buffer(mesh.mesh_table);
+        if (result != MEDIA_LIBRARY_SUCCESS)
+        {
+            LOGGER__ERROR("failed releasing cached mesh dsp buffer on error {}", result);
+        }
+    }
+}
+
+MeshCache::MeshCache(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1))
+{
+    m_worker = std::thread(&MeshCache::worker_loop, this);
+}
+
+MeshCache::~MeshCache()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_pending.clear();
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+
+    LOGGER__INFO("Mesh cache statistics: {} hits, {} misses, {} prefetched", m_hits, m_misses, m_prefetched);
+}
+
+void MeshCache::set_builder(builder_t builder)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_builder = builder;
+    m_generation++;
+    m_entries.clear();
+    m_pending.clear();
+}
+
+void MeshCache::clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_pending.clear();
+}
+
+MeshCacheEntryPtr MeshCache::lookup(const mesh_cache_key_t &key)
+{
+    auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                           [&key](const auto &entry)
+                           { return entry.first == key; });
+    if (it == m_entries.end())
+        return nullptr;
+
+    // move to front - most recently used
+    m_entries.splice(m_entries.begin(), m_entries, it);
+    return m_entries.front().second;
+}
+
+bool MeshCache::contains(const mesh_cache_key_t &key)
+{
+    return std::any_of(m_entries.begin(), m_entries.end(),
+                       [&key](const auto &entry)
+                       { return entry.first == key; });
+}
+
+void MeshCache::insert(const mesh_cache_key_t &key, MeshCacheEntryPtr entry)
+{
+    if (contains(key))
+        return;
+
+    m_entries.emplace_front(key, entry);
+    if (m_entries.size() <= m_capacity)
+        return;
+
+    // Evict the least recently used mesh. Meshes still referenced by the user are only dropped from the cache,
+    // their resources are released once the user switches away from them.
+    m_entries.pop_back();
+}
+
+mesh_cache_stats_t MeshCache::get_stats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return {m_hits, m_misses, m_prefetched};
+}
+
+tl::expected<MeshCacheEntryPtr, media_library_return> MeshCache::acquire(const mesh_cache_key_t &key)
+{
+    builder_t builder;
+    uint64_t generation;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        MeshCacheEntryPtr entry = lookup(key);
+        if (entry != nullptr)
+        {
+            m_hits++;
+            LOGGER__DEBUG("Mesh cache hit for magnification {} rotation {} ({}x{})", key.magnification(), key.flip_mirror_rot, key.width, key.height);
+            return entry;
+        }
+
+        m_misses++;
+        if (!m_builder)
+        {
+            LOGGER__ERROR("Mesh cache miss but no mesh builder was set");
+            return tl::make_unexpected(MEDIA_LIBRARY_UNINITIALIZED);
+        }
+        builder = m_builder;
+        generation = m_generation;
+
+        // Generated below, no need for the worker to generate it as well
+        m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), key), m_pending.end());
+    }
+
+    LOGGER__INFO("Mesh cache miss for magnification {} rotation {} ({}x{}), generating mesh", key.magnification(), key.flip_mirror_rot, key.width, key.height);
+    auto expected_entry = builder(key);
+    if (!expected_entry.has_value())
+        return tl::make_unexpected(expected_entry.error());
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (generation == m_generation)
+        insert(key, expected_entry.value());
+    return expected_entry.value();
+}
+
+void MeshCache::prefetch(const std::vector<mesh_cache_key_t> &keys)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const mesh_cache_key_t &key : keys)
+        {
+            if (contains(key) || std::find(m_pending.begin(), m_pending.end(), key) != m_pending.end())
+                continue;
+            m_pending.push_back(key);
+        }
+    }
+    m_cv.notify_one();
+}
+
+void MeshCache::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+        m_cv.wait(lock, [this]
+                  { return !m_running || (!m_pending.empty() && m_builder); });
+        if (!m_running)
+            break;
+
+        mesh_cache_key_t key = m_pending.front();
+        m_pending.pop_front();
+        if (contains(key))
+            continue;
+
+        builder_t builder = m_builder;
+        uint64_t generation = m_generation;
+
+        // Generate without holding the lock, so frames are not blocked by the generation
+        lock.unlock();
+        auto expected_entry = builder(key);
+        lock.lock();
+
+        if (!expected_entry.has_value())
+        {
+            LOGGER__WARNING("Failed to prefetch mesh for magnification {} rotation {}", key.magnification(), key.flip_mirror_rot);
+            continue;
+        }
+        if (generation != m_generation)
+            continue;
+
+        m_prefetched++;
+        insert(key, expected_entry.value());
+        LOGGER__DEBUG("Prefetched mesh for magnification {} rotation {} ({}x{})", key.magnification(), key.flip_mirror_rot, key.width, key.height);
+    }
+}
+
+dis_calibration_t mesh_cache_zoom_calibration(const dis_calibration_t &calib, float magnification)
+{
+    dis_calibration_t zoomed = calib;
+    if (magnification == 1.0)
+        return zoomed;
+
+    // crop
+    auto cropped = calib.theta2radius;
+    size_t crop_size = static_cast<size_t>(CALIBRATION_VECOTR_SIZE / magnification);
+    cropped.erase(cropped.begin() + crop_size, cropped.end());
+
+    // convert cropped to difference series
+    for (size_t i = 0; i < cropped.size() - 1; ++i)
+    {
+        cropped[i] = cropped[i + 1] - cropped[i];
+    }
+
+    // Resize the matrix using cv::resize
+    cv::Mat originalMat(1, crop_size, CV_32FC1, cropped.data());
+    cv::Mat resizedMat;
+    cv::resize(originalMat, resizedMat, cv::Size(CALIBRATION_VECOTR_SIZE, 1));
+    std::vector<float> resizedVector(resizedMat.begin<float>(), resizedMat.end<float>());
+
+    // convert resizedVector from difference series to cumulative series
+    zoomed.theta2radius = std::vector<float>{0};
+    for (size_t i = 0; i < CALIBRATION_VECOTR_SIZE; ++i)
+    {
+        zoomed.theta2radius.push_back(resizedVector[i] + zoomed.theta2radius[i]);
+    }
+    return zoomed;
+}
+
+tl::expected<MeshCacheEntryPtr, media_library_return> mesh_cache_generate_entry(const mesh_cache_key_t &key, dis_config_t dis_config,
+                                                                                const dis_calibration_t &calib,
+                                                                                camera_type_t camera_type, float camera_fov)
+{
+    MeshCacheEntryPtr entry = std::make_shared<mesh_cache_entry_t>();
+    dis_calibration_t zoomed_calib = mesh_cache_zoom_calibration(calib, key.magnification());
+
+    // Initialize dis dewarp mesh object using DIS library
+    DewarpT dewarp_mesh;
+    RetCodes ret = dis_init(&entry->dis_ctx, dis_config, zoomed_calib, key.width, key.height,
+                            camera_type, camera_fov, &dewarp_mesh);
+    if (ret != DIS_OK)
+    {
+        LOGGER__ERROR("dewarp mesh initialization failed on error {}", ret);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+
+    size_t mesh_size = dewarp_mesh.mesh_width * dewarp_mesh.mesh_height * 2 * 4;
+    media_library_return result = DmaMemoryAllocator::get_instance().allocate_dma_buffer(mesh_size, &entry->mesh.mesh_table);
+    if (result != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("dewarp mesh initialization failed in the buffer allocation process (tried to allocate buffer in size of {})", mesh_size);
+        return tl::make_unexpected(MEDIA_LIBRARY_DSP_OPERATION_ERROR);
+    }
+
+    // The grid is generated with the natural orientation dimensions, DIS swaps them for 90/270 rotations
+    dewarp_mesh.mesh_table = (int *)entry->mesh.mesh_table;
+    DmaMemoryAllocator::get_instance().dmabuf_sync_start(entry->mesh.mesh_table);
+    ret = dis_dewarp_only_grid(entry->dis_ctx, key.width, key.height, key.flip_mirror_rot, &dewarp_mesh);
+    DmaMemoryAllocator::get_instance().dmabuf_sync_end(entry->mesh.mesh_table);
+    if (ret != DIS_OK)
+    {
+        LOGGER__ERROR("Failed to generate mesh, status: {}", ret);
+        return tl::make_unexpected(MEDIA_LIBRARY_ERROR);
+    }
+
+    entry->mesh.mesh_width = dewarp_mesh.mesh_width;
+    entry->mesh.mesh_height = dewarp_mesh.mesh_height;
+    LOGGER__INFO("generated dewarp mesh grid {}x{} for magnification {} rotation {}", dewarp_mesh.mesh_width, dewarp_mesh.mesh_height,
+                 key.magnification(), key.flip_mirror_rot);
+    return entry;
+}
+
+tl::expected<MeshCacheEntryPtr, media_library_return> mesh_cache_load_entry(const dsp_dewarp_mesh_t &mesh)
+{
+    MeshCacheEntryPtr entry = std::make_shared<mesh_cache_entry_t>();
+    size_t mesh_size = mesh.mesh_width * mesh.mesh_height * 2 * 4;
+    media_library_return result = DmaMemoryAllocator::get_instance().allocate_dma_buffer(mesh_size, &entry->mesh.mesh_table);
+    if (result != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("dewarp mesh initialization failed in the buffer allocation process (tried to allocate buffer in size of {})", mesh_size);
+        return tl::make_unexpected(MEDIA_LIBRARY_DSP_OPERATION_ERROR);
+    }
+
+    DmaMemoryAllocator::get_instance().dmabuf_sync_start(entry->mesh.mesh_table);
+    memcpy(entry->mesh.mesh_table, mesh.mesh_table, mesh_size);
+    DmaMemoryAllocator::get_instance().dmabuf_sync_end(entry->mesh.mesh_table);
+    entry->mesh.mesh_width = mesh.mesh_width;
+    entry->mesh.mesh_height = mesh.mesh_height;
+    return entry;
+}
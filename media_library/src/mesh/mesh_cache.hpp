@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mesh_cache.hpp
+ * @brief Bounded cache of ready dewarp meshes keyed by optical zoom, rotation and resolution
+ **/
+
+#pragma once
+#include "dsp_utils.hpp"
+#include "interface_types.h"
+#include "media_library_types.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tl/expected.hpp>
+#include <vector>
+
+// Size of the theta2radius calibration LUT (without the leading 0)
+#define CALIBRATION_VECOTR_SIZE 1024
+
+// Maximum number of meshes (DIS context + DMA mesh table) kept alive by the cache
+#define MESH_CACHE_CAPACITY (8)
+// Number of zoom steps ahead of the current magnification that are generated in the background
+#define MESH_CACHE_PREFETCH_DEPTH (2)
+// Zoom step (in magnification buckets) assumed before the first zoom change is observed
+#define MESH_CACHE_DEFAULT_ZOOM_STEP (10)
+
+/**
+ * @brief Converts an optical zoom magnification to its cache bucket.
+ * Buckets have a resolution of 0.01x - the same resolution used for the ISP optical zoom control.
+ */
+static inline uint32_t mesh_cache_magnification_bucket(float magnification)
+{
+    return static_cast<uint32_t>(magnification * 100 + 0.5f);
+}
+
+struct mesh_cache_key_t
+{
+    uint32_t magnification_bucket;
+    FlipMirrorRot flip_mirror_rot;
+    uint32_t width;
+    uint32_t height;
+
+    float magnification() const
+    {
+        return magnification_bucket / 100.0f;
+    }
+
+    bool operator==(const mesh_cache_key_t &other) const
+    {
+        return magnification_bucket == other.magnification_bucket &&
+               flip_mirror_rot == other.flip_mirror_rot &&
+               width == other.width && height == other.height;
+    }
+    bool operator!=(const mesh_cache_key_t &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ * @brief A ready to use mesh - the DIS context it was generated with and its DMA mesh table.
+ * Both are released when the last reference to the entry is dropped.
+ */
+struct mesh_cache_entry_t
+{
+    // Pointer to internally allocated DIS instance, initialized for the entry's magnification
+    void *dis_ctx = nullptr;
+    // dewarp mesh object, mesh_table is a DMA buffer
+    dsp_dewarp_mesh_t mesh = {0, 0, nullptr};
+
+    mesh_cache_entry_t() = default;
+    ~mesh_cache_entry_t();
+    mesh_cache_entry_t(const mesh_cache_entry_t &) = delete;
+    mesh_cache_entry_t &operator=(const mesh_cache_entry_t &) = delete;
+};
+using MeshCacheEntryPtr = std::shared_ptr<mesh_cache_entry_t>;
+
+struct mesh_cache_stats_t
+{
+    // number of acquired meshes that were ready in the cache
+    uint64_t hits;
+    // number of acquired meshes generated on the calling thread
+    uint64_t misses;
+    // number of meshes generated by the background worker
+    uint64_t prefetched;
+};
+
+class MeshCache
+{
+public:
+    using builder_t = std::function<tl::expected<MeshCacheEntryPtr, media_library_return>(const mesh_cache_key_t &)>;
+
+    MeshCache(size_t capacity = MESH_CACHE_CAPACITY);
+    ~MeshCache();
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+
+    /**
+     * @brief Set the function used to generate meshes.
+     * The builder must not reference state that changes after it is set - it runs on the background worker.
+     * Setting a new builder drops all cached meshes and pending prefetch requests.
+     */
+    void set_builder(builder_t builder);
+
+    /**
+     * @brief Get the mesh for a key, generating it on the calling thread on a cache miss.
+     */
+    tl::expected<MeshCacheEntryPtr, media_library_return> acquire(const mesh_cache_key_t &key);
+
+    /**
+     * @brief Queue keys to be generated by the background worker if they are not cached yet.
+     */
+    void prefetch(const std::vector<mesh_cache_key_t> &keys);
+
+    /**
+     * @brief Drop all cached meshes and pending prefetch requests.
+     * Meshes still referenced by their users stay alive until released.
+     */
+    void clear();
+
+    mesh_cache_stats_t get_stats();
+
+private:
+    size_t m_capacity;
+    builder_t m_builder;
+    // Incremented on every builder change, so meshes built by a stale builder are discarded
+    uint64_t m_generation = 0;
+    // Most recently used entries at the front
+    std::list<std::pair<mesh_cache_key_t, MeshCacheEntryPtr>> m_entries;
+    std::deque<mesh_cache_key_t> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+    bool m_running = true;
+
+    // statistics
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_prefetched = 0;
+
+    void worker_loop();
+    MeshCacheEntryPtr lookup(const mesh_cache_key_t &key);
+    bool contains(const mesh_cache_key_t &key);
+    void insert(const mesh_cache_key_t &key, MeshCacheEntryPtr entry);
+};
+
+/**
+ * @brief Adjust a sensor calibration to an optical zoom magnification.
+ * The theta2radius LUT is cropped to the zoomed field of view and stretched back to its full size.
+ *
+ * @param[in] calib - calibration of the sensor without optical zoom
+ * @param[in] magnification - optical zoom magnification level
+ * @return dis_calibration_t - calibration matching the magnification level
+ */
+dis_calibration_t mesh_cache_zoom_calibration(const dis_calibration_t &calib, float magnification);
+
+/**
+ * @brief Generate a dewarp only mesh for a cache key, using a dedicated DIS context.
+ * Safe to call from the background worker - all the inputs are passed by value.
+ *
+ * @param[in] key - magnification, flip/rotation and resolution of the mesh
+ * @param[in] dis_config - DIS configuration of the new DIS context
+ * @param[in] calib - calibration of the sensor without optical zoom
+ * @param[in] camera_type - output camera type
+ * @param[in] camera_fov - output camera field of view
+ * @return tl::expected<MeshCacheEntryPtr, media_library_return> - the generated mesh or an error
+ */
+tl::expected<MeshCacheEntryPtr, media_library_return> mesh_cache_generate_entry(const mesh_cache_key_t &key, dis_config_t dis_config,
+                                                                                const dis_calibration_t &calib,
+                                                                                camera_type_t camera_type, float camera_fov);
+
+/**
+ * @brief Create an entry from a ready mesh table, without a DIS context - for dewarp only meshes.
+ *
+ * @param[in] mesh - mesh to copy into the DMA mesh table of the entry
+ * @return tl::expected<MeshCacheEntryPtr, media_library_return> - the entry or an error
+ */
+tl::expected<MeshCacheEntryPtr, media_library_return> mesh_cache_load_entry(const dsp_dewarp_mesh_t &mesh);
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "mesh_engine.hpp"
+#include "media_library_logger.hpp"
+#include <mutex>
+#include <vector>
+
+MeshEngine::MeshEngine(const mesh_engine_config_t &config) : m_config(config)
+{
+    m_mesh_cache = std::make_unique<MeshCache>(m_config.cache_capacity);
+    m_mesh_generator = std::make_unique<AsyncMeshGenerator>(m_config.async_generation);
+}
+
+MeshEngine::~MeshEngine()
+{
+    // Stop generation and prefetching and release the cached meshes
+    m_mesh_generator.reset();
+    m_mesh.reset();
+    m_mesh_cache.reset();
+    if (m_snapshot != nullptr && m_config.persist_snapshot)
+        m_snapshot->save();
+}
+
+media_library_return MeshEngine::initialize_snapshot()
+{
+    mesh_snapshot_params_t snapshot_params = {m_params.dewarp_config.camera_type, m_params.dewarp_config.camera_fov,
+                                              m_params.dis_config.debug.generate_resize_grid};
+    auto expected_snapshot = MeshSnapshot::create(m_params.dewarp_config.sensor_calib_path, snapshot_params);
+    if (!expected_snapshot.has_value())
+    {
+        LOGGER__ERROR("dewarp mesh initialization failed when reading calib_file");
+        return MEDIA_LIBRARY_CONFIGURATION_ERROR;
+    }
+    m_snapshot = expected_snapshot.value();
+
+    // The builder runs on the cache worker, so it captures a snapshot of the configuration
+    m_mesh_cache->set_builder(mesh_snapshot_builder(m_snapshot, m_params.dis_config,
+                                                    m_params.dewarp_config.camera_type,
+                                                    m_params.dewarp_config.camera_fov));
+    m_builder_dewarp_config = m_params.dewarp_config;
+    m_builder_dis_config = m_params.dis_config;
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+mesh_cache_key_t MeshEngine::current_mesh_key()
+{
+    float magnification = m_params.optical_zoom_enabled ? m_params.magnification : 1.0f;
+    return {mesh_cache_magnification_bucket(magnification), m_params.flip_mirror_rot, m_params.width, m_params.height};
+}
+
+void MeshEngine::set_mesh(const mesh_cache_key_t &key, MeshCacheEntryPtr mesh)
+{
+    // The previous mesh is released here, or by the cache once evicted
+    m_mesh = mesh;
+    m_mesh_key = key;
+    m_mesh_generator->set_source(m_mesh);
+}
+
+void MeshEngine::prefetch_zoom_meshes(const mesh_cache_key_t &key)
+{
+    if (!m_params.optical_zoom_enabled || m_config.prefetch_depth == 0)
+        return;
+
+    // Zoom usually sweeps in one direction - prepare the next levels in the direction of the last change,
+    // and one level back in case the sweep reverses
+    std::vector<mesh_cache_key_t> keys;
+    for (int32_t i = 1; i <= (int32_t)m_config.prefetch_depth; i++)
+    {
+        int32_t bucket = (int32_t)key.magnification_bucket + i * m_zoom_step;
+        if (bucket < 100)
+            break;
+        mesh_cache_key_t next = key;
+        next.magnification_bucket = bucket;
+        keys.push_back(next);
+    }
+    int32_t previous_bucket = (int32_t)key.magnification_bucket - m_zoom_step;
+    if (previous_bucket >= 100)
+    {
+        mesh_cache_key_t previous = key;
+        previous.magnification_bucket = previous_bucket;
+        keys.push_back(previous);
+    }
+    m_mesh_cache->prefetch(keys);
+}
+
+media_library_return MeshEngine::configure(const mesh_engine_params_t &params)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    media_library_return ret = MEDIA_LIBRARY_SUCCESS;
+    m_params = params;
+    bool was_initialized = m_is_initialized;
+
+    if (!m_is_initialized) // initialize the calibration for the first time
+    {
+        ret = initialize_snapshot();
+        if (ret != MEDIA_LIBRARY_SUCCESS)
+            return ret;
+    }
+    else if (m_builder_dewarp_config != m_params.dewarp_config ||
+             m_builder_dewarp_config.camera_type != m_params.dewarp_config.camera_type ||
+             m_builder_dis_config.enabled != m_params.dis_config.enabled ||
+             m_builder_dis_config.debug.generate_resize_grid != m_params.dis_config.debug.generate_resize_grid)
+    {
+        // Cached meshes were generated with a different dewarp configuration, or without a DIS instance
+        LOGGER__INFO("Dewarp configuration changed, dropping cached meshes");
+        ret = initialize_snapshot();
+        if (ret != MEDIA_LIBRARY_SUCCESS)
+            return ret;
+    }
+
+    mesh_cache_key_t key = current_mesh_key();
+    lock.unlock();
+
+    // Generating the mesh on a miss and waiting for the dewarp to release the stabilized meshes are done without the
+    // engine lock, so frames keep taking the current mesh meanwhile
+    auto expected_mesh = m_mesh_cache->acquire(key);
+    if (!expected_mesh.has_value())
+    {
+        LOGGER__ERROR("Failed to generate mesh, status: {}", expected_mesh.error());
+        return expected_mesh.error();
+    }
+    MeshCacheEntryPtr mesh = expected_mesh.value();
+
+    // Stabilized meshes have the same size as the base mesh. Frames may still read them, the allocation waits for
+    // their release
+    ret = m_mesh_generator->allocate(mesh->mesh.mesh_width * mesh->mesh.mesh_height * 2 * 4);
+    if (ret != MEDIA_LIBRARY_SUCCESS)
+        return ret;
+
+    lock.lock();
+    // A zoom change or a newer configuration applied meanwhile sets the mesh of its own key
+    if (was_initialized && key != current_mesh_key())
+        return MEDIA_LIBRARY_SUCCESS;
+    set_mesh(key, mesh);
+    prefetch_zoom_meshes(key);
+    LOGGER__INFO("generated base dewarp mesh grid {}x{}", mesh->mesh.mesh_width, mesh->mesh.mesh_height);
+    m_is_initialized = true;
+
+    MeshSnapshotPtr snapshot = m_snapshot;
+    lock.unlock();
+
+    // Keep the generated meshes for the next start, failing to write them is not critical
+    if (m_config.persist_snapshot && snapshot->has_unsaved_meshes())
+        snapshot->save();
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return MeshEngine::set_optical_zoom(float magnification)
+{
+    mesh_cache_key_t key;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        int32_t zoom_step = (int32_t)mesh_cache_magnification_bucket(magnification) - (int32_t)mesh_cache_magnification_bucket(m_params.magnification);
+        if (zoom_step != 0)
+            m_zoom_step = zoom_step;
+        m_params.magnification = magnification;
+        if (!m_is_initialized)
+            return MEDIA_LIBRARY_SUCCESS;
+        key = current_mesh_key();
+        if (key == m_mesh_key)
+            return MEDIA_LIBRARY_SUCCESS;
+    }
+
+    // On a miss the mesh is generated here, without blocking the frames that still use the current mesh
+    auto expected_mesh = m_mesh_cache->acquire(key);
+    if (!expected_mesh.has_value())
+    {
+        LOGGER__ERROR("Failed to generate mesh for magnification {}, status: {}", magnification, expected_mesh.error());
+        return expected_mesh.error();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    // A newer configuration or zoom level might have been applied while generating
+    if (key != current_mesh_key())
+        return MEDIA_LIBRARY_SUCCESS;
+    set_mesh(key, expected_mesh.value());
+    prefetch_zoom_meshes(key);
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+media_library_return MeshEngine::submit_vsm(float motion_x, float motion_y, std::shared_ptr<angular_dis_params_t> angular_dis_params)
+{
+    mesh_generator_request_t request;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_mesh == nullptr)
+            return MEDIA_LIBRARY_UNINITIALIZED;
+        request = {++m_vsm_frame_id, motion_x, motion_y, m_mesh_key.flip_mirror_rot,
+                   m_params.width, m_params.height, angular_dis_params};
+    }
+
+    // Not holding the engine lock - synchronous generation must not block zoom changes and frames
+    media_library_return ret = m_mesh_generator->submit(request);
+    if (ret != MEDIA_LIBRARY_SUCCESS)
+    {
+        LOGGER__ERROR("Failed to update mesh with VSM, status: {}", ret);
+    }
+    return ret;
+}
+
+std::shared_ptr<dsp_dewarp_mesh_t> MeshEngine::get()
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_mesh_generator->acquire();
+}
+
+mesh_engine_stats_t MeshEngine::get_stats()
+{
+    return {m_mesh_cache->get_stats(), m_mesh_generator->get_stats()};
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mesh_engine.hpp
+ * @brief Dewarp mesh engine shared by the front end LDC and the vision pre-processing dewarp
+ **/
+
+#pragma once
+#include "dsp_utils.hpp"
+#include "interface_types.h"
+#include "media_library_types.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_generator.hpp"
+#include "mesh_snapshot.hpp"
+#include <memory>
+#include <shared_mutex>
+
+/**
+ * @brief Threading and caching model of a mesh engine
+ */
+struct mesh_engine_config_t
+{
+    // maximum number of meshes kept alive by the cache
+    size_t cache_capacity;
+    // number of zoom levels ahead of the current one generated in the background, 0 disables prefetching
+    uint32_t prefetch_depth;
+    // generate stabilized meshes on a worker thread, otherwise on the thread submitting the VSM update
+    bool async_generation;
+    // write the generated meshes to the snapshot file, so the next start skips their generation
+    bool persist_snapshot;
+};
+
+static inline mesh_engine_config_t mesh_engine_default_config()
+{
+    return {MESH_CACHE_CAPACITY, MESH_CACHE_PREFETCH_DEPTH, true, true};
+}
+
+/**
+ * @brief Configuration a mesh is generated for
+ */
+struct mesh_engine_params_t
+{
+    dewarp_config_t dewarp_config;
+    dis_config_t dis_config;
+    // input resolution of the dewarp
+    uint32_t width;
+    uint32_t height;
+    FlipMirrorRot flip_mirror_rot;
+    bool optical_zoom_enabled;
+    float magnification;
+};
+
+struct mesh_engine_stats_t
+{
+    mesh_cache_stats_t cache;
+    mesh_generator_stats_t generator;
+};
+
+/**
+ * @brief Owns the sensor calibration snapshot, the cache of ready meshes per zoom level and rotation,
+ * and the generation of stabilized meshes. Users only map their configuration to mesh_engine_params_t
+ * and take the latest mesh for every dewarped frame.
+ */
+class MeshEngine
+{
+public:
+    MeshEngine(const mesh_engine_config_t &config = mesh_engine_default_config());
+    ~MeshEngine();
+    MeshEngine(const MeshEngine &) = delete;
+    MeshEngine &operator=(const MeshEngine &) = delete;
+
+    /**
+     * @brief Apply a configuration. The calibration is read and the cached meshes are dropped only when the
+     * dewarp configuration changes, otherwise the mesh is taken from the cache.
+     */
+    media_library_return configure(const mesh_engine_params_t &params);
+
+    /**
+     * @brief Switch to the mesh of a magnification level. On a cache miss it is generated on the calling thread,
+     * frames keep using the current mesh meanwhile.
+     */
+    media_library_return set_optical_zoom(float magnification);
+
+    /**
+     * @brief Generate a stabilized mesh for the motion of a frame.
+     */
+    media_library_return submit_vsm(float motion_x, float motion_y, std::shared_ptr<angular_dis_params_t> angular_dis_params);
+
+    /**
+     * @brief Get the latest completed mesh - the mesh buffer is kept until the returned pointer is released.
+     */
+    std::shared_ptr<dsp_dewarp_mesh_t> get();
+
+    mesh_engine_stats_t get_stats();
+
+private:
+    mesh_engine_config_t m_config;
+    mesh_engine_params_t m_params;
+    // Sensor calibration without optical zoom and its snapshot of generated meshes
+    MeshSnapshotPtr m_snapshot;
+    // Ready meshes per magnification/rotation, each holding its own DIS instance
+    std::unique_ptr<MeshCache> m_mesh_cache;
+    // Stabilized meshes based on the mesh in use
+    std::unique_ptr<AsyncMeshGenerator> m_mesh_generator;
+    // configuration the mesh cache builder was created with - a change of these invalidates the cache
+    dewarp_config_t m_builder_dewarp_config;
+    dis_config_t m_builder_dis_config;
+    // mesh currently in use and its key
+    MeshCacheEntryPtr m_mesh;
+    mesh_cache_key_t m_mesh_key;
+    uint64_t m_vsm_frame_id = 0;
+    // last observed zoom change in magnification buckets, used to predict the next zoom levels
+    int32_t m_zoom_step = MESH_CACHE_DEFAULT_ZOOM_STEP;
+    bool m_is_initialized = false;
+    std::shared_mutex m_mutex;
+
+    media_library_return initialize_snapshot();
+    mesh_cache_key_t current_mesh_key();
+    void set_mesh(const mesh_cache_key_t &key, MeshCacheEntryPtr mesh);
+    void prefetch_zoom_meshes(const mesh_cache_key_t &key);
+};
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "mesh_generator.hpp"
+#include "dis_interface.h"
+#include "dma_memory_allocator.hpp"
+#include "media_library_logger.hpp"
+#include <algorithm>
+
+/**
+ * @brief Copy the angular DIS state a grid is generated from, so generation reads and writes its own copy
+ * while the frame thread keeps updating the live state
+ */
+static std::shared_ptr<angular_dis_params_t> snapshot_angular_dis_params(const std::shared_ptr<angular_dis_params_t> &params)
+{
+    if (params == nullptr)
+        return nullptr;
+    std::shared_ptr<angular_dis_params_t> snapshot = std::make_shared<angular_dis_params_t>(*params);
+    // The DSP column and row sums are not used by grid generation
+    snapshot->cur_columns_sum = nullptr;
+    snapshot->cur_rows_sum = nullptr;
+    if (params->dsp_filter_angle != nullptr)
+    {
+        const angular_dis_filter_angle_t &filter = *params->dsp_filter_angle;
+        snapshot->dsp_filter_angle = std::make_shared<angular_dis_filter_angle_t>(filter);
+        snapshot->dsp_filter_angle->cur_angles_sum = std::make_shared<float>(filter.cur_angles_sum ? *filter.cur_angles_sum : 0.0f);
+        snapshot->dsp_filter_angle->cur_traj = std::make_shared<float>(filter.cur_traj ? *filter.cur_traj : 0.0f);
+        snapshot->dsp_filter_angle->stabilized_theta = std::make_shared<float>(filter.stabilized_theta ? *filter.stabilized_theta : 0.0f);
+    }
+    return snapshot;
+}
+
+AsyncMeshGenerator::AsyncMeshGenerator(bool threaded)
+{
+    if (threaded)
+        m_worker = std::thread(&AsyncMeshGenerator::worker_loop, this);
+}
+
+AsyncMeshGenerator::~AsyncMeshGenerator()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_pending.clear();
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+
+    LOGGER__INFO("Mesh generator statistics: {} of {} dewarped frames used a stale mesh, {} VSM updates merged",
+                 m_stats.stale, m_stats.acquired, m_stats.merged);
+    free_buffers();
+}
+
+void AsyncMeshGenerator::free_buffers()
+{
+    for (mesh_buffer_t &buffer : m_buffers)
+    {
+        media_library_return result = DmaMemoryAllocator::get_instance().free_dma_buffer(buffer.mesh.mesh_table);
+        if (result != MEDIA_LIBRARY_SUCCESS)
+        {
+            LOGGER__ERROR("failed releasing mesh generator buffer on error {}", result);
+        }
+    }
+    m_buffers.clear();
+}
+
+media_library_return AsyncMeshGenerator::allocate(size_t mesh_size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Frames keep coming while waiting - they take the base mesh, so the readers of the buffers drain,
+    // and a grid in progress is not published
+    m_allocating = true;
+    m_published = -1;
+    m_generation++;
+    m_cv.wait(lock, [this]
+              { return !m_busy && std::all_of(m_buffers.begin(), m_buffers.end(),
+                                              [](const mesh_buffer_t &buffer)
+                                              { return buffer.readers == 0; }); });
+    media_library_return ret = allocate_buffers(mesh_size);
+    m_allocating = false;
+    lock.unlock();
+    m_cv.notify_all();
+    return ret;
+}
+
+media_library_return AsyncMeshGenerator::allocate_buffers(size_t mesh_size)
+{
+    if (mesh_size == m_mesh_size)
+        return MEDIA_LIBRARY_SUCCESS;
+
+    free_buffers();
+    m_mesh_size = 0;
+    for (int i = 0; i < MESH_GENERATOR_NUM_BUFFERS; i++)
+    {
+        mesh_buffer_t buffer = {{0, 0, nullptr}, 0, 0, nullptr};
+        media_library_return result = DmaMemoryAllocator::get_instance().allocate_dma_buffer(mesh_size, &buffer.mesh.mesh_table);
+        if (result != MEDIA_LIBRARY_SUCCESS)
+        {
+            LOGGER__ERROR("mesh generator failed in the buffer allocation process (tried to allocate buffer in size of {})", mesh_size);
+            free_buffers();
+            return MEDIA_LIBRARY_BUFFER_ALLOCATION_ERROR;
+        }
+        m_buffers.push_back(buffer);
+    }
+    m_mesh_size = mesh_size;
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+void AsyncMeshGenerator::set_source(MeshCacheEntryPtr source)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_source = source;
+    m_generation++;
+    m_published = -1;
+    m_pending.clear();
+}
+
+media_library_return AsyncMeshGenerator::submit(const mesh_generator_request_t &live_request)
+{
+    // Taken on the submitting thread, the same one that updates the live angular DIS state
+    mesh_generator_request_t request = live_request;
+    request.angular_dis_params = snapshot_angular_dis_params(live_request.angular_dis_params);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_source == nullptr || m_source->dis_ctx == nullptr || m_buffers.empty())
+            return MEDIA_LIBRARY_UNINITIALIZED;
+        m_angular_dis_params = live_request.angular_dis_params;
+
+        m_latest_submitted = request.frame_id;
+        if (!m_worker.joinable())
+        {
+            // Synchronous generation - at most the published buffer and the ones still read by the dewarp are in use
+            m_cv.wait(lock, [this]
+                      { return !m_busy && !m_allocating && (m_buffers.empty() || find_free_buffer() >= 0); });
+            // the buffers might have failed to be reallocated while waiting
+            if (m_buffers.empty())
+                return MEDIA_LIBRARY_UNINITIALIZED;
+            generate(lock, request);
+            return MEDIA_LIBRARY_SUCCESS;
+        }
+
+        if (m_pending.size() >= MESH_GENERATOR_MAX_PENDING)
+        {
+            // The worker fell behind - motion vectors are relative to the previous frame,
+            // so accumulate instead of dropping to keep the stabilization trajectory intact
+            mesh_generator_request_t &last = m_pending.back();
+            last.frame_id = request.frame_id;
+            last.motion_x += request.motion_x;
+            last.motion_y += request.motion_y;
+            last.angular_dis_params = request.angular_dis_params;
+            m_stats.merged++;
+        }
+        else
+        {
+            m_pending.push_back(request);
+        }
+    }
+    m_cv.notify_all();
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+void AsyncMeshGenerator::release(int index)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_buffers[index].readers--;
+    }
+    m_cv.notify_all();
+}
+
+std::shared_ptr<dsp_dewarp_mesh_t> AsyncMeshGenerator::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stats.acquired++;
+    if (m_published < 0 || m_buffers[m_published].frame_id < m_latest_submitted)
+        m_stats.stale++;
+    if (m_stats.acquired % MESH_GENERATOR_STATS_INTERVAL == 0)
+    {
+        LOGGER__DEBUG("Mesh generator: {} of {} dewarped frames used a stale mesh", m_stats.stale, m_stats.acquired);
+    }
+
+    if (m_published < 0)
+    {
+        if (m_source == nullptr)
+            return nullptr;
+        // No stabilized grid yet - use the base mesh, kept alive by the source entry
+        return std::shared_ptr<dsp_dewarp_mesh_t>(m_source, &m_source->mesh);
+    }
+
+    int index = m_published;
+    apply_angular_dis_results(m_buffers[index]);
+    m_buffers[index].readers++;
+    return std::shared_ptr<dsp_dewarp_mesh_t>(&m_buffers[index].mesh, [this, index](dsp_dewarp_mesh_t *)
+                                              { release(index); });
+}
+
+void AsyncMeshGenerator::apply_angular_dis_results(const mesh_buffer_t &buffer)
+{
+    if (m_angular_dis_params == nullptr || m_angular_dis_params->dsp_filter_angle == nullptr ||
+        buffer.angular_dis_params == nullptr || buffer.angular_dis_params->dsp_filter_angle == nullptr ||
+        buffer.frame_id <= m_angular_applied)
+        return;
+
+    // Grid generation only updates the filter alpha and the maximum theta of the rotation stabilization
+    if (buffer.angular_dis_params->stabilize_rotation)
+    {
+        m_angular_dis_params->dsp_filter_angle->alpha = buffer.angular_dis_params->dsp_filter_angle->alpha;
+        m_angular_dis_params->dsp_filter_angle->maximum_theta = buffer.angular_dis_params->dsp_filter_angle->maximum_theta;
+    }
+    m_angular_applied = buffer.frame_id;
+}
+
+mesh_generator_stats_t AsyncMeshGenerator::get_stats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+int AsyncMeshGenerator::find_free_buffer()
+{
+    for (size_t i = 0; i < m_buffers.size(); i++)
+    {
+        if ((int)i != m_published && m_buffers[i].readers == 0)
+            return i;
+    }
+    return -1;
+}
+
+void AsyncMeshGenerator::generate(std::unique_lock<std::mutex> &lock, const mesh_generator_request_t &request)
+{
+    int index = find_free_buffer();
+    MeshCacheEntryPtr source = m_source;
+    uint64_t generation = m_generation;
+    mesh_buffer_t &buffer = m_buffers[index];
+    DewarpT mesh = {(int)source->mesh.mesh_width,
+                    (int)source->mesh.mesh_height,
+                    (int *)buffer.mesh.mesh_table};
+    m_busy = true;
+
+    // Generate without holding the lock - the buffer is neither published nor read, so frames are not blocked
+    lock.unlock();
+    DmaMemoryAllocator::get_instance().dmabuf_sync_start(mesh.mesh_table);
+    RetCodes ret = dis_generate_grid(source->dis_ctx, request.width, request.height, request.motion_x,
+                                     request.motion_y, 0, request.flip_mirror_rot, request.angular_dis_params, &mesh);
+    DmaMemoryAllocator::get_instance().dmabuf_sync_end(mesh.mesh_table);
+    lock.lock();
+
+    m_busy = false;
+    if (ret != DIS_OK)
+    {
+        LOGGER__ERROR("Failed to update mesh with VSM, status: {}", ret);
+    }
+    else if (generation == m_generation)
+    {
+        buffer.mesh.mesh_width = mesh.mesh_width;
+        buffer.mesh.mesh_height = mesh.mesh_height;
+        buffer.frame_id = request.frame_id;
+        buffer.angular_dis_params = request.angular_dis_params;
+        m_published = index;
+    }
+    m_cv.notify_all();
+}
+
+void AsyncMeshGenerator::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+        m_cv.wait(lock, [this]
+                  { return !m_running || (!m_pending.empty() && !m_allocating && find_free_buffer() >= 0); });
+        if (!m_running)
+            break;
+
+        mesh_generator_request_t request = m_pending.front();
+        m_pending.pop_front();
+        generate(lock, request);
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mesh_generator.hpp
+ * @brief Asynchronous generation of DIS stabilized dewarp meshes into a ring of DMA mesh buffers
+ **/
+
+#pragma once
+#include "dsp_utils.hpp"
+#include "interface_types.h"
+#include "media_library_types.hpp"
+#include "mesh_cache.hpp"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of DMA mesh buffers - one being read by the DSP, one published and one being generated
+#define MESH_GENERATOR_NUM_BUFFERS (3)
+// Maximum number of pending VSM updates, further updates are accumulated into the last pending one
+#define MESH_GENERATOR_MAX_PENDING (4)
+// Number of dewarped frames between stale mesh statistics prints
+#define MESH_GENERATOR_STATS_INTERVAL (300)
+
+struct mesh_generator_request_t
+{
+    uint64_t frame_id;
+    float motion_x;
+    float motion_y;
+    FlipMirrorRot flip_mirror_rot;
+    uint32_t width;
+    uint32_t height;
+    // live angular DIS state on submit, a private snapshot of it once queued - the worker never touches the live state
+    std::shared_ptr<angular_dis_params_t> angular_dis_params;
+};
+
+struct mesh_generator_stats_t
+{
+    // number of meshes acquired for dewarp
+    uint64_t acquired;
+    // number of meshes acquired before the mesh of the latest submitted VSM was ready
+    uint64_t stale;
+    // number of VSM updates accumulated into a pending update since the worker fell behind
+    uint64_t merged;
+};
+
+/**
+ * @brief Generates stabilized meshes on a dedicated worker thread.
+ * VSM updates are queued by the frame thread and applied in order by the worker, which writes each grid into
+ * a free DMA mesh buffer and then publishes it. The dewarp takes the latest published mesh without waiting
+ * for generation, falling back to the base (unstabilized) mesh of the source until the first grid is ready.
+ * Without a worker thread, submit() generates the grid on the calling thread and publishes it before returning.
+ */
+class AsyncMeshGenerator
+{
+public:
+    /**
+     * @param[in] threaded - generate on a dedicated worker thread, otherwise on the thread calling submit()
+     */
+    AsyncMeshGenerator(bool threaded = true);
+    ~AsyncMeshGenerator();
+    AsyncMeshGenerator(const AsyncMeshGenerator &) = delete;
+    AsyncMeshGenerator &operator=(const AsyncMeshGenerator &) = delete;
+
+    /**
+     * @brief Allocate the mesh buffers. Waits for the generation in progress and for acquired meshes to be released.
+     * Until then frames get the base mesh of the source, and no grid is generated or published.
+     *
+     * @param[in] mesh_size - size in bytes of a single mesh table
+     */
+    media_library_return allocate(size_t mesh_size);
+
+    /**
+     * @brief Set the mesh that generation is based on - its DIS instance and its base mesh.
+     * Drops the published mesh and pending updates, they belong to the previous source.
+     */
+    void set_source(MeshCacheEntryPtr source);
+
+    /**
+     * @brief Queue a VSM update for generation. Never blocks on the generation itself when threaded.
+     */
+    media_library_return submit(const mesh_generator_request_t &request);
+
+    /**
+     * @brief Get the latest completed mesh. The mesh buffer is not reused until the returned pointer is released.
+     * The angular DIS filter results of the mesh are applied to the live angular DIS state here, on the frame thread.
+     */
+    std::shared_ptr<dsp_dewarp_mesh_t> acquire();
+
+    mesh_generator_stats_t get_stats();
+
+private:
+    struct mesh_buffer_t
+    {
+        dsp_dewarp_mesh_t mesh;
+        uint64_t frame_id;
+        uint32_t readers;
+        // snapshot the grid was generated with, holding its angular DIS filter results
+        std::shared_ptr<angular_dis_params_t> angular_dis_params;
+    };
+
+    std::vector<mesh_buffer_t> m_buffers;
+    size_t m_mesh_size = 0;
+    MeshCacheEntryPtr m_source;
+    // Incremented on every source change, so grids generated for a stale source are not published
+    uint64_t m_generation = 0;
+    int m_published = -1;
+    uint64_t m_latest_submitted = 0;
+    // live angular DIS state of the frame thread, and the frame id of the results last applied to it
+    std::shared_ptr<angular_dis_params_t> m_angular_dis_params;
+    uint64_t m_angular_applied = 0;
+    bool m_busy = false;
+    // the buffers are being reallocated - the dewarp must release them and no grid may be written to them
+    bool m_allocating = false;
+    bool m_running = true;
+    std::deque<mesh_generator_request_t> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_worker;
+    mesh_generator_stats_t m_stats = {0, 0, 0};
+
+    void worker_loop();
+    void generate(std::unique_lock<std::mutex> &lock, const mesh_generator_request_t &request);
+    int find_free_buffer();
+    void release(int index);
+    void apply_angular_dis_results(const mesh_buffer_t &buffer);
+    void free_buffers();
+    media_library_return allocate_buffers(size_t mesh_size);
+};
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "mesh_snapshot.hpp"
+#include "dma_memory_allocator.hpp"
+#include "media_library_logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct mesh_snapshot_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t generation_us;
+    int32_t res_x;
+    int32_t res_y;
+    float oc_x;
+    float oc_y;
+    uint32_t theta2radius_size;
+    uint32_t num_meshes;
+};
+
+struct mesh_snapshot_mesh_header_t
+{
+    uint32_t magnification_bucket;
+    uint32_t flip_mirror_rot;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mesh_width;
+    uint32_t mesh_height;
+};
+
+static uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+tl::expected<dis_calibration_t, media_library_return> mesh_calibration_parse(const std::string &text)
+{
+    dis_calibration_t calib{{}, {1, 1}, {}};
+    std::istringstream file(text);
+
+    // Ignore first line - it is a comment
+    file.ignore(1024, '\n');
+
+    std::string row;
+    std::getline(file, row);
+    calib.res.x = atoi(row.c_str());
+    if (file.eof())
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    std::getline(file, row);
+    calib.res.y = atoi(row.c_str());
+    if (file.eof())
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    std::getline(file, row);
+    calib.oc.x = atof(row.c_str());
+    if (file.eof())
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    std::getline(file, row);
+    calib.oc.y = atof(row.c_str());
+    if (file.eof())
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    std::getline(file, row);
+    calib.theta2radius.push_back(atof(row.c_str()));
+    if (file.eof())
+    {
+        LOGGER__ERROR("read_calibration_file failed, invalid data");
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+    if (calib.theta2radius[0] != 0)
+    {
+        LOGGER__ERROR("Improper calibration file theta2radius[0] must be 0, but it is {}", calib.theta2radius[0]);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+
+    for (uint32_t i = 1; !file.eof() && i < CALIBRATION_VECOTR_SIZE; ++i)
+    {
+        std::getline(file, row);
+        calib.theta2radius.push_back(atof(row.c_str()));
+
+        if (calib.theta2radius[i] <= 0)
+        {
+            LOGGER__ERROR("theta2radius[{}] contain positive radii. is {}", i, calib.theta2radius[i]);
+            return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+        }
+        if (calib.theta2radius[i] < calib.theta2radius[i - 1])
+        {
+            LOGGER__ERROR("Improper calibration file theta2radius[{}] must be monotonically increasing, but it is not ({})", i, calib.theta2radius[i]);
+            return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+        }
+    }
+    return calib;
+}
+
+MeshSnapshot::MeshSnapshot(const std::string &path, uint64_t hash) : m_path(path), m_hash(hash)
+{
+}
+
+MeshSnapshot::~MeshSnapshot()
+{
+    if (m_mapping != nullptr)
+        munmap(m_mapping, m_mapping_size);
+}
+
+tl::expected<MeshSnapshotPtr, media_library_return> MeshSnapshot::create(const std::string &calib_path,
+                                                                         const mesh_snapshot_params_t &params)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // The calibration is read in a single read - it is needed for the hash anyway
+    std::ifstream file(calib_path, std::ios::binary);
+    if (!file.is_open())
+    {
+        LOGGER__ERROR("read_calibration_file failed, could not open file {}", calib_path);
+        return tl::make_unexpected(MEDIA_LIBRARY_CONFIGURATION_ERROR);
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    uint32_t version = MESH_SNAPSHOT_VERSION;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = fnv1a_hash(hash, &version, sizeof(version));
+    hash = fnv1a_hash(hash, text.data(), text.size());
+    hash = fnv1a_hash(hash, &params.camera_type, sizeof(params.camera_type));
+    hash = fnv1a_hash(hash, &params.camera_fov, sizeof(params.camera_fov));
+    hash = fnv1a_hash(hash, &params.generate_resize_grid, sizeof(params.generate_resize_grid));
+
+    std::stringstream path;
+    path << MESH_SNAPSHOT_DIR << "/mesh_" << std::hex << hash << ".bin";
+    MeshSnapshotPtr snapshot = MeshSnapshotPtr(new MeshSnapshot(path.str(), hash));
+
+    if (snapshot->load())
+    {
+        uint64_t load_us = elapsed_us(start);
+        LOGGER__INFO("Loaded calibration and {} meshes from snapshot {} in {} us (generating them took {} us, saved {} us)",
+                     snapshot->m_meshes.size(), snapshot->m_path, load_us, snapshot->m_generation_us,
+                     (int64_t)snapshot->m_generation_us - (int64_t)load_us);
+        return snapshot;
+    }
+
+    // No matching snapshot - parse the text calibration
+    auto expected_calib = mesh_calibration_parse(text);
+    if (!expected_calib.has_value())
+        return tl::make_unexpected(expected_calib.error());
+    snapshot->m_calibration = expected_calib.value();
+    snapshot->m_generation_us = elapsed_us(start);
+    snapshot->m_dirty = true;
+    LOGGER__INFO("No mesh snapshot for calibration {}, parsed it in {} us", calib_path, snapshot->m_generation_us);
+    return snapshot;
+}
+
+bool MeshSnapshot::load()
+{
+    int fd = open(m_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mesh_snapshot_header_t))
+    {
+        close(fd);
+        return false;
+    }
+    m_mapping_size = st.st_size;
+    m_mapping = mmap(nullptr, m_mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m_mapping == MAP_FAILED)
+    {
+        m_mapping = nullptr;
+        return false;
+    }
+
+    const uint8_t *data = static_cast<const uint8_t *>(m_mapping);
+    const uint8_t *end = data + m_mapping_size;
+    mesh_snapshot_header_t header;
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+    if (header.magic != MESH_SNAPSHOT_MAGIC || header.version != MESH_SNAPSHOT_VERSION || header.hash != m_hash ||
+        header.theta2radius_size > CALIBRATION_VECOTR_SIZE + 1 ||
+        (size_t)(end - data) < header.theta2radius_size * sizeof(float))
+    {
+        LOGGER__WARNING("Mesh snapshot {} does not match, ignoring it", m_path);
+        return false;
+    }
+
+    m_calibration.res = ivec2(header.res_x, header.res_y);
+    m_calibration.oc = vec2(header.oc_x, header.oc_y);
+    m_calibration.theta2radius.resize(header.theta2radius_size);
+    memcpy(m_calibration.theta2radius.data(), data, header.theta2radius_size * sizeof(float));
+    data += header.theta2radius_size * sizeof(float);
+
+    for (uint32_t i = 0; i < header.num_meshes; i++)
+    {
+        mesh_snapshot_mesh_header_t mesh_header;
+        if ((size_t)(end - data) < sizeof(mesh_header))
+            break;
+        memcpy(&mesh_header, data, sizeof(mesh_header));
+        data += sizeof(mesh_header);
+
+        size_t table_size = (size_t)mesh_header.mesh_width * mesh_header.mesh_height * 2 * sizeof(int32_t);
+        if ((size_t)(end - data) < table_size)
+        {
+            LOGGER__WARNING("Mesh snapshot {} is truncated, using {} of {} meshes", m_path, i, header.num_meshes);
+            break;
+        }
+        snapshot_mesh_t mesh;
+        mesh.key = {mesh_header.magnification_bucket, (FlipMirrorRot)mesh_header.flip_mirror_rot, mesh_header.width, mesh_header.height};
+        mesh.mesh_width = mesh_header.mesh_width;
+        mesh.mesh_height = mesh_header.mesh_height;
+        mesh.table = reinterpret_cast<const int32_t *>(data);
+        m_meshes.push_back(std::move(mesh));
+        data += table_size;
+    }
+    m_generation_us = header.generation_us;
+    return true;
+}
+
+const dis_calibration_t &MeshSnapshot::get_calibration() const
+{
+    return m_calibration;
+}
+
+bool MeshSnapshot::find_mesh(const mesh_cache_key_t &key, dsp_dewarp_mesh_t &mesh)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (const snapshot_mesh_t &snapshot_mesh : m_meshes)
+    {
+        if (snapshot_mesh.key != key)
+            continue;
+        mesh.mesh_width = snapshot_mesh.mesh_width;
+        mesh.mesh_height = snapshot_mesh.mesh_height;
+        mesh.mesh_table = const_cast<int32_t *>(snapshot_mesh.table);
+        return true;
+    }
+    return false;
+}
+
+void MeshSnapshot::add_mesh(const mesh_cache_key_t &key, const dsp_dewarp_mesh_t &mesh, uint64_t generation_us)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_meshes.size() >= MESH_SNAPSHOT_MAX_MESHES)
+        return;
+    for (const snapshot_mesh_t &snapshot_mesh : m_meshes)
+    {
+        if (snapshot_mesh.key == key)
+            return;
+    }
+
+    snapshot_mesh_t snapshot_mesh;
+    snapshot_mesh.key = key;
+    snapshot_mesh.mesh_width = mesh.mesh_width;
+    snapshot_mesh.mesh_height = mesh.mesh_height;
+    const int32_t *table = static_cast<const int32_t *>(mesh.mesh_table);
+    snapshot_mesh.owned_table.assign(table, table + mesh.mesh_width * mesh.mesh_height * 2);
+    snapshot_mesh.table = snapshot_mesh.owned_table.data();
+    m_meshes.push_back(std::move(snapshot_mesh));
+    m_generation_us += generation_us;
+    m_dirty = true;
+}
+
+bool MeshSnapshot::has_unsaved_meshes()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_dirty;
+}
+
+media_library_return MeshSnapshot::save()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_dirty)
+        return MEDIA_LIBRARY_SUCCESS;
+
+    if (mkdir(MESH_SNAPSHOT_DIR, 0755) != 0 && errno != EEXIST)
+    {
+        LOGGER__WARNING("Failed to create mesh snapshot directory {}, errno {}", MESH_SNAPSHOT_DIR, errno);
+        return MEDIA_LIBRARY_ERROR;
+    }
+
+    // Write to a temporary file and rename, so a concurrent load never sees a partial snapshot
+    std::string tmp_path = m_path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        LOGGER__WARNING("Failed to open mesh snapshot {} for writing", tmp_path);
+        return MEDIA_LIBRARY_ERROR;
+    }
+
+    mesh_snapshot_header_t header = {MESH_SNAPSHOT_MAGIC, MESH_SNAPSHOT_VERSION, m_hash, m_generation_us,
+                                     m_calibration.res.x, m_calibration.res.y, m_calibration.oc.x, m_calibration.oc.y,
+                                     (uint32_t)m_calibration.theta2radius.size(), (uint32_t)m_meshes.size()};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(m_calibration.theta2radius.data()), m_calibration.theta2radius.size() * sizeof(float));
+    for (const snapshot_mesh_t &mesh : m_meshes)
+    {
+        mesh_snapshot_mesh_header_t mesh_header = {mesh.key.magnification_bucket, (uint32_t)mesh.key.flip_mirror_rot,
+                                                   mesh.key.width, mesh.key.height, mesh.mesh_width, mesh.mesh_height};
+        file.write(reinterpret_cast<const char *>(&mesh_header), sizeof(mesh_header));
+        file.write(reinterpret_cast<const char *>(mesh.table), (size_t)mesh.mesh_width * mesh.mesh_height * 2 * sizeof(int32_t));
+    }
+    file.close();
+    if (file.fail() || rename(tmp_path.c_str(), m_path.c_str()) != 0)
+    {
+        LOGGER__WARNING("Failed to write mesh snapshot {}", m_path);
+        unlink(tmp_path.c_str());
+        return MEDIA_LIBRARY_ERROR;
+    }
+
+    m_dirty = false;
+    LOGGER__INFO("Saved calibration and {} meshes to snapshot {}", m_meshes.size(), m_path);
+    return MEDIA_LIBRARY_SUCCESS;
+}
+
+MeshCache::builder_t mesh_snapshot_builder(MeshSnapshotPtr snapshot, dis_config_t dis_config,
+                                           camera_type_t camera_type, float camera_fov)
+{
+    return [snapshot, dis_config, camera_type, camera_fov](const mesh_cache_key_t &key) -> tl::expected<MeshCacheEntryPtr, media_library_return>
+    {
+        dsp_dewarp_mesh_t snapshot_mesh;
+        if (!dis_config.enabled && snapshot->find_mesh(key, snapshot_mesh))
+            return mesh_cache_load_entry(snapshot_mesh);
+
+        auto start = std::chrono::steady_clock::now();
+        auto expected_entry = mesh_cache_generate_entry(key, dis_config, snapshot->get_calibration(), camera_type, camera_fov);
+        if (!expected_entry.has_value())
+            return expected_entry;
+
+        uint64_t generation_us = elapsed_us(start);
+        void *mesh_table = expected_entry.value()->mesh.mesh_table;
+        DmaMemoryAllocator::get_instance().dmabuf_sync_start(mesh_table);
+        snapshot->add_mesh(key, expected_entry.value()->mesh, generation_us);
+        DmaMemoryAllocator::get_instance().dmabuf_sync_end(mesh_table);
+        return expected_entry;
+    };
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file mesh_snapshot.hpp
+ * @brief Versioned binary snapshot of a parsed sensor calibration and its generated dewarp meshes
+ **/
+
+#pragma once
+#include "dsp_utils.hpp"
+#include "interface_types.h"
+#include "media_library_types.hpp"
+#include "mesh_cache.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tl/expected.hpp>
+#include <vector>
+
+#define MESH_SNAPSHOT_MAGIC (0x48534d48) // "HMSH"
+// Bump on any change of the file layout or of the mesh generation, old snapshots are then ignored
+#define MESH_SNAPSHOT_VERSION (1)
+#define MESH_SNAPSHOT_DIR "/var/cache/hailo_media_library"
+// Maximum number of meshes kept in a snapshot - enough for the rotations and a few zoom levels
+#define MESH_SNAPSHOT_MAX_MESHES (16)
+
+/**
+ * @brief Configuration the meshes of a snapshot depend on, in addition to the calibration file content
+ */
+struct mesh_snapshot_params_t
+{
+    camera_type_t camera_type;
+    float camera_fov;
+    bool generate_resize_grid;
+};
+
+/**
+ * @brief Parse the text sensor calibration format
+ * First row is a comment, then width, height, optical center x, y and the theta2radius LUT - one value per row.
+ */
+tl::expected<dis_calibration_t, media_library_return> mesh_calibration_parse(const std::string &text);
+
+/**
+ * @brief Calibration and meshes of a sensor, loaded from a binary snapshot when one matches.
+ * The snapshot file is named after a hash of the calibration file content, the mesh related configuration and the
+ * snapshot version, so any change of these falls back to text parsing and mesh generation. It is mapped as a
+ * whole - no parsing is done on a hit.
+ */
+class MeshSnapshot
+{
+public:
+    /**
+     * @brief Read the calibration file and load the matching snapshot, or parse the calibration text.
+     */
+    static tl::expected<std::shared_ptr<MeshSnapshot>, media_library_return> create(const std::string &calib_path,
+                                                                                     const mesh_snapshot_params_t &params);
+    ~MeshSnapshot();
+    MeshSnapshot(const MeshSnapshot &) = delete;
+    MeshSnapshot &operator=(const MeshSnapshot &) = delete;
+
+    const dis_calibration_t &get_calibration() const;
+
+    /**
+     * @brief Find a snapshot mesh. The table stays valid for the lifetime of the snapshot.
+     */
+    bool find_mesh(const mesh_cache_key_t &key, dsp_dewarp_mesh_t &mesh);
+
+    /**
+     * @brief Record a generated mesh so it is part of the next saved snapshot.
+     *
+     * @param[in] generation_us - time it took to generate the mesh, reported as saved on later loads
+     */
+    void add_mesh(const mesh_cache_key_t &key, const dsp_dewarp_mesh_t &mesh, uint64_t generation_us);
+
+    /**
+     * @brief Write the snapshot if meshes were added since it was loaded.
+     */
+    media_library_return save();
+
+    /**
+     * @brief Whether meshes were added since the snapshot was loaded or last saved.
+     */
+    bool has_unsaved_meshes();
+
+private:
+    struct snapshot_mesh_t
+    {
+        mesh_cache_key_t key;
+        uint32_t mesh_width;
+        uint32_t mesh_height;
+        // points into the mapped file, or into owned_table for meshes added since loading
+        const int32_t *table;
+        std::vector<int32_t> owned_table;
+    };
+
+    std::string m_path;
+    uint64_t m_hash;
+    dis_calibration_t m_calibration;
+    std::vector<snapshot_mesh_t> m_meshes;
+    // time it took to parse the calibration and generate the meshes of the snapshot
+    uint64_t m_generation_us = 0;
+    bool m_dirty = false;
+    void *m_mapping = nullptr;
+    size_t m_mapping_size = 0;
+    std::mutex m_mutex;
+
+    MeshSnapshot(const std::string &path, uint64_t hash);
+    bool load();
+};
+using MeshSnapshotPtr = std::shared_ptr<MeshSnapshot>;
+
+/**
+ * @brief Mesh cache builder backed by a snapshot.
+ * Meshes found in the snapshot are copied as is when DIS is disabled (no DIS instance is needed then),
+ * other meshes are generated and recorded in the snapshot.
+ */
+MeshCache::builder_t mesh_snapshot_builder(MeshSnapshotPtr snapshot, dis_config_t dis_config,
+                                           camera_type_t camera_type, float camera_fov);
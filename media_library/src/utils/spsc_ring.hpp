@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2017-2024 Hailo Technologies Ltd. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @file spsc_ring.hpp
+ * @brief Bounded lock-free single producer single consumer ring with blocking push and pop
+ **/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Keeps the producer and consumer indices on separate cache lines
+#define SPSC_RING_CACHE_LINE_SIZE (64)
+
+/**
+ * @brief Bounded ring passing items from one producer thread to one consumer thread.
+ *
+ * The indices are atomics, so a push or pop that does not wait takes no lock and makes no system call.
+ * A full push or an empty pop sleeps on a futex (std::atomic::wait), and the other side only wakes it
+ * when a waiter is registered - a ring that keeps up never enters the kernel.
+ * Closing the ring wakes both sides, pop still returns the queued items and push fails.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    SpscRing(size_t capacity) : m_capacity(capacity), m_slots(capacity + 1) {}
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /**
+     * @brief Push an item, waiting while the ring is full. Producer thread only.
+     *
+     * @return false if the ring is closed, the item is not queued
+     */
+    bool push(T item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = increment(tail);
+        while (next == m_head.load(std::memory_order_acquire))
+        {
+            if (!wait_for(m_space_events, [this, next]
+                          { return next != m_head.load(std::memory_order_acquire); }))
+                return false;
+        }
+        if (m_closed.load(std::memory_order_acquire))
+            return false;
+
+        m_slots[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_release);
+        signal(m_item_events);
+        return true;
+    }
+
+    /**
+     * @brief Pop an item, waiting while the ring is empty. Consumer thread only.
+     *
+     * @return the item, or nothing if the ring is empty and closed
+     */
+    std::optional<T> pop()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        while (head == m_tail.load(std::memory_order_acquire))
+        {
+            if (!wait_for(m_item_events, [this, head]
+                          { return head != m_tail.load(std::memory_order_acquire); }))
+                return std::nullopt;
+        }
+
+        T item = std::move(m_slots[head]);
+        m_slots[head] = T();
+        m_head.store(increment(head), std::memory_order_release);
+        signal(m_space_events);
+        return item;
+    }
+
+    /**
+     * @brief Pop an item if there is one, without waiting. Consumer thread only.
+     */
+    std::optional<T> try_pop()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return std::nullopt;
+
+        T item = std::move(m_slots[head]);
+        m_slots[head] = T();
+        m_head.store(increment(head), std::memory_order_release);
+        signal(m_space_events);
+        return item;
+    }
+
+    /**
+     * @brief Fail all pushes and wake both sides. Queued items can still be popped.
+     */
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        // Waiters sleep on the event words, bump them unconditionally so no waiter misses the close
+        m_item_events.fetch_add(1, std::memory_order_release);
+        m_item_events.notify_all();
+        m_space_events.fetch_add(1, std::memory_order_release);
+        m_space_events.notify_all();
+    }
+
+    /**
+     * @brief Accept pushes again. Only call while neither side is waiting.
+     */
+    void reopen()
+    {
+        m_closed.store(false, std::memory_order_release);
+    }
+
+    bool closed() const
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + m_slots.size() - head;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    const size_t m_capacity;
+    // One slot is always left empty, so a full ring is told apart from an empty one
+    std::vector<T> m_slots;
+    alignas(SPSC_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_head{0};
+    alignas(SPSC_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_tail{0};
+    // Futex words - bumped on every push (items) or pop (space) that a waiter is registered for
+    alignas(SPSC_RING_CACHE_LINE_SIZE) std::atomic<uint32_t> m_item_events{0};
+    std::atomic<uint32_t> m_item_waiters{0};
+    alignas(SPSC_RING_CACHE_LINE_SIZE) std::atomic<uint32_t> m_space_events{0};
+    std::atomic<uint32_t> m_space_waiters{0};
+    std::atomic<bool> m_closed{false};
+
+    size_t increment(size_t index) const
+    {
+        return index + 1 == m_slots.size() ? 0 : index + 1;
+    }
+
+    std::atomic<uint32_t> &waiters_of(std::atomic<uint32_t> &events)
+    {
+        return &events == &m_item_events ? m_item_waiters : m_space_waiters;
+    }
+
+    void signal(std::atomic<uint32_t> &events)
+    {
+        // Pairs with the fence in wait_for - either the waiter sees the new index or it is seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_of(events).load(std::memory_order_relaxed) == 0)
+            return;
+        events.fetch_add(1, std::memory_order_release);
+        events.notify_one();
+    }
+
+    /**
+     * @brief Sleep until ready() holds or the ring is closed.
+     *
+     * @return true if ready() holds, false if the ring was closed first
+     */
+    template <typename ready_t>
+    bool wait_for(std::atomic<uint32_t> &events, ready_t ready)
+    {
+        std::atomic<uint32_t> &waiters = waiters_of(events);
+        while (true)
+        {
+            uint32_t observed = events.load(std::memory_order_acquire);
+            waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready())
+            {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (m_closed.load(std::memory_order_acquire))
+            {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            events.wait(observed, std::memory_order_acquire);
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+};
@@ -425,13 +425,18 @@ media_library_return MediaLibraryVisionPreProc::Impl::perform_dewarp(
     }
 
     // Perform dewarp
-    dsp_dewarp_mesh_t *mesh = m_dewarp_mesh_ctx->get();
+    std::shared_ptr<dsp_dewarp_mesh_t> mesh = m_dewarp_mesh_ctx->get();
+    if (mesh == nullptr)
+    {
+        LOGGER__ERROR("Dewarp mesh is not initialized");
+        return MEDIA_LIBRARY_UNINITIALIZED;
+    }
     LOGGER__TRACE("Performing dewarp with mesh (w={}, h={}) interpolation type {}", mesh->mesh_width, mesh->mesh_height, m_pre_proc_configs.dewarp_config.interpolation_type);
     clock_gettime(CLOCK_MONOTONIC, &start_dewarp);
     dsp_status ret = dsp_utils::perform_dsp_dewarp(
         input_buffer.hailo_pix_buffer.get(),
         dewarp_output_buffer.hailo_pix_buffer.get(),
-        mesh,
+        mesh.get(),
         m_pre_proc_configs.dewarp_config.interpolation_type);
     clock_gettime(CLOCK_MONOTONIC, &end_dewarp);
     [[maybe_unused]] long ms = (long)media_library_difftimespec_ms(end_dewarp, start_dewarp);